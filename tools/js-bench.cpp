@@ -0,0 +1,438 @@
+/*
+ * Micro-benchmarks of js plugin, run without WeeChat (plugin objects are
+ * linked with a stub of WeeChat API). Results are written as JSON.
+ *
+ * Usage: js-bench [-n iterations] [-o file.json] [-v]
+ */
+
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <v8.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+#include "weechat-stub.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-profile.h"
+
+using namespace v8;
+
+#define BENCH_ITERATIONS_DEFAULT 100000
+#define BENCH_LOAD_ITERATIONS 200
+#define BENCH_REPEAT 3                       /* best of N runs              */
+#define BENCH_FANOUT_SCRIPTS 50
+
+struct t_bench_result
+{
+    std::string name;                        /* name of benchmark           */
+    long long ops;                           /* number of operations        */
+    double ns_per_op;                        /* time by operation (ns)      */
+};
+
+std::vector<struct t_bench_result> bench_results;
+std::vector<std::string> bench_files;
+char bench_home[] = "/tmp/weechat-js-bench.XXXXXX";
+
+/* script with one function per binding measured, each running n calls */
+const char *bench_script =
+    "weechat.register('bench', 'bench', '0.1', 'GPL3', 'benchmark', '', '');\n"
+    "var option = weechat.config_get('weechat.bench.integer');\n"
+    "function bench_empty(n) {\n"
+    "    for (var i = 0; i < n; i++) {}\n"
+    "    return 0;\n"
+    "}\n"
+    "function bench_prnt(n) {\n"
+    "    for (var i = 0; i < n; i++)\n"
+    "        weechat.prnt('', 'benchmark line');\n"
+    "    return 0;\n"
+    "}\n"
+    "function bench_config_integer(n) {\n"
+    "    for (var i = 0; i < n; i++)\n"
+    "        weechat.config_integer(option);\n"
+    "    return 0;\n"
+    "}\n"
+    "function bench_list(n) {\n"
+    "    var list = weechat.list_new();\n"
+    "    for (var i = 0; i < n; i++) {\n"
+    "        weechat.list_add(list, 'item', 'end', '');\n"
+    "        weechat.list_search(list, 'item');\n"
+    "        weechat.list_remove_all(list);\n"
+    "    }\n"
+    "    weechat.list_free(list);\n"
+    "    return 0;\n"
+    "}\n"
+    "function bench_string_eval_expression(n) {\n"
+    "    var vars = { 'nick': 'alice', 'channel': '#weechat' };\n"
+    "    for (var i = 0; i < n; i++)\n"
+    "        weechat.string_eval_expression('${nick} on ${channel}', {}, vars);\n"
+    "    return 0;\n"
+    "}\n";
+
+/* script loaded/unloaded in a loop */
+const char *bench_script_load =
+    "weechat.register('bench_load', 'bench', '0.1', 'GPL3', 'benchmark', '', '');\n"
+    "var table = {};\n"
+    "for (var i = 0; i < 100; i++)\n"
+    "    table['key' + i] = function (x) { return x + i; };\n"
+    "function unused(data, buffer, args) { return 0; }\n";
+
+/* script subscribed to a signal (loaded N times for fan-out) */
+const char *bench_script_signal =
+    "weechat.register('bench_signal_%d', 'bench', '0.1', 'GPL3', 'benchmark', '', '');\n"
+    "var count = 0;\n"
+    "weechat.hook_signal('bench_fanout', 'on_signal', '');\n"
+    "function on_signal(data, signal, type_data, signal_data) {\n"
+    "    count++;\n"
+    "    return 0;\n"
+    "}\n";
+
+/*
+ * Writes a script in bench home.
+ *
+ * Returns path to script.
+ */
+
+std::string
+bench_write_script (const char *name, const char *content)
+{
+    std::string path;
+    FILE *file;
+
+    path = std::string(bench_home) + "/" + name;
+    file = fopen(path.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "js-bench: unable to write %s\n", path.c_str());
+        exit(1);
+    }
+    fputs(content, file);
+    fclose(file);
+    bench_files.push_back(path);
+
+    return path;
+}
+
+/*
+ * Adds a result.
+ */
+
+void
+bench_add_result (const char *name, long long ops, unsigned long long ns)
+{
+    struct t_bench_result result;
+
+    result.name = name;
+    result.ops = ops;
+    result.ns_per_op = (ops > 0) ? (double) ns / ops : 0;
+    bench_results.push_back(result);
+
+    fprintf(stderr, "%-32s %12lld ops %12.1f ns/op\n",
+            name, ops, result.ns_per_op);
+}
+
+/*
+ * Runs a js function of bench script with number of iterations.
+ *
+ * Returns time spent (ns), best of BENCH_REPEAT runs.
+ */
+
+unsigned long long
+bench_run_js (struct t_plugin_script *script, const char *function,
+              long long iterations)
+{
+    HandleScope scope;
+    Handle<Value> argv[1];
+    unsigned long long start, duration, best;
+    int i;
+
+    best = 0;
+    for (i = 0; i < BENCH_REPEAT; i++)
+    {
+        argv[0] = Number::New(iterations);
+        start = weechat_js_profile_now();
+        weechat_js_exec_function(script, function, 1, argv);
+        duration = weechat_js_profile_now() - start;
+        if ((i == 0) || (duration < best))
+            best = duration;
+    }
+
+    return best;
+}
+
+/*
+ * Measures bindings called from js: cost of a call is time of loop with
+ * call minus time of empty loop.
+ */
+
+void
+bench_bindings (long long iterations)
+{
+    static const char *bindings[] = { "prnt", "config_integer", "list",
+                                      "string_eval_expression", NULL };
+    struct t_plugin_script *script;
+    unsigned long long empty, duration;
+    char function[128];
+    int i;
+
+    weechat_stub_config_set("weechat.bench.integer", "42");
+
+    if (!weechat_js_load(bench_write_script("bench.js", bench_script).c_str()))
+    {
+        fprintf(stderr, "js-bench: unable to load bench script\n");
+        exit(1);
+    }
+    script = weechat_js_script_search("bench");
+
+    empty = bench_run_js(script, "bench_empty", iterations);
+    for (i = 0; bindings[i]; i++)
+    {
+        snprintf(function, sizeof(function), "bench_%s", bindings[i]);
+        duration = bench_run_js(script, function, iterations);
+        bench_add_result(bindings[i], iterations,
+                         (duration > empty) ? duration - empty : 0);
+    }
+}
+
+/*
+ * Measures conversions between hashtables and js objects.
+ */
+
+void
+bench_hashtables (long long iterations)
+{
+    HandleScope scope;
+    struct t_plugin_script *script;
+    struct t_hashtable *hashtable, *result;
+    Handle<Object> object;
+    unsigned long long start;
+    char key[32], value[32];
+    long long i;
+
+    script = weechat_js_script_search("bench");
+    if (!script)
+        return;
+
+    Context::Scope context_scope(((WeechatJsCore *) script->interpreter)->getContext());
+
+    hashtable = weechat_hashtable_new(16,
+                                      WEECHAT_HASHTABLE_STRING,
+                                      WEECHAT_HASHTABLE_STRING,
+                                      NULL, NULL);
+    for (i = 0; i < 8; i++)
+    {
+        snprintf(key, sizeof(key), "key%lld", i);
+        snprintf(value, sizeof(value), "value%lld", i);
+        weechat_hashtable_set(hashtable, key, value);
+    }
+
+    start = weechat_js_profile_now();
+    for (i = 0; i < iterations; i++)
+    {
+        HandleScope loop_scope;
+        weechat_js_hashtable_to_object(hashtable);
+    }
+    bench_add_result("hashtable_to_object", iterations,
+                     weechat_js_profile_now() - start);
+
+    object = weechat_js_hashtable_to_object(hashtable);
+    start = weechat_js_profile_now();
+    for (i = 0; i < iterations; i++)
+    {
+        result = weechat_js_object_to_hashtable(object,
+                                                WEECHAT_SCRIPT_HASHTABLE_DEFAULT_SIZE,
+                                                WEECHAT_HASHTABLE_STRING,
+                                                WEECHAT_HASHTABLE_STRING);
+        if (result)
+            weechat_hashtable_free(result);
+    }
+    bench_add_result("object_to_hashtable", iterations,
+                     weechat_js_profile_now() - start);
+
+    weechat_hashtable_free(hashtable);
+}
+
+/*
+ * Measures compilation of a script, and full load/unload of a script.
+ */
+
+void
+bench_load ()
+{
+    struct t_plugin_script *script;
+    std::string path;
+    unsigned long long start;
+    int i;
+
+    {
+        HandleScope scope;
+        Persistent<Context> context = Context::New();
+        Context::Scope context_scope(context);
+        Handle<String> source = String::New(bench_script_load);
+
+        start = weechat_js_profile_now();
+        for (i = 0; i < BENCH_LOAD_ITERATIONS; i++)
+        {
+            HandleScope loop_scope;
+            Script::Compile(source, String::New("bench_load.js"));
+        }
+        bench_add_result("script_compile", BENCH_LOAD_ITERATIONS,
+                         weechat_js_profile_now() - start);
+        context.Dispose();
+    }
+
+    path = bench_write_script("bench_load.js", bench_script_load);
+    start = weechat_js_profile_now();
+    for (i = 0; i < BENCH_LOAD_ITERATIONS; i++)
+    {
+        weechat_js_load(path.c_str());
+        script = weechat_js_script_search("bench_load");
+        if (script)
+            weechat_js_unload(script);
+    }
+    bench_add_result("script_load_unload", BENCH_LOAD_ITERATIONS,
+                     weechat_js_profile_now() - start);
+}
+
+/*
+ * Measures a signal sent to many scripts.
+ */
+
+void
+bench_signal_fanout (long long iterations)
+{
+    char name[64], *content;
+    unsigned long long start;
+    long long i, sends;
+    int length;
+
+    length = strlen(bench_script_signal) + 32;
+    content = (char *) malloc(length);
+    if (!content)
+        return;
+    for (i = 0; i < BENCH_FANOUT_SCRIPTS; i++)
+    {
+        snprintf(name, sizeof(name), "bench_signal_%lld.js", i);
+        snprintf(content, length, bench_script_signal, (int) i);
+        weechat_js_load(bench_write_script(name, content).c_str());
+    }
+    free(content);
+
+    sends = iterations / BENCH_FANOUT_SCRIPTS;
+    if (sends < 1)
+        sends = 1;
+    start = weechat_js_profile_now();
+    for (i = 0; i < sends; i++)
+    {
+        weechat_stub_signal_send("bench_fanout", WEECHAT_HOOK_SIGNAL_STRING,
+                                 (void *) "data");
+    }
+    bench_add_result("signal_fanout_50_scripts", sends,
+                     weechat_js_profile_now() - start);
+}
+
+/*
+ * Writes results as JSON.
+ */
+
+void
+bench_write_json (FILE *file, long long iterations)
+{
+    size_t i;
+
+    fprintf(file, "{\n  \"iterations\": %lld,\n  \"results\": [\n", iterations);
+    for (i = 0; i < bench_results.size(); i++)
+    {
+        fprintf(file, "    {\"name\": ");
+        weechat_js_fprint_json_string(file, bench_results[i].name.c_str());
+        fprintf(file, ", \"ops\": %lld, \"ns_per_op\": %.1f}%s\n",
+                bench_results[i].ops, bench_results[i].ns_per_op,
+                (i + 1 < bench_results.size()) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+    struct t_weechat_plugin *plugin;
+    const char *output;
+    long long iterations;
+    FILE *file;
+    size_t i;
+    int opt;
+
+    iterations = BENCH_ITERATIONS_DEFAULT;
+    output = NULL;
+    while ((opt = getopt(argc, argv, "n:o:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                iterations = atoll(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'v':
+                weechat_stub_verbose = 1;
+                break;
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-n iterations] [-o file.json] [-v]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (iterations < 1)
+        iterations = BENCH_ITERATIONS_DEFAULT;
+
+    if (!mkdtemp(bench_home))
+    {
+        perror("js-bench: mkdtemp");
+        return 1;
+    }
+
+    plugin = weechat_stub_plugin_new(JS_PLUGIN_NAME, bench_home);
+    if (!plugin || (weechat_plugin_init(plugin, 0, NULL) != WEECHAT_RC_OK))
+    {
+        fprintf(stderr, "js-bench: unable to initialize plugin\n");
+        return 1;
+    }
+
+    bench_bindings(iterations);
+    bench_hashtables(iterations);
+    bench_load();
+    bench_signal_fanout(iterations);
+
+    weechat_plugin_end(plugin);
+    weechat_stub_plugin_free(plugin);
+
+    for (i = 0; i < bench_files.size(); i++)
+        unlink(bench_files[i].c_str());
+    rmdir(bench_home);
+
+    file = (output) ? fopen(output, "w") : stdout;
+    if (!file)
+    {
+        perror("js-bench");
+        return 1;
+    }
+    bench_write_json(file, iterations);
+    if (file != stdout)
+        fclose(file);
+
+    return 0;
+}
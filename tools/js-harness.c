@@ -0,0 +1,392 @@
+/*
+ * Test harness for js plugin: runs scenarios against js.so loaded in a
+ * headless WeeChat (see js-host.h).
+ *
+ * Usage: js-harness [-p plugin.so] [-d home] [-q] [scenario...]
+ *
+ * A scenario (read on stdin if no file is given) has one directive by line
+ * (empty lines and lines beginning with "#" are ignored):
+ *
+ *   load <file>                   load a script
+ *   unload <name>                 unload a script
+ *   command <command>             execute command on core buffer
+ *   input <buffer> <text>         send text (or command) to a buffer
+ *   signal <signal> [<string>]    send a signal (with string data)
+ *   print <buffer> <tags> <text>  display a line in a buffer (created if
+ *                                 needed), "\t" separates prefix and text,
+ *                                 tags "-" = no tags
+ *   set <option> <value>          set option (or plugins.var.js.xxx)
+ *   run <ms>                      run timers and fd hooks during <ms>
+ *   expect <regex>                a line displayed matches regex
+ *                                 ("prefix\tmessage"), lines before and
+ *                                 matching line are consumed
+ *   expect_not <regex>            no line displayed matches regex
+ *   clear                         forget lines displayed
+ *   write <file> <text>           append a line to a file ("\t" = tab)
+ *   truncate <file> <size>        truncate a file to <size> bytes (for
+ *                                 example to simulate an incomplete write)
+ *
+ * In arguments, "%h" is replaced by WeeChat home.
+ *
+ * Exit code is 0 if all expectations succeeded, 1 otherwise.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "weechat-stub.h"
+#include "js-host.h"
+
+int harness_failures = 0;                  /* number of failed directives  */
+
+/*
+ * Replaces "\t" by a tab in a string (in place).
+ */
+
+static void
+harness_unescape (char *string)
+{
+    char *ptr_read, *ptr_write;
+
+    ptr_read = string;
+    ptr_write = string;
+    while (ptr_read[0])
+    {
+        if ((ptr_read[0] == '\\') && (ptr_read[1] == 't'))
+        {
+            ptr_write[0] = '\t';
+            ptr_read += 2;
+        }
+        else
+        {
+            ptr_write[0] = ptr_read[0];
+            ptr_read++;
+        }
+        ptr_write++;
+    }
+    ptr_write[0] = '\0';
+}
+
+/*
+ * Replaces "%h" by WeeChat home in a string.
+ *
+ * Note: result must be freed after use.
+ */
+
+static char *
+harness_expand_home (const char *string, const char *home)
+{
+    const char *ptr_string, *pos;
+    char *result;
+    int count, length_home;
+
+    count = 0;
+    for (pos = strstr(string, "%h"); pos; pos = strstr(pos + 2, "%h"))
+    {
+        count++;
+    }
+
+    length_home = strlen(home);
+    result = malloc(strlen(string) + (count * length_home) + 1);
+    if (!result)
+        return NULL;
+    result[0] = '\0';
+
+    ptr_string = string;
+    while ((pos = strstr(ptr_string, "%h")))
+    {
+        strncat(result, ptr_string, pos - ptr_string);
+        strcat(result, home);
+        ptr_string = pos + 2;
+    }
+    strcat(result, ptr_string);
+
+    return result;
+}
+
+/*
+ * Appends a line to a file.
+ *
+ * Returns 1 if OK, 0 if error.
+ */
+
+static int
+harness_write (const char *filename, const char *text)
+{
+    FILE *file;
+    int rc;
+
+    file = fopen(filename, "a");
+    if (!file)
+        return 0;
+    rc = (fprintf(file, "%s\n", text) >= 0) ? 1 : 0;
+    if (fclose(file) != 0)
+        rc = 0;
+
+    return rc;
+}
+
+/*
+ * Splits first word of a string: returns pointer to string after word and
+ * spaces (word is terminated in place), NULL if there is no word.
+ */
+
+static char *
+harness_next_word (char *string, char **word)
+{
+    *word = NULL;
+
+    while (string[0] == ' ')
+        string++;
+    if (!string[0])
+        return NULL;
+
+    *word = string;
+    while (string[0] && (string[0] != ' '))
+        string++;
+    if (string[0])
+    {
+        string[0] = '\0';
+        string++;
+        while (string[0] == ' ')
+            string++;
+    }
+
+    return string;
+}
+
+/*
+ * Displays a failure.
+ */
+
+static void
+harness_fail (const char *scenario, int line_number, const char *line,
+              const char *reason)
+{
+    fprintf(stderr, "%s:%d: %s: %s\n", scenario, line_number, reason, line);
+    harness_failures++;
+}
+
+/*
+ * Executes a directive of scenario.
+ */
+
+static void
+harness_directive (struct t_js_host *host, const char *scenario,
+                   int line_number, char *line)
+{
+    char *copy, *directive, *args, *arg1, *arg2;
+    int rc;
+
+    copy = harness_expand_home(line, host->home);
+    if (!copy)
+        return;
+
+    args = harness_next_word(copy, &directive);
+    if (!directive || (directive[0] == '#'))
+        goto end;
+
+    if (strcmp(directive, "load") == 0)
+    {
+        if (!args[0])
+            harness_fail(scenario, line_number, line, "missing file");
+        else
+            js_host_load(host, args);
+    }
+    else if (strcmp(directive, "unload") == 0)
+    {
+        if (!args[0])
+            harness_fail(scenario, line_number, line, "missing name");
+        else
+            js_host_unload(host, args);
+    }
+    else if (strcmp(directive, "command") == 0)
+    {
+        if (js_host_command(host, NULL, args) != WEECHAT_RC_OK)
+            harness_fail(scenario, line_number, line, "command failed");
+    }
+    else if (strcmp(directive, "input") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (!arg1)
+            harness_fail(scenario, line_number, line, "missing buffer");
+        else if (js_host_command(host, arg1, args) != WEECHAT_RC_OK)
+            harness_fail(scenario, line_number, line, "input failed");
+    }
+    else if (strcmp(directive, "signal") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (!arg1)
+            harness_fail(scenario, line_number, line, "missing signal");
+        else
+        {
+            weechat_stub_signal_send(arg1, WEECHAT_HOOK_SIGNAL_STRING,
+                                     (args && args[0]) ? args : NULL);
+        }
+    }
+    else if (strcmp(directive, "print") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (args)
+            args = harness_next_word(args, &arg2);
+        if (!arg1 || !args)
+            harness_fail(scenario, line_number, line, "missing arguments");
+        else
+        {
+            harness_unescape(args);
+            js_host_print(host, arg1, (strcmp(arg2, "-") == 0) ? NULL : arg2,
+                          args);
+        }
+    }
+    else if (strcmp(directive, "set") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (!arg1)
+            harness_fail(scenario, line_number, line, "missing option");
+        else
+            weechat_stub_config_set(arg1, (args) ? args : "");
+    }
+    else if (strcmp(directive, "run") == 0)
+    {
+        weechat_stub_run(atol(args));
+    }
+    else if ((strcmp(directive, "expect") == 0)
+             || (strcmp(directive, "expect_not") == 0))
+    {
+        harness_unescape(args);
+        rc = js_host_expect(host, args, (directive[6] == '_') ? 1 : 0);
+        if (rc < 0)
+            harness_fail(scenario, line_number, line, "invalid regex");
+        else if (rc == 0)
+            harness_fail(scenario, line_number, line, "expectation failed");
+    }
+    else if (strcmp(directive, "clear") == 0)
+    {
+        js_host_clear(host);
+    }
+    else if (strcmp(directive, "write") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (!arg1)
+            harness_fail(scenario, line_number, line, "missing file");
+        else
+        {
+            harness_unescape(args);
+            if (!harness_write(arg1, args))
+                harness_fail(scenario, line_number, line, "write failed");
+        }
+    }
+    else if (strcmp(directive, "truncate") == 0)
+    {
+        args = harness_next_word(args, &arg1);
+        if (!arg1 || !args || !args[0])
+            harness_fail(scenario, line_number, line, "missing arguments");
+        else if (truncate(arg1, atol(args)) < 0)
+            harness_fail(scenario, line_number, line, "truncate failed");
+    }
+    else
+    {
+        harness_fail(scenario, line_number, line, "unknown directive");
+    }
+
+end:
+    free(copy);
+}
+
+/*
+ * Runs a scenario (filename NULL = stdin).
+ *
+ * Returns 1 if OK, 0 if file can not be read.
+ */
+
+static int
+harness_run_scenario (struct t_js_host *host, const char *filename)
+{
+    FILE *file;
+    char line[8192];
+    int line_number;
+    size_t length;
+
+    file = (filename) ? fopen(filename, "r") : stdin;
+    if (!file)
+    {
+        perror(filename);
+        return 0;
+    }
+
+    line_number = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        line_number++;
+        length = strlen(line);
+        while ((length > 0)
+               && ((line[length - 1] == '\n') || (line[length - 1] == '\r')))
+        {
+            line[--length] = '\0';
+        }
+        harness_directive(host, (filename) ? filename : "<stdin>",
+                          line_number, line);
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    return 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+    struct t_js_host *host;
+    const char *plugin, *home;
+    int opt, echo, i, rc;
+
+    plugin = NULL;
+    home = NULL;
+    echo = 1;
+    while ((opt = getopt(argc, argv, "p:d:q")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                plugin = optarg;
+                break;
+            case 'd':
+                home = optarg;
+                break;
+            case 'q':
+                echo = 0;
+                break;
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-p plugin.so] [-d home] [-q] "
+                        "[scenario...]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    host = js_host_new(plugin, home, echo);
+    if (!host)
+        return 1;
+
+    rc = 1;
+    if (optind >= argc)
+        rc = harness_run_scenario(host, NULL);
+    for (i = optind; i < argc; i++)
+    {
+        if (!harness_run_scenario(host, argv[i]))
+            rc = 0;
+    }
+
+    js_host_free(host);
+
+    if (harness_failures > 0)
+        fprintf(stderr, "js-harness: %d failure(s)\n", harness_failures);
+
+    return (rc && (harness_failures == 0)) ? 0 : 1;
+}
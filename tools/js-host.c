@@ -0,0 +1,360 @@
+/*
+ * Headless host for js plugin: loads js.so in the in-memory WeeChat of
+ * weechat-stub.c, and keeps lines printed for expectations.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <ftw.h>
+#include <regex.h>
+
+#include "weechat-stub.h"
+#include "js-host.h"
+
+struct t_js_host *js_host_current = NULL;  /* host receiving printed lines */
+
+/*
+ * Frees a line of host.
+ */
+
+static void
+js_host_line_free (struct t_js_host_line *line)
+{
+    free(line->buffer);
+    free(line->text);
+    free(line);
+}
+
+/*
+ * Callback for lines printed in buffers of stub.
+ */
+
+static void
+js_host_print_cb (struct t_gui_buffer *buffer, time_t date, const char *tags,
+                  const char *prefix, const char *message)
+{
+    struct t_js_host *host;
+    struct t_js_host_line *new_line, *old_line;
+    size_t length;
+
+    host = js_host_current;
+    if (!host)
+        return;
+
+    if (host->echo)
+        printf("[%s] %s\t%s\n", buffer->full_name, prefix, message);
+
+    new_line = calloc(1, sizeof(*new_line));
+    if (!new_line)
+        return;
+    new_line->buffer = strdup(buffer->full_name);
+    length = strlen(prefix) + 1 + strlen(message) + 1;
+    new_line->text = malloc(length);
+    if (new_line->text)
+        snprintf(new_line->text, length, "%s\t%s", prefix, message);
+    if (!new_line->buffer || !new_line->text)
+    {
+        js_host_line_free(new_line);
+        return;
+    }
+
+    if (host->last_line)
+        host->last_line->next_line = new_line;
+    else
+        host->lines = new_line;
+    host->last_line = new_line;
+    host->lines_count++;
+
+    if (host->lines_count > JS_HOST_MAX_LINES)
+    {
+        old_line = host->lines;
+        host->lines = old_line->next_line;
+        js_host_line_free(old_line);
+        host->lines_count--;
+    }
+}
+
+/*
+ * Removes a file of temporary home (callback of nftw).
+ */
+
+static int
+js_host_remove_cb (const char *path, const struct stat *st, int flag,
+                   struct FTW *ftw)
+{
+    return remove(path);
+}
+
+/*
+ * Creates a host: loads js.so (filename NULL = JS_HOST_PLUGIN_DEFAULT) and
+ * initializes it, with WeeChat home "home" (NULL = temporary directory).
+ *
+ * Returns pointer to host, NULL if error.
+ */
+
+struct t_js_host *
+js_host_new (const char *filename, const char *home, int echo)
+{
+    struct t_js_host *new_host;
+    const char *plugin_name;
+    char template[] = "/tmp/weechat-js-host.XXXXXX";
+
+    new_host = calloc(1, sizeof(*new_host));
+    if (!new_host)
+        return NULL;
+    new_host->echo = echo;
+
+    if (home)
+    {
+        new_host->home = strdup(home);
+    }
+    else if (mkdtemp(template))
+    {
+        new_host->home = strdup(template);
+        new_host->home_temp = 1;
+    }
+    if (!new_host->home)
+    {
+        fprintf(stderr, "js-host: unable to create WeeChat home\n");
+        goto error;
+    }
+
+    /* symbols of plugin-script.c are resolved with the host (-rdynamic) */
+    if (!filename)
+        filename = JS_HOST_PLUGIN_DEFAULT;
+    new_host->handle = dlopen(filename, RTLD_NOW | RTLD_GLOBAL);
+    if (!new_host->handle)
+    {
+        fprintf(stderr, "js-host: unable to load plugin: %s\n", dlerror());
+        goto error;
+    }
+    plugin_name = dlsym(new_host->handle, "weechat_plugin_name");
+    *(void **)(&new_host->plugin_init) = dlsym(new_host->handle,
+                                               "weechat_plugin_init");
+    *(void **)(&new_host->plugin_end) = dlsym(new_host->handle,
+                                              "weechat_plugin_end");
+    if (!plugin_name || !new_host->plugin_init || !new_host->plugin_end)
+    {
+        fprintf(stderr, "js-host: \"%s\" is not a WeeChat plugin\n",
+                filename);
+        goto error;
+    }
+
+    new_host->plugin = weechat_stub_plugin_new(plugin_name, new_host->home);
+    if (!new_host->plugin)
+        goto error;
+    free(new_host->plugin->filename);
+    new_host->plugin->filename = strdup(filename);
+
+    js_host_current = new_host;
+    weechat_stub_print_cb = &js_host_print_cb;
+
+    if ((new_host->plugin_init) (new_host->plugin, 0, NULL) != WEECHAT_RC_OK)
+    {
+        fprintf(stderr, "js-host: unable to initialize plugin\n");
+        weechat_stub_plugin_free(new_host->plugin);
+        new_host->plugin = NULL;
+        goto error;
+    }
+
+    return new_host;
+
+error:
+    js_host_free(new_host);
+    return NULL;
+}
+
+/*
+ * Ends plugin and frees host (temporary home is removed).
+ */
+
+void
+js_host_free (struct t_js_host *host)
+{
+    if (!host)
+        return;
+
+    if (host->plugin)
+    {
+        (host->plugin_end) (host->plugin);
+        weechat_stub_plugin_free(host->plugin);
+    }
+    if (host->handle)
+        dlclose(host->handle);
+
+    js_host_clear(host);
+    if (js_host_current == host)
+    {
+        js_host_current = NULL;
+        weechat_stub_print_cb = NULL;
+    }
+
+    if (host->home && host->home_temp)
+        nftw(host->home, &js_host_remove_cb, 16, FTW_DEPTH | FTW_PHYS);
+    free(host->home);
+    free(host);
+}
+
+/*
+ * Executes a command or sends text in a buffer (full name, NULL = core
+ * buffer).
+ *
+ * Returns WEECHAT_RC_OK if OK, WEECHAT_RC_ERROR if error.
+ */
+
+int
+js_host_command (struct t_js_host *host, const char *buffer,
+                 const char *command)
+{
+    struct t_gui_buffer *ptr_buffer;
+
+    ptr_buffer = NULL;
+    if (buffer)
+    {
+        ptr_buffer = weechat_stub_buffer_search_full_name(buffer);
+        if (!ptr_buffer)
+        {
+            fprintf(stderr, "js-host: buffer \"%s\" not found\n", buffer);
+            return WEECHAT_RC_ERROR;
+        }
+    }
+
+    return weechat_stub_command(host->plugin, ptr_buffer, command);
+}
+
+/*
+ * Loads a script (with command /js load).
+ */
+
+int
+js_host_load (struct t_js_host *host, const char *filename)
+{
+    char command[4096];
+
+    snprintf(command, sizeof(command), "/%s load %s",
+             host->plugin->name, filename);
+
+    return js_host_command(host, NULL, command);
+}
+
+/*
+ * Unloads a script (with command /js unload).
+ */
+
+int
+js_host_unload (struct t_js_host *host, const char *name)
+{
+    char command[4096];
+
+    snprintf(command, sizeof(command), "/%s unload %s",
+             host->plugin->name, name);
+
+    return js_host_command(host, NULL, command);
+}
+
+/*
+ * Displays a line in a buffer (full name like "irc.freenode.#weechat",
+ * created if not found), as if it was printed by WeeChat or another plugin.
+ */
+
+void
+js_host_print (struct t_js_host *host, const char *buffer, const char *tags,
+               const char *message)
+{
+    struct t_gui_buffer *ptr_buffer;
+    const char *pos;
+    char *plugin_name;
+
+    ptr_buffer = NULL;
+    if (buffer && buffer[0])
+    {
+        ptr_buffer = weechat_stub_buffer_search_full_name(buffer);
+        pos = strchr(buffer, '.');
+        if (!ptr_buffer && pos && pos[1])
+        {
+            plugin_name = strndup(buffer, pos - buffer);
+            if (plugin_name)
+            {
+                ptr_buffer = weechat_stub_buffer_add(plugin_name, pos + 1);
+                free(plugin_name);
+            }
+        }
+    }
+
+    weechat_stub_print(ptr_buffer, 0, tags, message);
+}
+
+/*
+ * Searches a line matching regex (extended) in lines not yet expected.
+ * If found, this line and all lines before are consumed.
+ * If negate is 1, no line must match (lines are not consumed).
+ *
+ * Returns 1 if expectation is OK, 0 if it failed, -1 if regex is invalid.
+ */
+
+int
+js_host_expect (struct t_js_host *host, const char *regex, int negate)
+{
+    regex_t compiled;
+    struct t_js_host_line *ptr_line, *next_line;
+    int found;
+
+    if (regcomp(&compiled, regex, REG_EXTENDED | REG_NOSUB) != 0)
+        return -1;
+
+    for (ptr_line = host->lines; ptr_line; ptr_line = ptr_line->next_line)
+    {
+        if (regexec(&compiled, ptr_line->text, 0, NULL, 0) == 0)
+            break;
+    }
+    regfree(&compiled);
+
+    found = (ptr_line) ? 1 : 0;
+    if (negate)
+        return !found;
+    if (!found)
+        return 0;
+
+    /* consume lines up to the matching one */
+    while (host->lines)
+    {
+        next_line = host->lines->next_line;
+        host->lines_count--;
+        if (host->lines == ptr_line)
+        {
+            js_host_line_free(host->lines);
+            host->lines = next_line;
+            break;
+        }
+        js_host_line_free(host->lines);
+        host->lines = next_line;
+    }
+    if (!host->lines)
+        host->last_line = NULL;
+
+    return 1;
+}
+
+/*
+ * Removes all lines not yet expected.
+ */
+
+void
+js_host_clear (struct t_js_host *host)
+{
+    struct t_js_host_line *next_line;
+
+    while (host->lines)
+    {
+        next_line = host->lines->next_line;
+        js_host_line_free(host->lines);
+        host->lines = next_line;
+    }
+    host->last_line = NULL;
+    host->lines_count = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __JS_HOST_H_
+#define __JS_HOST_H_
+
+/*
+ * Headless host for js plugin: js.so is loaded with dlopen and initialized
+ * with weechat_plugin_init, using the in-memory WeeChat of weechat-stub.c
+ * (buffers, options, hooks and signals). Lines printed are kept in the
+ * host until they are read by an expectation (or cleared).
+ */
+
+#include "weechat-stub.h"
+
+#define JS_HOST_PLUGIN_DEFAULT "../js.so"
+#define JS_HOST_MAX_LINES 4096               /* lines kept for expectations */
+
+struct t_js_host_line
+{
+    char *buffer;                            /* full name of buffer         */
+    char *text;                              /* "prefix\tmessage"           */
+    struct t_js_host_line *next_line;        /* link to next line           */
+};
+
+struct t_js_host
+{
+    void *handle;                            /* handle of js.so (dlopen)    */
+    struct t_weechat_plugin *plugin;         /* stub plugin given to js.so  */
+    int (*plugin_init)(struct t_weechat_plugin *plugin, int argc,
+                       char *argv[]);
+    int (*plugin_end)(struct t_weechat_plugin *plugin);
+    char *home;                              /* WeeChat home                */
+    int home_temp;                           /* 1 if home must be removed   */
+    int echo;                                /* 1 = echo lines on stdout    */
+    struct t_js_host_line *lines;            /* lines not yet expected      */
+    struct t_js_host_line *last_line;        /* last line                   */
+    int lines_count;                         /* number of lines             */
+};
+
+extern struct t_js_host *js_host_new (const char *filename, const char *home,
+                                      int echo);
+extern void js_host_free (struct t_js_host *host);
+extern int js_host_command (struct t_js_host *host, const char *buffer,
+                            const char *command);
+extern int js_host_load (struct t_js_host *host, const char *filename);
+extern int js_host_unload (struct t_js_host *host, const char *name);
+extern void js_host_print (struct t_js_host *host, const char *buffer,
+                           const char *tags, const char *message);
+extern int js_host_expect (struct t_js_host *host, const char *regex,
+                           int negate);
+extern void js_host_clear (struct t_js_host *host);
+
+#endif /* __JS_HOST_H_ */
@@ -0,0 +1,513 @@
+/*
+ * Replay of IRC traffic through js plugin (loaded in a headless WeeChat,
+ * see js-host.h), to measure latency of scripts callbacks for each message
+ * and the rate of messages that can be handled.
+ *
+ * Usage: js-replay [-p plugin.so] [-d home] [-s server] [-r rate|max]
+ *                  [-n count] [-o file.json] [-v] [-l script]... log
+ *
+ * Each line of log is a raw IRC message received, with its time as first
+ * word (seconds since epoch, with optional fraction):
+ *
+ *   1382012345.120 :alice!~a@host PRIVMSG #weechat :hello
+ *
+ * For each message, like irc plugin does, signals "server,irc_raw_in_xxx"
+ * and "server,irc_in_xxx" are sent, the message is displayed in its buffer
+ * (so hooks print are called), then signals "server,irc_in2_xxx" and
+ * "server,irc_raw_in2_xxx" are sent.
+ *
+ * Messages are sent at times of log divided by rate ("max" = without any
+ * delay). Latency of a message is the time between its scheduled arrival
+ * and the end of its dispatch (so it includes the wait for previous
+ * messages when scripts are too slow for the rate); service time is the
+ * dispatch only.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "weechat-stub.h"
+#include "js-host.h"
+
+#define REPLAY_SERVER_DEFAULT "replay"
+#define REPLAY_MAX_SCRIPTS 256
+
+struct t_replay_message
+{
+    double time;                             /* time in log (seconds)       */
+    char *raw;                               /* raw IRC message             */
+};
+
+struct t_replay_message *replay_messages = NULL;
+int replay_messages_count = 0;
+unsigned long long *replay_latency = NULL;   /* arrival to end (ns)         */
+unsigned long long *replay_service = NULL;   /* dispatch only (ns)          */
+
+/*
+ * Returns monotonic time in nanoseconds.
+ */
+
+static unsigned long long
+replay_now ()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((unsigned long long)now.tv_sec * 1000000000ULL)
+        + (unsigned long long)now.tv_nsec;
+}
+
+/*
+ * Reads log file.
+ *
+ * Returns number of messages read, -1 if error.
+ */
+
+static int
+replay_read_log (const char *filename, int max_count)
+{
+    FILE *file;
+    char line[8192], *pos, *error;
+    struct t_replay_message *new_messages;
+    int size;
+    size_t length;
+    double time, last_time;
+
+    file = (strcmp(filename, "-") == 0) ? stdin : fopen(filename, "r");
+    if (!file)
+    {
+        perror(filename);
+        return -1;
+    }
+
+    size = 0;
+    last_time = 0;
+    while (fgets(line, sizeof(line), file)
+           && ((max_count <= 0) || (replay_messages_count < max_count)))
+    {
+        length = strlen(line);
+        while ((length > 0)
+               && ((line[length - 1] == '\n') || (line[length - 1] == '\r')))
+        {
+            line[--length] = '\0';
+        }
+
+        /* time (if missing: same time as previous message) */
+        error = NULL;
+        time = strtod(line, &error);
+        if (error && (error != line) && (error[0] == ' '))
+        {
+            pos = error + 1;
+            last_time = time;
+        }
+        else
+        {
+            pos = line;
+            time = last_time;
+        }
+        while (pos[0] == ' ')
+            pos++;
+        if (!pos[0])
+            continue;
+
+        if (replay_messages_count >= size)
+        {
+            size = (size == 0) ? 1024 : size * 2;
+            new_messages = realloc(replay_messages,
+                                   size * sizeof(*replay_messages));
+            if (!new_messages)
+                break;
+            replay_messages = new_messages;
+        }
+        replay_messages[replay_messages_count].time = time;
+        replay_messages[replay_messages_count].raw = strdup(pos);
+        if (!replay_messages[replay_messages_count].raw)
+            break;
+        replay_messages_count++;
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    return replay_messages_count;
+}
+
+/*
+ * Parses a raw IRC message: nick (from prefix), command, target (first
+ * parameter) and text (last parameter). Raw message is modified.
+ */
+
+static void
+replay_parse (char *raw, char **nick, char **command, char **target,
+              char **text)
+{
+    char *pos;
+
+    *nick = NULL;
+    *command = NULL;
+    *target = NULL;
+    *text = NULL;
+
+    /* skip IRCv3 tags */
+    if (raw[0] == '@')
+    {
+        pos = strchr(raw, ' ');
+        if (!pos)
+            return;
+        raw = pos + 1;
+    }
+
+    if (raw[0] == ':')
+    {
+        pos = strchr(raw, ' ');
+        if (!pos)
+            return;
+        pos[0] = '\0';
+        *nick = raw + 1;
+        raw = pos + 1;
+        pos = strchr(*nick, '!');
+        if (pos)
+            pos[0] = '\0';
+    }
+
+    while (raw[0] == ' ')
+        raw++;
+    *command = raw;
+    pos = strchr(raw, ' ');
+    if (!pos)
+        return;
+    pos[0] = '\0';
+    raw = pos + 1;
+
+    if (raw[0] == ':')
+    {
+        *text = raw + 1;
+        return;
+    }
+    *target = raw;
+    pos = strchr(raw, ' ');
+    if (!pos)
+        return;
+    pos[0] = '\0';
+    raw = pos + 1;
+    pos = strstr(raw, ":");
+    *text = (pos) ? pos + 1 : raw;
+}
+
+/*
+ * Sends a signal "server,irc_xxx_command" with raw message.
+ */
+
+static void
+replay_signal (const char *server, const char *name, const char *command,
+               const char *raw)
+{
+    char signal[256];
+
+    snprintf(signal, sizeof(signal), "%s,%s_%s", server, name, command);
+    weechat_stub_signal_send(signal, WEECHAT_HOOK_SIGNAL_STRING,
+                             (void *)raw);
+}
+
+/*
+ * Dispatches a message: signals and display in buffer.
+ */
+
+static void
+replay_dispatch (struct t_js_host *host, const char *server,
+                 struct t_replay_message *message)
+{
+    char *copy, *nick, *command, *target, *text;
+    char buffer[512], tags[512], line[8192];
+    int is_channel;
+
+    copy = strdup(message->raw);
+    if (!copy)
+        return;
+    replay_parse(copy, &nick, &command, &target, &text);
+    if (!command || !command[0])
+    {
+        free(copy);
+        return;
+    }
+
+    replay_signal(server, "irc_raw_in", command, message->raw);
+    replay_signal(server, "irc_in", command, message->raw);
+
+    /* "JOIN :#channel" */
+    if (!target && text && text[0] && strchr("#&+!", text[0]))
+    {
+        target = text;
+        text = NULL;
+    }
+    is_channel = (target && strchr("#&+!", target[0])) ? 1 : 0;
+    snprintf(tags, sizeof(tags), "irc_%s,nick_%s,log1",
+             command, (nick) ? nick : "");
+    if ((strcasecmp(command, "PRIVMSG") == 0)
+        || (strcasecmp(command, "NOTICE") == 0))
+    {
+        snprintf(buffer, sizeof(buffer), "irc.%s.%s", server,
+                 (is_channel || !nick) ? ((target) ? target : "") : nick);
+        snprintf(tags, sizeof(tags), "irc_%s,notify_%s,nick_%s,log1",
+                 command, (is_channel) ? "message" : "private",
+                 (nick) ? nick : "");
+        snprintf(line, sizeof(line), "%s\t%s",
+                 (nick) ? nick : "", (text) ? text : "");
+    }
+    else if (is_channel)
+    {
+        snprintf(buffer, sizeof(buffer), "irc.%s.%s", server, target);
+        snprintf(line, sizeof(line), "--\t%s %s %s",
+                 (nick) ? nick : "", command, (text) ? text : "");
+    }
+    else
+    {
+        snprintf(buffer, sizeof(buffer), "irc.server.%s", server);
+        snprintf(line, sizeof(line), "--\t%s", (text) ? text : "");
+    }
+    js_host_print(host, buffer, tags, line);
+
+    replay_signal(server, "irc_in2", command, message->raw);
+    replay_signal(server, "irc_raw_in2", command, message->raw);
+
+    free(copy);
+}
+
+/*
+ * Compares two durations (for qsort).
+ */
+
+static int
+replay_compare (const void *a, const void *b)
+{
+    unsigned long long value_a, value_b;
+
+    value_a = *((const unsigned long long *)a);
+    value_b = *((const unsigned long long *)b);
+
+    return (value_a < value_b) ? -1 : ((value_a > value_b) ? 1 : 0);
+}
+
+/*
+ * Returns percentile (0-100) of sorted durations, in microseconds.
+ */
+
+static double
+replay_percentile (const unsigned long long *values, int count,
+                   double percentile)
+{
+    int index;
+
+    if (count <= 0)
+        return 0;
+
+    index = (int)((percentile / 100.0) * (count - 1) + 0.5);
+    if (index >= count)
+        index = count - 1;
+
+    return (double)values[index] / 1000.0;
+}
+
+/*
+ * Writes statistics of durations (sorted), as text or JSON.
+ */
+
+static void
+replay_write_stats (FILE *file, int json, const char *name,
+                    const unsigned long long *values, int count)
+{
+    static const double percentiles[] = { 50, 90, 99, 99.9, 100 };
+    static const char *labels[] = { "p50", "p90", "p99", "p999", "max" };
+    int i;
+
+    if (json)
+        fprintf(file, "  \"%s_us\": {", name);
+    else
+        fprintf(file, "%-8s (us):", name);
+    for (i = 0; i < 5; i++)
+    {
+        if (json)
+        {
+            fprintf(file, "%s\"%s\": %.1f", (i > 0) ? ", " : "", labels[i],
+                    replay_percentile(values, count, percentiles[i]));
+        }
+        else
+        {
+            fprintf(file, " %s=%.1f", labels[i],
+                    replay_percentile(values, count, percentiles[i]));
+        }
+    }
+    fprintf(file, (json) ? "}" : "\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+    struct t_js_host *host;
+    const char *plugin, *home, *server, *output, *scripts[REPLAY_MAX_SCRIPTS];
+    unsigned long long start, arrival, dispatch, end, now;
+    double rate, duration;
+    int opt, verbose, max_count, num_scripts, i;
+    FILE *file;
+
+    plugin = NULL;
+    home = NULL;
+    server = REPLAY_SERVER_DEFAULT;
+    output = NULL;
+    rate = 1;
+    verbose = 0;
+    max_count = 0;
+    num_scripts = 0;
+    while ((opt = getopt(argc, argv, "p:d:s:r:n:o:vl:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                plugin = optarg;
+                break;
+            case 'd':
+                home = optarg;
+                break;
+            case 's':
+                server = optarg;
+                break;
+            case 'r':
+                rate = (strcmp(optarg, "max") == 0) ? 0 : atof(optarg);
+                break;
+            case 'n':
+                max_count = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'l':
+                if (num_scripts < REPLAY_MAX_SCRIPTS)
+                    scripts[num_scripts++] = optarg;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if ((optind != argc - 1) || (rate < 0))
+    {
+        fprintf(stderr,
+                "Usage: %s [-p plugin.so] [-d home] [-s server] "
+                "[-r rate|max] [-n count] [-o file.json] [-v] "
+                "[-l script]... log\n",
+                argv[0]);
+        return 1;
+    }
+
+    if (replay_read_log(argv[optind], max_count) <= 0)
+    {
+        fprintf(stderr, "js-replay: no message in log\n");
+        return 1;
+    }
+    replay_latency = calloc(replay_messages_count, sizeof(*replay_latency));
+    replay_service = calloc(replay_messages_count, sizeof(*replay_service));
+    if (!replay_latency || !replay_service)
+        return 1;
+
+    host = js_host_new(plugin, home, verbose);
+    if (!host)
+        return 1;
+    for (i = 0; i < num_scripts; i++)
+        js_host_load(host, scripts[i]);
+    js_host_clear(host);
+
+    start = replay_now();
+    for (i = 0; i < replay_messages_count; i++)
+    {
+        /* wait for arrival of message (timers and fd run meanwhile) */
+        now = replay_now();
+        if (rate > 0)
+        {
+            arrival = start + (unsigned long long)
+                (((replay_messages[i].time - replay_messages[0].time) / rate)
+                 * 1000000000.0);
+            if (arrival > now)
+                weechat_stub_run((long)((arrival - now) / 1000000ULL));
+        }
+        else
+        {
+            weechat_stub_run(0);
+            arrival = replay_now();
+        }
+
+        dispatch = replay_now();
+        replay_dispatch(host, server, &replay_messages[i]);
+        end = replay_now();
+
+        replay_service[i] = end - dispatch;
+        replay_latency[i] = end - ((arrival < dispatch) ? arrival : dispatch);
+
+        /* lines are not checked here */
+        js_host_clear(host);
+    }
+    duration = (double)(replay_now() - start) / 1000000000.0;
+
+    qsort(replay_latency, replay_messages_count, sizeof(*replay_latency),
+          &replay_compare);
+    qsort(replay_service, replay_messages_count, sizeof(*replay_service),
+          &replay_compare);
+
+    file = (output) ? fopen(output, "w") : stdout;
+    if (!file)
+    {
+        perror("js-replay");
+        js_host_free(host);
+        return 1;
+    }
+    if (output)
+    {
+        fprintf(file, "{\n  \"messages\": %d,\n  \"scripts\": %d,\n"
+                "  \"rate\": %g,\n  \"duration_s\": %.3f,\n"
+                "  \"messages_per_s\": %.1f,\n",
+                replay_messages_count, num_scripts, rate, duration,
+                (duration > 0) ? replay_messages_count / duration : 0);
+        replay_write_stats(file, 1, "latency", replay_latency,
+                           replay_messages_count);
+        fprintf(file, ",\n");
+        replay_write_stats(file, 1, "service", replay_service,
+                           replay_messages_count);
+        fprintf(file, "\n}\n");
+        fclose(file);
+    }
+    else
+    {
+        fprintf(file, "messages: %d, scripts: %d, ",
+                replay_messages_count, num_scripts);
+        if (rate > 0)
+            fprintf(file, "rate: %gx, ", rate);
+        else
+            fprintf(file, "rate: max, ");
+        fprintf(file, "duration: %.3f s, %.1f messages/s\n",
+                duration,
+                (duration > 0) ? replay_messages_count / duration : 0);
+        replay_write_stats(file, 0, "latency", replay_latency,
+                           replay_messages_count);
+        replay_write_stats(file, 0, "service", replay_service,
+                           replay_messages_count);
+    }
+
+    js_host_free(host);
+
+    for (i = 0; i < replay_messages_count; i++)
+        free(replay_messages[i].raw);
+    free(replay_messages);
+    free(replay_latency);
+    free(replay_service);
+
+    return 0;
+}
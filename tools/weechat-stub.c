@@ -0,0 +1,2418 @@
+/*
+ * Stub of WeeChat plugin API (see weechat-stub.h).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "weechat-stub.h"
+
+int weechat_stub_verbose = 0;                /* 1 = print lines on stdout   */
+unsigned long weechat_stub_lines_printed = 0;
+struct t_hook *weechat_stub_hooks = NULL;
+struct t_hook *last_weechat_stub_hook = NULL;
+int weechat_stub_hooks_running = 0;          /* > 0 when running callbacks  */
+
+struct t_gui_buffer *weechat_stub_buffers = NULL;
+struct t_gui_buffer *last_weechat_stub_buffer = NULL;
+void (*weechat_stub_print_cb)(struct t_gui_buffer *buffer, time_t date,
+                              const char *tags, const char *prefix,
+                              const char *message) = NULL;
+
+struct t_config_option *weechat_stub_options = NULL;
+struct t_hashtable *weechat_stub_plugin_options = NULL;
+char *weechat_stub_home = NULL;
+
+static void weechat_stub_print_hooks (struct t_gui_buffer *buffer,
+                                      time_t date, const char *tags,
+                                      const char *prefix,
+                                      const char *message);
+
+
+/* ---------------------------------------------------------------------- */
+/* hashtables                                                             */
+/* ---------------------------------------------------------------------- */
+
+enum t_stub_hashtable_type
+{
+    STUB_HASHTABLE_INTEGER = 0,
+    STUB_HASHTABLE_STRING,
+    STUB_HASHTABLE_POINTER,
+    STUB_HASHTABLE_BUFFER,
+    STUB_HASHTABLE_TIME,
+};
+
+struct t_hashtable_item
+{
+    void *key;                               /* key (copy, or pointer)      */
+    int key_size;                            /* size of key (buffer)        */
+    void *value;                             /* value (copy, or pointer)    */
+    int value_size;                          /* size of value (buffer)      */
+    struct t_hashtable_item *next_item;      /* next item in bucket         */
+};
+
+struct t_hashtable
+{
+    int size;                                /* number of buckets           */
+    int items_count;                         /* number of items             */
+    enum t_stub_hashtable_type type_keys;    /* type of keys                */
+    enum t_stub_hashtable_type type_values;  /* type of values              */
+    struct t_hashtable_item **buckets;       /* buckets                     */
+    char *keys_values;                       /* for get_string (last call)  */
+};
+
+/*
+ * Returns type of hashtable keys/values (string by default).
+ */
+
+static enum t_stub_hashtable_type
+weechat_stub_hashtable_type (const char *type)
+{
+    if (!type || (strcmp(type, WEECHAT_HASHTABLE_STRING) == 0))
+        return STUB_HASHTABLE_STRING;
+    if (strcmp(type, WEECHAT_HASHTABLE_INTEGER) == 0)
+        return STUB_HASHTABLE_INTEGER;
+    if (strcmp(type, WEECHAT_HASHTABLE_POINTER) == 0)
+        return STUB_HASHTABLE_POINTER;
+    if (strcmp(type, WEECHAT_HASHTABLE_BUFFER) == 0)
+        return STUB_HASHTABLE_BUFFER;
+    if (strcmp(type, WEECHAT_HASHTABLE_TIME) == 0)
+        return STUB_HASHTABLE_TIME;
+    return STUB_HASHTABLE_STRING;
+}
+
+/*
+ * Returns hash of a key.
+ */
+
+static unsigned int
+weechat_stub_hashtable_hash (struct t_hashtable *hashtable, const void *key,
+                             int key_size)
+{
+    const unsigned char *ptr;
+    unsigned int hash;
+    int i, size;
+
+    hash = 5381;
+    switch (hashtable->type_keys)
+    {
+        case STUB_HASHTABLE_STRING:
+            for (ptr = (const unsigned char *)key; *ptr; ptr++)
+                hash = (hash << 5) + hash + *ptr;
+            return hash % hashtable->size;
+        case STUB_HASHTABLE_INTEGER:
+            ptr = (const unsigned char *)key;
+            size = sizeof(int);
+            break;
+        case STUB_HASHTABLE_TIME:
+            ptr = (const unsigned char *)key;
+            size = sizeof(time_t);
+            break;
+        case STUB_HASHTABLE_BUFFER:
+            ptr = (const unsigned char *)key;
+            size = key_size;
+            break;
+        default: /* pointer: hash of pointer value */
+            ptr = (const unsigned char *)&key;
+            size = sizeof(void *);
+            break;
+    }
+    for (i = 0; i < size; i++)
+        hash = (hash << 5) + hash + ptr[i];
+
+    return hash % hashtable->size;
+}
+
+/*
+ * Compares two keys (returns 0 if equal).
+ */
+
+static int
+weechat_stub_hashtable_keycmp (struct t_hashtable *hashtable,
+                               struct t_hashtable_item *item,
+                               const void *key, int key_size)
+{
+    switch (hashtable->type_keys)
+    {
+        case STUB_HASHTABLE_STRING:
+            return strcmp((const char *)item->key, (const char *)key);
+        case STUB_HASHTABLE_INTEGER:
+            return *((int *)item->key) != *((const int *)key);
+        case STUB_HASHTABLE_TIME:
+            return *((time_t *)item->key) != *((const time_t *)key);
+        case STUB_HASHTABLE_BUFFER:
+            return (item->key_size != key_size)
+                || (memcmp(item->key, key, key_size) != 0);
+        default:
+            return item->key != key;
+    }
+}
+
+/*
+ * Allocates a copy of a key or value (pointers are not copied).
+ */
+
+static void *
+weechat_stub_hashtable_dup (enum t_stub_hashtable_type type,
+                            const void *data, int size)
+{
+    void *copy;
+
+    if (!data)
+        return NULL;
+
+    switch (type)
+    {
+        case STUB_HASHTABLE_STRING:
+            return strdup((const char *)data);
+        case STUB_HASHTABLE_INTEGER:
+            size = sizeof(int);
+            break;
+        case STUB_HASHTABLE_TIME:
+            size = sizeof(time_t);
+            break;
+        case STUB_HASHTABLE_BUFFER:
+            break;
+        default:
+            return (void *)data;
+    }
+    copy = malloc(size);
+    if (copy)
+        memcpy(copy, data, size);
+    return copy;
+}
+
+/*
+ * Frees a key or value allocated by weechat_stub_hashtable_dup.
+ */
+
+static void
+weechat_stub_hashtable_free_data (enum t_stub_hashtable_type type, void *data)
+{
+    if (data && (type != STUB_HASHTABLE_POINTER))
+        free(data);
+}
+
+static struct t_hashtable *
+weechat_stub_hashtable_new (int size, const char *type_keys,
+                            const char *type_values,
+                            unsigned int (*callback_hash_key)(struct t_hashtable *hashtable,
+                                                              const void *key),
+                            int (*callback_keycmp)(struct t_hashtable *hashtable,
+                                                   const void *key1,
+                                                   const void *key2))
+{
+    struct t_hashtable *hashtable;
+
+    hashtable = calloc(1, sizeof(*hashtable));
+    if (!hashtable)
+        return NULL;
+    hashtable->size = (size > 0) ? size : 32;
+    hashtable->type_keys = weechat_stub_hashtable_type(type_keys);
+    hashtable->type_values = weechat_stub_hashtable_type(type_values);
+    hashtable->buckets = calloc(hashtable->size, sizeof(*hashtable->buckets));
+    if (!hashtable->buckets)
+    {
+        free(hashtable);
+        return NULL;
+    }
+
+    return hashtable;
+}
+
+static struct t_hashtable_item *
+weechat_stub_hashtable_search (struct t_hashtable *hashtable, const void *key,
+                               int key_size)
+{
+    struct t_hashtable_item *ptr_item;
+
+    if (!hashtable || !key)
+        return NULL;
+
+    for (ptr_item = hashtable->buckets[weechat_stub_hashtable_hash(hashtable,
+                                                                   key,
+                                                                   key_size)];
+         ptr_item; ptr_item = ptr_item->next_item)
+    {
+        if (weechat_stub_hashtable_keycmp(hashtable, ptr_item, key,
+                                          key_size) == 0)
+            return ptr_item;
+    }
+
+    return NULL;
+}
+
+static struct t_hashtable_item *
+weechat_stub_hashtable_set_with_size (struct t_hashtable *hashtable,
+                                      const void *key, int key_size,
+                                      const void *value, int value_size)
+{
+    struct t_hashtable_item *item;
+    unsigned int hash;
+
+    if (!hashtable || !key)
+        return NULL;
+
+    item = weechat_stub_hashtable_search(hashtable, key, key_size);
+    if (item)
+    {
+        weechat_stub_hashtable_free_data(hashtable->type_values, item->value);
+    }
+    else
+    {
+        item = calloc(1, sizeof(*item));
+        if (!item)
+            return NULL;
+        item->key = weechat_stub_hashtable_dup(hashtable->type_keys, key,
+                                               key_size);
+        item->key_size = key_size;
+        hash = weechat_stub_hashtable_hash(hashtable, key, key_size);
+        item->next_item = hashtable->buckets[hash];
+        hashtable->buckets[hash] = item;
+        hashtable->items_count++;
+    }
+    item->value = weechat_stub_hashtable_dup(hashtable->type_values, value,
+                                             value_size);
+    item->value_size = value_size;
+
+    return item;
+}
+
+static struct t_hashtable_item *
+weechat_stub_hashtable_set (struct t_hashtable *hashtable, const void *key,
+                            const void *value)
+{
+    return weechat_stub_hashtable_set_with_size(hashtable, key, 0, value, 0);
+}
+
+static void *
+weechat_stub_hashtable_get (struct t_hashtable *hashtable, const void *key)
+{
+    struct t_hashtable_item *item;
+
+    item = weechat_stub_hashtable_search(hashtable, key, 0);
+
+    return (item) ? item->value : NULL;
+}
+
+static int
+weechat_stub_hashtable_has_key (struct t_hashtable *hashtable, const void *key)
+{
+    return (weechat_stub_hashtable_search(hashtable, key, 0)) ? 1 : 0;
+}
+
+static void
+weechat_stub_hashtable_map (struct t_hashtable *hashtable,
+                            void (*callback_map)(void *data,
+                                                 struct t_hashtable *hashtable,
+                                                 const void *key,
+                                                 const void *value),
+                            void *callback_map_data)
+{
+    struct t_hashtable_item *ptr_item, *next_item;
+    int i;
+
+    if (!hashtable || !callback_map)
+        return;
+
+    for (i = 0; i < hashtable->size; i++)
+    {
+        ptr_item = hashtable->buckets[i];
+        while (ptr_item)
+        {
+            next_item = ptr_item->next_item;
+            (void) (callback_map) (callback_map_data, hashtable,
+                                   ptr_item->key, ptr_item->value);
+            ptr_item = next_item;
+        }
+    }
+}
+
+/*
+ * Converts a key or value to string (for map_string).
+ */
+
+static const char *
+weechat_stub_hashtable_to_string (enum t_stub_hashtable_type type,
+                                  const void *data, char *str, int size)
+{
+    if (!data)
+        return NULL;
+
+    switch (type)
+    {
+        case STUB_HASHTABLE_STRING:
+            return (const char *)data;
+        case STUB_HASHTABLE_INTEGER:
+            snprintf(str, size, "%d", *((const int *)data));
+            return str;
+        case STUB_HASHTABLE_TIME:
+            snprintf(str, size, "%ld", (long)*((const time_t *)data));
+            return str;
+        default:
+            snprintf(str, size, "0x%lx", (unsigned long)data);
+            return str;
+    }
+}
+
+static void
+weechat_stub_hashtable_map_string (struct t_hashtable *hashtable,
+                                   void (*callback_map)(void *data,
+                                                        struct t_hashtable *hashtable,
+                                                        const char *key,
+                                                        const char *value),
+                                   void *callback_map_data)
+{
+    struct t_hashtable_item *ptr_item, *next_item;
+    char str_key[64], str_value[64];
+    int i;
+
+    if (!hashtable || !callback_map)
+        return;
+
+    for (i = 0; i < hashtable->size; i++)
+    {
+        ptr_item = hashtable->buckets[i];
+        while (ptr_item)
+        {
+            next_item = ptr_item->next_item;
+            (void) (callback_map) (callback_map_data, hashtable,
+                                   weechat_stub_hashtable_to_string(hashtable->type_keys,
+                                                                    ptr_item->key,
+                                                                    str_key,
+                                                                    sizeof(str_key)),
+                                   weechat_stub_hashtable_to_string(hashtable->type_values,
+                                                                    ptr_item->value,
+                                                                    str_value,
+                                                                    sizeof(str_value)));
+            ptr_item = next_item;
+        }
+    }
+}
+
+static int
+weechat_stub_hashtable_get_integer (struct t_hashtable *hashtable,
+                                    const char *property)
+{
+    if (hashtable && property && (strcmp(property, "size") == 0))
+        return hashtable->size;
+    if (hashtable && property && (strcmp(property, "items_count") == 0))
+        return hashtable->items_count;
+    return 0;
+}
+
+static const char *
+weechat_stub_hashtable_get_string (struct t_hashtable *hashtable,
+                                   const char *property)
+{
+    static const char *types[] = { WEECHAT_HASHTABLE_INTEGER,
+                                   WEECHAT_HASHTABLE_STRING,
+                                   WEECHAT_HASHTABLE_POINTER,
+                                   WEECHAT_HASHTABLE_BUFFER,
+                                   WEECHAT_HASHTABLE_TIME };
+
+    if (!hashtable || !property)
+        return NULL;
+    if (strcmp(property, "type_keys") == 0)
+        return types[hashtable->type_keys];
+    if (strcmp(property, "type_values") == 0)
+        return types[hashtable->type_values];
+    return NULL;
+}
+
+static void
+weechat_stub_hashtable_remove_item (struct t_hashtable *hashtable,
+                                    struct t_hashtable_item **ptr_link)
+{
+    struct t_hashtable_item *item;
+
+    item = *ptr_link;
+    *ptr_link = item->next_item;
+    weechat_stub_hashtable_free_data(hashtable->type_keys, item->key);
+    weechat_stub_hashtable_free_data(hashtable->type_values, item->value);
+    free(item);
+    hashtable->items_count--;
+}
+
+static void
+weechat_stub_hashtable_remove (struct t_hashtable *hashtable, const void *key)
+{
+    struct t_hashtable_item **ptr_link;
+
+    if (!hashtable || !key)
+        return;
+
+    for (ptr_link = &hashtable->buckets[weechat_stub_hashtable_hash(hashtable,
+                                                                    key, 0)];
+         *ptr_link; ptr_link = &((*ptr_link)->next_item))
+    {
+        if (weechat_stub_hashtable_keycmp(hashtable, *ptr_link, key, 0) == 0)
+        {
+            weechat_stub_hashtable_remove_item(hashtable, ptr_link);
+            return;
+        }
+    }
+}
+
+static void
+weechat_stub_hashtable_remove_all (struct t_hashtable *hashtable)
+{
+    int i;
+
+    if (!hashtable)
+        return;
+
+    for (i = 0; i < hashtable->size; i++)
+    {
+        while (hashtable->buckets[i])
+            weechat_stub_hashtable_remove_item(hashtable, &hashtable->buckets[i]);
+    }
+}
+
+static void
+weechat_stub_hashtable_free (struct t_hashtable *hashtable)
+{
+    if (!hashtable)
+        return;
+
+    weechat_stub_hashtable_remove_all(hashtable);
+    free(hashtable->buckets);
+    free(hashtable->keys_values);
+    free(hashtable);
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* sorted lists                                                           */
+/* ---------------------------------------------------------------------- */
+
+struct t_weelist_item
+{
+    char *data;                              /* item data                   */
+    void *user_data;                         /* pointer to user data        */
+    struct t_weelist_item *prev_item;        /* link to previous item       */
+    struct t_weelist_item *next_item;        /* link to next item           */
+};
+
+struct t_weelist
+{
+    struct t_weelist_item *items;            /* items in list               */
+    struct t_weelist_item *last_item;        /* last item in list           */
+    int size;                                /* number of items             */
+};
+
+static struct t_weelist *
+weechat_stub_list_new ()
+{
+    return calloc(1, sizeof(struct t_weelist));
+}
+
+static struct t_weelist_item *
+weechat_stub_list_add (struct t_weelist *weelist, const char *data,
+                       const char *where, void *user_data)
+{
+    struct t_weelist_item *new_item, *pos_item;
+
+    if (!weelist || !data || !where)
+        return NULL;
+
+    new_item = calloc(1, sizeof(*new_item));
+    if (!new_item)
+        return NULL;
+    new_item->data = strdup(data);
+    new_item->user_data = user_data;
+
+    /* find item before which new item is inserted (NULL = at the end) */
+    pos_item = NULL;
+    if (strcmp(where, "beginning") == 0)
+        pos_item = weelist->items;
+    else if (strcmp(where, "sort") == 0)
+    {
+        for (pos_item = weelist->items; pos_item;
+             pos_item = pos_item->next_item)
+        {
+            if (strcasecmp(data, pos_item->data) < 0)
+                break;
+        }
+    }
+
+    if (pos_item)
+    {
+        new_item->prev_item = pos_item->prev_item;
+        new_item->next_item = pos_item;
+        if (pos_item->prev_item)
+            pos_item->prev_item->next_item = new_item;
+        else
+            weelist->items = new_item;
+        pos_item->prev_item = new_item;
+    }
+    else
+    {
+        new_item->prev_item = weelist->last_item;
+        if (weelist->last_item)
+            weelist->last_item->next_item = new_item;
+        else
+            weelist->items = new_item;
+        weelist->last_item = new_item;
+    }
+    weelist->size++;
+
+    return new_item;
+}
+
+static struct t_weelist_item *
+weechat_stub_list_search_internal (struct t_weelist *weelist, const char *data,
+                                   int case_sensitive, int *pos)
+{
+    struct t_weelist_item *ptr_item;
+    int i;
+
+    if (!weelist || !data)
+        return NULL;
+
+    for (ptr_item = weelist->items, i = 0; ptr_item;
+         ptr_item = ptr_item->next_item, i++)
+    {
+        if ((case_sensitive) ?
+            (strcmp(data, ptr_item->data) == 0) :
+            (strcasecmp(data, ptr_item->data) == 0))
+        {
+            if (pos)
+                *pos = i;
+            return ptr_item;
+        }
+    }
+
+    return NULL;
+}
+
+static struct t_weelist_item *
+weechat_stub_list_search (struct t_weelist *weelist, const char *data)
+{
+    return weechat_stub_list_search_internal(weelist, data, 1, NULL);
+}
+
+static int
+weechat_stub_list_search_pos (struct t_weelist *weelist, const char *data)
+{
+    int pos;
+
+    return (weechat_stub_list_search_internal(weelist, data, 1, &pos)) ?
+        pos : -1;
+}
+
+static struct t_weelist_item *
+weechat_stub_list_casesearch (struct t_weelist *weelist, const char *data)
+{
+    return weechat_stub_list_search_internal(weelist, data, 0, NULL);
+}
+
+static int
+weechat_stub_list_casesearch_pos (struct t_weelist *weelist, const char *data)
+{
+    int pos;
+
+    return (weechat_stub_list_search_internal(weelist, data, 0, &pos)) ?
+        pos : -1;
+}
+
+static struct t_weelist_item *
+weechat_stub_list_get (struct t_weelist *weelist, int position)
+{
+    struct t_weelist_item *ptr_item;
+    int i;
+
+    if (!weelist)
+        return NULL;
+
+    for (ptr_item = weelist->items, i = 0; ptr_item;
+         ptr_item = ptr_item->next_item, i++)
+    {
+        if (i == position)
+            return ptr_item;
+    }
+
+    return NULL;
+}
+
+static void
+weechat_stub_list_set (struct t_weelist_item *item, const char *value)
+{
+    if (!item || !value)
+        return;
+
+    free(item->data);
+    item->data = strdup(value);
+}
+
+static struct t_weelist_item *
+weechat_stub_list_next (struct t_weelist_item *item)
+{
+    return (item) ? item->next_item : NULL;
+}
+
+static struct t_weelist_item *
+weechat_stub_list_prev (struct t_weelist_item *item)
+{
+    return (item) ? item->prev_item : NULL;
+}
+
+static const char *
+weechat_stub_list_string (struct t_weelist_item *item)
+{
+    return (item) ? item->data : NULL;
+}
+
+static int
+weechat_stub_list_size (struct t_weelist *weelist)
+{
+    return (weelist) ? weelist->size : 0;
+}
+
+static void
+weechat_stub_list_remove (struct t_weelist *weelist,
+                          struct t_weelist_item *item)
+{
+    if (!weelist || !item)
+        return;
+
+    if (item->prev_item)
+        item->prev_item->next_item = item->next_item;
+    else
+        weelist->items = item->next_item;
+    if (item->next_item)
+        item->next_item->prev_item = item->prev_item;
+    else
+        weelist->last_item = item->prev_item;
+    weelist->size--;
+
+    free(item->data);
+    free(item);
+}
+
+static void
+weechat_stub_list_remove_all (struct t_weelist *weelist)
+{
+    if (!weelist)
+        return;
+
+    while (weelist->items)
+        weechat_stub_list_remove(weelist, weelist->items);
+}
+
+static void
+weechat_stub_list_free (struct t_weelist *weelist)
+{
+    if (!weelist)
+        return;
+
+    weechat_stub_list_remove_all(weelist);
+    free(weelist);
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* strings and directories                                                */
+/* ---------------------------------------------------------------------- */
+
+static const char *
+weechat_stub_plugin_get_name (struct t_weechat_plugin *plugin)
+{
+    return (plugin) ? plugin->name : "core";
+}
+
+static void
+weechat_stub_charset_set (struct t_weechat_plugin *plugin, const char *charset)
+{
+}
+
+static char *
+weechat_stub_iconv (const char *charset, const char *string)
+{
+    return (string) ? strdup(string) : NULL;
+}
+
+static const char *
+weechat_stub_gettext (const char *string)
+{
+    return string;
+}
+
+static const char *
+weechat_stub_ngettext (const char *single, const char *plural, int count)
+{
+    return (count == 1) ? single : plural;
+}
+
+static int
+weechat_stub_strcasecmp (const char *string1, const char *string2)
+{
+    if (!string1 || !string2)
+        return (string1) ? 1 : ((string2) ? -1 : 0);
+    return strcasecmp(string1, string2);
+}
+
+static int
+weechat_stub_strncasecmp (const char *string1, const char *string2, int max)
+{
+    if (!string1 || !string2)
+        return (string1) ? 1 : ((string2) ? -1 : 0);
+    return strncasecmp(string1, string2, max);
+}
+
+static int
+weechat_stub_strcmp_ignore_chars (const char *string1, const char *string2,
+                                  const char *chars_ignored,
+                                  int case_sensitive)
+{
+    int c1, c2;
+
+    if (!string1 || !string2)
+        return (string1) ? 1 : ((string2) ? -1 : 0);
+
+    while (1)
+    {
+        while (*string1 && strchr(chars_ignored, *string1))
+            string1++;
+        while (*string2 && strchr(chars_ignored, *string2))
+            string2++;
+        c1 = (case_sensitive) ? *string1 : tolower((unsigned char)*string1);
+        c2 = (case_sensitive) ? *string2 : tolower((unsigned char)*string2);
+        if ((c1 != c2) || !c1)
+            return c1 - c2;
+        string1++;
+        string2++;
+    }
+}
+
+/*
+ * Checks if a string matches a mask (only "*" is a wildcard).
+ */
+
+static int
+weechat_stub_string_match (const char *string, const char *mask,
+                           int case_sensitive)
+{
+    if (!string || !mask)
+        return 0;
+
+    while (*mask)
+    {
+        if (*mask == '*')
+        {
+            mask++;
+            if (!*mask)
+                return 1;
+            for (; *string; string++)
+            {
+                if (weechat_stub_string_match(string, mask, case_sensitive))
+                    return 1;
+            }
+            return 0;
+        }
+        if (!*string
+            || ((case_sensitive) ?
+                (*string != *mask) :
+                (tolower((unsigned char)*string)
+                 != tolower((unsigned char)*mask))))
+            return 0;
+        string++;
+        mask++;
+    }
+
+    return (*string) ? 0 : 1;
+}
+
+/*
+ * Evaluates an expression: only "${name}" is replaced, by value in
+ * extra_vars (or option value), conditions are not supported.
+ */
+
+static char *
+weechat_stub_string_eval_expression (const char *expr,
+                                     struct t_hashtable *pointers,
+                                     struct t_hashtable *extra_vars)
+{
+    struct t_config_option *ptr_option;
+    const char *pos, *pos_end, *value;
+    char *result, *name;
+    size_t length, size, value_length;
+
+    if (!expr)
+        return NULL;
+
+    size = strlen(expr) + 1;
+    result = malloc(size);
+    if (!result)
+        return NULL;
+    length = 0;
+
+    pos = expr;
+    while (*pos)
+    {
+        value = NULL;
+        pos_end = NULL;
+        if ((pos[0] == '$') && (pos[1] == '{'))
+            pos_end = strchr(pos + 2, '}');
+        if (pos_end)
+        {
+            name = strndup(pos + 2, pos_end - pos - 2);
+            value = (const char *)weechat_stub_hashtable_get(extra_vars, name);
+            for (ptr_option = weechat_stub_options; !value && ptr_option;
+                 ptr_option = ptr_option->next_option)
+            {
+                if (strcmp(ptr_option->name, name) == 0)
+                    value = ptr_option->value;
+            }
+            free(name);
+            if (!value)
+                value = "";
+            pos = pos_end + 1;
+        }
+        else
+        {
+            result[length++] = *pos++;
+            continue;
+        }
+        value_length = strlen(value);
+        if (length + value_length + strlen(pos) + 1 > size)
+        {
+            size = length + value_length + strlen(pos) + 1;
+            result = realloc(result, size);
+            if (!result)
+                return NULL;
+        }
+        memcpy(result + length, value, value_length);
+        length += value_length;
+    }
+    result[length] = '\0';
+
+    return result;
+}
+
+static char *
+weechat_stub_string_remove_color (const char *string, const char *replacement)
+{
+    return (string) ? strdup(string) : NULL;
+}
+
+/*
+ * Splits a string on separators (empty items are skipped); with keep_eol,
+ * each item contains the end of string (trailing separators are removed
+ * if keep_eol is 1).
+ */
+
+static char **
+weechat_stub_string_split (const char *string, const char *separators,
+                           int keep_eol, int num_items_max, int *num_items)
+{
+    char **array;
+    const char *ptr, *ptr_end;
+    int count, index;
+    size_t length;
+
+    if (num_items)
+        *num_items = 0;
+
+    if (!string || !string[0] || !separators || !separators[0])
+        return NULL;
+
+    /* count items */
+    count = 0;
+    ptr = string;
+    while (ptr[0])
+    {
+        ptr += strspn(ptr, separators);
+        if (!ptr[0])
+            break;
+        count++;
+        ptr += strcspn(ptr, separators);
+    }
+    if ((num_items_max > 0) && (count > num_items_max))
+        count = num_items_max;
+
+    array = calloc(count + 1, sizeof(*array));
+    if (!array)
+        return NULL;
+
+    ptr = string;
+    for (index = 0; index < count; index++)
+    {
+        ptr += strspn(ptr, separators);
+        length = strcspn(ptr, separators);
+        if (keep_eol || ((num_items_max > 0) && (index == count - 1)))
+        {
+            ptr_end = ptr + strlen(ptr);
+            if (keep_eol != 2)
+            {
+                while ((ptr_end > ptr) && strchr(separators, ptr_end[-1]))
+                    ptr_end--;
+            }
+            array[index] = strndup(ptr, ptr_end - ptr);
+        }
+        else
+        {
+            array[index] = strndup(ptr, length);
+        }
+        ptr += length;
+    }
+
+    if (num_items)
+        *num_items = count;
+
+    return array;
+}
+
+static void
+weechat_stub_string_free_split (char **split_string)
+{
+    char **ptr;
+
+    if (!split_string)
+        return;
+
+    for (ptr = split_string; *ptr; ptr++)
+        free(*ptr);
+    free(split_string);
+}
+
+static int
+weechat_stub_mkdir (const char *directory, int mode)
+{
+    if (!directory)
+        return 0;
+
+    if ((mkdir(directory, mode) < 0) && (errno != EEXIST))
+        return 0;
+
+    return 1;
+}
+
+static int
+weechat_stub_mkdir_home (const char *directory, int mode)
+{
+    char path[4096];
+
+    if (!directory || !weechat_stub_home)
+        return 0;
+
+    snprintf(path, sizeof(path), "%s/%s", weechat_stub_home, directory);
+
+    return weechat_stub_mkdir(path, mode);
+}
+
+static int
+weechat_stub_mkdir_parents (const char *directory, int mode)
+{
+    char *path, *pos;
+    int rc;
+
+    if (!directory)
+        return 0;
+
+    path = strdup(directory);
+    if (!path)
+        return 0;
+    for (pos = strchr(path + 1, '/'); pos; pos = strchr(pos + 1, '/'))
+    {
+        pos[0] = '\0';
+        weechat_stub_mkdir(path, mode);
+        pos[0] = '/';
+    }
+    rc = weechat_stub_mkdir(path, mode);
+    free(path);
+
+    return rc;
+}
+
+static void
+weechat_stub_exec_on_files (const char *directory, int hidden_files,
+                            void *data,
+                            void (*callback)(void *data, const char *filename))
+{
+    /* no autoload: scripts are loaded explicitly by tools */
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* options                                                                */
+/* ---------------------------------------------------------------------- */
+
+static void weechat_stub_config_changed (const char *name,
+                                        const char *value);
+
+/*
+ * Creates or updates a core option (readable with config_get); options
+ * "plugins.var.*" are options of plugins (config_get_plugin).
+ */
+
+struct t_config_option *
+weechat_stub_config_set (const char *name, const char *value)
+{
+    struct t_config_option *ptr_option;
+
+    if (strncmp(name, "plugins.var.", 12) == 0)
+    {
+        weechat_stub_hashtable_set(weechat_stub_plugin_options, name, value);
+        weechat_stub_config_changed(name, value);
+        return NULL;
+    }
+
+    for (ptr_option = weechat_stub_options; ptr_option;
+         ptr_option = ptr_option->next_option)
+    {
+        if (strcmp(ptr_option->name, name) == 0)
+            break;
+    }
+    if (!ptr_option)
+    {
+        ptr_option = calloc(1, sizeof(*ptr_option));
+        if (!ptr_option)
+            return NULL;
+        ptr_option->name = strdup(name);
+        ptr_option->next_option = weechat_stub_options;
+        weechat_stub_options = ptr_option;
+    }
+    free(ptr_option->value);
+    ptr_option->value = strdup((value) ? value : "");
+    weechat_stub_config_changed(name, ptr_option->value);
+
+    return ptr_option;
+}
+
+static struct t_config_option *
+weechat_stub_config_get (const char *option_name)
+{
+    struct t_config_option *ptr_option;
+
+    for (ptr_option = weechat_stub_options; ptr_option;
+         ptr_option = ptr_option->next_option)
+    {
+        if (option_name && (strcmp(ptr_option->name, option_name) == 0))
+            return ptr_option;
+    }
+
+    return NULL;
+}
+
+static int
+weechat_stub_config_boolean (struct t_config_option *option)
+{
+    if (!option)
+        return 0;
+    return (strcasecmp(option->value, "on") == 0)
+        || (strcasecmp(option->value, "true") == 0)
+        || (strcmp(option->value, "1") == 0);
+}
+
+static int
+weechat_stub_config_integer (struct t_config_option *option)
+{
+    return (option) ? atoi(option->value) : 0;
+}
+
+static const char *
+weechat_stub_config_string (struct t_config_option *option)
+{
+    return (option) ? option->value : NULL;
+}
+
+/*
+ * Sends signal for a changed option to hooks "config".
+ */
+
+static void
+weechat_stub_config_changed (const char *name, const char *value)
+{
+    struct t_hook *ptr_hook;
+
+    weechat_stub_hooks_running++;
+    for (ptr_hook = weechat_stub_hooks; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (!ptr_hook->deleted && (ptr_hook->type == STUB_HOOK_CONFIG)
+            && weechat_stub_string_match(name, ptr_hook->name, 0))
+        {
+            (void) ((int (*)(void *, const char *, const char *))ptr_hook->callback)
+                (ptr_hook->callback_data, name, value);
+        }
+    }
+    weechat_stub_hooks_running--;
+    weechat_stub_hooks_purge();
+}
+
+static const char *
+weechat_stub_config_get_plugin (struct t_weechat_plugin *plugin,
+                                const char *option_name)
+{
+    char name[1024];
+
+    snprintf(name, sizeof(name), "plugins.var.%s.%s",
+             plugin->name, option_name);
+
+    return (const char *)weechat_stub_hashtable_get(weechat_stub_plugin_options,
+                                                    name);
+}
+
+static int
+weechat_stub_config_is_set_plugin (struct t_weechat_plugin *plugin,
+                                   const char *option_name)
+{
+    return (weechat_stub_config_get_plugin(plugin, option_name)) ? 1 : 0;
+}
+
+static int
+weechat_stub_config_set_plugin (struct t_weechat_plugin *plugin,
+                                const char *option_name, const char *value)
+{
+    char name[1024];
+
+    snprintf(name, sizeof(name), "plugins.var.%s.%s",
+             plugin->name, option_name);
+    weechat_stub_hashtable_set(weechat_stub_plugin_options, name, value);
+    weechat_stub_config_changed(name, value);
+
+    return 1; /* WEECHAT_CONFIG_OPTION_SET_OK_CHANGED */
+}
+
+static void
+weechat_stub_config_set_desc_plugin (struct t_weechat_plugin *plugin,
+                                     const char *option_name,
+                                     const char *description)
+{
+}
+
+static int
+weechat_stub_config_unset_plugin (struct t_weechat_plugin *plugin,
+                                  const char *option_name)
+{
+    char name[1024];
+
+    snprintf(name, sizeof(name), "plugins.var.%s.%s",
+             plugin->name, option_name);
+    weechat_stub_hashtable_remove(weechat_stub_plugin_options, name);
+
+    return 2; /* WEECHAT_CONFIG_OPTION_UNSET_OK_REMOVED */
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* buffers                                                                */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Searches a buffer by plugin and name (plugin NULL = any plugin).
+ */
+
+struct t_gui_buffer *
+weechat_stub_buffer_search (const char *plugin, const char *name)
+{
+    struct t_gui_buffer *ptr_buffer;
+
+    if (!name)
+        return NULL;
+
+    for (ptr_buffer = weechat_stub_buffers; ptr_buffer;
+         ptr_buffer = ptr_buffer->next_buffer)
+    {
+        if ((!plugin || (strcmp(plugin, ptr_buffer->plugin_name) == 0))
+            && (strcmp(name, ptr_buffer->name) == 0))
+            return ptr_buffer;
+    }
+
+    return NULL;
+}
+
+/*
+ * Searches a buffer by full name ("plugin.name").
+ */
+
+struct t_gui_buffer *
+weechat_stub_buffer_search_full_name (const char *full_name)
+{
+    struct t_gui_buffer *ptr_buffer;
+
+    if (!full_name)
+        return NULL;
+
+    for (ptr_buffer = weechat_stub_buffers; ptr_buffer;
+         ptr_buffer = ptr_buffer->next_buffer)
+    {
+        if (strcmp(full_name, ptr_buffer->full_name) == 0)
+            return ptr_buffer;
+    }
+
+    return NULL;
+}
+
+/*
+ * Adds a buffer without callbacks (used for core buffer and by tools to
+ * create buffers of other plugins, like irc).
+ */
+
+struct t_gui_buffer *
+weechat_stub_buffer_add (const char *plugin_name, const char *name)
+{
+    struct t_gui_buffer *new_buffer;
+    size_t length;
+
+    new_buffer = calloc(1, sizeof(*new_buffer));
+    if (!new_buffer)
+        return NULL;
+
+    new_buffer->plugin_name = strdup(plugin_name);
+    new_buffer->name = strdup(name);
+    length = strlen(plugin_name) + 1 + strlen(name) + 1;
+    new_buffer->full_name = malloc(length);
+    if (new_buffer->full_name)
+        snprintf(new_buffer->full_name, length, "%s.%s", plugin_name, name);
+    new_buffer->local_variables = weechat_stub_hashtable_new(16,
+                                                             WEECHAT_HASHTABLE_STRING,
+                                                             WEECHAT_HASHTABLE_STRING,
+                                                             NULL, NULL);
+
+    new_buffer->prev_buffer = last_weechat_stub_buffer;
+    if (last_weechat_stub_buffer)
+        last_weechat_stub_buffer->next_buffer = new_buffer;
+    else
+        weechat_stub_buffers = new_buffer;
+    last_weechat_stub_buffer = new_buffer;
+
+    return new_buffer;
+}
+
+static struct t_gui_buffer *
+weechat_stub_buffer_new (struct t_weechat_plugin *plugin, const char *name,
+                         int (*input_callback)(void *data,
+                                               struct t_gui_buffer *buffer,
+                                               const char *input_data),
+                         void *input_callback_data,
+                         int (*close_callback)(void *data,
+                                               struct t_gui_buffer *buffer),
+                         void *close_callback_data)
+{
+    struct t_gui_buffer *new_buffer;
+
+    if (!name || !name[0]
+        || weechat_stub_buffer_search((plugin) ? plugin->name : "core", name))
+        return NULL;
+
+    new_buffer = weechat_stub_buffer_add((plugin) ?
+                                                  plugin->name : "core",
+                                                  name);
+    if (!new_buffer)
+        return NULL;
+    new_buffer->input_callback = input_callback;
+    new_buffer->input_callback_data = input_callback_data;
+    new_buffer->close_callback = close_callback;
+    new_buffer->close_callback_data = close_callback_data;
+
+    weechat_stub_signal_send("buffer_opened", WEECHAT_HOOK_SIGNAL_POINTER,
+                             new_buffer);
+
+    return new_buffer;
+}
+
+static struct t_gui_buffer *
+weechat_stub_buffer_search_main ()
+{
+    return weechat_stub_buffer_search("core", "weechat");
+}
+
+static void
+weechat_stub_buffer_clear (struct t_gui_buffer *buffer)
+{
+    struct t_stub_line *ptr_line;
+
+    if (!buffer)
+        return;
+
+    while (buffer->lines)
+    {
+        ptr_line = buffer->lines;
+        buffer->lines = ptr_line->next_line;
+        free(ptr_line->tags);
+        free(ptr_line->prefix);
+        free(ptr_line->message);
+        free(ptr_line);
+    }
+    buffer->last_line = NULL;
+    buffer->lines_count = 0;
+}
+
+static void
+weechat_stub_buffer_close (struct t_gui_buffer *buffer)
+{
+    if (!buffer || (buffer == weechat_stub_buffer_search_main()))
+        return;
+
+    if (buffer->close_callback)
+    {
+        (void) (buffer->close_callback) (buffer->close_callback_data,
+                                         buffer);
+    }
+    weechat_stub_signal_send("buffer_closing", WEECHAT_HOOK_SIGNAL_POINTER,
+                             buffer);
+
+    if (buffer->prev_buffer)
+        buffer->prev_buffer->next_buffer = buffer->next_buffer;
+    else
+        weechat_stub_buffers = buffer->next_buffer;
+    if (buffer->next_buffer)
+        buffer->next_buffer->prev_buffer = buffer->prev_buffer;
+    else
+        last_weechat_stub_buffer = buffer->prev_buffer;
+
+    weechat_stub_signal_send("buffer_closed", WEECHAT_HOOK_SIGNAL_POINTER,
+                             buffer);
+
+    weechat_stub_buffer_clear(buffer);
+    weechat_stub_hashtable_free(buffer->local_variables);
+    free(buffer->plugin_name);
+    free(buffer->name);
+    free(buffer->full_name);
+    free(buffer->title);
+    free(buffer);
+}
+
+static int
+weechat_stub_buffer_get_integer (struct t_gui_buffer *buffer,
+                                 const char *property)
+{
+    if (!buffer || !property)
+        return 0;
+    if (strcmp(property, "lines_count") == 0)
+        return buffer->lines_count;
+    return 0;
+}
+
+static const char *
+weechat_stub_buffer_get_string (struct t_gui_buffer *buffer,
+                                const char *property)
+{
+    if (!buffer || !property)
+        return NULL;
+    if (strcmp(property, "plugin") == 0)
+        return buffer->plugin_name;
+    if (strcmp(property, "name") == 0)
+        return buffer->name;
+    if (strcmp(property, "full_name") == 0)
+        return buffer->full_name;
+    if (strcmp(property, "title") == 0)
+        return buffer->title;
+    if (strncmp(property, "localvar_", 9) == 0)
+        return (const char *)weechat_stub_hashtable_get(buffer->local_variables,
+                                                        property + 9);
+    return NULL;
+}
+
+static void *
+weechat_stub_buffer_get_pointer (struct t_gui_buffer *buffer,
+                                 const char *property)
+{
+    return NULL;
+}
+
+static void
+weechat_stub_buffer_set (struct t_gui_buffer *buffer, const char *property,
+                         const char *value)
+{
+    if (!buffer || !property)
+        return;
+
+    if (strcmp(property, "title") == 0)
+    {
+        free(buffer->title);
+        buffer->title = (value) ? strdup(value) : NULL;
+    }
+    else if (strncmp(property, "localvar_set_", 13) == 0)
+    {
+        weechat_stub_hashtable_set(buffer->local_variables, property + 13,
+                                   (value) ? value : "");
+    }
+    else if (strncmp(property, "localvar_del_", 13) == 0)
+    {
+        weechat_stub_hashtable_remove(buffer->local_variables, property + 13);
+    }
+}
+
+/*
+ * Adds a line in a buffer (NULL = core buffer): message is split in prefix
+ * and message on first tab, and hooks "print" are called.
+ */
+
+void
+weechat_stub_print (struct t_gui_buffer *buffer, time_t date,
+                    const char *tags, const char *message)
+{
+    struct t_stub_line *new_line, *old_line;
+    const char *pos_tab;
+
+    if (!message)
+        return;
+
+    if (!buffer)
+        buffer = weechat_stub_buffer_search_main();
+    if (!buffer)
+        return;
+    if (date == 0)
+        date = time(NULL);
+
+    new_line = calloc(1, sizeof(*new_line));
+    if (!new_line)
+        return;
+    new_line->date = date;
+    new_line->tags = strdup((tags) ? tags : "");
+    pos_tab = strchr(message, '\t');
+    if (pos_tab)
+    {
+        new_line->prefix = strndup(message, pos_tab - message);
+        new_line->message = strdup(pos_tab + 1);
+    }
+    else
+    {
+        new_line->prefix = strdup("");
+        new_line->message = strdup(message);
+    }
+
+    if (buffer->last_line)
+        buffer->last_line->next_line = new_line;
+    else
+        buffer->lines = new_line;
+    buffer->last_line = new_line;
+    buffer->lines_count++;
+
+    /* only last lines are kept in buffer */
+    if (buffer->lines_count > STUB_BUFFER_MAX_LINES)
+    {
+        old_line = buffer->lines;
+        buffer->lines = old_line->next_line;
+        free(old_line->tags);
+        free(old_line->prefix);
+        free(old_line->message);
+        free(old_line);
+        buffer->lines_count--;
+    }
+
+    weechat_stub_lines_printed++;
+
+    if (weechat_stub_print_cb)
+    {
+        weechat_stub_print_cb(buffer, date, new_line->tags, new_line->prefix,
+                              new_line->message);
+    }
+    else if (weechat_stub_verbose)
+    {
+        fprintf(stdout, "%s\t%s\t%s\n",
+                buffer->full_name, new_line->prefix, new_line->message);
+    }
+
+    weechat_stub_print_hooks(buffer, date, new_line->tags, new_line->prefix,
+                             new_line->message);
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* display                                                                */
+/* ---------------------------------------------------------------------- */
+
+static const char *
+weechat_stub_prefix (const char *prefix)
+{
+    if (prefix && (strcmp(prefix, "error") == 0))
+        return "=!=\t";
+    return "";
+}
+
+static const char *
+weechat_stub_color (const char *color_name)
+{
+    return "";
+}
+
+static void
+weechat_stub_printf_date_tags (struct t_gui_buffer *buffer, time_t date,
+                               const char *tags, const char *message, ...)
+{
+    va_list args;
+    char *line;
+    int length;
+
+    if (!message)
+        return;
+
+    va_start(args, message);
+    length = vsnprintf(NULL, 0, message, args);
+    va_end(args);
+    if (length < 0)
+        return;
+
+    line = malloc(length + 1);
+    if (!line)
+        return;
+
+    va_start(args, message);
+    vsnprintf(line, length + 1, message, args);
+    va_end(args);
+
+    weechat_stub_print(buffer, date, tags, line);
+    free(line);
+}
+
+static void
+weechat_stub_log_printf (const char *message, ...)
+{
+    va_list args;
+
+    if (!weechat_stub_verbose || !message)
+        return;
+
+    va_start(args, message);
+    vfprintf(stderr, message, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* hooks                                                                  */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Returns monotonic time in milliseconds (used for timers).
+ */
+
+static long long
+weechat_stub_now_ms ()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((long long)now.tv_sec * 1000LL) + (now.tv_nsec / 1000000L);
+}
+
+static struct t_hook *
+weechat_stub_hook_new (struct t_weechat_plugin *plugin,
+                       enum t_stub_hook_type type, const char *name,
+                       void *callback, void *callback_data)
+{
+    struct t_hook *new_hook;
+
+    new_hook = calloc(1, sizeof(*new_hook));
+    if (!new_hook)
+        return NULL;
+
+    new_hook->plugin = plugin;
+    new_hook->type = type;
+    new_hook->name = (name) ? strdup(name) : NULL;
+    new_hook->callback = callback;
+    new_hook->callback_data = callback_data;
+    new_hook->fd = -1;
+
+    new_hook->prev_hook = last_weechat_stub_hook;
+    if (last_weechat_stub_hook)
+        last_weechat_stub_hook->next_hook = new_hook;
+    else
+        weechat_stub_hooks = new_hook;
+    last_weechat_stub_hook = new_hook;
+
+    return new_hook;
+}
+
+/*
+ * Frees hooks removed while callbacks were running.
+ */
+
+void
+weechat_stub_hooks_purge ()
+{
+    struct t_hook *ptr_hook, *next_hook;
+
+    if (weechat_stub_hooks_running > 0)
+        return;
+
+    ptr_hook = weechat_stub_hooks;
+    while (ptr_hook)
+    {
+        next_hook = ptr_hook->next_hook;
+        if (ptr_hook->deleted)
+        {
+            if (ptr_hook->prev_hook)
+                ptr_hook->prev_hook->next_hook = ptr_hook->next_hook;
+            else
+                weechat_stub_hooks = ptr_hook->next_hook;
+            if (ptr_hook->next_hook)
+                ptr_hook->next_hook->prev_hook = ptr_hook->prev_hook;
+            else
+                last_weechat_stub_hook = ptr_hook->prev_hook;
+            free(ptr_hook->name);
+            free(ptr_hook->message);
+            free(ptr_hook);
+        }
+        ptr_hook = next_hook;
+    }
+}
+
+static struct t_hook *
+weechat_stub_hook_command (struct t_weechat_plugin *plugin,
+                           const char *command, const char *description,
+                           const char *args, const char *args_description,
+                           const char *completion,
+                           int (*callback)(void *data,
+                                           struct t_gui_buffer *buffer,
+                                           int argc, char **argv,
+                                           char **argv_eol),
+                           void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_COMMAND, command,
+                                 (void *)callback, callback_data);
+}
+
+static struct t_hook *
+weechat_stub_hook_timer (struct t_weechat_plugin *plugin, long interval,
+                         int align_second, int max_calls,
+                         int (*callback)(void *data, int remaining_calls),
+                         void *callback_data)
+{
+    struct t_hook *new_hook;
+
+    new_hook = weechat_stub_hook_new(plugin, STUB_HOOK_TIMER, NULL,
+                                     (void *)callback, callback_data);
+    if (new_hook)
+    {
+        new_hook->interval = interval;
+        new_hook->max_calls = max_calls;
+        new_hook->next_call = weechat_stub_now_ms() + interval;
+    }
+
+    return new_hook;
+}
+
+static struct t_hook *
+weechat_stub_hook_fd (struct t_weechat_plugin *plugin, int fd, int flag_read,
+                      int flag_write, int flag_exception,
+                      int (*callback)(void *data, int fd),
+                      void *callback_data)
+{
+    struct t_hook *new_hook;
+
+    new_hook = weechat_stub_hook_new(plugin, STUB_HOOK_FD, NULL,
+                                     (void *)callback, callback_data);
+    if (new_hook)
+    {
+        new_hook->fd = fd;
+        new_hook->flags = ((flag_read) ? 1 : 0) | ((flag_write) ? 2 : 0)
+            | ((flag_exception) ? 4 : 0);
+    }
+
+    return new_hook;
+}
+
+static struct t_hook *
+weechat_stub_hook_signal (struct t_weechat_plugin *plugin, const char *signal,
+                          int (*callback)(void *data, const char *signal,
+                                          const char *type_data,
+                                          void *signal_data),
+                          void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_SIGNAL, signal,
+                                 (void *)callback, callback_data);
+}
+
+/*
+ * Sends a signal to all hooks matching it (stops if a callback returns
+ * WEECHAT_RC_OK_EAT).
+ */
+
+void
+weechat_stub_signal_send (const char *signal, const char *type_data,
+                          void *signal_data)
+{
+    struct t_hook *ptr_hook;
+    int rc;
+
+    weechat_stub_hooks_running++;
+    for (ptr_hook = weechat_stub_hooks; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (ptr_hook->deleted || (ptr_hook->type != STUB_HOOK_SIGNAL)
+            || !weechat_stub_string_match(signal, ptr_hook->name, 0))
+            continue;
+        rc = ((int (*)(void *, const char *, const char *, void *))ptr_hook->callback)
+            (ptr_hook->callback_data, signal, type_data, signal_data);
+        if (rc == WEECHAT_RC_OK_EAT)
+            break;
+    }
+    weechat_stub_hooks_running--;
+    weechat_stub_hooks_purge();
+}
+
+static struct t_hook *
+weechat_stub_hook_config (struct t_weechat_plugin *plugin, const char *option,
+                          int (*callback)(void *data, const char *option,
+                                          const char *value),
+                          void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_CONFIG, option,
+                                 (void *)callback, callback_data);
+}
+
+static struct t_hook *
+weechat_stub_hook_completion (struct t_weechat_plugin *plugin,
+                              const char *completion_item,
+                              const char *description,
+                              int (*callback)(void *data,
+                                              const char *completion_item,
+                                              struct t_gui_buffer *buffer,
+                                              struct t_gui_completion *completion),
+                              void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_COMPLETION,
+                                 completion_item, (void *)callback,
+                                 callback_data);
+}
+
+static struct t_hook *
+weechat_stub_hook_infolist (struct t_weechat_plugin *plugin,
+                            const char *infolist_name,
+                            const char *description,
+                            const char *pointer_description,
+                            const char *args_description,
+                            struct t_infolist *(*callback)(void *data,
+                                                           const char *infolist_name,
+                                                           void *pointer,
+                                                           const char *arguments),
+                            void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_INFOLIST, infolist_name,
+                                 (void *)callback, callback_data);
+}
+
+static struct t_hook *
+weechat_stub_hook_hdata (struct t_weechat_plugin *plugin,
+                         const char *hdata_name, const char *description,
+                         struct t_hdata *(*callback)(void *data,
+                                                     const char *hdata_name),
+                         void *callback_data)
+{
+    return weechat_stub_hook_new(plugin, STUB_HOOK_HDATA, hdata_name,
+                                 (void *)callback, callback_data);
+}
+
+static struct t_hook *
+weechat_stub_hook_print (struct t_weechat_plugin *plugin,
+                         struct t_gui_buffer *buffer, const char *tags,
+                         const char *message, int strip_colors,
+                         int (*callback)(void *data,
+                                         struct t_gui_buffer *buffer,
+                                         time_t date, int tags_count,
+                                         const char **tags, int displayed,
+                                         int highlight, const char *prefix,
+                                         const char *message),
+                         void *callback_data)
+{
+    struct t_hook *new_hook;
+
+    new_hook = weechat_stub_hook_new(plugin, STUB_HOOK_PRINT,
+                                     (tags && tags[0]) ? tags : NULL,
+                                     (void *)callback, callback_data);
+    if (new_hook)
+    {
+        new_hook->buffer = buffer;
+        new_hook->message = (message && message[0]) ? strdup(message) : NULL;
+    }
+
+    return new_hook;
+}
+
+/*
+ * Checks if tags of a line match tags of a hook print (comma-separated
+ * list, one tag is enough).
+ *
+ * Returns 1 if tags match, 0 otherwise.
+ */
+
+static int
+weechat_stub_print_tags_match (const char *hook_tags, int tags_count,
+                               const char **tags)
+{
+    const char *pos, *pos_comma;
+    size_t length;
+    int i;
+
+    if (!hook_tags)
+        return 1;
+
+    pos = hook_tags;
+    while (pos && pos[0])
+    {
+        pos_comma = strchr(pos, ',');
+        length = (pos_comma) ? (size_t)(pos_comma - pos) : strlen(pos);
+        for (i = 0; i < tags_count; i++)
+        {
+            if ((strlen(tags[i]) == length)
+                && (strncmp(tags[i], pos, length) == 0))
+                return 1;
+        }
+        pos = (pos_comma) ? pos_comma + 1 : NULL;
+    }
+
+    return 0;
+}
+
+/*
+ * Calls hooks print matching a line displayed in a buffer.
+ */
+
+static void
+weechat_stub_print_hooks (struct t_gui_buffer *buffer, time_t date,
+                          const char *tags, const char *prefix,
+                          const char *message)
+{
+    struct t_hook *ptr_hook;
+    char **line_tags;
+    int tags_count, highlight;
+
+    line_tags = weechat_stub_string_split(tags, ",", 0, 0, &tags_count);
+    highlight = weechat_stub_print_tags_match("notify_highlight", tags_count,
+                                              (const char **)line_tags);
+
+    weechat_stub_hooks_running++;
+    for (ptr_hook = weechat_stub_hooks; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (ptr_hook->deleted || (ptr_hook->type != STUB_HOOK_PRINT)
+            || (ptr_hook->buffer && (ptr_hook->buffer != buffer))
+            || (ptr_hook->message && !strstr(message, ptr_hook->message))
+            || !weechat_stub_print_tags_match(ptr_hook->name, tags_count,
+                                              (const char **)line_tags))
+            continue;
+        (void) ((int (*)(void *, struct t_gui_buffer *, time_t, int,
+                         const char **, int, int, const char *,
+                         const char *))ptr_hook->callback)
+            (ptr_hook->callback_data, buffer, date, tags_count,
+             (const char **)line_tags, 1, highlight, prefix, message);
+    }
+    weechat_stub_hooks_running--;
+    weechat_stub_hooks_purge();
+
+    weechat_stub_string_free_split(line_tags);
+}
+
+/*
+ * Executes a command ("/name args") with hooks command, or sends text to
+ * input callback of buffer.
+ *
+ * Returns WEECHAT_RC_OK if command was found and executed,
+ * WEECHAT_RC_ERROR otherwise.
+ */
+
+int
+weechat_stub_command (struct t_weechat_plugin *plugin,
+                      struct t_gui_buffer *buffer, const char *command)
+{
+    struct t_hook *ptr_hook;
+    char **argv, **argv_eol;
+    int argc, rc;
+
+    if (!command)
+        return WEECHAT_RC_ERROR;
+
+    if (!buffer)
+        buffer = weechat_stub_buffer_search_main();
+
+    if ((command[0] != '/') || (command[1] == '/'))
+    {
+        if (!buffer || !buffer->input_callback)
+            return WEECHAT_RC_ERROR;
+        return (buffer->input_callback) (buffer->input_callback_data, buffer,
+                                         (command[0] == '/') ?
+                                         command + 1 : command);
+    }
+
+    argv = weechat_stub_string_split(command + 1, " ", 0, 0, &argc);
+    argv_eol = weechat_stub_string_split(command + 1, " ", 1, 0, NULL);
+    if (!argv || !argv_eol)
+    {
+        weechat_stub_string_free_split(argv);
+        weechat_stub_string_free_split(argv_eol);
+        return WEECHAT_RC_ERROR;
+    }
+
+    rc = WEECHAT_RC_ERROR;
+    weechat_stub_hooks_running++;
+    for (ptr_hook = weechat_stub_hooks; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (!ptr_hook->deleted && (ptr_hook->type == STUB_HOOK_COMMAND)
+            && ptr_hook->name && (strcmp(ptr_hook->name, argv[0]) == 0))
+        {
+            rc = ((int (*)(void *, struct t_gui_buffer *, int, char **,
+                           char **))ptr_hook->callback)
+                (ptr_hook->callback_data, buffer, argc, argv, argv_eol);
+            break;
+        }
+    }
+    weechat_stub_hooks_running--;
+    weechat_stub_hooks_purge();
+
+    if (!ptr_hook)
+    {
+        weechat_stub_printf_date_tags(NULL, 0, NULL,
+                                      "%sUnknown command \"%s\"",
+                                      weechat_stub_prefix("error"), argv[0]);
+    }
+
+    weechat_stub_string_free_split(argv);
+    weechat_stub_string_free_split(argv_eol);
+
+    return rc;
+}
+
+static void
+weechat_stub_plugin_command (struct t_weechat_plugin *plugin,
+                             struct t_gui_buffer *buffer, const char *command)
+{
+    (void) weechat_stub_command(plugin, buffer, command);
+}
+
+/*
+ * Runs timers and fd hooks during timeout_ms milliseconds (0 = run only
+ * timers and fd ready now).
+ */
+
+void
+weechat_stub_run (long timeout_ms)
+{
+    struct t_hook *ptr_hook;
+    struct pollfd fds[256];
+    struct t_hook *fd_hooks[256];
+    long long now, end, next;
+    int i, count, ready, remaining;
+
+    end = weechat_stub_now_ms() + timeout_ms;
+
+    while (1)
+    {
+        /* timers */
+        now = weechat_stub_now_ms();
+        weechat_stub_hooks_running++;
+        for (ptr_hook = weechat_stub_hooks; ptr_hook;
+             ptr_hook = ptr_hook->next_hook)
+        {
+            if (ptr_hook->deleted || (ptr_hook->type != STUB_HOOK_TIMER)
+                || (ptr_hook->next_call > now))
+                continue;
+            ptr_hook->next_call = now + ptr_hook->interval;
+            remaining = -1;
+            if (ptr_hook->max_calls > 0)
+            {
+                ptr_hook->max_calls--;
+                remaining = ptr_hook->max_calls;
+            }
+            (void) ((int (*)(void *, int))ptr_hook->callback)
+                (ptr_hook->callback_data, remaining);
+            if (remaining == 0)
+                ptr_hook->deleted = 1;
+        }
+        weechat_stub_hooks_running--;
+        weechat_stub_hooks_purge();
+
+        /* next timer (or end of run) */
+        now = weechat_stub_now_ms();
+        next = end;
+        for (ptr_hook = weechat_stub_hooks; ptr_hook;
+             ptr_hook = ptr_hook->next_hook)
+        {
+            if (!ptr_hook->deleted && (ptr_hook->type == STUB_HOOK_TIMER)
+                && (ptr_hook->next_call < next))
+                next = ptr_hook->next_call;
+        }
+
+        /* fd */
+        count = 0;
+        for (ptr_hook = weechat_stub_hooks; ptr_hook && (count < 256);
+             ptr_hook = ptr_hook->next_hook)
+        {
+            if (ptr_hook->deleted || (ptr_hook->type != STUB_HOOK_FD)
+                || (ptr_hook->fd < 0))
+                continue;
+            fds[count].fd = ptr_hook->fd;
+            fds[count].events = ((ptr_hook->flags & 1) ? POLLIN : 0)
+                | ((ptr_hook->flags & 2) ? POLLOUT : 0)
+                | ((ptr_hook->flags & 4) ? POLLPRI : 0);
+            fds[count].revents = 0;
+            fd_hooks[count] = ptr_hook;
+            count++;
+        }
+        ready = poll(fds, count, (next > now) ? (int)(next - now) : 0);
+        if (ready > 0)
+        {
+            weechat_stub_hooks_running++;
+            for (i = 0; i < count; i++)
+            {
+                if (fds[i].revents && !fd_hooks[i]->deleted)
+                {
+                    (void) ((int (*)(void *, int))fd_hooks[i]->callback)
+                        (fd_hooks[i]->callback_data, fds[i].fd);
+                }
+            }
+            weechat_stub_hooks_running--;
+            weechat_stub_hooks_purge();
+        }
+
+        if (weechat_stub_now_ms() >= end)
+            break;
+    }
+}
+
+static void
+weechat_stub_unhook (struct t_hook *hook)
+{
+    if (!hook)
+        return;
+
+    hook->deleted = 1;
+    weechat_stub_hooks_purge();
+}
+
+static void
+weechat_stub_unhook_all (struct t_weechat_plugin *plugin)
+{
+    struct t_hook *ptr_hook;
+
+    for (ptr_hook = weechat_stub_hooks; ptr_hook;
+         ptr_hook = ptr_hook->next_hook)
+    {
+        if (ptr_hook->plugin == plugin)
+            ptr_hook->deleted = 1;
+    }
+    weechat_stub_hooks_purge();
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* infos and infolists                                                    */
+/* ---------------------------------------------------------------------- */
+
+static const char *
+weechat_stub_info_get (struct t_weechat_plugin *plugin, const char *info_name,
+                       const char *arguments)
+{
+    if (!info_name)
+        return NULL;
+    if (strcmp(info_name, "weechat_dir") == 0)
+        return weechat_stub_home;
+    if (strcmp(info_name, "version") == 0)
+        return "0.4.0";
+    if (strcmp(info_name, "charset_internal") == 0)
+        return "UTF-8";
+    return NULL;
+}
+
+struct t_infolist_var
+{
+    char *name;                              /* name of variable            */
+    char *value;                             /* value (as string)           */
+    struct t_infolist_var *next_var;         /* link to next variable       */
+};
+
+struct t_infolist_item
+{
+    struct t_infolist_var *vars;             /* variables of item           */
+    struct t_infolist_item *next_item;       /* link to next item           */
+};
+
+struct t_infolist
+{
+    struct t_infolist_item *items;           /* items of infolist           */
+    struct t_infolist_item *last_item;       /* last item                   */
+    struct t_infolist_item *ptr_item;        /* current item (for "next")   */
+};
+
+static struct t_infolist *
+weechat_stub_infolist_new ()
+{
+    return calloc(1, sizeof(struct t_infolist));
+}
+
+static struct t_infolist_item *
+weechat_stub_infolist_new_item (struct t_infolist *infolist)
+{
+    struct t_infolist_item *new_item;
+
+    new_item = calloc(1, sizeof(*new_item));
+    if (!new_item)
+        return NULL;
+    if (infolist->last_item)
+        infolist->last_item->next_item = new_item;
+    else
+        infolist->items = new_item;
+    infolist->last_item = new_item;
+
+    return new_item;
+}
+
+static struct t_infolist_var *
+weechat_stub_infolist_new_var (struct t_infolist_item *item, const char *name,
+                               const char *value)
+{
+    struct t_infolist_var *new_var;
+
+    new_var = calloc(1, sizeof(*new_var));
+    if (!new_var)
+        return NULL;
+    new_var->name = strdup(name);
+    new_var->value = (value) ? strdup(value) : NULL;
+    new_var->next_var = item->vars;
+    item->vars = new_var;
+
+    return new_var;
+}
+
+static struct t_infolist_var *
+weechat_stub_infolist_new_var_integer (struct t_infolist_item *item,
+                                       const char *name, int value)
+{
+    char str_value[32];
+
+    snprintf(str_value, sizeof(str_value), "%d", value);
+
+    return weechat_stub_infolist_new_var(item, name, str_value);
+}
+
+static struct t_infolist_var *
+weechat_stub_infolist_new_var_string (struct t_infolist_item *item,
+                                      const char *name, const char *value)
+{
+    return weechat_stub_infolist_new_var(item, name, value);
+}
+
+static struct t_infolist_var *
+weechat_stub_infolist_new_var_pointer (struct t_infolist_item *item,
+                                       const char *name, void *pointer)
+{
+    char str_value[32];
+
+    snprintf(str_value, sizeof(str_value), "0x%lx", (unsigned long)pointer);
+
+    return weechat_stub_infolist_new_var(item, name, str_value);
+}
+
+static struct t_infolist_var *
+weechat_stub_infolist_new_var_time (struct t_infolist_item *item,
+                                    const char *name, time_t time)
+{
+    char str_value[32];
+
+    snprintf(str_value, sizeof(str_value), "%ld", (long)time);
+
+    return weechat_stub_infolist_new_var(item, name, str_value);
+}
+
+static void
+weechat_stub_infolist_free (struct t_infolist *infolist)
+{
+    struct t_infolist_item *ptr_item, *next_item;
+    struct t_infolist_var *ptr_var, *next_var;
+
+    if (!infolist)
+        return;
+
+    for (ptr_item = infolist->items; ptr_item; ptr_item = next_item)
+    {
+        next_item = ptr_item->next_item;
+        for (ptr_var = ptr_item->vars; ptr_var; ptr_var = next_var)
+        {
+            next_var = ptr_var->next_var;
+            free(ptr_var->name);
+            free(ptr_var->value);
+            free(ptr_var);
+        }
+        free(ptr_item);
+    }
+    free(infolist);
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* plugin                                                                 */
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Creates a plugin with stub functions; "home" is used as WeeChat home
+ * (for weechat_dir and mkdir_home).
+ */
+
+struct t_weechat_plugin *
+weechat_stub_plugin_new (const char *name, const char *home)
+{
+    struct t_weechat_plugin *plugin;
+
+    plugin = calloc(1, sizeof(*plugin));
+    if (!plugin)
+        return NULL;
+
+    if (!weechat_stub_plugin_options)
+    {
+        weechat_stub_plugin_options = weechat_stub_hashtable_new(64,
+                                                                 WEECHAT_HASHTABLE_STRING,
+                                                                 WEECHAT_HASHTABLE_STRING,
+                                                                 NULL, NULL);
+    }
+    if (!weechat_stub_buffer_search_main())
+        weechat_stub_buffer_add("core", "weechat");
+    free(weechat_stub_home);
+    weechat_stub_home = strdup(home);
+
+    plugin->filename = strdup(name);
+    plugin->name = strdup(name);
+    plugin->description = strdup(name);
+    plugin->author = strdup("stub");
+    plugin->version = strdup("0.1.0");
+    plugin->license = strdup("GPL3");
+    plugin->charset = NULL;
+
+    plugin->plugin_get_name = &weechat_stub_plugin_get_name;
+    plugin->charset_set = &weechat_stub_charset_set;
+    plugin->iconv_to_internal = &weechat_stub_iconv;
+    plugin->iconv_from_internal = &weechat_stub_iconv;
+    plugin->gettext = &weechat_stub_gettext;
+    plugin->ngettext = &weechat_stub_ngettext;
+    plugin->strcasecmp = &weechat_stub_strcasecmp;
+    plugin->strncasecmp = &weechat_stub_strncasecmp;
+    plugin->strcmp_ignore_chars = &weechat_stub_strcmp_ignore_chars;
+    plugin->string_match = &weechat_stub_string_match;
+    plugin->string_remove_color = &weechat_stub_string_remove_color;
+    plugin->string_eval_expression = &weechat_stub_string_eval_expression;
+    plugin->string_split = &weechat_stub_string_split;
+    plugin->string_free_split = &weechat_stub_string_free_split;
+
+    plugin->mkdir_home = &weechat_stub_mkdir_home;
+    plugin->mkdir = &weechat_stub_mkdir;
+    plugin->mkdir_parents = &weechat_stub_mkdir_parents;
+    plugin->exec_on_files = &weechat_stub_exec_on_files;
+
+    plugin->list_new = &weechat_stub_list_new;
+    plugin->list_add = &weechat_stub_list_add;
+    plugin->list_search = &weechat_stub_list_search;
+    plugin->list_search_pos = &weechat_stub_list_search_pos;
+    plugin->list_casesearch = &weechat_stub_list_casesearch;
+    plugin->list_casesearch_pos = &weechat_stub_list_casesearch_pos;
+    plugin->list_get = &weechat_stub_list_get;
+    plugin->list_set = &weechat_stub_list_set;
+    plugin->list_next = &weechat_stub_list_next;
+    plugin->list_prev = &weechat_stub_list_prev;
+    plugin->list_string = &weechat_stub_list_string;
+    plugin->list_size = &weechat_stub_list_size;
+    plugin->list_remove = &weechat_stub_list_remove;
+    plugin->list_remove_all = &weechat_stub_list_remove_all;
+    plugin->list_free = &weechat_stub_list_free;
+
+    plugin->hashtable_new = &weechat_stub_hashtable_new;
+    plugin->hashtable_set_with_size = &weechat_stub_hashtable_set_with_size;
+    plugin->hashtable_set = &weechat_stub_hashtable_set;
+    plugin->hashtable_get = &weechat_stub_hashtable_get;
+    plugin->hashtable_has_key = &weechat_stub_hashtable_has_key;
+    plugin->hashtable_map = &weechat_stub_hashtable_map;
+    plugin->hashtable_map_string = &weechat_stub_hashtable_map_string;
+    plugin->hashtable_get_integer = &weechat_stub_hashtable_get_integer;
+    plugin->hashtable_get_string = &weechat_stub_hashtable_get_string;
+    plugin->hashtable_remove = &weechat_stub_hashtable_remove;
+    plugin->hashtable_remove_all = &weechat_stub_hashtable_remove_all;
+    plugin->hashtable_free = &weechat_stub_hashtable_free;
+
+    plugin->config_get = &weechat_stub_config_get;
+    plugin->config_boolean = &weechat_stub_config_boolean;
+    plugin->config_integer = &weechat_stub_config_integer;
+    plugin->config_string = &weechat_stub_config_string;
+    plugin->config_get_plugin = &weechat_stub_config_get_plugin;
+    plugin->config_is_set_plugin = &weechat_stub_config_is_set_plugin;
+    plugin->config_set_plugin = &weechat_stub_config_set_plugin;
+    plugin->config_set_desc_plugin = &weechat_stub_config_set_desc_plugin;
+    plugin->config_unset_plugin = &weechat_stub_config_unset_plugin;
+
+    plugin->prefix = &weechat_stub_prefix;
+    plugin->color = &weechat_stub_color;
+    plugin->printf_date_tags = &weechat_stub_printf_date_tags;
+    plugin->log_printf = &weechat_stub_log_printf;
+
+    plugin->buffer_new = &weechat_stub_buffer_new;
+    plugin->buffer_search = &weechat_stub_buffer_search;
+    plugin->buffer_search_main = &weechat_stub_buffer_search_main;
+    plugin->buffer_clear = &weechat_stub_buffer_clear;
+    plugin->buffer_close = &weechat_stub_buffer_close;
+    plugin->buffer_get_integer = &weechat_stub_buffer_get_integer;
+    plugin->buffer_get_string = &weechat_stub_buffer_get_string;
+    plugin->buffer_get_pointer = &weechat_stub_buffer_get_pointer;
+    plugin->buffer_set = &weechat_stub_buffer_set;
+
+    plugin->command = &weechat_stub_plugin_command;
+
+    plugin->hook_command = &weechat_stub_hook_command;
+    plugin->hook_timer = &weechat_stub_hook_timer;
+    plugin->hook_fd = &weechat_stub_hook_fd;
+    plugin->hook_signal = &weechat_stub_hook_signal;
+    plugin->hook_signal_send = &weechat_stub_signal_send;
+    plugin->hook_config = &weechat_stub_hook_config;
+    plugin->hook_completion = &weechat_stub_hook_completion;
+    plugin->hook_infolist = &weechat_stub_hook_infolist;
+    plugin->hook_hdata = &weechat_stub_hook_hdata;
+    plugin->hook_print = &weechat_stub_hook_print;
+    plugin->unhook = &weechat_stub_unhook;
+    plugin->unhook_all = &weechat_stub_unhook_all;
+
+    plugin->info_get = &weechat_stub_info_get;
+
+    plugin->infolist_new = &weechat_stub_infolist_new;
+    plugin->infolist_new_item = &weechat_stub_infolist_new_item;
+    plugin->infolist_new_var_integer = &weechat_stub_infolist_new_var_integer;
+    plugin->infolist_new_var_string = &weechat_stub_infolist_new_var_string;
+    plugin->infolist_new_var_pointer = &weechat_stub_infolist_new_var_pointer;
+    plugin->infolist_new_var_time = &weechat_stub_infolist_new_var_time;
+    plugin->infolist_free = &weechat_stub_infolist_free;
+
+    return plugin;
+}
+
+/*
+ * Frees a plugin created by weechat_stub_plugin_new (and its hooks).
+ */
+
+void
+weechat_stub_plugin_free (struct t_weechat_plugin *plugin)
+{
+    struct t_gui_buffer *ptr_buffer, *next_buffer;
+
+    if (!plugin)
+        return;
+
+    ptr_buffer = weechat_stub_buffers;
+    while (ptr_buffer)
+    {
+        next_buffer = ptr_buffer->next_buffer;
+        if (strcmp(ptr_buffer->plugin_name, plugin->name) == 0)
+            weechat_stub_buffer_close(ptr_buffer);
+        ptr_buffer = next_buffer;
+    }
+
+    weechat_stub_unhook_all(plugin);
+
+    free(plugin->filename);
+    free(plugin->name);
+    free(plugin->description);
+    free(plugin->author);
+    free(plugin->version);
+    free(plugin->license);
+    free(plugin);
+}
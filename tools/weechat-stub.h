@@ -0,0 +1,126 @@
+#ifndef __WEECHAT_STUB_H_
+#define __WEECHAT_STUB_H_
+
+/*
+ * Stub of WeeChat plugin API, used to run js plugin without WeeChat
+ * (benchmarks and tools): hashtables, lists, options, buffers, hooks
+ * (commands, timers, fd, signals, prints) are implemented in memory, other
+ * functions of t_weechat_plugin are NULL.
+ */
+
+#include <time.h>
+
+#include "weechat-plugin.h"
+
+#define STUB_BUFFER_MAX_LINES 4096           /* lines kept in each buffer   */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum t_stub_hook_type
+{
+    STUB_HOOK_COMMAND = 0,
+    STUB_HOOK_TIMER,
+    STUB_HOOK_FD,
+    STUB_HOOK_SIGNAL,
+    STUB_HOOK_CONFIG,
+    STUB_HOOK_COMPLETION,
+    STUB_HOOK_INFOLIST,
+    STUB_HOOK_HDATA,
+    STUB_HOOK_PRINT,
+    STUB_NUM_HOOK_TYPES,
+};
+
+struct t_hook
+{
+    struct t_weechat_plugin *plugin;         /* plugin which created hook   */
+    enum t_stub_hook_type type;              /* type of hook                */
+    char *name;                              /* command/signal/tags/...     */
+    void *callback;                          /* callback (depends on type)  */
+    void *callback_data;                     /* data sent to callback       */
+    long interval;                           /* timer: interval (ms)        */
+    int max_calls;                           /* timer: calls left (0 = inf) */
+    long long next_call;                     /* timer: next call (ms)       */
+    int fd;                                  /* fd: file descriptor         */
+    int flags;                               /* fd: 1=read, 2=write, 4=exc  */
+    struct t_gui_buffer *buffer;             /* print: buffer (NULL = any)  */
+    char *message;                           /* print: text to search       */
+    int deleted;                             /* unhooked (freed later)      */
+    struct t_hook *prev_hook;                /* link to previous hook       */
+    struct t_hook *next_hook;                /* link to next hook           */
+};
+
+struct t_config_option
+{
+    char *name;                              /* full name (file.sect.name)  */
+    char *value;                             /* value (as string)           */
+    struct t_config_option *next_option;     /* link to next option         */
+};
+
+struct t_stub_line
+{
+    time_t date;                             /* date of line                */
+    char *tags;                              /* tags (comma separated)      */
+    char *prefix;                            /* prefix (before tab)         */
+    char *message;                           /* message                     */
+    struct t_stub_line *next_line;           /* link to next line           */
+};
+
+struct t_gui_buffer
+{
+    char *plugin_name;                       /* "core" or plugin name       */
+    char *name;                              /* buffer name                 */
+    char *full_name;                         /* plugin_name + "." + name    */
+    char *title;                             /* buffer title                */
+    struct t_stub_line *lines;               /* last lines displayed        */
+    struct t_stub_line *last_line;           /* last line                   */
+    int lines_count;                         /* number of lines kept        */
+    int (*input_callback)(void *data,        /* called on input in buffer   */
+                          struct t_gui_buffer *buffer,
+                          const char *input_data);
+    void *input_callback_data;               /* data for input callback     */
+    int (*close_callback)(void *data,        /* called when buffer closed   */
+                          struct t_gui_buffer *buffer);
+    void *close_callback_data;               /* data for close callback     */
+    struct t_hashtable *local_variables;     /* local variables             */
+    struct t_gui_buffer *prev_buffer;        /* link to previous buffer     */
+    struct t_gui_buffer *next_buffer;        /* link to next buffer         */
+};
+
+extern int weechat_stub_verbose;
+extern unsigned long weechat_stub_lines_printed;
+extern struct t_hook *weechat_stub_hooks;
+extern struct t_gui_buffer *weechat_stub_buffers;
+extern void (*weechat_stub_print_cb)(struct t_gui_buffer *buffer,
+                                     time_t date, const char *tags,
+                                     const char *prefix,
+                                     const char *message);
+
+extern struct t_weechat_plugin *weechat_stub_plugin_new (const char *name,
+                                                         const char *home);
+extern void weechat_stub_plugin_free (struct t_weechat_plugin *plugin);
+extern struct t_config_option *weechat_stub_config_set (const char *name,
+                                                        const char *value);
+extern void weechat_stub_signal_send (const char *signal,
+                                      const char *type_data,
+                                      void *signal_data);
+extern void weechat_stub_hooks_purge (void);
+extern struct t_gui_buffer *weechat_stub_buffer_search (const char *plugin,
+                                                        const char *name);
+extern struct t_gui_buffer *weechat_stub_buffer_add (const char *plugin_name,
+                                                     const char *name);
+extern struct t_gui_buffer *weechat_stub_buffer_search_full_name (const char *full_name);
+extern void weechat_stub_print (struct t_gui_buffer *buffer, time_t date,
+                                const char *tags, const char *message);
+extern int weechat_stub_command (struct t_weechat_plugin *plugin,
+                                 struct t_gui_buffer *buffer,
+                                 const char *command);
+extern void weechat_stub_run (long timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WEECHAT_STUB_H_ */
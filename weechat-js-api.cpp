@@ -15,20 +15,35 @@ extern "C"
 
 #include "weechat-js-core.h"
 #include "weechat-js-api.h"
+#include "weechat-js-signal.h"
+#include "weechat-js-timer.h"
+#include "weechat-js-microtask.h"
+#include "weechat-js-process.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-stream.h"
+#include "weechat-js-worker.h"
+#include "weechat-js-fs.h"
+#include "weechat-js-store.h"
+#include "weechat-js-option.h"
+#include "weechat-js-apistats.h"
+#include "weechat-js-cbindex.h"
 
 using namespace v8;
 
 #define API_FUNC(__init, __name, __ret)                                 \
     std::string js_function_name(__name);                               \
+    WeechatJsApiCall js_api_call(__name);                               \
     if (__init                                                          \
         && (!js_current_script || !js_current_script->name))            \
     {                                                                   \
+        js_api_call.setError();                                         \
         WEECHAT_SCRIPT_MSG_NOT_INIT(JS_CURRENT_SCRIPT_NAME,             \
                                     js_function_name.c_str());          \
         __ret;                                                          \
     }
 #define API_WRONG_ARGS(__ret)                                           \
     {                                                                   \
+        js_api_call.setError();                                         \
         WEECHAT_SCRIPT_MSG_WRONG_ARGS(JS_CURRENT_SCRIPT_NAME,           \
                                       js_function_name.c_str());        \
         __ret;                                                          \
@@ -60,6 +75,9 @@ using namespace v8;
 #define API_DEF_FUNC(__name)                                            \
     weechat_obj->Set(String::New(#__name),                              \
                      FunctionTemplate::New(weechat_js_api_##__name));
+#define API_DEF_GLOBAL_FUNC(__js_name, __name)                          \
+    this->addGlobal(#__js_name,                                         \
+                    FunctionTemplate::New(weechat_js_api_##__name));
 #define API_FUNC_DEF(__name)                                            \
     static Handle<Value> weechat_js_api_##__name (const Arguments &args)
 
@@ -89,7 +107,7 @@ API_FUNC_DEF(register)
     String::AsciiValue shutdown_func(args[5]);
     String::AsciiValue charset(args[6]);
 
-    if (plugin_script_search(weechat_js_plugin, js_scripts, *name))
+    if (weechat_js_script_search(*name))
     {
         /* another script already exists with same name */
         weechat_printf (NULL,
@@ -100,13 +118,11 @@ API_FUNC_DEF(register)
         API_RETURN_ERROR;
     }
     /* register script */
-    js_current_script = plugin_script_add (weechat_js_plugin,
-                                           &js_scripts, &last_js_script,
-                                           (js_current_script_filename) ?
-                                           js_current_script_filename : "",
-                                           *name, *author, *version,
-                                           *license, *description,
-                                           *shutdown_func, *charset);
+    js_current_script = weechat_js_script_add ((js_current_script_filename) ?
+                                               js_current_script_filename : "",
+                                               *name, *author, *version,
+                                               *license, *description,
+                                               *shutdown_func, *charset);
 
     if (js_current_script)
     {
@@ -621,24 +637,318 @@ API_FUNC_DEF(list_free)
     API_RETURN_OK;
 }
 
-int weechat_js_api_config_reload_cb(void *data, struct t_config_file *config_file)
+/*
+ * Returns value of an option as string (NULL if value is null).
+ *
+ * Note: result must be freed after use.
+ */
+
+static char *
+weechat_js_api_config_option_value (struct t_hdata *hdata_option,
+                                    struct t_config_option *option)
+{
+    const char *type, *value;
+    char str_value[32];
+
+    if (!weechat_hdata_pointer(hdata_option, option, "value"))
+        return NULL;
+
+    type = weechat_config_option_get_string(option, "type");
+    if (!type)
+        return NULL;
+
+    if (strcmp(type, "boolean") == 0)
+        return strdup((weechat_config_boolean(option)) ? "on" : "off");
+    if (strcmp(type, "integer") == 0)
+    {
+        /* integer with string values */
+        value = weechat_config_string(option);
+        if (value)
+            return strdup(value);
+        snprintf(str_value, sizeof(str_value), "%d",
+                 weechat_config_integer(option));
+        return strdup(str_value);
+    }
+    if (strcmp(type, "color") == 0)
+    {
+        value = weechat_config_color(option);
+        return (value) ? strdup(value) : NULL;
+    }
+
+    value = weechat_config_string(option);
+    return (value) ? strdup(value) : NULL;
+}
+
+/*
+ * Returns values of all options in a configuration file: hashtable with
+ * full name of option ("file.section.option") as key.
+ */
+
+static struct t_hashtable *
+weechat_js_api_config_values (struct t_config_file *config_file)
+{
+    struct t_hdata *hdata_file, *hdata_section, *hdata_option;
+    struct t_hashtable *values;
+    void *ptr_section, *ptr_option;
+    const char *file_name, *section_name, *option_name;
+    char *full_name, *value;
+    int length;
+
+    values = weechat_hashtable_new(128,
+                                   WEECHAT_HASHTABLE_STRING,
+                                   WEECHAT_HASHTABLE_STRING,
+                                   NULL, NULL);
+    if (!values)
+        return NULL;
+
+    hdata_file = weechat_hdata_get("config_file");
+    hdata_section = weechat_hdata_get("config_section");
+    hdata_option = weechat_hdata_get("config_option");
+    if (!hdata_file || !hdata_section || !hdata_option)
+        return values;
+
+    file_name = weechat_hdata_string(hdata_file, config_file, "name");
+    for (ptr_section = weechat_hdata_pointer(hdata_file, config_file,
+                                             "sections");
+         ptr_section;
+         ptr_section = weechat_hdata_pointer(hdata_section, ptr_section,
+                                             "next_section"))
+    {
+        section_name = weechat_hdata_string(hdata_section, ptr_section,
+                                            "name");
+        for (ptr_option = weechat_hdata_pointer(hdata_section, ptr_section,
+                                                "options");
+             ptr_option;
+             ptr_option = weechat_hdata_pointer(hdata_option, ptr_option,
+                                                "next_option"))
+        {
+            option_name = weechat_hdata_string(hdata_option, ptr_option,
+                                               "name");
+            length = strlen((file_name) ? file_name : "")
+                + strlen((section_name) ? section_name : "")
+                + strlen((option_name) ? option_name : "") + 3;
+            full_name = (char *) malloc(length);
+            if (!full_name)
+                continue;
+            snprintf(full_name, length, "%s.%s.%s",
+                     (file_name) ? file_name : "",
+                     (section_name) ? section_name : "",
+                     (option_name) ? option_name : "");
+            value = weechat_js_api_config_option_value(
+                hdata_option, (struct t_config_option *) ptr_option);
+            weechat_hashtable_set(values, full_name, value);
+            free(full_name);
+            if (value)
+                free(value);
+        }
+    }
+
+    return values;
+}
+
+struct t_js_api_config_diff
+{
+    struct t_hashtable *other;               /* values to compare with      */
+    struct t_hashtable *changes;             /* options changed             */
+};
+
+/*
+ * Adds option in changes if its value is not the same in other values
+ * (callback of hashtable_map_string).
+ */
+
+static void
+weechat_js_api_config_diff_cb (void *data, struct t_hashtable *hashtable,
+                               const char *key, const char *value)
+{
+    struct t_js_api_config_diff *diff;
+    const char *other_value;
+
+    diff = (struct t_js_api_config_diff *) data;
+
+    if (weechat_hashtable_has_key(diff->other, key))
+    {
+        other_value = (const char *) weechat_hashtable_get(diff->other, key);
+        if ((!value && !other_value)
+            || (value && other_value && (strcmp(value, other_value) == 0)))
+            return;
+    }
+
+    weechat_hashtable_set(diff->changes, key, value);
+}
+
+/*
+ * Adds option in changes (with null value) if it is not in other values
+ * (callback of hashtable_map_string).
+ */
+
+static void
+weechat_js_api_config_removed_cb (void *data, struct t_hashtable *hashtable,
+                                  const char *key, const char *value)
+{
+    struct t_js_api_config_diff *diff;
+
+    diff = (struct t_js_api_config_diff *) data;
+
+    if (!weechat_hashtable_has_key(diff->other, key))
+        weechat_hashtable_set(diff->changes, key, NULL);
+}
+
+/*
+ * Callback for reload of a configuration file created by a script (same
+ * contract as other script plugins): script function is called with
+ * (data, config_file) and must reload the file itself (for example with
+ * config_reload).
+ */
+
+int
+weechat_js_api_config_reload_cb (void *data,
+                                 struct t_config_file *config_file)
 {
+    struct t_plugin_script_cb *script_callback;
+    void *func_argv[2];
+    char empty_arg[1] = { '\0' };
+    int *rc, ret;
+
+    script_callback = (struct t_plugin_script_cb *) data;
+
+    if (script_callback && script_callback->function
+        && script_callback->function[0])
+    {
+        func_argv[0] = (script_callback->data) ?
+            script_callback->data : empty_arg;
+        func_argv[1] = plugin_script_ptr2str(config_file);
+
+        rc = (int *) weechat_js_exec((struct t_plugin_script *) script_callback->script,
+                                     WEECHAT_SCRIPT_EXEC_INT,
+                                     script_callback->function,
+                                     "ss", func_argv);
+
+        if (!rc)
+            ret = WEECHAT_CONFIG_READ_FILE_NOT_FOUND;
+        else
+        {
+            ret = *rc;
+            free(rc);
+        }
+        if (func_argv[1])
+            free(func_argv[1]);
+
+        return ret;
+    }
+
     return WEECHAT_CONFIG_READ_FILE_NOT_FOUND;
 }
 
+/*
+ * Callback for reload of a configuration file created by a script with
+ * option "diff": file is reloaded by the plugin (config_reload: options
+ * not in file are reset to their default value), then script function is
+ * called with (data, config_file, changes), where changes is an object with
+ * options changed by the reload: full name of option as key and new value
+ * (null for a null value or an option removed).
+ */
+
+int
+weechat_js_api_config_reload_diff_cb (void *data,
+                                      struct t_config_file *config_file)
+{
+    struct t_plugin_script_cb *script_callback;
+    struct t_hashtable *values_before, *values_after;
+    struct t_js_api_config_diff diff;
+    void *func_argv[3];
+    char empty_arg[1] = { '\0' };
+    int *rc, rc_reload;
+
+    script_callback = (struct t_plugin_script_cb *) data;
+
+    values_before = weechat_js_api_config_values(config_file);
+    rc_reload = weechat_config_reload(config_file);
+    values_after = weechat_js_api_config_values(config_file);
+
+    diff.changes = weechat_hashtable_new(32,
+                                         WEECHAT_HASHTABLE_STRING,
+                                         WEECHAT_HASHTABLE_STRING,
+                                         NULL, NULL);
+    if (diff.changes && values_before && values_after)
+    {
+        diff.other = values_before;
+        weechat_hashtable_map_string(values_after,
+                                     &weechat_js_api_config_diff_cb, &diff);
+        diff.other = values_after;
+        weechat_hashtable_map_string(values_before,
+                                     &weechat_js_api_config_removed_cb,
+                                     &diff);
+    }
+
+    if (script_callback && script_callback->function
+        && script_callback->function[0] && diff.changes)
+    {
+        func_argv[0] = (script_callback->data) ?
+            script_callback->data : empty_arg;
+        func_argv[1] = plugin_script_ptr2str(config_file);
+        func_argv[2] = diff.changes;
+
+        rc = (int *) weechat_js_exec((struct t_plugin_script *) script_callback->script,
+                                     WEECHAT_SCRIPT_EXEC_INT,
+                                     script_callback->function,
+                                     "ssh", func_argv);
+
+        /* error of reload is kept, otherwise script gives result */
+        if (rc)
+        {
+            if (rc_reload == WEECHAT_CONFIG_READ_OK)
+                rc_reload = *rc;
+            free(rc);
+        }
+        if (func_argv[1])
+            free(func_argv[1]);
+    }
+
+    if (values_before)
+        weechat_hashtable_free(values_before);
+    if (values_after)
+        weechat_hashtable_free(values_after);
+    if (diff.changes)
+        weechat_hashtable_free(diff.changes);
+
+    return rc_reload;
+}
+
+/*
+ * Creates a configuration file: config_new(name, function, data[, options]).
+ *
+ * Without options, function is called on /reload with (data, config_file)
+ * and must reload the file itself. With options {diff: true}, the plugin
+ * reloads the file and function is called with (data, config_file,
+ * changes): only options changed by the reload are in changes.
+ */
+
 API_FUNC_DEF(config_new)
 {
+    struct t_config_file *ptr_object;
     char *result;
+    int diff;
 
     API_FUNC(1, "config_new", API_RETURN_EMPTY);
-    if (args.Length() != 3)
+    if ((args.Length() < 3) || (args.Length() > 4)
+        || ((args.Length() == 4) && !args[3]->IsObject()))
         API_WRONG_ARGS(API_RETURN_EMPTY);
 
     String::AsciiValue name(args[0]);
     String::AsciiValue function(args[1]);
     String::AsciiValue data(args[2]);
-
-    result = API_PTR2STR(plugin_script_api_config_new(weechat_js_plugin, js_current_script, *name, NULL, *function, *data));
+    diff = ((args.Length() == 4)
+            && args[3]->ToObject()->Get(String::New("diff"))->BooleanValue()) ?
+        1 : 0;
+
+    ptr_object = plugin_script_api_config_new(weechat_js_plugin, js_current_script, *name,
+                                              (diff) ?
+                                              &weechat_js_api_config_reload_diff_cb :
+                                              &weechat_js_api_config_reload_cb,
+                                              *function, *data);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
 
     API_RETURN_STRING_FREE(result);
 }
@@ -646,6 +956,7 @@ API_FUNC_DEF(config_new)
 API_FUNC_DEF(config_new_section)
 {
     int user_can_add_options, user_can_delete_options;
+    struct t_config_section *ptr_object;
     char *result;
 
     API_FUNC(1, "config_new_section", API_RETURN_EMPTY);
@@ -667,27 +978,29 @@ API_FUNC_DEF(config_new_section)
     String::AsciiValue function_delete_option(args[12]);
     String::AsciiValue data_delete_option(args[13]);
 
-    result = API_PTR2STR(plugin_script_api_config_new_section (weechat_js_plugin,
-                                                               js_current_script,
-                                                               (t_config_file *) API_STR2PTR(*config_file),
-                                                               *name,
-                                                               user_can_add_options,
-                                                               user_can_delete_options,
-                                                               NULL,
-                                                               *function_read,
-                                                               *data_read,
-                                                               NULL,
-                                                               *function_write,
-                                                               *data_write,
-                                                               NULL,
-                                                               *function_write_default,
-                                                               *data_write_default,
-                                                               NULL,
-                                                               *function_create_option,
-                                                               *data_create_option,
-                                                               NULL,
-                                                               *function_delete_option,
-                                                               *data_delete_option));
+    ptr_object = plugin_script_api_config_new_section (weechat_js_plugin,
+                                                       js_current_script,
+                                                       (t_config_file *) API_STR2PTR(*config_file),
+                                                       *name,
+                                                       user_can_add_options,
+                                                       user_can_delete_options,
+                                                       NULL,
+                                                       *function_read,
+                                                       *data_read,
+                                                       NULL,
+                                                       *function_write,
+                                                       *data_write,
+                                                       NULL,
+                                                       *function_write_default,
+                                                       *data_write_default,
+                                                       NULL,
+                                                       *function_create_option,
+                                                       *data_create_option,
+                                                       NULL,
+                                                       *function_delete_option,
+                                                       *data_delete_option);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
 
     API_RETURN_STRING_FREE(result);
 }
@@ -710,6 +1023,7 @@ API_FUNC_DEF(config_search_section)
 
 API_FUNC_DEF(config_new_option)
 {
+    struct t_config_option *ptr_object;
     char *result;
     int min, max, null_value_allowed;
 
@@ -735,28 +1049,30 @@ API_FUNC_DEF(config_new_option)
     String::AsciiValue function_delete(args[15]);
     String::AsciiValue data_delete(args[16]);
 
-    result = API_PTR2STR(plugin_script_api_config_new_option (weechat_js_plugin,
-                                                              js_current_script,
-                                                              (t_config_file *) API_STR2PTR(*config_file),
-                                                              (t_config_section *) API_STR2PTR(*section),
-                                                              *name,
-                                                              *type,
-                                                              *description,
-                                                              *string_values,
-                                                              min,
-                                                              max,
-                                                              *default_value,
-                                                              *value,
-                                                              null_value_allowed,
-                                                              NULL,
-                                                              *function_check_value,
-                                                              *data_check_value,
-                                                              NULL,
-                                                              *function_change,
-                                                              *data_change,
-                                                              NULL,
-                                                              *function_delete,
-                                                              *data_delete));
+    ptr_object = plugin_script_api_config_new_option (weechat_js_plugin,
+                                                      js_current_script,
+                                                      (t_config_file *) API_STR2PTR(*config_file),
+                                                      (t_config_section *) API_STR2PTR(*section),
+                                                      *name,
+                                                      *type,
+                                                      *description,
+                                                      *string_values,
+                                                      min,
+                                                      max,
+                                                      *default_value,
+                                                      *value,
+                                                      null_value_allowed,
+                                                      NULL,
+                                                      *function_check_value,
+                                                      *data_check_value,
+                                                      NULL,
+                                                      *function_change,
+                                                      *data_change,
+                                                      NULL,
+                                                      *function_delete,
+                                                      *data_delete);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
 
     API_RETURN_STRING_FREE(result);
 }
@@ -1097,58 +1413,80 @@ API_FUNC_DEF(config_reload)
 
 API_FUNC_DEF(config_option_free)
 {
+    void *ptr_option;
+
     API_FUNC(1, "config_option_free", API_RETURN_ERROR);
     if (args.Length() != 1)
         API_WRONG_ARGS(API_RETURN_ERROR);
 
     String::AsciiValue option(args[0]);
+    ptr_option = API_STR2PTR(*option);
 
-    plugin_script_api_config_option_free(weechat_js_plugin, js_current_script, (t_config_option *) API_STR2PTR(*option));
+    /* callbacks of option are found with index */
+    weechat_config_option_free((t_config_option *) ptr_option);
+    weechat_js_cbindex_free_pointer(ptr_option);
 
     API_RETURN_OK;
 }
 
 API_FUNC_DEF(config_section_free_options)
 {
+    struct t_config_section *ptr_section;
+    std::vector<void *> pointers;
+
     API_FUNC(1, "config_section_free_options", API_RETURN_ERROR);
     if (args.Length() != 1)
         API_WRONG_ARGS(API_RETURN_ERROR);
 
     String::AsciiValue section(args[0]);
+    ptr_section = (t_config_section *) API_STR2PTR(*section);
 
-    plugin_script_api_config_section_free_options(weechat_js_plugin,
-                                                  js_current_script,
-                                                  (t_config_section *) API_STR2PTR(*section));
+    /* callbacks of options are found with index */
+    weechat_js_cbindex_section_pointers(ptr_section, pointers);
+    weechat_config_section_free_options(ptr_section);
+    weechat_js_cbindex_free_pointers(pointers);
 
     API_RETURN_OK;
 }
 
 API_FUNC_DEF(config_section_free)
 {
+    struct t_config_section *ptr_section;
+    std::vector<void *> pointers;
+
     API_FUNC(1, "config_section_free", API_RETURN_ERROR);
     if (args.Length() != 1)
         API_WRONG_ARGS(API_RETURN_ERROR);
 
     String::AsciiValue section(args[0]);
+    ptr_section = (t_config_section *) API_STR2PTR(*section);
 
-    plugin_script_api_config_section_free(weechat_js_plugin,
-                                          js_current_script,
-                                          (t_config_section *) API_STR2PTR(*section));
+    /* callbacks of section and its options are found with index */
+    if (ptr_section)
+        pointers.push_back(ptr_section);
+    weechat_js_cbindex_section_pointers(ptr_section, pointers);
+    weechat_config_section_free(ptr_section);
+    weechat_js_cbindex_free_pointers(pointers);
 
     API_RETURN_OK;
 }
 
 API_FUNC_DEF(config_free)
 {
+    struct t_config_file *ptr_config_file;
+    std::vector<void *> pointers;
+
     API_FUNC(1, "config_free", API_RETURN_ERROR);
     if (args.Length() != 1)
         API_WRONG_ARGS(API_RETURN_ERROR);
 
     String::AsciiValue config_file(args[0]);
+    ptr_config_file = (t_config_file *) API_STR2PTR(*config_file);
 
-    plugin_script_api_config_free(weechat_js_plugin,
-                                  js_current_script,
-                                  (t_config_file *) API_STR2PTR(*config_file));
+    /* callbacks of file, sections and options are found with index */
+    weechat_js_cbindex_file_pointers(ptr_config_file, pointers);
+    weechat_config_free(ptr_config_file);
+    weechat_js_cbindex_free_pointers(pointers);
 
     API_RETURN_OK;
 }
@@ -1168,6 +1506,17 @@ API_FUNC_DEF(config_get)
     API_RETURN_STRING_FREE(result);
 }
 
+API_FUNC_DEF(config_option)
+{
+    API_FUNC(1, "config_option", return v8::Null());
+    if (args.Length() != 1)
+        API_WRONG_ARGS(return v8::Null());
+
+    String::AsciiValue option(args[0]);
+
+    return weechat_js_option_get(js_current_script, *option);
+}
+
 API_FUNC_DEF(config_get_plugin)
 {
     const char *result;
@@ -1403,6 +1752,769 @@ API_FUNC_DEF(log_print)
     API_RETURN_OK;
 }
 
+int
+weechat_js_api_hook_fd_cb (void *data, int fd)
+{
+    struct t_plugin_script_cb *script_callback;
+    void *func_argv[2];
+    char empty_arg[1] = { '\0' };
+    int *rc, ret;
+
+    script_callback = (struct t_plugin_script_cb *) data;
+
+    if (script_callback && script_callback->function
+        && script_callback->function[0])
+    {
+        func_argv[0] = (script_callback->data) ?
+            script_callback->data : empty_arg;
+        func_argv[1] = &fd;
+
+        rc = (int *) weechat_js_exec((struct t_plugin_script *) script_callback->script,
+                                     WEECHAT_SCRIPT_EXEC_INT,
+                                     script_callback->function,
+                                     "si", func_argv);
+        if (!rc)
+            ret = WEECHAT_RC_ERROR;
+        else
+        {
+            ret = *rc;
+            free(rc);
+        }
+
+        return ret;
+    }
+
+    return WEECHAT_RC_ERROR;
+}
+
+API_FUNC_DEF(hook_fd)
+{
+    int fd, read, write, exception;
+    struct t_hook *ptr_object;
+    char *result;
+
+    API_FUNC(1, "hook_fd", API_RETURN_EMPTY);
+    if (args.Length() != 6)
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    fd = args[0]->IntegerValue();
+    read = args[1]->IntegerValue();
+    write = args[2]->IntegerValue();
+    exception = args[3]->IntegerValue();
+    String::AsciiValue function(args[4]);
+    String::AsciiValue data(args[5]);
+
+    ptr_object = plugin_script_api_hook_fd(weechat_js_plugin,
+                                           js_current_script,
+                                           fd,
+                                           read,
+                                           write,
+                                           exception,
+                                           &weechat_js_api_hook_fd_cb,
+                                           *function,
+                                           *data);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(stream_open)
+{
+    int binary, read_size;
+    char *result;
+    Handle<Object> options;
+
+    API_FUNC(1, "stream_open", API_RETURN_EMPTY);
+    if ((args.Length() != 4) || !args[1]->IsObject())
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value path(args[0]);
+    options = args[1]->ToObject();
+    String::AsciiValue mode(options->Get(String::New("mode")));
+    binary = options->Get(String::New("binary"))->BooleanValue() ? 1 : 0;
+    read_size = options->Get(String::New("read_size"))->Int32Value();
+    String::AsciiValue function(args[2]);
+    String::AsciiValue data(args[3]);
+
+    result = API_PTR2STR(weechat_js_stream_open(js_current_script,
+                                                *path,
+                                                (options->Has(String::New("mode"))) ?
+                                                *mode : "r",
+                                                binary,
+                                                read_size,
+                                                *function,
+                                                *data));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(stream_connect)
+{
+    int binary, read_size;
+    char *result;
+    Handle<Object> options;
+
+    API_FUNC(1, "stream_connect", API_RETURN_EMPTY);
+    if ((args.Length() != 4) || !args[1]->IsObject())
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value path(args[0]);
+    options = args[1]->ToObject();
+    binary = options->Get(String::New("binary"))->BooleanValue() ? 1 : 0;
+    read_size = options->Get(String::New("read_size"))->Int32Value();
+    String::AsciiValue function(args[2]);
+    String::AsciiValue data(args[3]);
+
+    result = API_PTR2STR(weechat_js_stream_connect(js_current_script,
+                                                   *path,
+                                                   binary,
+                                                   read_size,
+                                                   *function,
+                                                   *data));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(stream_write)
+{
+    char *bytes;
+    int size, rc;
+
+    API_FUNC(1, "stream_write", API_RETURN_INT(-1));
+    if (args.Length() != 2)
+        API_WRONG_ARGS(API_RETURN_INT(-1));
+
+    String::AsciiValue stream(args[0]);
+
+    bytes = weechat_js_buffer_data(args[1], &size);
+    if (bytes)
+    {
+        rc = weechat_js_stream_write(js_current_script,
+                                     API_STR2PTR(*stream),
+                                     bytes, size);
+    }
+    else
+    {
+        String::Utf8Value data(args[1]);
+        rc = weechat_js_stream_write(js_current_script,
+                                     API_STR2PTR(*stream),
+                                     *data, data.length());
+    }
+
+    API_RETURN_INT(rc);
+}
+
+API_FUNC_DEF(stream_pause)
+{
+    API_FUNC(1, "stream_pause", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue stream(args[0]);
+
+    if (weechat_js_stream_pause(js_current_script, API_STR2PTR(*stream), 1))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(stream_resume)
+{
+    API_FUNC(1, "stream_resume", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue stream(args[0]);
+
+    if (weechat_js_stream_pause(js_current_script, API_STR2PTR(*stream), 0))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(stream_close)
+{
+    API_FUNC(1, "stream_close", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue stream(args[0]);
+
+    if (weechat_js_stream_close(js_current_script, API_STR2PTR(*stream)))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(worker_new)
+{
+    char *result;
+
+    API_FUNC(1, "worker_new", API_RETURN_EMPTY);
+    if (args.Length() != 3)
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value filename(args[0]);
+    String::AsciiValue function(args[1]);
+    String::AsciiValue data(args[2]);
+
+    result = API_PTR2STR(weechat_js_worker_new(js_current_script,
+                                               *filename,
+                                               *function,
+                                               *data));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(worker_post)
+{
+    API_FUNC(1, "worker_post", API_RETURN_ERROR);
+    if (args.Length() != 2)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue worker(args[0]);
+
+    if (weechat_js_worker_post(js_current_script, API_STR2PTR(*worker),
+                               args[1]))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(worker_terminate)
+{
+    API_FUNC(1, "worker_terminate", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue worker(args[0]);
+
+    if (weechat_js_worker_remove(js_current_script, API_STR2PTR(*worker)))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+/*
+ * Submits an async file job: last arguments are optional function and
+ * data (without function, a promise is returned).
+ */
+
+static Handle<Value>
+weechat_js_api_fs_submit (const Arguments &args, int op, int first_cb)
+{
+    HandleScope scope;
+    char *bytes;
+    int size, binary;
+
+    String::Utf8Value path(args[0]);
+    String::AsciiValue function((args.Length() > first_cb) ?
+                                args[first_cb] : Handle<Value>(String::New("")));
+    String::AsciiValue data((args.Length() > first_cb + 1) ?
+                            args[first_cb + 1] : Handle<Value>(String::New("")));
+
+    if ((op == JS_FS_OP_WRITE) || (op == JS_FS_OP_APPEND))
+    {
+        bytes = weechat_js_buffer_data(args[1], &size);
+        if (bytes)
+        {
+            return scope.Close(weechat_js_fs_submit(js_current_script, op,
+                                                    *path, bytes, size, 0,
+                                                    *function, *data));
+        }
+        String::Utf8Value content(args[1]);
+        return scope.Close(weechat_js_fs_submit(js_current_script, op,
+                                                *path, *content,
+                                                content.length(), 0,
+                                                *function, *data));
+    }
+
+    binary = ((op == JS_FS_OP_READ) && args[1]->IsObject()) ?
+        args[1]->ToObject()->Get(String::New("binary"))->BooleanValue() : 0;
+
+    return scope.Close(weechat_js_fs_submit(js_current_script, op, *path,
+                                            NULL, 0, binary,
+                                            *function, *data));
+}
+
+API_FUNC_DEF(read_file)
+{
+    API_FUNC(1, "read_file", API_RETURN_ERROR);
+    if ((args.Length() < 1) || (args.Length() > 4))
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    return weechat_js_api_fs_submit(args, JS_FS_OP_READ, 2);
+}
+
+API_FUNC_DEF(write_file)
+{
+    API_FUNC(1, "write_file", API_RETURN_ERROR);
+    if ((args.Length() < 2) || (args.Length() > 4))
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    return weechat_js_api_fs_submit(args, JS_FS_OP_WRITE, 2);
+}
+
+API_FUNC_DEF(append_file)
+{
+    API_FUNC(1, "append_file", API_RETURN_ERROR);
+    if ((args.Length() < 2) || (args.Length() > 4))
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    return weechat_js_api_fs_submit(args, JS_FS_OP_APPEND, 2);
+}
+
+API_FUNC_DEF(stat)
+{
+    API_FUNC(1, "stat", API_RETURN_ERROR);
+    if ((args.Length() < 1) || (args.Length() > 3))
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    return weechat_js_api_fs_submit(args, JS_FS_OP_STAT, 1);
+}
+
+API_FUNC_DEF(store)
+{
+    char *result;
+
+    API_FUNC(1, "store", API_RETURN_EMPTY);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value name(args[0]);
+
+    result = API_PTR2STR(weechat_js_store_open(js_current_script, *name));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+/*
+ * Returns value of a key in a store, null if key is not found.
+ */
+
+API_FUNC_DEF(store_get)
+{
+    struct t_js_store *ptr_store;
+    const char *value;
+    size_t value_length;
+
+    API_FUNC(1, "store_get", return v8::Null());
+    if (args.Length() != 2)
+        API_WRONG_ARGS(return v8::Null());
+
+    String::AsciiValue store(args[0]);
+    String::Utf8Value key(args[1]);
+
+    ptr_store = weechat_js_store_search(js_current_script,
+                                        API_STR2PTR(*store));
+    value = weechat_js_store_get(ptr_store, *key, key.length(),
+                                 &value_length);
+    if (!value)
+        return v8::Null();
+
+    return String::New(value, value_length);
+}
+
+API_FUNC_DEF(store_set)
+{
+    struct t_js_store *ptr_store;
+
+    API_FUNC(1, "store_set", API_RETURN_ERROR);
+    if (args.Length() != 3)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue store(args[0]);
+    String::Utf8Value key(args[1]);
+    String::Utf8Value value(args[2]);
+
+    ptr_store = weechat_js_store_search(js_current_script,
+                                        API_STR2PTR(*store));
+    if (weechat_js_store_set(ptr_store, *key, key.length(),
+                             *value, value.length()))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(store_delete)
+{
+    struct t_js_store *ptr_store;
+
+    API_FUNC(1, "store_delete", API_RETURN_ERROR);
+    if (args.Length() != 2)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue store(args[0]);
+    String::Utf8Value key(args[1]);
+
+    ptr_store = weechat_js_store_search(js_current_script,
+                                        API_STR2PTR(*store));
+    if (weechat_js_store_delete(ptr_store, *key, key.length()))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(store_count)
+{
+    struct t_js_store *ptr_store;
+
+    API_FUNC(1, "store_count", API_RETURN_INT(0));
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_INT(0));
+
+    String::AsciiValue store(args[0]);
+
+    ptr_store = weechat_js_store_search(js_current_script,
+                                        API_STR2PTR(*store));
+
+    API_RETURN_INT(weechat_js_store_count(ptr_store));
+}
+
+API_FUNC_DEF(store_close)
+{
+    struct t_js_store *ptr_store;
+
+    API_FUNC(1, "store_close", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue store(args[0]);
+
+    ptr_store = weechat_js_store_search(js_current_script,
+                                        API_STR2PTR(*store));
+    if (!ptr_store)
+        API_RETURN_ERROR;
+
+    weechat_js_store_close(ptr_store);
+
+    API_RETURN_OK;
+}
+
+int
+weechat_js_api_hook_process_cb (void *data,
+                                const char *command, int return_code,
+                                const char *out, const char *err)
+{
+    struct t_plugin_script_cb *script_callback;
+    void *func_argv[5];
+    char empty_arg[1] = { '\0' };
+    int *rc, ret;
+
+    script_callback = (struct t_plugin_script_cb *) data;
+
+    if (script_callback && script_callback->function
+        && script_callback->function[0])
+    {
+        func_argv[0] = (script_callback->data) ?
+            script_callback->data : empty_arg;
+        func_argv[1] = (command) ? (char *) command : empty_arg;
+        func_argv[2] = &return_code;
+        func_argv[3] = (out) ? (char *) out : empty_arg;
+        func_argv[4] = (err) ? (char *) err : empty_arg;
+
+        rc = (int *) weechat_js_exec((struct t_plugin_script *) script_callback->script,
+                                     WEECHAT_SCRIPT_EXEC_INT,
+                                     script_callback->function,
+                                     "ssiss", func_argv);
+        if (!rc)
+            ret = WEECHAT_RC_ERROR;
+        else
+        {
+            ret = *rc;
+            free(rc);
+        }
+
+        return ret;
+    }
+
+    return WEECHAT_RC_ERROR;
+}
+
+API_FUNC_DEF(hook_process)
+{
+    int timeout;
+    struct t_hook *ptr_object;
+    char *result;
+
+    API_FUNC(1, "hook_process", API_RETURN_EMPTY);
+    if (args.Length() != 4)
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value command(args[0]);
+    timeout = args[1]->IntegerValue();
+    String::AsciiValue function(args[2]);
+    String::AsciiValue data(args[3]);
+
+    ptr_object = plugin_script_api_hook_process(weechat_js_plugin,
+                                                js_current_script,
+                                                *command,
+                                                timeout,
+                                                &weechat_js_api_hook_process_cb,
+                                                *function,
+                                                *data);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(hook_process_hashtable)
+{
+    int timeout;
+    struct t_hook *ptr_object;
+    char *result;
+    struct t_hashtable *options;
+
+    API_FUNC(1, "hook_process_hashtable", API_RETURN_EMPTY);
+    if ((args.Length() != 5) || !args[1]->IsObject())
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value command(args[0]);
+    options = weechat_js_object_to_hashtable(args[1]->ToObject(),
+                                             WEECHAT_SCRIPT_HASHTABLE_DEFAULT_SIZE,
+                                             WEECHAT_HASHTABLE_STRING,
+                                             WEECHAT_HASHTABLE_STRING);
+    timeout = args[2]->IntegerValue();
+    String::AsciiValue function(args[3]);
+    String::AsciiValue data(args[4]);
+
+    ptr_object = plugin_script_api_hook_process_hashtable(weechat_js_plugin,
+                                                          js_current_script,
+                                                          *command,
+                                                          options,
+                                                          timeout,
+                                                          &weechat_js_api_hook_process_cb,
+                                                          *function,
+                                                          *data);
+    weechat_js_cbindex_add_new(js_current_script, ptr_object);
+    result = API_PTR2STR(ptr_object);
+
+    if (options)
+        weechat_hashtable_free(options);
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(hook_process_stream)
+{
+    int timeout, chunk_size, binary;
+    char *result;
+    Handle<Object> options;
+
+    API_FUNC(1, "hook_process_stream", API_RETURN_EMPTY);
+    if ((args.Length() != 4) || !args[1]->IsObject())
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::Utf8Value command(args[0]);
+    options = args[1]->ToObject();
+    timeout = options->Get(String::New("timeout"))->Int32Value();
+    chunk_size = options->Get(String::New("max_buffer"))->Int32Value();
+    binary = options->Get(String::New("binary"))->BooleanValue() ? 1 : 0;
+    String::AsciiValue function(args[2]);
+    String::AsciiValue data(args[3]);
+
+    result = API_PTR2STR(weechat_js_process_new(js_current_script,
+                                                *command,
+                                                timeout,
+                                                chunk_size,
+                                                binary,
+                                                *function,
+                                                *data));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(process_pause)
+{
+    API_FUNC(1, "process_pause", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue hook(args[0]);
+
+    if (weechat_js_process_pause(js_current_script, API_STR2PTR(*hook), 1))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(process_resume)
+{
+    API_FUNC(1, "process_resume", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue hook(args[0]);
+
+    if (weechat_js_process_pause(js_current_script, API_STR2PTR(*hook), 0))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(hook_signal)
+{
+    char *result;
+
+    API_FUNC(1, "hook_signal", API_RETURN_EMPTY);
+    if (args.Length() != 3)
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    String::AsciiValue signal(args[0]);
+    String::AsciiValue function(args[1]);
+    String::AsciiValue data(args[2]);
+
+    result = API_PTR2STR(weechat_js_signal_hook(js_current_script,
+                                                *signal,
+                                                *function,
+                                                *data));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(hook_signal_send)
+{
+    int number;
+
+    API_FUNC(1, "hook_signal_send", API_RETURN_ERROR);
+    if (args.Length() != 3)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue signal(args[0]);
+    String::AsciiValue type_data(args[1]);
+
+    if (strcmp(*type_data, WEECHAT_HOOK_SIGNAL_STRING) == 0)
+    {
+        String::Utf8Value signal_data(args[2]);
+        weechat_hook_signal_send(*signal, *type_data, *signal_data);
+        API_RETURN_OK;
+    }
+    else if (strcmp(*type_data, WEECHAT_HOOK_SIGNAL_INT) == 0)
+    {
+        number = args[2]->Int32Value();
+        weechat_hook_signal_send(*signal, *type_data, &number);
+        API_RETURN_OK;
+    }
+    else if (strcmp(*type_data, WEECHAT_HOOK_SIGNAL_POINTER) == 0)
+    {
+        String::AsciiValue signal_data(args[2]);
+        weechat_hook_signal_send(*signal, *type_data,
+                                 API_STR2PTR(*signal_data));
+        API_RETURN_OK;
+    }
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(unhook)
+{
+    void *hook;
+
+    API_FUNC(1, "unhook", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue weechat_hook(args[0]);
+    hook = API_STR2PTR(*weechat_hook);
+
+    /* signals are hooked by the router, not directly in WeeChat */
+    if (!weechat_js_signal_unhook(js_current_script, hook)
+        && !weechat_js_process_remove(js_current_script, hook)
+        && !weechat_js_stream_remove(js_current_script, hook)
+        && !weechat_js_worker_remove(js_current_script, hook))
+    {
+        /* callbacks of hook are found with index */
+        weechat_unhook((struct t_hook *) hook);
+        weechat_js_cbindex_free_pointer(hook);
+    }
+
+    API_RETURN_OK;
+}
+
+API_FUNC_DEF(unhook_all)
+{
+    API_FUNC(1, "unhook_all", API_RETURN_ERROR);
+
+    weechat_js_signal_remove_script(js_current_script);
+    weechat_js_process_remove_script(js_current_script);
+    weechat_js_stream_remove_script(js_current_script);
+    weechat_js_worker_remove_script(js_current_script);
+    weechat_js_cbindex_unhook_all(js_current_script);
+
+    API_RETURN_OK;
+}
+
+/*
+ * Adds a timer for setTimeout/setInterval.
+ */
+
+static Handle<Value>
+weechat_js_api_timer_new (const Arguments &args, const char *name, int repeat)
+{
+    char *result;
+    long delay;
+    int i;
+
+    API_FUNC(1, name, API_RETURN_EMPTY);
+    if ((args.Length() < 1)
+        || (!args[0]->IsFunction() && !args[0]->IsString()))
+        API_WRONG_ARGS(API_RETURN_EMPTY);
+
+    delay = (args.Length() > 1) ? args[1]->IntegerValue() : 0;
+
+    Handle<Array> arguments = Array::New((args.Length() > 2) ?
+                                         args.Length() - 2 : 0);
+    for (i = 2; i < args.Length(); i++)
+        arguments->Set(i - 2, args[i]);
+
+    result = API_PTR2STR(weechat_js_timer_add(js_current_script,
+                                              args[0],
+                                              delay,
+                                              repeat,
+                                              arguments));
+
+    API_RETURN_STRING_FREE(result);
+}
+
+API_FUNC_DEF(set_timeout)
+{
+    return weechat_js_api_timer_new(args, "setTimeout", 0);
+}
+
+API_FUNC_DEF(set_interval)
+{
+    return weechat_js_api_timer_new(args, "setInterval", 1);
+}
+
+API_FUNC_DEF(clear_timeout)
+{
+    API_FUNC(1, "clearTimeout", API_RETURN_ERROR);
+    if (args.Length() != 1)
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    String::AsciiValue timer(args[0]);
+
+    if (weechat_js_timer_remove(js_current_script, API_STR2PTR(*timer)))
+        API_RETURN_OK;
+
+    API_RETURN_ERROR;
+}
+
+API_FUNC_DEF(queue_microtask)
+{
+    API_FUNC(1, "queueMicrotask", API_RETURN_ERROR);
+    if ((args.Length() != 1) || !args[0]->IsFunction())
+        API_WRONG_ARGS(API_RETURN_ERROR);
+
+    if (!weechat_js_microtask_enqueue(js_current_script,
+                                      Handle<Function>::Cast(args[0])))
+        API_RETURN_ERROR;
+
+    API_RETURN_OK;
+}
+
 void
 WeechatJsCore::loadLibs()
 {
@@ -1471,6 +2583,7 @@ WeechatJsCore::loadLibs()
     API_DEF_FUNC(config_section_free);
     API_DEF_FUNC(config_free);
     API_DEF_FUNC(config_get);
+    API_DEF_FUNC(config_option);
     API_DEF_FUNC(config_get_plugin);
     API_DEF_FUNC(config_is_set_plugin);
     API_DEF_FUNC(config_set_plugin);
@@ -1484,8 +2597,43 @@ WeechatJsCore::loadLibs()
     API_DEF_FUNC(prnt_date_tags);
     API_DEF_FUNC(prnt_y);
     API_DEF_FUNC(log_print);
+    API_DEF_FUNC(hook_fd);
+    API_DEF_FUNC(stream_open);
+    API_DEF_FUNC(stream_connect);
+    API_DEF_FUNC(stream_write);
+    API_DEF_FUNC(stream_pause);
+    API_DEF_FUNC(stream_resume);
+    API_DEF_FUNC(stream_close);
+    API_DEF_FUNC(read_file);
+    API_DEF_FUNC(write_file);
+    API_DEF_FUNC(append_file);
+    API_DEF_FUNC(stat);
+    API_DEF_FUNC(store);
+    API_DEF_FUNC(store_get);
+    API_DEF_FUNC(store_set);
+    API_DEF_FUNC(store_delete);
+    API_DEF_FUNC(store_count);
+    API_DEF_FUNC(store_close);
+    API_DEF_FUNC(worker_new);
+    API_DEF_FUNC(worker_post);
+    API_DEF_FUNC(worker_terminate);
+    API_DEF_FUNC(hook_process);
+    API_DEF_FUNC(hook_process_hashtable);
+    API_DEF_FUNC(hook_process_stream);
+    API_DEF_FUNC(process_pause);
+    API_DEF_FUNC(process_resume);
+    API_DEF_FUNC(hook_signal);
+    API_DEF_FUNC(hook_signal_send);
+    API_DEF_FUNC(unhook);
+    API_DEF_FUNC(unhook_all);
 
     this->addGlobal("weechat", weechat_obj);
+
+    API_DEF_GLOBAL_FUNC(setTimeout, set_timeout);
+    API_DEF_GLOBAL_FUNC(setInterval, set_interval);
+    API_DEF_GLOBAL_FUNC(clearTimeout, clear_timeout);
+    API_DEF_GLOBAL_FUNC(clearInterval, clear_timeout);
+    API_DEF_GLOBAL_FUNC(queueMicrotask, queue_microtask);
 }
 
 static void
@@ -1496,7 +2644,8 @@ weechat_js_hashtable_map_cb(void *data,
 {
     Handle<Object> *obj = (Handle<Object> *) data;
 
-    (*obj)->Set(String::New(key), String::New(value));
+    (*obj)->Set(String::New(key),
+                (value) ? Handle<Value>(String::New(value)) : Handle<Value>(Null()));
 }
 
 Handle<Object> weechat_js_hashtable_to_object(struct t_hashtable *hashtable)
@@ -0,0 +1,358 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-profile.h"
+#include "weechat-js-trace.h"
+#include "weechat-js-slowlog.h"
+#include "weechat-js-apistats.h"
+
+int js_apistats_enabled = 0;
+
+/* script name -> hashtable (API function -> stats) */
+struct t_hashtable *js_apistats_scripts = NULL;
+
+/*
+ * Initializes API stats.
+ */
+
+void
+weechat_js_apistats_init ()
+{
+    js_apistats_scripts = weechat_hashtable_new(32,
+                                                WEECHAT_HASHTABLE_STRING,
+                                                WEECHAT_HASHTABLE_POINTER,
+                                                NULL, NULL);
+}
+
+/*
+ * Adds a call (started at "start") to an API function.
+ */
+
+void
+weechat_js_apistats_add (const char *script_name, const char *function,
+                         unsigned long long start, int error)
+{
+    struct t_hashtable *functions;
+    struct t_js_apistats *stats;
+
+    if (!js_apistats_scripts || !script_name || !function)
+        return;
+
+    functions = (struct t_hashtable *) weechat_hashtable_get(js_apistats_scripts,
+                                                             script_name);
+    if (!functions)
+    {
+        functions = weechat_hashtable_new(64,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          WEECHAT_HASHTABLE_POINTER,
+                                          NULL, NULL);
+        if (!functions)
+            return;
+        weechat_hashtable_set(js_apistats_scripts, script_name, functions);
+    }
+
+    stats = (struct t_js_apistats *) weechat_hashtable_get(functions,
+                                                           function);
+    if (!stats)
+    {
+        stats = (struct t_js_apistats *) calloc(1, sizeof(*stats));
+        if (!stats)
+            return;
+        stats->script_name = strdup(script_name);
+        stats->function = function;
+        weechat_hashtable_set(functions, function, stats);
+    }
+
+    stats->calls++;
+    if (error)
+        stats->errors++;
+    stats->total_ns += weechat_js_profile_now() - start;
+}
+
+/*
+ * Callback used to free stats of functions.
+ */
+
+static void
+weechat_js_apistats_free_stats_cb (void *data, struct t_hashtable *hashtable,
+                                   const void *key, const void *value)
+{
+    struct t_js_apistats *stats;
+
+    stats = (struct t_js_apistats *) value;
+
+    free(stats->script_name);
+    free(stats);
+}
+
+/*
+ * Callback used to free stats of scripts.
+ */
+
+static void
+weechat_js_apistats_free_script_cb (void *data, struct t_hashtable *hashtable,
+                                    const void *key, const void *value)
+{
+    struct t_hashtable *functions;
+
+    functions = (struct t_hashtable *) value;
+
+    weechat_hashtable_map(functions, &weechat_js_apistats_free_stats_cb, NULL);
+    weechat_hashtable_free(functions);
+}
+
+/*
+ * Resets all stats.
+ */
+
+void
+weechat_js_apistats_reset ()
+{
+    if (!js_apistats_scripts)
+        return;
+
+    weechat_hashtable_map(js_apistats_scripts,
+                          &weechat_js_apistats_free_script_cb, NULL);
+    weechat_hashtable_remove_all(js_apistats_scripts);
+}
+
+struct t_js_apistats_list
+{
+    const char *script_name;                 /* only this script (optional) */
+    struct t_js_apistats **stats;            /* array of stats              */
+    int count;                               /* number of stats in array    */
+    int size;                                /* allocated size of array     */
+};
+
+/*
+ * Callback used to add stats of a function in a list.
+ */
+
+static void
+weechat_js_apistats_list_stats_cb (void *data, struct t_hashtable *hashtable,
+                                   const void *key, const void *value)
+{
+    struct t_js_apistats_list *list;
+    struct t_js_apistats **new_stats;
+
+    list = (struct t_js_apistats_list *) data;
+
+    if (list->count == list->size)
+    {
+        new_stats = (struct t_js_apistats **) realloc(list->stats,
+                                                      (list->size + 64) * sizeof(*new_stats));
+        if (!new_stats)
+            return;
+        list->stats = new_stats;
+        list->size += 64;
+    }
+    list->stats[list->count++] = (struct t_js_apistats *) value;
+}
+
+/*
+ * Callback used to add stats of a script in a list.
+ */
+
+static void
+weechat_js_apistats_list_script_cb (void *data, struct t_hashtable *hashtable,
+                                    const void *key, const void *value)
+{
+    struct t_js_apistats_list *list;
+
+    list = (struct t_js_apistats_list *) data;
+
+    if (list->script_name && list->script_name[0]
+        && (strcmp(list->script_name, (const char *) key) != 0))
+        return;
+
+    weechat_hashtable_map((struct t_hashtable *) value,
+                          &weechat_js_apistats_list_stats_cb, data);
+}
+
+/*
+ * Compares two stats by number of calls (descending), for qsort.
+ */
+
+static int
+weechat_js_apistats_compare (const void *p1, const void *p2)
+{
+    const struct t_js_apistats *stats1, *stats2;
+
+    stats1 = *((const struct t_js_apistats **) p1);
+    stats2 = *((const struct t_js_apistats **) p2);
+
+    if (stats1->calls > stats2->calls)
+        return -1;
+    if (stats1->calls < stats2->calls)
+        return 1;
+    return 0;
+}
+
+/*
+ * Builds list of stats (of one script or all scripts), sorted by number of
+ * calls.
+ *
+ * Note: list->stats must be freed after use.
+ */
+
+static void
+weechat_js_apistats_list (struct t_js_apistats_list *list,
+                          const char *script_name)
+{
+    list->script_name = script_name;
+    list->stats = NULL;
+    list->count = 0;
+    list->size = 0;
+
+    if (!js_apistats_scripts)
+        return;
+
+    weechat_hashtable_map(js_apistats_scripts,
+                          &weechat_js_apistats_list_script_cb, list);
+    if (list->count > 1)
+    {
+        qsort(list->stats, list->count, sizeof(*list->stats),
+              &weechat_js_apistats_compare);
+    }
+}
+
+/*
+ * Displays API functions most called (by one script or all scripts).
+ */
+
+void
+weechat_js_apistats_display (const char *script_name, int count)
+{
+    struct t_js_apistats_list list;
+    struct t_js_apistats *stats;
+    int i;
+
+    weechat_js_apistats_list(&list, script_name);
+
+    weechat_printf(NULL, "");
+    if (list.count == 0)
+    {
+        weechat_printf(NULL,
+                       (js_apistats_enabled) ?
+                       weechat_gettext("%s: no API function called") :
+                       weechat_gettext("%s: no API stats (use /js apistats on)"),
+                       JS_PLUGIN_NAME);
+        return;
+    }
+
+    weechat_printf(NULL,
+                   weechat_gettext("%s API functions (top %d by calls%s):"),
+                   JS_PLUGIN_NAME, count,
+                   (js_apistats_enabled) ? "" : ", disabled");
+    weechat_printf(NULL,
+                   "  %-16s %-28s %10s %8s %12s %10s",
+                   "script", "function", "calls", "errors", "total ms",
+                   "mean us");
+    for (i = 0; (i < list.count) && (i < count); i++)
+    {
+        stats = list.stats[i];
+        weechat_printf(NULL,
+                       "  %-16s %-28s %10llu %8llu %12.3f %10.2f",
+                       stats->script_name, stats->function,
+                       stats->calls, stats->errors,
+                       (double) stats->total_ns / 1000000.0,
+                       ((double) stats->total_ns / stats->calls) / 1000.0);
+    }
+
+    free(list.stats);
+}
+
+/*
+ * Returns infolist "js_api_stats" (arguments: optional script name).
+ */
+
+struct t_infolist *
+weechat_js_apistats_infolist (const char *arguments)
+{
+    struct t_infolist *infolist;
+    struct t_infolist_item *item;
+    struct t_js_apistats_list list;
+    struct t_js_apistats *stats;
+    char value[64];
+    int i;
+
+    infolist = weechat_infolist_new();
+    if (!infolist)
+        return NULL;
+
+    weechat_js_apistats_list(&list, arguments);
+
+    for (i = 0; i < list.count; i++)
+    {
+        stats = list.stats[i];
+        item = weechat_infolist_new_item(infolist);
+        if (!item)
+            break;
+        weechat_infolist_new_var_string(item, "script", stats->script_name);
+        weechat_infolist_new_var_string(item, "function", stats->function);
+        snprintf(value, sizeof(value), "%llu", stats->calls);
+        weechat_infolist_new_var_string(item, "calls", value);
+        snprintf(value, sizeof(value), "%llu", stats->errors);
+        weechat_infolist_new_var_string(item, "errors", value);
+        snprintf(value, sizeof(value), "%llu", stats->total_ns / 1000);
+        weechat_infolist_new_var_string(item, "total_us", value);
+    }
+
+    free(list.stats);
+
+    return infolist;
+}
+
+/*
+ * Frees all stats.
+ */
+
+void
+weechat_js_apistats_end ()
+{
+    if (js_apistats_scripts)
+    {
+        weechat_js_apistats_reset();
+        weechat_hashtable_free(js_apistats_scripts);
+        js_apistats_scripts = NULL;
+    }
+}
+
+WeechatJsApiCall::WeechatJsApiCall (const char *name)
+{
+    this->name = name;
+    this->error = 0;
+    if (js_slowlog_frame && js_slowlog_threshold)
+        weechat_js_slowlog_check();
+    this->start = (js_apistats_enabled
+                   || (js_trace_level >= JS_TRACE_LEVEL_API)) ?
+        weechat_js_profile_now() : 0;
+}
+
+WeechatJsApiCall::~WeechatJsApiCall ()
+{
+    const char *script_name;
+
+    if (!this->start)
+        return;
+
+    script_name = (js_current_script && js_current_script->name) ?
+        js_current_script->name : "-";
+
+    if (js_apistats_enabled)
+        weechat_js_apistats_add(script_name, this->name, this->start,
+                                this->error);
+    if (js_trace_level >= JS_TRACE_LEVEL_API)
+        weechat_js_trace_add("api", script_name, this->name, NULL,
+                             this->start);
+}
@@ -0,0 +1,51 @@
+#ifndef __WEECHAT_JS_APISTATS_H_
+#define __WEECHAT_JS_APISTATS_H_
+
+/*
+ * Counters of calls to weechat API functions, per script: number of calls,
+ * errors (wrong arguments, script not initialized) and time spent in
+ * native code. Disabled by default (/js apistats on).
+ */
+
+#define JS_APISTATS_TOP_DEFAULT 20
+
+struct t_js_apistats
+{
+    char *script_name;                       /* name of script              */
+    const char *function;                    /* API function (static str)   */
+    unsigned long long calls;                /* number of calls             */
+    unsigned long long errors;               /* calls returning an error    */
+    unsigned long long total_ns;             /* time in API (nanoseconds)   */
+};
+
+extern int js_apistats_enabled;
+
+extern void weechat_js_apistats_init (void);
+extern void weechat_js_apistats_end (void);
+extern void weechat_js_apistats_add (const char *script_name,
+                                     const char *function,
+                                     unsigned long long start, int error);
+extern void weechat_js_apistats_reset (void);
+extern void weechat_js_apistats_display (const char *script_name, int count);
+extern struct t_infolist *weechat_js_apistats_infolist (const char *arguments);
+
+/*
+ * Call to a weechat API function: measured from API_FUNC until return
+ * (when object is destroyed), for API stats and trace.
+ */
+
+class WeechatJsApiCall
+{
+public:
+    WeechatJsApiCall (const char *name);
+    ~WeechatJsApiCall (void);
+
+    void setError (void) { this->error = 1; }
+
+private:
+    const char *name;
+    unsigned long long start;
+    int error;
+};
+
+#endif /* __WEECHAT_JS_APISTATS_H_ */
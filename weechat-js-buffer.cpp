@@ -0,0 +1,258 @@
+#undef _
+
+#include <cstdlib>
+#include <cstring>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-buffer.h"
+
+using namespace v8;
+
+struct t_js_buffer_block *js_buffer_pool[JS_BUFFER_POOL_CLASSES];
+int js_buffer_pool_count[JS_BUFFER_POOL_CLASSES];
+int js_buffer_pool_enabled = 0;
+long long js_buffer_external_size = 0;      /* bytes used by byte arrays */
+
+/*
+ * Returns block of data pointer.
+ */
+
+static struct t_js_buffer_block *
+weechat_js_buffer_block (const char *bytes)
+{
+    return ((struct t_js_buffer_block *) bytes) - 1;
+}
+
+/*
+ * Initializes pool of blocks.
+ */
+
+void
+weechat_js_buffer_init ()
+{
+    int i;
+
+    for (i = 0; i < JS_BUFFER_POOL_CLASSES; i++)
+    {
+        js_buffer_pool[i] = NULL;
+        js_buffer_pool_count[i] = 0;
+    }
+    js_buffer_pool_enabled = 1;
+}
+
+/*
+ * Allocates a block with at least size bytes (pool is used up to
+ * 2^JS_BUFFER_POOL_MAX_BITS bytes).
+ *
+ * Returns pointer to data, NULL if error.
+ */
+
+char *
+weechat_js_buffer_alloc (int size)
+{
+    struct t_js_buffer_block *block;
+    int size_class, capacity;
+
+    if (size < 0)
+        return NULL;
+
+    size_class = 0;
+    capacity = 1 << JS_BUFFER_POOL_MIN_BITS;
+    while ((capacity < size) && (size_class < JS_BUFFER_POOL_CLASSES))
+    {
+        size_class++;
+        capacity <<= 1;
+    }
+    if (size_class >= JS_BUFFER_POOL_CLASSES)
+    {
+        /* too big for pool */
+        size_class = -1;
+        capacity = size;
+    }
+
+    if ((size_class >= 0) && js_buffer_pool[size_class])
+    {
+        block = js_buffer_pool[size_class];
+        js_buffer_pool[size_class] = block->next_block;
+        js_buffer_pool_count[size_class]--;
+    }
+    else
+    {
+        block = (struct t_js_buffer_block *) malloc(sizeof(*block) + capacity);
+        if (!block)
+            return NULL;
+        block->size_class = size_class;
+        block->capacity = capacity;
+    }
+    block->next_block = NULL;
+
+    return (char *) (block + 1);
+}
+
+/*
+ * Returns number of bytes available in a block.
+ */
+
+int
+weechat_js_buffer_capacity (const char *bytes)
+{
+    return (bytes) ? weechat_js_buffer_block(bytes)->capacity : 0;
+}
+
+/*
+ * Gives back a block to pool (or frees it if pool is full).
+ */
+
+void
+weechat_js_buffer_release (char *bytes)
+{
+    struct t_js_buffer_block *block;
+
+    if (!bytes)
+        return;
+
+    block = weechat_js_buffer_block(bytes);
+
+    if (!js_buffer_pool_enabled || (block->size_class < 0)
+        || (js_buffer_pool_count[block->size_class] >= JS_BUFFER_POOL_MAX_FREE))
+    {
+        free(block);
+        return;
+    }
+
+    block->next_block = js_buffer_pool[block->size_class];
+    js_buffer_pool[block->size_class] = block;
+    js_buffer_pool_count[block->size_class]++;
+}
+
+/*
+ * Callback called when a byte array is garbage collected.
+ */
+
+static void
+weechat_js_buffer_weak_cb (Persistent<Value> object, void *parameter)
+{
+    js_buffer_external_size -= weechat_js_buffer_capacity((const char *) parameter);
+    V8::AdjustAmountOfExternalAllocatedMemory(
+        -weechat_js_buffer_capacity((const char *) parameter));
+    weechat_js_buffer_release((char *) parameter);
+
+    object.Dispose();
+    object.Clear();
+}
+
+/*
+ * Creates a byte array using a block of pool (no copy): the block belongs
+ * to the object and is released when the object is collected.
+ */
+
+Handle<Object>
+weechat_js_buffer_wrap (char *bytes, int size)
+{
+    HandleScope scope;
+    Handle<Object> obj = Object::New();
+    Persistent<Object> weak;
+
+    if (!bytes)
+        size = 0;
+
+    obj->SetIndexedPropertiesToExternalArrayData(bytes,
+                                                 kExternalUnsignedByteArray,
+                                                 size);
+    obj->Set(String::New("length"), Integer::New(size), ReadOnly);
+
+    if (bytes)
+    {
+        weak = Persistent<Object>::New(obj);
+        weak.MakeWeak(bytes, &weechat_js_buffer_weak_cb);
+        js_buffer_external_size += weechat_js_buffer_capacity(bytes);
+        V8::AdjustAmountOfExternalAllocatedMemory(
+            weechat_js_buffer_capacity(bytes));
+    }
+
+    return scope.Close(obj);
+}
+
+/*
+ * Creates a byte array with a copy of data.
+ */
+
+Handle<Object>
+weechat_js_buffer_new (const char *data, int size)
+{
+    char *bytes;
+
+    if (!data || (size < 0))
+        size = 0;
+
+    bytes = weechat_js_buffer_alloc(size);
+    if (bytes && (size > 0))
+        memcpy(bytes, data, size);
+
+    return weechat_js_buffer_wrap(bytes, size);
+}
+
+/*
+ * Gets data of a byte array.
+ *
+ * Returns pointer to data (size is set), NULL if value is not a byte array.
+ */
+
+char *
+weechat_js_buffer_data (Handle<Value> value, int *size)
+{
+    Handle<Object> obj;
+
+    if (!value->IsObject())
+        return NULL;
+
+    obj = value->ToObject();
+    if (!obj->HasIndexedPropertiesInExternalArrayData()
+        || (obj->GetIndexedPropertiesExternalArrayDataType()
+            != kExternalUnsignedByteArray))
+        return NULL;
+
+    if (size)
+        *size = obj->GetIndexedPropertiesExternalArrayDataLength();
+
+    return (char *) obj->GetIndexedPropertiesExternalArrayData();
+}
+
+/*
+ * Returns number of bytes used by byte arrays not yet collected.
+ */
+
+long long
+weechat_js_buffer_external_size ()
+{
+    return js_buffer_external_size;
+}
+
+/*
+ * Frees all free blocks of pool (blocks still used by objects are freed
+ * when objects are collected).
+ */
+
+void
+weechat_js_buffer_end ()
+{
+    struct t_js_buffer_block *next_block;
+    int i;
+
+    for (i = 0; i < JS_BUFFER_POOL_CLASSES; i++)
+    {
+        while (js_buffer_pool[i])
+        {
+            next_block = js_buffer_pool[i]->next_block;
+            free(js_buffer_pool[i]);
+            js_buffer_pool[i] = next_block;
+        }
+        js_buffer_pool_count[i] = 0;
+    }
+    js_buffer_pool_enabled = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef __WEECHAT_JS_BUFFER_H_
+#define __WEECHAT_JS_BUFFER_H_
+
+#include <v8.h>
+
+/*
+ * Byte arrays given to scripts: objects with indexed access to external
+ * memory (this V8 has no ArrayBuffer). Memory comes from a pool of blocks
+ * (power of 2 sizes), so that I/O can read directly in a block which is
+ * then given to the script without copy, and reused after collection.
+ */
+
+#define JS_BUFFER_POOL_MIN_BITS 9            /* smallest block: 512 bytes   */
+#define JS_BUFFER_POOL_MAX_BITS 16           /* biggest block: 64 KB        */
+#define JS_BUFFER_POOL_CLASSES                                          \
+    (JS_BUFFER_POOL_MAX_BITS - JS_BUFFER_POOL_MIN_BITS + 1)
+#define JS_BUFFER_POOL_MAX_FREE 32           /* free blocks kept per size   */
+
+struct t_js_buffer_block
+{
+    int size_class;                          /* class in pool (-1 if none)  */
+    int capacity;                            /* size of data                */
+    struct t_js_buffer_block *next_block;    /* link to next free block     */
+};
+
+extern void weechat_js_buffer_init (void);
+extern void weechat_js_buffer_end (void);
+extern char *weechat_js_buffer_alloc (int size);
+extern int weechat_js_buffer_capacity (const char *bytes);
+extern void weechat_js_buffer_release (char *bytes);
+extern v8::Handle<v8::Object> weechat_js_buffer_wrap (char *bytes, int size);
+extern v8::Handle<v8::Object> weechat_js_buffer_new (const char *data,
+                                                     int size);
+extern char *weechat_js_buffer_data (v8::Handle<v8::Value> value, int *size);
+extern long long weechat_js_buffer_external_size (void);
+
+#endif /* __WEECHAT_JS_BUFFER_H_ */
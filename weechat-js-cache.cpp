@@ -0,0 +1,172 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <v8.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-cache.h"
+
+using namespace v8;
+
+/* filename -> struct t_js_cache_entry */
+struct t_hashtable *js_cache = NULL;
+
+/*
+ * Initializes cache of pre-parse data.
+ */
+
+void
+weechat_js_cache_init ()
+{
+    js_cache = weechat_hashtable_new(32,
+                                     WEECHAT_HASHTABLE_STRING,
+                                     WEECHAT_HASHTABLE_POINTER,
+                                     NULL, NULL);
+}
+
+/*
+ * Frees an entry of cache.
+ */
+
+static void
+weechat_js_cache_entry_free (struct t_js_cache_entry *entry)
+{
+    if (entry->data)
+        free(entry->data);
+    free(entry);
+}
+
+/*
+ * Returns hash of a source (FNV-1a on its UTF-8 bytes).
+ */
+
+static unsigned long long
+weechat_js_cache_hash (Handle<String> source)
+{
+    String::Utf8Value utf8(source);
+    const unsigned char *ptr_data;
+    unsigned long long hash;
+    int i;
+
+    hash = 14695981039346656037ULL;
+    ptr_data = (const unsigned char *) *utf8;
+    for (i = 0; ptr_data && (i < utf8.length()); i++)
+    {
+        hash ^= ptr_data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Returns pre-parse data for a source: from cache if source did not change
+ * since last compile of this file, otherwise source is pre-parsed and
+ * result is stored in cache.
+ *
+ * Note: result must be deleted after compile.
+ */
+
+ScriptData *
+weechat_js_cache_get (const char *filename, Handle<String> source)
+{
+    struct t_js_cache_entry *entry;
+    ScriptData *pre_data;
+    unsigned long long hash;
+
+    if (!js_cache || !filename || !filename[0] || source.IsEmpty())
+        return NULL;
+
+    hash = weechat_js_cache_hash(source);
+
+    entry = (struct t_js_cache_entry *) weechat_hashtable_get(js_cache,
+                                                              filename);
+    if (entry && entry->data && (entry->hash == hash)
+        && (entry->source_length == source->Length()))
+        return ScriptData::New(entry->data, entry->length);
+
+    pre_data = ScriptData::PreCompile(source);
+    if (!pre_data)
+        return NULL;
+    if (pre_data->HasError())
+    {
+        /* syntax error: reported by compile, nothing to cache */
+        weechat_js_cache_remove(filename);
+        return pre_data;
+    }
+
+    if (!entry)
+    {
+        entry = (struct t_js_cache_entry *) calloc(1, sizeof(*entry));
+        if (!entry)
+            return pre_data;
+        weechat_hashtable_set(js_cache, filename, entry);
+    }
+    if (entry->data)
+        free(entry->data);
+    entry->length = pre_data->Length();
+    entry->data = (char *) malloc(entry->length);
+    if (entry->data)
+        memcpy(entry->data, pre_data->Data(), entry->length);
+    else
+        entry->length = 0;
+    entry->hash = hash;
+    entry->source_length = source->Length();
+
+    return pre_data;
+}
+
+/*
+ * Removes a file from cache.
+ */
+
+void
+weechat_js_cache_remove (const char *filename)
+{
+    struct t_js_cache_entry *entry;
+
+    if (!js_cache || !filename)
+        return;
+
+    entry = (struct t_js_cache_entry *) weechat_hashtable_get(js_cache,
+                                                              filename);
+    if (entry)
+    {
+        weechat_hashtable_remove(js_cache, filename);
+        weechat_js_cache_entry_free(entry);
+    }
+}
+
+/*
+ * Frees an entry (callback of hashtable_map).
+ */
+
+static void
+weechat_js_cache_free_cb (void *data, struct t_hashtable *hashtable,
+                          const void *key, const void *value)
+{
+    weechat_js_cache_entry_free((struct t_js_cache_entry *) value);
+}
+
+/*
+ * Ends cache of pre-parse data.
+ */
+
+void
+weechat_js_cache_end ()
+{
+    if (js_cache)
+    {
+        weechat_hashtable_map(js_cache, &weechat_js_cache_free_cb, NULL);
+        weechat_hashtable_free(js_cache);
+        js_cache = NULL;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef __WEECHAT_JS_CACHE_H_
+#define __WEECHAT_JS_CACHE_H_
+
+#include <v8.h>
+
+/*
+ * Cache of pre-parse data of sources compiled (prelude and script files):
+ * when a source is compiled again without change (reload of scripts, or
+ * prelude compiled for each script), V8 gets the pre-parse data instead of
+ * pre-parsing it again. Entries are checked with a hash of source (data
+ * given for another source would be wrong, even if file has same mtime).
+ */
+
+struct t_js_cache_entry
+{
+    char *data;                              /* pre-parse data              */
+    int length;                              /* length of data              */
+    unsigned long long hash;                 /* hash of source (FNV-1a)     */
+    int source_length;                       /* length of source            */
+};
+
+extern void weechat_js_cache_init (void);
+extern void weechat_js_cache_end (void);
+extern v8::ScriptData *weechat_js_cache_get (const char *filename,
+                                             v8::Handle<v8::String> source);
+extern void weechat_js_cache_remove (const char *filename);
+
+#endif /* __WEECHAT_JS_CACHE_H_ */
@@ -0,0 +1,370 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-cbindex.h"
+
+/* pointer (hook, config file/section/option) -> struct t_js_cbindex_list */
+struct t_hashtable *js_cbindex = NULL;
+
+/*
+ * Initializes index of callbacks.
+ */
+
+void
+weechat_js_cbindex_init ()
+{
+    js_cbindex = weechat_hashtable_new(256,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+}
+
+/*
+ * Returns pointers of a callback which are indexed (NULL if not set).
+ *
+ * Buffer and bar item pointers are not indexed: no function of API binds a
+ * script callback to them.
+ */
+
+static void
+weechat_js_cbindex_pointers (struct t_plugin_script_cb *script_cb,
+                             void *pointers[JS_CBINDEX_NUM_POINTERS])
+{
+    pointers[0] = script_cb->hook;
+    pointers[1] = script_cb->config_file;
+    pointers[2] = script_cb->config_section;
+    pointers[3] = script_cb->config_option;
+}
+
+/*
+ * Frees a list of index.
+ */
+
+static void
+weechat_js_cbindex_list_free (struct t_js_cbindex_list *list)
+{
+    if (list->entries)
+        free(list->entries);
+    free(list);
+}
+
+/*
+ * Adds a callback in list of a pointer.
+ */
+
+static void
+weechat_js_cbindex_list_add (void *pointer, struct t_plugin_script *script,
+                             struct t_plugin_script_cb *script_cb)
+{
+    struct t_js_cbindex_list *list;
+    struct t_js_cbindex_entry *new_entries;
+    int i;
+
+    list = (struct t_js_cbindex_list *) weechat_hashtable_get(js_cbindex,
+                                                              pointer);
+    if (!list)
+    {
+        list = (struct t_js_cbindex_list *) calloc(1, sizeof(*list));
+        if (!list)
+            return;
+        weechat_hashtable_set(js_cbindex, pointer, list);
+    }
+
+    /* same pointer used twice by callback (for example file and section) */
+    for (i = 0; i < list->count; i++)
+    {
+        if (list->entries[i].script_cb == script_cb)
+            return;
+    }
+
+    if (list->count == list->size)
+    {
+        new_entries = (struct t_js_cbindex_entry *) realloc(
+            list->entries,
+            ((list->size == 0) ? 4 : list->size * 2) * sizeof(*new_entries));
+        if (!new_entries)
+            return;
+        list->entries = new_entries;
+        list->size = (list->size == 0) ? 4 : list->size * 2;
+    }
+    list->entries[list->count].script_cb = script_cb;
+    list->entries[list->count].script = script;
+    list->count++;
+}
+
+/*
+ * Removes a callback from list of a pointer (list is freed if empty).
+ */
+
+static void
+weechat_js_cbindex_list_remove (void *pointer,
+                                struct t_plugin_script_cb *script_cb)
+{
+    struct t_js_cbindex_list *list;
+    int i;
+
+    list = (struct t_js_cbindex_list *) weechat_hashtable_get(js_cbindex,
+                                                              pointer);
+    if (!list)
+        return;
+
+    for (i = 0; i < list->count; i++)
+    {
+        if (list->entries[i].script_cb == script_cb)
+        {
+            list->entries[i] = list->entries[list->count - 1];
+            list->count--;
+            break;
+        }
+    }
+
+    if (list->count == 0)
+    {
+        weechat_hashtable_remove(js_cbindex, pointer);
+        weechat_js_cbindex_list_free(list);
+    }
+}
+
+/*
+ * Adds a callback in index (for each pointer set in callback).
+ */
+
+void
+weechat_js_cbindex_add (struct t_plugin_script *script,
+                        struct t_plugin_script_cb *script_cb)
+{
+    void *pointers[JS_CBINDEX_NUM_POINTERS];
+    int i;
+
+    if (!js_cbindex || !script || !script_cb)
+        return;
+
+    weechat_js_cbindex_pointers(script_cb, pointers);
+    for (i = 0; i < JS_CBINDEX_NUM_POINTERS; i++)
+    {
+        if (pointers[i])
+            weechat_js_cbindex_list_add(pointers[i], script, script_cb);
+    }
+}
+
+/*
+ * Adds in index the callbacks created by plugin_script_api_xxx for a new
+ * object (a section or an option can have many callbacks).
+ */
+
+void
+weechat_js_cbindex_add_new (struct t_plugin_script *script, void *pointer)
+{
+    struct t_plugin_script_cb *ptr_script_cb;
+    void *pointers[JS_CBINDEX_NUM_POINTERS];
+    int i;
+
+    if (!js_cbindex || !script || !pointer)
+        return;
+
+    for (ptr_script_cb = script->callbacks; ptr_script_cb;
+         ptr_script_cb = ptr_script_cb->next_callback)
+    {
+        weechat_js_cbindex_pointers(ptr_script_cb, pointers);
+        for (i = 0; i < JS_CBINDEX_NUM_POINTERS; i++)
+        {
+            if (pointers[i] == pointer)
+            {
+                weechat_js_cbindex_add(script, ptr_script_cb);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Removes a callback from index (callback must not be freed yet).
+ */
+
+void
+weechat_js_cbindex_remove (struct t_plugin_script_cb *script_cb)
+{
+    void *pointers[JS_CBINDEX_NUM_POINTERS];
+    int i;
+
+    if (!js_cbindex || !script_cb)
+        return;
+
+    weechat_js_cbindex_pointers(script_cb, pointers);
+    for (i = 0; i < JS_CBINDEX_NUM_POINTERS; i++)
+    {
+        if (pointers[i])
+            weechat_js_cbindex_list_remove(pointers[i], script_cb);
+    }
+}
+
+/*
+ * Removes and frees all callbacks using a pointer (after object was freed
+ * in WeeChat, pointer is only used as key): only callbacks in list of
+ * pointer are read, not all callbacks of scripts.
+ */
+
+void
+weechat_js_cbindex_free_pointer (void *pointer)
+{
+    struct t_js_cbindex_list *list;
+    struct t_plugin_script_cb *ptr_script_cb;
+    struct t_plugin_script *ptr_script;
+
+    if (!js_cbindex || !pointer)
+        return;
+
+    /* list is freed (and removed from index) with its last callback */
+    while (1)
+    {
+        list = (struct t_js_cbindex_list *) weechat_hashtable_get(js_cbindex,
+                                                                  pointer);
+        if (!list)
+            break;
+        ptr_script_cb = list->entries[0].script_cb;
+        ptr_script = list->entries[0].script;
+        weechat_js_cbindex_remove(ptr_script_cb);
+        plugin_script_callback_remove(ptr_script, ptr_script_cb);
+    }
+}
+
+/*
+ * Removes and frees callbacks of many pointers.
+ */
+
+void
+weechat_js_cbindex_free_pointers (std::vector<void *> &pointers)
+{
+    size_t i;
+
+    for (i = 0; i < pointers.size(); i++)
+    {
+        weechat_js_cbindex_free_pointer(pointers[i]);
+    }
+}
+
+/*
+ * Adds pointers of options of a section (read with hdata, before section
+ * is freed).
+ */
+
+void
+weechat_js_cbindex_section_pointers (struct t_config_section *section,
+                                     std::vector<void *> &pointers)
+{
+    struct t_hdata *hdata_section, *hdata_option;
+    void *ptr_option;
+
+    hdata_section = weechat_hdata_get("config_section");
+    hdata_option = weechat_hdata_get("config_option");
+    if (!section || !hdata_section || !hdata_option)
+        return;
+
+    for (ptr_option = weechat_hdata_pointer(hdata_section, section,
+                                            "options");
+         ptr_option;
+         ptr_option = weechat_hdata_pointer(hdata_option, ptr_option,
+                                            "next_option"))
+    {
+        pointers.push_back(ptr_option);
+    }
+}
+
+/*
+ * Adds pointers of a configuration file, its sections and their options
+ * (read with hdata, before file is freed).
+ */
+
+void
+weechat_js_cbindex_file_pointers (struct t_config_file *config_file,
+                                  std::vector<void *> &pointers)
+{
+    struct t_hdata *hdata_file, *hdata_section;
+    void *ptr_section;
+
+    if (!config_file)
+        return;
+
+    pointers.push_back(config_file);
+
+    hdata_file = weechat_hdata_get("config_file");
+    hdata_section = weechat_hdata_get("config_section");
+    if (!hdata_file || !hdata_section)
+        return;
+
+    for (ptr_section = weechat_hdata_pointer(hdata_file, config_file,
+                                             "sections");
+         ptr_section;
+         ptr_section = weechat_hdata_pointer(hdata_section, ptr_section,
+                                             "next_section"))
+    {
+        pointers.push_back(ptr_section);
+        weechat_js_cbindex_section_pointers(
+            (struct t_config_section *) ptr_section, pointers);
+    }
+}
+
+/*
+ * Unhooks all hooks of a script and frees their callbacks (callbacks of
+ * script are read once, index is not walked).
+ */
+
+void
+weechat_js_cbindex_unhook_all (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+
+    if (!script)
+        return;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        if (ptr_script_cb->hook)
+        {
+            weechat_unhook(ptr_script_cb->hook);
+            weechat_js_cbindex_remove(ptr_script_cb);
+            plugin_script_callback_remove(script, ptr_script_cb);
+        }
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Frees a list (callback of hashtable_map).
+ */
+
+static void
+weechat_js_cbindex_free_list_cb (void *data, struct t_hashtable *hashtable,
+                                 const void *key, const void *value)
+{
+    weechat_js_cbindex_list_free((struct t_js_cbindex_list *) value);
+}
+
+/*
+ * Ends index of callbacks.
+ */
+
+void
+weechat_js_cbindex_end ()
+{
+    if (js_cbindex)
+    {
+        weechat_hashtable_map(js_cbindex, &weechat_js_cbindex_free_list_cb,
+                              NULL);
+        weechat_hashtable_free(js_cbindex);
+        js_cbindex = NULL;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __WEECHAT_JS_CBINDEX_H_
+#define __WEECHAT_JS_CBINDEX_H_
+
+#include <vector>
+
+/*
+ * Index of script callbacks by WeeChat pointer (hook, config
+ * file/section/option), so that callbacks tied to an object are removed
+ * (on unhook or free of config) without walking callbacks of scripts.
+ */
+
+#define JS_CBINDEX_NUM_POINTERS 4
+
+struct t_js_cbindex_entry
+{
+    struct t_plugin_script_cb *script_cb;    /* callback                    */
+    struct t_plugin_script *script;          /* script of callback          */
+};
+
+struct t_js_cbindex_list
+{
+    int count;                               /* number of entries           */
+    int size;                                /* entries allocated           */
+    struct t_js_cbindex_entry *entries;      /* callbacks for a pointer     */
+};
+
+extern void weechat_js_cbindex_init (void);
+extern void weechat_js_cbindex_end (void);
+extern void weechat_js_cbindex_add (struct t_plugin_script *script,
+                                    struct t_plugin_script_cb *script_cb);
+extern void weechat_js_cbindex_add_new (struct t_plugin_script *script,
+                                        void *pointer);
+extern void weechat_js_cbindex_remove (struct t_plugin_script_cb *script_cb);
+extern void weechat_js_cbindex_free_pointer (void *pointer);
+extern void weechat_js_cbindex_free_pointers (std::vector<void *> &pointers);
+extern void weechat_js_cbindex_section_pointers (struct t_config_section *section,
+                                                 std::vector<void *> &pointers);
+extern void weechat_js_cbindex_file_pointers (struct t_config_file *config_file,
+                                              std::vector<void *> &pointers);
+extern void weechat_js_cbindex_unhook_all (struct t_plugin_script *script);
+extern void weechat_js_cbindex_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_CBINDEX_H_ */
@@ -1,5 +1,7 @@
 #undef _
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 extern "C"
 {
@@ -9,25 +11,63 @@ extern "C"
 }
 
 #include "weechat-js-core.h"
+#include "weechat-js-microtask.h"
+#include "weechat-js-cache.h"
 
 using namespace v8;
 
 WeechatJsCore *js_current_core;
 
+/*
+ * Prints the exception caught by a TryCatch on core buffer.
+ */
+
+static void
+weechat_js_core_print_exception (TryCatch &try_catch)
+{
+    HandleScope scope;
+    Handle<Message> message = try_catch.Message();
+    String::Utf8Value exception(try_catch.Exception());
+
+    if (message.IsEmpty())
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: %s"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME,
+                       *exception);
+        return;
+    }
+
+    String::Utf8Value filename(message->GetScriptResourceName());
+    weechat_printf(NULL,
+                   weechat_gettext("%s%s: %s:%d: %s"),
+                   weechat_prefix("error"), JS_PLUGIN_NAME,
+                   (*filename) ? *filename : "?",
+                   message->GetLineNumber(), *exception);
+}
+
 WeechatJsCore::WeechatJsCore ()
 {
-    this->global = ObjectTemplate::New();
+    HandleScope scope;
+
+    this->global = Persistent<ObjectTemplate>::New(ObjectTemplate::New());
 }
 
 WeechatJsCore::~WeechatJsCore ()
 {
-    
+    if (!this->context.IsEmpty())
+        this->context.Dispose();
+    if (!this->source.IsEmpty())
+        this->source.Dispose();
+    this->global.Dispose();
 }
 
 bool
 WeechatJsCore::load (Handle<String> source)
 {
-    this->source = source;
+    if (!this->source.IsEmpty())
+        this->source.Dispose();
+    this->source = Persistent<String>::New(source);
 
     return true;
 }
@@ -35,6 +75,7 @@ WeechatJsCore::load (Handle<String> source)
 bool
 WeechatJsCore::load (const char *source)
 {
+    HandleScope scope;
     Handle<String> src = String::New(source);
 
     return this->load(src);
@@ -88,16 +129,211 @@ WeechatJsCore::loadFile (const char *filename)
 bool
 WeechatJsCore::execute ()
 {
-    Persistent<Context> context = Context::New(NULL, this->global);
-    Context::Scope context_scope(context);
-    Handle<Script> script = Script::Compile(this->source);
+    HandleScope scope;
+    TryCatch try_catch;
+    ScriptData *pre_data;
+    const char *filename;
+
+    /* the context is kept alive so that callbacks can be run later */
+    if (this->context.IsEmpty())
+        this->context = Context::New(NULL, this->global);
+
+    Context::Scope context_scope(this->context);
+
+    /* install what the engine is missing (Promise) before the script */
+    Handle<String> prelude_source = String::New(weechat_js_microtask_prelude);
+    ScriptOrigin prelude_origin(String::New("prelude.js"));
+    pre_data = weechat_js_cache_get("(prelude)", prelude_source);
+    Handle<Script> prelude = Script::Compile(prelude_source, &prelude_origin,
+                                             pre_data);
+    delete pre_data;
+    if (prelude.IsEmpty() || prelude->Run().IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return false;
+    }
+
+    filename = (js_current_script_filename) ? js_current_script_filename : "";
+    ScriptOrigin origin(String::New(filename));
+    pre_data = weechat_js_cache_get(filename, this->source);
+    Handle<Script> script = Script::Compile(this->source, &origin, pre_data);
+    delete pre_data;
+    if (script.IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return false;
+    }
 
-    script->Run();
+    if (script->Run().IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return false;
+    }
 
-    context.Dispose();
     return true;
 }
 
+/*
+ * Returns context of the script (empty before execute).
+ */
+
+Handle<Context>
+WeechatJsCore::getContext ()
+{
+    return this->context;
+}
+
+/*
+ * Checks if a function is defined in the global scope of the script.
+ */
+
+bool
+WeechatJsCore::functionExists (const char *function)
+{
+    HandleScope scope;
+
+    if (this->context.IsEmpty() || !function || !function[0])
+        return false;
+
+    Context::Scope context_scope(this->context);
+
+    return this->context->Global()->Get(String::New(function))->IsFunction();
+}
+
+/*
+ * Calls a global function of the script with given arguments.
+ *
+ * Returns an empty handle if the function does not exist or has thrown.
+ */
+
+Handle<Value>
+WeechatJsCore::execFunction (const char *function, int argc, Handle<Value> *argv)
+{
+    HandleScope scope;
+
+    if (this->context.IsEmpty())
+        return Handle<Value>();
+
+    Context::Scope context_scope(this->context);
+    Handle<Value> value = this->context->Global()->Get(String::New(function));
+
+    if (!value->IsFunction())
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: unable to run function \"%s\""),
+                       weechat_prefix("error"), JS_PLUGIN_NAME, function);
+        return Handle<Value>();
+    }
+
+    Handle<Value> result = this->callFunction(Handle<Function>::Cast(value),
+                                              argc, argv);
+    if (result.IsEmpty())
+        return Handle<Value>();
+
+    return scope.Close(result);
+}
+
+/*
+ * Calls a function object in the context of the script.
+ *
+ * Returns an empty handle if the function has thrown.
+ */
+
+Handle<Value>
+WeechatJsCore::callFunction (Handle<Function> function, int argc, Handle<Value> *argv)
+{
+    HandleScope scope;
+    TryCatch try_catch;
+
+    if (this->context.IsEmpty() || function.IsEmpty())
+        return Handle<Value>();
+
+    Context::Scope context_scope(this->context);
+    Handle<Value> result = function->Call(this->context->Global(), argc, argv);
+    if (result.IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return Handle<Value>();
+    }
+
+    return scope.Close(result);
+}
+
+/*
+ * Serializes a value with JSON.stringify of the script context.
+ *
+ * Returns NULL if value can not be serialized (undefined, function, cyclic
+ * object...), otherwise a string which must be freed after use.
+ */
+
+char *
+WeechatJsCore::toJSON (Handle<Value> value)
+{
+    HandleScope scope;
+    TryCatch try_catch;
+
+    if (this->context.IsEmpty() || value.IsEmpty() || value->IsUndefined())
+        return NULL;
+
+    Context::Scope context_scope(this->context);
+    Handle<Value> json = this->context->Global()->Get(String::New("JSON"));
+    if (!json->IsObject())
+        return NULL;
+    Handle<Value> stringify = json->ToObject()->Get(String::New("stringify"));
+    if (!stringify->IsFunction())
+        return NULL;
+
+    Handle<Value> argv[1] = { value };
+    Handle<Value> result = Handle<Function>::Cast(stringify)->Call(
+        json->ToObject(), 1, argv);
+    if (result.IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return NULL;
+    }
+    if (!result->IsString())
+        return NULL;
+
+    String::Utf8Value utf8(result);
+
+    return (*utf8) ? strdup(*utf8) : NULL;
+}
+
+/*
+ * Builds a value with JSON.parse of the script context.
+ *
+ * Returns an empty handle if string is not valid JSON.
+ */
+
+Handle<Value>
+WeechatJsCore::fromJSON (const char *string)
+{
+    HandleScope scope;
+    TryCatch try_catch;
+
+    if (this->context.IsEmpty() || !string)
+        return Handle<Value>();
+
+    Context::Scope context_scope(this->context);
+    Handle<Value> json = this->context->Global()->Get(String::New("JSON"));
+    if (!json->IsObject())
+        return Handle<Value>();
+    Handle<Value> parse = json->ToObject()->Get(String::New("parse"));
+    if (!parse->IsFunction())
+        return Handle<Value>();
+
+    Handle<Value> argv[1] = { String::New(string) };
+    Handle<Value> result = Handle<Function>::Cast(parse)->Call(
+        json->ToObject(), 1, argv);
+    if (result.IsEmpty())
+    {
+        weechat_js_core_print_exception(try_catch);
+        return Handle<Value>();
+    }
+
+    return scope.Close(result);
+}
+
 void
 WeechatJsCore::addGlobal(Handle<String> key, Handle<Template> val)
 {
@@ -18,18 +18,38 @@ public:
 
     bool execute(void);
 
+    v8::Handle<v8::Context> getContext(void);
+
+    bool functionExists(const char *);
+    v8::Handle<v8::Value> execFunction(const char *, int, v8::Handle<v8::Value> *);
+    v8::Handle<v8::Value> callFunction(v8::Handle<v8::Function>, int, v8::Handle<v8::Value> *);
+
+    char *toJSON(v8::Handle<v8::Value>);
+    v8::Handle<v8::Value> fromJSON(const char *);
+
     void addGlobal(v8::Handle<v8::String>, v8::Handle<v8::Template>);
     void addGlobal(const char *, v8::Handle<v8::Template>);
 
     void loadLibs(void);
 
 private:
-    v8::HandleScope handle_scope;
-    v8::Handle<v8::ObjectTemplate> global;
+    v8::Persistent<v8::ObjectTemplate> global;
+    v8::Persistent<v8::Context> context;
 
-    v8::Handle<v8::String> source;
+    v8::Persistent<v8::String> source;
 };
 
 extern WeechatJsCore *js_current_core;
 
+extern v8::Handle<v8::Value> weechat_js_exec_function(struct t_plugin_script *script,
+                                                      const char *function,
+                                                      int argc,
+                                                      v8::Handle<v8::Value> *argv,
+                                                      const char *hook_type = NULL);
+extern v8::Handle<v8::Value> weechat_js_exec_function(struct t_plugin_script *script,
+                                                      v8::Handle<v8::Function> function,
+                                                      int argc,
+                                                      v8::Handle<v8::Value> *argv,
+                                                      const char *hook_type = NULL);
+
 #endif /* __WEECHAT_JS_CORE_H_ */
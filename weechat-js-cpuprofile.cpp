@@ -0,0 +1,233 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+
+#include <v8.h>
+#include <v8-profiler.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-cpuprofile.h"
+
+using namespace v8;
+
+/* script name -> start time of profile (seconds, as double) */
+struct t_hashtable *js_cpuprofiles = NULL;
+
+/*
+ * Initializes CPU profiles.
+ */
+
+void
+weechat_js_cpuprofile_init ()
+{
+    js_cpuprofiles = weechat_hashtable_new(8,
+                                           WEECHAT_HASHTABLE_STRING,
+                                           WEECHAT_HASHTABLE_POINTER,
+                                           NULL, NULL);
+}
+
+/*
+ * Returns current time in seconds.
+ */
+
+static double
+weechat_js_cpuprofile_time ()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (double) tv.tv_sec + ((double) tv.tv_usec / 1000000.0);
+}
+
+/*
+ * Returns title of profile for a script.
+ */
+
+static Handle<String>
+weechat_js_cpuprofile_title (const char *name)
+{
+    return String::Concat(String::New(JS_CPUPROFILE_TITLE_PREFIX),
+                          String::New(name));
+}
+
+/*
+ * Checks if a profile is running for a script.
+ */
+
+int
+weechat_js_cpuprofile_is_running (const char *name)
+{
+    return (js_cpuprofiles && name
+            && weechat_hashtable_has_key(js_cpuprofiles, name)) ? 1 : 0;
+}
+
+/*
+ * Starts profile of a script.
+ *
+ * Returns 1 if OK, 0 if error (profile already running).
+ */
+
+int
+weechat_js_cpuprofile_start (const char *name)
+{
+    HandleScope scope;
+    double *start;
+
+    if (!js_cpuprofiles || !name || weechat_js_cpuprofile_is_running(name))
+        return 0;
+
+    start = (double *) malloc(sizeof(*start));
+    if (!start)
+        return 0;
+    *start = weechat_js_cpuprofile_time();
+
+    CpuProfiler::StartProfiling(weechat_js_cpuprofile_title(name));
+    weechat_hashtable_set(js_cpuprofiles, name, start);
+
+    return 1;
+}
+
+/*
+ * Writes a node of profile (and its children) in file.
+ */
+
+static void
+weechat_js_cpuprofile_write_node (FILE *file, const CpuProfileNode *node,
+                                  int *id)
+{
+    HandleScope scope;
+    int i;
+
+    String::Utf8Value function_name(node->GetFunctionName());
+    String::Utf8Value url(node->GetScriptResourceName());
+
+    fputs("{\"functionName\":", file);
+    weechat_js_fprint_json_string(file,
+                                  (*function_name && (*function_name)[0]) ?
+                                  *function_name : "(anonymous function)");
+    fputs(",\"scriptId\":\"0\",\"url\":", file);
+    weechat_js_fprint_json_string(file, (*url) ? *url : "");
+    fprintf(file,
+            ",\"lineNumber\":%d,\"columnNumber\":0,\"hitCount\":%.0f,"
+            "\"callUID\":%u,\"id\":%d,\"children\":[",
+            node->GetLineNumber(), node->GetSelfSamplesCount(),
+            node->GetCallUid(), (*id)++);
+    for (i = 0; i < node->GetChildrenCount(); i++)
+    {
+        if (i > 0)
+            fputc(',', file);
+        weechat_js_cpuprofile_write_node(file, node->GetChild(i), id);
+    }
+    fputs("]}", file);
+}
+
+/*
+ * Writes a profile in a .cpuprofile file.
+ *
+ * Returns 1 if OK, 0 if error.
+ */
+
+static int
+weechat_js_cpuprofile_write (const char *filename, const CpuProfile *profile,
+                             double start, double end)
+{
+    FILE *file;
+    int id;
+
+    file = fopen(filename, "w");
+    if (!file)
+        return 0;
+
+    /* samples are not recorded by this V8: tree with hit counts only */
+    id = 1;
+    fputs("{\"head\":", file);
+    weechat_js_cpuprofile_write_node(file, profile->GetTopDownRoot(), &id);
+    fprintf(file,
+            ",\"startTime\":%.6f,\"endTime\":%.6f,"
+            "\"samples\":[],\"timestamps\":[]}\n",
+            start, end);
+
+    return (fclose(file) == 0) ? 1 : 0;
+}
+
+/*
+ * Stops profile of a script and writes it in WeeChat home.
+ *
+ * Returns name of file written (must be freed after use), NULL if error.
+ */
+
+char *
+weechat_js_cpuprofile_stop (const char *name)
+{
+    HandleScope scope;
+    const CpuProfile *profile;
+    double *start;
+    char *filename;
+
+    if (!weechat_js_cpuprofile_is_running(name))
+        return NULL;
+
+    start = (double *) weechat_hashtable_get(js_cpuprofiles, name);
+
+    profile = CpuProfiler::StopProfiling(weechat_js_cpuprofile_title(name));
+    filename = NULL;
+    if (profile)
+    {
+        filename = weechat_js_dump_filename(name, "cpuprofile");
+        if (filename
+            && !weechat_js_cpuprofile_write(filename, profile, *start,
+                                            weechat_js_cpuprofile_time()))
+        {
+            free(filename);
+            filename = NULL;
+        }
+        const_cast<CpuProfile *>(profile)->Delete();
+    }
+
+    weechat_hashtable_remove(js_cpuprofiles, name);
+    free(start);
+
+    return filename;
+}
+
+/*
+ * Callback used to stop all profiles.
+ */
+
+static void
+weechat_js_cpuprofile_stop_cb (void *data, struct t_hashtable *hashtable,
+                               const void *key, const void *value)
+{
+    HandleScope scope;
+    const CpuProfile *profile;
+
+    profile = CpuProfiler::StopProfiling(weechat_js_cpuprofile_title((const char *) key));
+    if (profile)
+        const_cast<CpuProfile *>(profile)->Delete();
+    free((void *) value);
+}
+
+/*
+ * Stops all profiles (without writing them).
+ */
+
+void
+weechat_js_cpuprofile_end ()
+{
+    if (js_cpuprofiles)
+    {
+        weechat_hashtable_map(js_cpuprofiles,
+                              &weechat_js_cpuprofile_stop_cb, NULL);
+        weechat_hashtable_free(js_cpuprofiles);
+        js_cpuprofiles = NULL;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef __WEECHAT_JS_CPUPROFILE_H_
+#define __WEECHAT_JS_CPUPROFILE_H_
+
+/*
+ * Sampling CPU profiles of scripts (V8 CpuProfiler), written in WeeChat
+ * home as .cpuprofile files (Chrome DevTools format).
+ */
+
+#define JS_CPUPROFILE_TITLE_PREFIX "js:"
+
+extern void weechat_js_cpuprofile_init (void);
+extern void weechat_js_cpuprofile_end (void);
+extern int weechat_js_cpuprofile_start (const char *name);
+extern char *weechat_js_cpuprofile_stop (const char *name);
+extern int weechat_js_cpuprofile_is_running (const char *name);
+
+#endif /* __WEECHAT_JS_CPUPROFILE_H_ */
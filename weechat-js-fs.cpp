@@ -0,0 +1,584 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-fs.h"
+
+/* all jobs not yet given to script (used by main thread only) */
+struct t_js_fs_job *js_fs_jobs = NULL;
+
+/* queues shared with threads (locked by js_fs_mutex) */
+struct t_js_fs_job *js_fs_pending = NULL;
+struct t_js_fs_job *js_fs_last_pending = NULL;
+struct t_js_fs_job *js_fs_done = NULL;
+struct t_js_fs_job *js_fs_last_done = NULL;
+int js_fs_stop = 0;
+pthread_mutex_t js_fs_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t js_fs_cond = PTHREAD_COND_INITIALIZER;
+
+pthread_t js_fs_threads[JS_FS_THREADS];
+int js_fs_num_threads = 0;
+int js_fs_pipe[2] = { -1, -1 };
+struct t_hook *js_fs_hook_fd = NULL;
+
+/*
+ * Reads a whole file.
+ */
+
+static void
+weechat_js_fs_read (struct t_js_fs_job *job)
+{
+    struct stat st;
+    ssize_t num_read;
+    long size, length;
+    char *data, *new_data;
+    int fd;
+
+    fd = open(job->path, O_RDONLY);
+    if (fd < 0)
+    {
+        job->error = errno;
+        return;
+    }
+
+    /* size may change while reading: grow buffer if needed */
+    size = ((fstat(fd, &st) == 0) && (st.st_size > 0)) ? st.st_size : 4096;
+    data = (char *) malloc(size + 1);
+    length = 0;
+    while (data)
+    {
+        if (length == size)
+        {
+            size *= 2;
+            new_data = (char *) realloc(data, size + 1);
+            if (!new_data)
+            {
+                free(data);
+                data = NULL;
+                break;
+            }
+            data = new_data;
+        }
+        num_read = read(fd, data + length, size - length);
+        if (num_read < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            job->error = errno;
+            free(data);
+            data = NULL;
+            break;
+        }
+        if (num_read == 0)
+            break;
+        length += num_read;
+    }
+    close(fd);
+
+    if (!data)
+    {
+        if (!job->error)
+            job->error = ENOMEM;
+        return;
+    }
+
+    data[length] = '\0';
+    job->data = data;
+    job->size = length;
+}
+
+/*
+ * Writes (or appends) data to a file.
+ */
+
+static void
+weechat_js_fs_write (struct t_js_fs_job *job)
+{
+    ssize_t num_written;
+    long length;
+    int fd;
+
+    fd = open(job->path,
+              O_WRONLY | O_CREAT
+              | ((job->op == JS_FS_OP_APPEND) ? O_APPEND : O_TRUNC),
+              0644);
+    if (fd < 0)
+    {
+        job->error = errno;
+        return;
+    }
+
+    length = 0;
+    while (length < job->size)
+    {
+        num_written = write(fd, job->data + length, job->size - length);
+        if (num_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            job->error = errno;
+            break;
+        }
+        length += num_written;
+    }
+    if ((close(fd) < 0) && !job->error)
+        job->error = errno;
+}
+
+/*
+ * Main function of threads: runs pending jobs until stop is asked (jobs
+ * still pending are run before stopping).
+ */
+
+static void *
+weechat_js_fs_run (void *arg)
+{
+    struct t_js_fs_job *job;
+    int was_empty;
+
+    while (1)
+    {
+        pthread_mutex_lock(&js_fs_mutex);
+        while (!js_fs_pending && !js_fs_stop)
+        {
+            pthread_cond_wait(&js_fs_cond, &js_fs_mutex);
+        }
+        if (!js_fs_pending)
+        {
+            pthread_mutex_unlock(&js_fs_mutex);
+            break;
+        }
+        job = js_fs_pending;
+        js_fs_pending = job->next_queued;
+        if (!js_fs_pending)
+            js_fs_last_pending = NULL;
+        job->next_queued = NULL;
+        pthread_mutex_unlock(&js_fs_mutex);
+
+        switch (job->op)
+        {
+            case JS_FS_OP_READ:
+                weechat_js_fs_read(job);
+                break;
+            case JS_FS_OP_WRITE:
+            case JS_FS_OP_APPEND:
+                weechat_js_fs_write(job);
+                break;
+            case JS_FS_OP_STAT:
+                if (stat(job->path, &job->st) < 0)
+                    job->error = errno;
+                break;
+        }
+
+        pthread_mutex_lock(&js_fs_mutex);
+        was_empty = (js_fs_done == NULL);
+        if (js_fs_last_done)
+            js_fs_last_done->next_queued = job;
+        else
+            js_fs_done = job;
+        js_fs_last_done = job;
+        /* one byte in pipe for a batch of results */
+        if (was_empty)
+        {
+            if (write(js_fs_pipe[1], "f", 1) < 0)
+            {
+                /* pipe full: main thread will be woken up anyway */
+            }
+        }
+        pthread_mutex_unlock(&js_fs_mutex);
+    }
+
+    return NULL;
+}
+
+/*
+ * Frees a job (on main thread, after it is done).
+ */
+
+static void
+weechat_js_fs_job_free (struct t_js_fs_job *job)
+{
+    if (job->prev_job)
+        job->prev_job->next_job = job->next_job;
+    else
+        js_fs_jobs = job->next_job;
+    if (job->next_job)
+        job->next_job->prev_job = job->prev_job;
+
+    if (!job->resolve.IsEmpty())
+        job->resolve.Dispose();
+    if (!job->reject.IsEmpty())
+        job->reject.Dispose();
+    if (job->script_cb && job->script)
+        plugin_script_callback_remove(job->script, job->script_cb);
+    if (job->path)
+        free(job->path);
+    if (job->data)
+        free(job->data);
+    delete job;
+}
+
+/*
+ * Builds result of a job (in context of script).
+ */
+
+static Handle<Value>
+weechat_js_fs_result (struct t_js_fs_job *job)
+{
+    HandleScope scope;
+    Handle<Object> obj;
+
+    switch (job->op)
+    {
+        case JS_FS_OP_READ:
+            if (job->binary)
+                return scope.Close(weechat_js_buffer_new(job->data, job->size));
+            return scope.Close(String::New((job->data) ? job->data : "",
+                                           job->size));
+        case JS_FS_OP_WRITE:
+        case JS_FS_OP_APPEND:
+            return scope.Close(Number::New(job->size));
+        case JS_FS_OP_STAT:
+            obj = Object::New();
+            obj->Set(String::New("size"), Number::New(job->st.st_size));
+            obj->Set(String::New("mtime"), Number::New(job->st.st_mtime));
+            obj->Set(String::New("mode"), Integer::New(job->st.st_mode & 07777));
+            obj->Set(String::New("is_file"),
+                     Boolean::New(S_ISREG(job->st.st_mode)));
+            obj->Set(String::New("is_dir"),
+                     Boolean::New(S_ISDIR(job->st.st_mode)));
+            return scope.Close(obj);
+    }
+
+    return scope.Close(Undefined());
+}
+
+/*
+ * Gives result of a job to script: callback is called with
+ * (data, error, result), or promise is resolved/rejected.
+ */
+
+static void
+weechat_js_fs_deliver (struct t_js_fs_job *job)
+{
+    HandleScope scope;
+    Handle<Value> argv[3];
+    WeechatJsCore *js_core;
+    char *function;
+
+    js_core = (WeechatJsCore *) job->script->interpreter;
+    if (!js_core)
+        return;
+
+    Context::Scope context_scope(js_core->getContext());
+
+    if (job->script_cb)
+    {
+        argv[0] = String::New((job->script_cb->data) ? job->script_cb->data : "");
+        argv[1] = String::New((job->error) ? strerror(job->error) : "");
+        argv[2] = (job->error) ?
+            Handle<Value>(Undefined()) : weechat_js_fs_result(job);
+        function = strdup(job->script_cb->function);
+        weechat_js_exec_function(job->script, function, 3, argv, "fs");
+        free(function);
+    }
+    else if (job->error)
+    {
+        argv[0] = Exception::Error(String::New(strerror(job->error)));
+        weechat_js_exec_function(job->script, job->reject, 1, argv, "fs");
+    }
+    else
+    {
+        argv[0] = weechat_js_fs_result(job);
+        weechat_js_exec_function(job->script, job->resolve, 1, argv, "fs");
+    }
+}
+
+/*
+ * Callback for results signaled on pipe.
+ */
+
+static int
+weechat_js_fs_fd_cb (void *data, int fd)
+{
+    struct t_js_fs_job *job;
+    char buffer[64];
+
+    while (read(fd, buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    while (1)
+    {
+        pthread_mutex_lock(&js_fs_mutex);
+        job = js_fs_done;
+        if (job)
+        {
+            js_fs_done = job->next_queued;
+            if (!js_fs_done)
+                js_fs_last_done = NULL;
+        }
+        pthread_mutex_unlock(&js_fs_mutex);
+
+        if (!job)
+            break;
+
+        /* script may have been unloaded while job was running */
+        if (job->script)
+            weechat_js_fs_deliver(job);
+        weechat_js_fs_job_free(job);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes async file I/O (threads are started on first job).
+ */
+
+void
+weechat_js_fs_init ()
+{
+    int i;
+
+    js_fs_stop = 0;
+
+    if (pipe(js_fs_pipe) < 0)
+    {
+        js_fs_pipe[0] = -1;
+        js_fs_pipe[1] = -1;
+        return;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        fcntl(js_fs_pipe[i], F_SETFL, fcntl(js_fs_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(js_fs_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    js_fs_hook_fd = weechat_hook_fd(js_fs_pipe[0], 1, 0, 0,
+                                    &weechat_js_fs_fd_cb, NULL);
+}
+
+/*
+ * Callback for executor of promise: saves resolve/reject functions in job.
+ */
+
+static Handle<Value>
+weechat_js_fs_executor_cb (const Arguments &args)
+{
+    struct t_js_fs_job *job;
+
+    job = (struct t_js_fs_job *) External::Unwrap(args.Data());
+
+    if ((args.Length() >= 2) && args[0]->IsFunction() && args[1]->IsFunction())
+    {
+        job->resolve = Persistent<Function>::New(Handle<Function>::Cast(args[0]));
+        job->reject = Persistent<Function>::New(Handle<Function>::Cast(args[1]));
+    }
+
+    return Undefined();
+}
+
+/*
+ * Submits a job to thread pool (called in context of script). If function
+ * is empty, a promise is returned.
+ *
+ * Returns true (job submitted), the promise, or false if error.
+ */
+
+Handle<Value>
+weechat_js_fs_submit (struct t_plugin_script *script, int op,
+                      const char *path, const char *data, long size,
+                      int binary, const char *function, const char *data_cb)
+{
+    HandleScope scope;
+    struct t_js_fs_job *new_job;
+    Handle<Value> promise_class, promise, executor;
+
+    if (!script || !path || !path[0] || (js_fs_pipe[0] < 0))
+        return scope.Close(False());
+
+    /* start threads on first use */
+    while (js_fs_num_threads < JS_FS_THREADS)
+    {
+        if (pthread_create(&js_fs_threads[js_fs_num_threads], NULL,
+                           &weechat_js_fs_run, NULL) != 0)
+            break;
+        js_fs_num_threads++;
+    }
+    if (js_fs_num_threads == 0)
+        return scope.Close(False());
+
+    new_job = new t_js_fs_job;
+    new_job->script = script;
+    new_job->script_cb = NULL;
+    new_job->op = op;
+    new_job->binary = binary;
+    new_job->path = strdup(path);
+    new_job->data = NULL;
+    new_job->size = 0;
+    new_job->error = 0;
+    new_job->next_queued = NULL;
+    if (data && (size > 0))
+    {
+        new_job->data = (char *) malloc(size);
+        if (new_job->data)
+        {
+            memcpy(new_job->data, data, size);
+            new_job->size = size;
+        }
+    }
+
+    if (!new_job->path || (data && (size > 0) && !new_job->data))
+    {
+        if (new_job->path)
+            free(new_job->path);
+        delete new_job;
+        return scope.Close(False());
+    }
+
+    if (function && function[0])
+    {
+        new_job->script_cb = plugin_script_callback_add(script, function,
+                                                        data_cb);
+        promise = True();
+    }
+    else
+    {
+        promise_class = Context::GetCurrent()->Global()->Get(String::New("Promise"));
+        if (promise_class->IsFunction())
+        {
+            executor = FunctionTemplate::New(&weechat_js_fs_executor_cb,
+                                             External::Wrap(new_job))->GetFunction();
+            promise = Handle<Function>::Cast(promise_class)->NewInstance(1, &executor);
+        }
+    }
+    if ((!new_job->script_cb && new_job->resolve.IsEmpty()) || promise.IsEmpty())
+    {
+        if (new_job->script_cb)
+            plugin_script_callback_remove(script, new_job->script_cb);
+        if (!new_job->resolve.IsEmpty())
+            new_job->resolve.Dispose();
+        if (!new_job->reject.IsEmpty())
+            new_job->reject.Dispose();
+        free(new_job->path);
+        if (new_job->data)
+            free(new_job->data);
+        delete new_job;
+        return scope.Close(False());
+    }
+
+    new_job->prev_job = NULL;
+    new_job->next_job = js_fs_jobs;
+    if (js_fs_jobs)
+        js_fs_jobs->prev_job = new_job;
+    js_fs_jobs = new_job;
+
+    pthread_mutex_lock(&js_fs_mutex);
+    if (js_fs_last_pending)
+        js_fs_last_pending->next_queued = new_job;
+    else
+        js_fs_pending = new_job;
+    js_fs_last_pending = new_job;
+    pthread_cond_signal(&js_fs_cond);
+    pthread_mutex_unlock(&js_fs_mutex);
+
+    return scope.Close(promise);
+}
+
+/*
+ * Cancels results of all jobs of a script (jobs are still run, so that
+ * pending writes are done).
+ */
+
+void
+weechat_js_fs_remove_script (struct t_plugin_script *script)
+{
+    struct t_js_fs_job *ptr_job;
+
+    for (ptr_job = js_fs_jobs; ptr_job; ptr_job = ptr_job->next_job)
+    {
+        if (ptr_job->script != script)
+            continue;
+        if (ptr_job->script_cb)
+        {
+            plugin_script_callback_remove(script, ptr_job->script_cb);
+            ptr_job->script_cb = NULL;
+        }
+        if (!ptr_job->resolve.IsEmpty())
+        {
+            ptr_job->resolve.Dispose();
+            ptr_job->resolve.Clear();
+        }
+        if (!ptr_job->reject.IsEmpty())
+        {
+            ptr_job->reject.Dispose();
+            ptr_job->reject.Clear();
+        }
+        ptr_job->script = NULL;
+    }
+}
+
+/*
+ * Waits for end of pending jobs, stops threads and frees all jobs (results
+ * are not given to scripts).
+ */
+
+void
+weechat_js_fs_end ()
+{
+    int i;
+
+    pthread_mutex_lock(&js_fs_mutex);
+    js_fs_stop = 1;
+    pthread_cond_broadcast(&js_fs_cond);
+    pthread_mutex_unlock(&js_fs_mutex);
+
+    for (i = 0; i < js_fs_num_threads; i++)
+    {
+        pthread_join(js_fs_threads[i], NULL);
+    }
+    js_fs_num_threads = 0;
+
+    js_fs_pending = NULL;
+    js_fs_last_pending = NULL;
+    js_fs_done = NULL;
+    js_fs_last_done = NULL;
+    while (js_fs_jobs)
+    {
+        js_fs_jobs->script = NULL;
+        weechat_js_fs_job_free(js_fs_jobs);
+    }
+
+    if (js_fs_hook_fd)
+    {
+        weechat_unhook(js_fs_hook_fd);
+        js_fs_hook_fd = NULL;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (js_fs_pipe[i] >= 0)
+        {
+            close(js_fs_pipe[i]);
+            js_fs_pipe[i] = -1;
+        }
+    }
+}
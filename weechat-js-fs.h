@@ -0,0 +1,54 @@
+#ifndef __WEECHAT_JS_FS_H_
+#define __WEECHAT_JS_FS_H_
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <v8.h>
+
+/*
+ * Asynchronous file I/O: jobs are run by a small pool of threads, results
+ * are signaled with a single pipe watched by hook_fd, and given to the
+ * script (callback or promise) on the WeeChat main loop.
+ */
+
+#define JS_FS_THREADS 4
+
+enum t_js_fs_op
+{
+    JS_FS_OP_READ = 0,
+    JS_FS_OP_WRITE,
+    JS_FS_OP_APPEND,
+    JS_FS_OP_STAT,
+};
+
+struct t_js_fs_job
+{
+    struct t_plugin_script *script;          /* script (NULL if canceled)   */
+    struct t_plugin_script_cb *script_cb;    /* callback (NULL for promise) */
+    v8::Persistent<v8::Function> resolve;    /* resolve function of promise */
+    v8::Persistent<v8::Function> reject;     /* reject function of promise  */
+    int op;                                  /* read/write/append/stat      */
+    int binary;                              /* 1 = read gives byte array   */
+    char *path;                              /* file path                   */
+    char *data;                              /* data written or read        */
+    long size;                               /* size of data                */
+    int error;                               /* errno (0 if OK)             */
+    struct stat st;                          /* result of stat              */
+    struct t_js_fs_job *next_queued;         /* link in pending/done queue  */
+    struct t_js_fs_job *prev_job;            /* link to previous job        */
+    struct t_js_fs_job *next_job;            /* link to next job            */
+};
+
+extern void weechat_js_fs_init (void);
+extern void weechat_js_fs_end (void);
+extern v8::Handle<v8::Value> weechat_js_fs_submit (struct t_plugin_script *script,
+                                                   int op,
+                                                   const char *path,
+                                                   const char *data,
+                                                   long size,
+                                                   int binary,
+                                                   const char *function,
+                                                   const char *data_cb);
+extern void weechat_js_fs_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_FS_H_ */
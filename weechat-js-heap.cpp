@@ -0,0 +1,350 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <v8.h>
+#include <v8-profiler.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-heap.h"
+
+using namespace v8;
+
+/* script name -> size reachable from its global (last snapshot) */
+struct t_hashtable *js_heap_script_sizes = NULL;
+
+/*
+ * Output stream writing a heap snapshot in a file.
+ */
+
+class WeechatJsHeapFileStream : public OutputStream
+{
+public:
+    WeechatJsHeapFileStream (FILE *file) : file(file), error(false) {}
+
+    void EndOfStream () {}
+
+    WriteResult WriteAsciiChunk (char *data, int size)
+    {
+        if (fwrite(data, 1, size, this->file) != (size_t) size)
+        {
+            this->error = true;
+            return kAbort;
+        }
+        return kContinue;
+    }
+
+    FILE *file;
+    bool error;
+};
+
+/*
+ * Initializes heap stats.
+ */
+
+void
+weechat_js_heap_init ()
+{
+    js_heap_script_sizes = weechat_hashtable_new(32,
+                                                 WEECHAT_HASHTABLE_STRING,
+                                                 WEECHAT_HASHTABLE_STRING,
+                                                 NULL, NULL);
+}
+
+/*
+ * Gets statistics of heap (shared by all scripts).
+ */
+
+void
+weechat_js_heap_get_stats (struct t_js_heap_stats *stats)
+{
+    HeapStatistics heap_stats;
+
+    V8::GetHeapStatistics(&heap_stats);
+
+    stats->total_heap_size = heap_stats.total_heap_size();
+    stats->total_heap_size_executable = heap_stats.total_heap_size_executable();
+    stats->used_heap_size = heap_stats.used_heap_size();
+    stats->heap_size_limit = heap_stats.heap_size_limit();
+    stats->external_size = weechat_js_buffer_external_size();
+}
+
+/*
+ * Returns size of a script measured by last snapshot, -1 if unknown.
+ */
+
+long long
+weechat_js_heap_script_size (const char *name)
+{
+    const char *size;
+
+    if (!js_heap_script_sizes || !name)
+        return -1;
+
+    size = (const char *) weechat_hashtable_get(js_heap_script_sizes, name);
+
+    return (size) ? strtoll(size, NULL, 10) : -1;
+}
+
+/*
+ * Removes size of a script measured by last snapshot (script is unloaded,
+ * a script loaded later with same name has not been measured).
+ */
+
+void
+weechat_js_heap_remove_script (struct t_plugin_script *script)
+{
+    if (js_heap_script_sizes && script->name)
+        weechat_hashtable_remove(js_heap_script_sizes, script->name);
+}
+
+/*
+ * Computes size of objects reachable from a node of snapshot; weak edges
+ * and nodes in "stop" (globals of other scripts) are not followed.
+ */
+
+static long long
+weechat_js_heap_reachable_size (const HeapGraphNode *root,
+                                std::set<const HeapGraphNode *> &stop)
+{
+    std::set<const HeapGraphNode *> visited;
+    std::vector<const HeapGraphNode *> stack;
+    const HeapGraphNode *node, *child;
+    const HeapGraphEdge *edge;
+    long long size;
+    int i;
+
+    size = 0;
+    stack.push_back(root);
+    visited.insert(root);
+    while (!stack.empty())
+    {
+        node = stack.back();
+        stack.pop_back();
+        size += node->GetSelfSize();
+        for (i = 0; i < node->GetChildrenCount(); i++)
+        {
+            edge = node->GetChild(i);
+            if ((edge->GetType() == HeapGraphEdge::kWeak)
+                || (edge->GetType() == HeapGraphEdge::kShortcut))
+                continue;
+            child = edge->GetToNode();
+            if (stop.count(child) || !visited.insert(child).second)
+                continue;
+            stack.push_back(child);
+        }
+    }
+
+    return size;
+}
+
+/*
+ * Takes a heap snapshot, measures size of a script, and writes snapshot in
+ * WeeChat home (.heapsnapshot).
+ *
+ * Returns name of file written (must be freed after use), NULL if error.
+ */
+
+char *
+weechat_js_heap_snapshot (struct t_plugin_script *script, long long *size)
+{
+    HandleScope scope;
+    const HeapSnapshot *snapshot;
+    const HeapGraphNode *node, *root;
+    std::set<const HeapGraphNode *> stop;
+    struct t_plugin_script *ptr_script;
+    WeechatJsCore *js_core;
+    char *filename, str_size[32];
+    FILE *file;
+
+    *size = -1;
+
+    js_core = (WeechatJsCore *) script->interpreter;
+    if (!js_core || js_core->getContext().IsEmpty())
+        return NULL;
+
+    snapshot = HeapProfiler::TakeSnapshot(String::Concat(String::New("js:"),
+                                                         String::New(script->name)));
+    if (!snapshot)
+        return NULL;
+
+    /* globals of other scripts are not counted in size of script */
+    root = NULL;
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        js_core = (WeechatJsCore *) ptr_script->interpreter;
+        if (!js_core || js_core->getContext().IsEmpty())
+            continue;
+        node = snapshot->GetNodeById(
+            HeapProfiler::GetSnapshotObjectId(js_core->getContext()->Global()));
+        if (!node)
+            continue;
+        if (ptr_script == script)
+            root = node;
+        else
+            stop.insert(node);
+    }
+    if (root)
+    {
+        *size = weechat_js_heap_reachable_size(root, stop);
+        snprintf(str_size, sizeof(str_size), "%lld", *size);
+        weechat_hashtable_set(js_heap_script_sizes, script->name, str_size);
+    }
+
+    filename = weechat_js_dump_filename(script->name, "heapsnapshot");
+    if (filename)
+    {
+        file = fopen(filename, "w");
+        if (file)
+        {
+            WeechatJsHeapFileStream stream(file);
+            snapshot->Serialize(&stream, HeapSnapshot::kJSON);
+            if ((fclose(file) != 0) || stream.error)
+            {
+                free(filename);
+                filename = NULL;
+            }
+        }
+        else
+        {
+            free(filename);
+            filename = NULL;
+        }
+    }
+
+    const_cast<HeapSnapshot *>(snapshot)->Delete();
+
+    return filename;
+}
+
+/*
+ * Displays heap statistics, and size of script(s) measured by last
+ * snapshot (all scripts if script is NULL).
+ */
+
+void
+weechat_js_heap_display (struct t_plugin_script *script)
+{
+    struct t_js_heap_stats stats;
+    struct t_plugin_script *ptr_script;
+    long long size;
+
+    weechat_js_heap_get_stats(&stats);
+
+    weechat_printf(NULL, "");
+    weechat_printf(NULL, weechat_gettext("%s heap (shared by all scripts):"),
+                   JS_PLUGIN_NAME);
+    weechat_printf(NULL, weechat_gettext("  used      : %llu KB"),
+                   stats.used_heap_size / 1024);
+    weechat_printf(NULL, weechat_gettext("  total     : %llu KB "
+                                         "(executable: %llu KB)"),
+                   stats.total_heap_size / 1024,
+                   stats.total_heap_size_executable / 1024);
+    weechat_printf(NULL, weechat_gettext("  limit     : %llu KB"),
+                   stats.heap_size_limit / 1024);
+    weechat_printf(NULL, weechat_gettext("  external  : %llu KB"),
+                   stats.external_size / 1024);
+
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        if (script && (ptr_script != script))
+            continue;
+        size = weechat_js_heap_script_size(ptr_script->name);
+        if (size >= 0)
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("  script %s: %lld KB reachable "
+                                           "(last snapshot)"),
+                           ptr_script->name, size / 1024);
+        }
+        else
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("  script %s: size unknown "
+                                           "(use /js heap %s snapshot)"),
+                           ptr_script->name, ptr_script->name);
+        }
+    }
+}
+
+/*
+ * Prints heap statistics in WeeChat log file.
+ */
+
+void
+weechat_js_heap_print_log ()
+{
+    struct t_js_heap_stats stats;
+    struct t_plugin_script *ptr_script;
+
+    weechat_js_heap_get_stats(&stats);
+
+    weechat_log_printf("");
+    weechat_log_printf("[js heap]");
+    weechat_log_printf("  used_heap_size. . . . . : %llu", stats.used_heap_size);
+    weechat_log_printf("  total_heap_size . . . . : %llu", stats.total_heap_size);
+    weechat_log_printf("  total_heap_size_exec. . : %llu",
+                       stats.total_heap_size_executable);
+    weechat_log_printf("  heap_size_limit . . . . : %llu", stats.heap_size_limit);
+    weechat_log_printf("  external_size . . . . . : %llu", stats.external_size);
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        weechat_log_printf("  script %-16s : %lld", ptr_script->name,
+                           weechat_js_heap_script_size(ptr_script->name));
+    }
+}
+
+/*
+ * Adds heap statistics to an infolist item of a script.
+ */
+
+void
+weechat_js_heap_add_to_infolist (struct t_infolist_item *item,
+                                 struct t_plugin_script *script)
+{
+    struct t_js_heap_stats stats;
+    char value[32];
+
+    weechat_js_heap_get_stats(&stats);
+
+    snprintf(value, sizeof(value), "%llu", stats.used_heap_size);
+    weechat_infolist_new_var_string(item, "heap_used", value);
+    snprintf(value, sizeof(value), "%llu", stats.total_heap_size);
+    weechat_infolist_new_var_string(item, "heap_total", value);
+    snprintf(value, sizeof(value), "%llu", stats.heap_size_limit);
+    weechat_infolist_new_var_string(item, "heap_limit", value);
+    snprintf(value, sizeof(value), "%llu", stats.external_size);
+    weechat_infolist_new_var_string(item, "heap_external", value);
+    snprintf(value, sizeof(value), "%lld",
+             weechat_js_heap_script_size(script->name));
+    weechat_infolist_new_var_string(item, "heap_script_size", value);
+}
+
+/*
+ * Frees heap stats.
+ */
+
+void
+weechat_js_heap_end ()
+{
+    if (js_heap_script_sizes)
+    {
+        weechat_hashtable_free(js_heap_script_sizes);
+        js_heap_script_sizes = NULL;
+    }
+}
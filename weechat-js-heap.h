@@ -0,0 +1,31 @@
+#ifndef __WEECHAT_JS_HEAP_H_
+#define __WEECHAT_JS_HEAP_H_
+
+/*
+ * Heap statistics and snapshots. All scripts share the same isolate, so
+ * HeapStatistics are global; memory of a script is measured with a heap
+ * snapshot, as the size of objects reachable from its global object.
+ */
+
+struct t_js_heap_stats
+{
+    unsigned long long total_heap_size;      /* heap reserved by V8         */
+    unsigned long long total_heap_size_executable; /* code heap             */
+    unsigned long long used_heap_size;       /* heap used by objects        */
+    unsigned long long heap_size_limit;      /* max heap size               */
+    unsigned long long external_size;        /* byte arrays (plugin memory) */
+};
+
+extern void weechat_js_heap_init (void);
+extern void weechat_js_heap_end (void);
+extern void weechat_js_heap_get_stats (struct t_js_heap_stats *stats);
+extern long long weechat_js_heap_script_size (const char *name);
+extern void weechat_js_heap_remove_script (struct t_plugin_script *script);
+extern char *weechat_js_heap_snapshot (struct t_plugin_script *script,
+                                       long long *size);
+extern void weechat_js_heap_display (struct t_plugin_script *script);
+extern void weechat_js_heap_print_log (void);
+extern void weechat_js_heap_add_to_infolist (struct t_infolist_item *item,
+                                             struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_HEAP_H_ */
@@ -0,0 +1,471 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-microtask.h"
+
+using namespace v8;
+
+/*
+ * Promise implementation (subset of ES6) installed in each context when the
+ * engine does not provide one; reactions are queued with queueMicrotask.
+ */
+
+const char *weechat_js_microtask_prelude =
+    "(function (global) {\n"
+    "    if (typeof global.Promise === 'function')\n"
+    "        return;\n"
+    "    var PENDING = 0, FULFILLED = 1, REJECTED = 2;\n"
+    "    function finish(promise, state, value) {\n"
+    "        var handlers = promise._handlers, i;\n"
+    "        promise._state = state;\n"
+    "        promise._value = value;\n"
+    "        promise._handlers = null;\n"
+    "        for (i = 0; i < handlers.length; i++)\n"
+    "            schedule(promise, handlers[i]);\n"
+    "    }\n"
+    "    function settle(promise, value) {\n"
+    "        var then, called = false;\n"
+    "        if (value === promise)\n"
+    "            return finish(promise, REJECTED,\n"
+    "                          new TypeError('promise resolved with itself'));\n"
+    "        if (value && (typeof value === 'object'\n"
+    "                      || typeof value === 'function')) {\n"
+    "            try {\n"
+    "                then = value.then;\n"
+    "            } catch (e) {\n"
+    "                return finish(promise, REJECTED, e);\n"
+    "            }\n"
+    "            if (typeof then === 'function') {\n"
+    "                try {\n"
+    "                    then.call(value, function (v) {\n"
+    "                        if (!called) { called = true; settle(promise, v); }\n"
+    "                    }, function (r) {\n"
+    "                        if (!called) { called = true; finish(promise, REJECTED, r); }\n"
+    "                    });\n"
+    "                } catch (e) {\n"
+    "                    if (!called) { called = true; finish(promise, REJECTED, e); }\n"
+    "                }\n"
+    "                return;\n"
+    "            }\n"
+    "        }\n"
+    "        finish(promise, FULFILLED, value);\n"
+    "    }\n"
+    "    function schedule(promise, handler) {\n"
+    "        queueMicrotask(function () {\n"
+    "            var callback = (promise._state === FULFILLED) ?\n"
+    "                handler.onFulfilled : handler.onRejected, result;\n"
+    "            if (typeof callback !== 'function') {\n"
+    "                if (promise._state === FULFILLED)\n"
+    "                    settle(handler.promise, promise._value);\n"
+    "                else\n"
+    "                    finish(handler.promise, REJECTED, promise._value);\n"
+    "                return;\n"
+    "            }\n"
+    "            try {\n"
+    "                result = callback(promise._value);\n"
+    "            } catch (e) {\n"
+    "                return finish(handler.promise, REJECTED, e);\n"
+    "            }\n"
+    "            settle(handler.promise, result);\n"
+    "        });\n"
+    "    }\n"
+    "    function Promise(executor) {\n"
+    "        var self = this, done = false;\n"
+    "        if (!(this instanceof Promise))\n"
+    "            throw new TypeError('Promise must be called with new');\n"
+    "        this._state = PENDING;\n"
+    "        this._value = undefined;\n"
+    "        this._handlers = [];\n"
+    "        try {\n"
+    "            executor(function (value) {\n"
+    "                if (!done) { done = true; settle(self, value); }\n"
+    "            }, function (reason) {\n"
+    "                if (!done) { done = true; finish(self, REJECTED, reason); }\n"
+    "            });\n"
+    "        } catch (e) {\n"
+    "            if (!done) { done = true; finish(self, REJECTED, e); }\n"
+    "        }\n"
+    "    }\n"
+    "    Promise.prototype.then = function (onFulfilled, onRejected) {\n"
+    "        var promise = new Promise(function () {});\n"
+    "        var handler = { onFulfilled: onFulfilled, onRejected: onRejected,\n"
+    "                        promise: promise };\n"
+    "        if (this._state === PENDING)\n"
+    "            this._handlers.push(handler);\n"
+    "        else\n"
+    "            schedule(this, handler);\n"
+    "        return promise;\n"
+    "    };\n"
+    "    Promise.prototype['catch'] = function (onRejected) {\n"
+    "        return this.then(undefined, onRejected);\n"
+    "    };\n"
+    "    Promise.resolve = function (value) {\n"
+    "        if (value instanceof Promise)\n"
+    "            return value;\n"
+    "        return new Promise(function (resolve) { resolve(value); });\n"
+    "    };\n"
+    "    Promise.reject = function (reason) {\n"
+    "        return new Promise(function (resolve, reject) { reject(reason); });\n"
+    "    };\n"
+    "    Promise.all = function (values) {\n"
+    "        return new Promise(function (resolve, reject) {\n"
+    "            var results = [], remaining = values.length, i;\n"
+    "            if (remaining === 0)\n"
+    "                return resolve(results);\n"
+    "            for (i = 0; i < values.length; i++) {\n"
+    "                (function (index) {\n"
+    "                    Promise.resolve(values[index]).then(function (value) {\n"
+    "                        results[index] = value;\n"
+    "                        if (--remaining === 0)\n"
+    "                            resolve(results);\n"
+    "                    }, reject);\n"
+    "                })(i);\n"
+    "            }\n"
+    "        });\n"
+    "    };\n"
+    "    Promise.race = function (values) {\n"
+    "        return new Promise(function (resolve, reject) {\n"
+    "            for (var i = 0; i < values.length; i++)\n"
+    "                Promise.resolve(values[i]).then(resolve, reject);\n"
+    "        });\n"
+    "    };\n"
+    "    global.Promise = Promise;\n"
+    "})(this);\n";
+
+struct t_js_microtask *js_microtasks = NULL;      /* queue of tasks        */
+struct t_js_microtask *last_js_microtask = NULL;  /* last task in queue    */
+int js_microtask_draining = 0;                    /* 1 when running tasks  */
+long js_microtask_budget = 0;                     /* max ms for one drain  */
+struct t_hook *js_microtask_idle_hook = NULL;     /* idle timer            */
+struct t_hook *js_microtask_config_hook = NULL;   /* hook on budget option */
+
+/*
+ * Returns current time in microseconds (monotonic clock).
+ */
+
+static unsigned long long
+weechat_js_microtask_now ()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((unsigned long long) ts.tv_sec * 1000000ULL)
+        + ((unsigned long long) ts.tv_nsec / 1000ULL);
+}
+
+/*
+ * Reads time budget of a drain in plugin options.
+ */
+
+static void
+weechat_js_microtask_read_budget ()
+{
+    const char *value;
+    char *error;
+    long number;
+
+    js_microtask_budget = atol(JS_MICROTASK_BUDGET_DEFAULT);
+
+    value = weechat_config_get_plugin("microtask_budget_ms");
+    if (value && value[0])
+    {
+        error = NULL;
+        number = strtol(value, &error, 10);
+        if (error && !error[0] && (number >= 0))
+            js_microtask_budget = number;
+    }
+}
+
+/*
+ * Callback called when budget option is changed.
+ */
+
+static int
+weechat_js_microtask_config_cb (void *data, const char *option,
+                                const char *value)
+{
+    weechat_js_microtask_read_budget();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for idle timer: runs tasks left by previous drain.
+ */
+
+static int
+weechat_js_microtask_idle_cb (void *data, int remaining_calls)
+{
+    /* hook is removed by WeeChat after this call (max calls = 1) */
+    js_microtask_idle_hook = NULL;
+
+    weechat_js_microtask_drain();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Arms idle timer if tasks are waiting.
+ */
+
+static void
+weechat_js_microtask_schedule_idle ()
+{
+    if (js_microtasks && !js_microtask_idle_hook)
+    {
+        js_microtask_idle_hook = weechat_hook_timer(1, 0, 1,
+                                                    &weechat_js_microtask_idle_cb,
+                                                    NULL);
+    }
+}
+
+/*
+ * Initializes microtask queue and its option.
+ */
+
+void
+weechat_js_microtask_init ()
+{
+    if (!weechat_config_is_set_plugin("microtask_budget_ms"))
+    {
+        weechat_config_set_plugin("microtask_budget_ms",
+                                  JS_MICROTASK_BUDGET_DEFAULT);
+    }
+    weechat_config_set_desc_plugin("microtask_budget_ms",
+                                   "max time (in milliseconds) spent running "
+                                   "queued js tasks after a callback, "
+                                   "0 = no limit (remaining tasks run on next "
+                                   "loop iteration)");
+    weechat_js_microtask_read_budget();
+
+    js_microtask_config_hook = weechat_hook_config("plugins.var."
+                                                   JS_PLUGIN_NAME
+                                                   ".microtask_budget_ms",
+                                                   &weechat_js_microtask_config_cb,
+                                                   NULL);
+}
+
+/*
+ * Adds a task at the end of the queue.
+ *
+ * Returns 1 if OK, 0 if error.
+ */
+
+int
+weechat_js_microtask_enqueue (struct t_plugin_script *script,
+                              Handle<Function> function)
+{
+    struct t_js_microtask *new_task;
+
+    if (!script || function.IsEmpty())
+        return 0;
+
+    new_task = new t_js_microtask;
+    new_task->script = script;
+    new_task->function = Persistent<Function>::New(function);
+    new_task->next_task = NULL;
+
+    if (last_js_microtask)
+        last_js_microtask->next_task = new_task;
+    else
+        js_microtasks = new_task;
+    last_js_microtask = new_task;
+
+    return 1;
+}
+
+/*
+ * Runs queued tasks (including tasks queued while running them), until the
+ * queue is empty or the time budget is exhausted.
+ */
+
+void
+weechat_js_microtask_drain ()
+{
+    struct t_js_microtask *ptr_task;
+    unsigned long long start;
+
+    if (js_microtask_draining || !js_microtasks)
+        return;
+
+    js_microtask_draining = 1;
+    start = weechat_js_microtask_now();
+
+    while (js_microtasks)
+    {
+        HandleScope scope;
+
+        ptr_task = js_microtasks;
+        js_microtasks = ptr_task->next_task;
+        if (!js_microtasks)
+            last_js_microtask = NULL;
+
+        Handle<Function> function = Local<Function>::New(ptr_task->function);
+        ptr_task->function.Dispose();
+        weechat_js_exec_function(ptr_task->script, function, 0, NULL,
+                                 "microtask");
+        delete ptr_task;
+
+        if ((js_microtask_budget > 0)
+            && (weechat_js_microtask_now() - start
+                >= (unsigned long long) js_microtask_budget * 1000ULL))
+        {
+            break;
+        }
+    }
+
+    js_microtask_draining = 0;
+
+    weechat_js_microtask_schedule_idle();
+}
+
+/*
+ * Callback for rejection of a promise returned by a callback.
+ */
+
+static Handle<Value>
+weechat_js_microtask_rejected_cb (const Arguments &args)
+{
+    String::Utf8Value function(args.Data());
+    String::Utf8Value reason((args.Length() > 0) ? args[0] : Handle<Value>(Undefined()));
+
+    weechat_printf(NULL,
+                   weechat_gettext("%s%s: promise returned by function "
+                                   "\"%s\" was rejected: %s"),
+                   weechat_prefix("error"), JS_PLUGIN_NAME,
+                   *function, *reason);
+
+    return Undefined();
+}
+
+/*
+ * Watches a value returned by a callback: if it is a promise (any object
+ * with a "then" method), its rejection will be displayed.
+ *
+ * Handler is attached as code of script (current script/core are set): a
+ * promise already settled queues its reaction at once, for this script;
+ * queue is then drained (if no js code is running).
+ *
+ * Returns 1 if value is a promise, 0 otherwise.
+ */
+
+int
+weechat_js_microtask_watch_promise (struct t_plugin_script *script,
+                                    Handle<Value> value,
+                                    const char *function)
+{
+    HandleScope scope;
+    struct t_plugin_script *old_js_current_script;
+    WeechatJsCore *core, *old_js_current_core;
+    Handle<Value> argv[2];
+
+    if (!script || !script->interpreter || value.IsEmpty()
+        || !value->IsObject())
+        return 0;
+
+    core = (WeechatJsCore *) script->interpreter;
+
+    {
+        Context::Scope context_scope(core->getContext());
+        TryCatch try_catch;
+
+        Handle<Object> object = value->ToObject();
+        Handle<Value> then = object->Get(String::New("then"));
+        if (!then->IsFunction())
+            return 0;
+
+        argv[0] = Undefined();
+        argv[1] = FunctionTemplate::New(&weechat_js_microtask_rejected_cb,
+                                        String::New((function) ? function : "?"))->GetFunction();
+
+        old_js_current_script = js_current_script;
+        old_js_current_core = js_current_core;
+        js_current_script = script;
+        js_current_core = core;
+        js_exec_depth++;
+        Handle<Function>::Cast(then)->Call(object, 2, argv);
+        js_exec_depth--;
+        js_current_script = old_js_current_script;
+        js_current_core = old_js_current_core;
+    }
+
+    /* run reaction queued by a promise already settled */
+    if (js_exec_depth == 0)
+        weechat_js_microtask_drain();
+
+    return 1;
+}
+
+/*
+ * Removes all tasks of a script.
+ */
+
+void
+weechat_js_microtask_remove_script (struct t_plugin_script *script)
+{
+    struct t_js_microtask *ptr_task, *prev_task, *next_task;
+
+    prev_task = NULL;
+    ptr_task = js_microtasks;
+    while (ptr_task)
+    {
+        next_task = ptr_task->next_task;
+        if (ptr_task->script == script)
+        {
+            if (prev_task)
+                prev_task->next_task = next_task;
+            else
+                js_microtasks = next_task;
+            if (last_js_microtask == ptr_task)
+                last_js_microtask = prev_task;
+            ptr_task->function.Dispose();
+            delete ptr_task;
+        }
+        else
+            prev_task = ptr_task;
+        ptr_task = next_task;
+    }
+}
+
+/*
+ * Frees all tasks and hooks.
+ */
+
+void
+weechat_js_microtask_end ()
+{
+    struct t_js_microtask *next_task;
+
+    while (js_microtasks)
+    {
+        next_task = js_microtasks->next_task;
+        js_microtasks->function.Dispose();
+        delete js_microtasks;
+        js_microtasks = next_task;
+    }
+    last_js_microtask = NULL;
+
+    if (js_microtask_idle_hook)
+    {
+        weechat_unhook(js_microtask_idle_hook);
+        js_microtask_idle_hook = NULL;
+    }
+    if (js_microtask_config_hook)
+    {
+        weechat_unhook(js_microtask_config_hook);
+        js_microtask_config_hook = NULL;
+    }
+}
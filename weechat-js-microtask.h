@@ -0,0 +1,33 @@
+#ifndef __WEECHAT_JS_MICROTASK_H_
+#define __WEECHAT_JS_MICROTASK_H_
+
+#include <v8.h>
+
+/*
+ * Microtask queue: jobs queued by scripts (queueMicrotask, promise
+ * reactions) are run after each callback, and on an idle timer when the
+ * time budget of a drain was exhausted.
+ */
+
+#define JS_MICROTASK_BUDGET_DEFAULT "10"
+
+struct t_js_microtask
+{
+    struct t_plugin_script *script;          /* script owning the task      */
+    v8::Persistent<v8::Function> function;   /* function to call            */
+    struct t_js_microtask *next_task;        /* link to next task           */
+};
+
+extern const char *weechat_js_microtask_prelude;
+
+extern void weechat_js_microtask_init (void);
+extern void weechat_js_microtask_end (void);
+extern int weechat_js_microtask_enqueue (struct t_plugin_script *script,
+                                         v8::Handle<v8::Function> function);
+extern void weechat_js_microtask_drain (void);
+extern int weechat_js_microtask_watch_promise (struct t_plugin_script *script,
+                                               v8::Handle<v8::Value> value,
+                                               const char *function);
+extern void weechat_js_microtask_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_MICROTASK_H_ */
@@ -0,0 +1,464 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <v8.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-option.h"
+
+using namespace v8;
+
+struct t_js_option *js_options = NULL;
+struct t_js_option *last_js_option = NULL;
+struct t_hashtable *js_options_by_key = NULL;  /* script/name -> handle    */
+struct t_hashtable *js_option_watches = NULL;  /* option name -> watch     */
+struct t_hook *js_option_hook_unloaded = NULL; /* signal "plugin_unloaded" */
+
+/*
+ * Invalidates caches of handles on an option (callback of hashtable_map).
+ */
+
+static void
+weechat_js_option_invalidate_cb (void *data, struct t_hashtable *hashtable,
+                                 const void *key, const void *value)
+{
+    ((struct t_js_option_watch *) value)->changes++;
+}
+
+/*
+ * Callback for signal "plugin_unloaded": options of plugin are freed without
+ * any change, so caches of all handles are invalid.
+ */
+
+static int
+weechat_js_option_unloaded_cb (void *data, const char *signal,
+                               const char *type_data, void *signal_data)
+{
+    weechat_hashtable_map(js_option_watches,
+                          &weechat_js_option_invalidate_cb, NULL);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Creates tables used by option handles.
+ */
+
+void
+weechat_js_option_init ()
+{
+    js_options_by_key = weechat_hashtable_new(32,
+                                              WEECHAT_HASHTABLE_STRING,
+                                              WEECHAT_HASHTABLE_POINTER,
+                                              NULL, NULL);
+    js_option_watches = weechat_hashtable_new(32,
+                                              WEECHAT_HASHTABLE_STRING,
+                                              WEECHAT_HASHTABLE_POINTER,
+                                              NULL, NULL);
+    js_option_hook_unloaded = weechat_hook_signal("plugin_unloaded",
+                                                  &weechat_js_option_unloaded_cb,
+                                                  NULL);
+}
+
+/*
+ * Builds key of a handle in index: "0x1234abcd/file.section.option".
+ *
+ * Note: result must be freed after use.
+ */
+
+static char *
+weechat_js_option_key (struct t_plugin_script *script, const char *name)
+{
+    char *key;
+    int length;
+
+    length = 32 + strlen(name) + 1;
+    key = (char *) malloc(length);
+    if (key)
+        snprintf(key, length, "%p/%s", (void *) script, name);
+
+    return key;
+}
+
+/*
+ * Callback for changes of an option: caches of all handles on option are
+ * invalid.
+ */
+
+static int
+weechat_js_option_config_cb (void *data, const char *option,
+                             const char *value)
+{
+    ((struct t_js_option_watch *) data)->changes++;
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Returns watch of an option (created with its hook if needed), and counts
+ * one more handle on it.
+ */
+
+static struct t_js_option_watch *
+weechat_js_option_watch_add (const char *name)
+{
+    struct t_js_option_watch *watch;
+
+    watch = (struct t_js_option_watch *) weechat_hashtable_get(js_option_watches,
+                                                               name);
+    if (!watch)
+    {
+        watch = (struct t_js_option_watch *) malloc(sizeof(*watch));
+        if (!watch)
+            return NULL;
+        watch->name = strdup(name);
+        watch->changes = 0;
+        watch->handles = 0;
+        watch->hook = weechat_hook_config(name, &weechat_js_option_config_cb,
+                                          watch);
+        weechat_hashtable_set(js_option_watches, watch->name, watch);
+    }
+    watch->handles++;
+
+    return watch;
+}
+
+/*
+ * Counts one handle less on an option, and frees watch of option (with its
+ * hook) if no handle remains.
+ */
+
+static void
+weechat_js_option_watch_remove (struct t_js_option_watch *watch)
+{
+    watch->handles--;
+    if (watch->handles > 0)
+        return;
+
+    if (watch->hook)
+        weechat_unhook(watch->hook);
+    weechat_hashtable_remove(js_option_watches, watch->name);
+    free(watch->name);
+    free(watch);
+}
+
+/*
+ * Reads value of option in WeeChat (if cache is invalid, or if option was
+ * freed since values were read): only the getter matching type of option is
+ * called, and nothing is read if value is null.
+ */
+
+static void
+weechat_js_option_refresh (struct t_js_option *option)
+{
+    struct t_config_option *ptr_option;
+    int *ptr_type;
+    const char *value;
+
+    /* option may be freed without any change: it is found again by name */
+    ptr_option = weechat_config_get(option->watch->name);
+
+    if (option->valid && (option->changes == option->watch->changes)
+        && (ptr_option == option->pointer))
+        return;
+
+    if (!option->value.IsEmpty())
+        option->value.Dispose();
+    if (!option->value_string.IsEmpty())
+        option->value_string.Dispose();
+    option->value.Clear();
+    option->value_string.Clear();
+    option->type = -1;
+
+    option->exists = (ptr_option) ? 1 : 0;
+    option->pointer = ptr_option;
+    ptr_type = (ptr_option) ?
+        (int *) weechat_config_option_get_pointer(ptr_option, "type") : NULL;
+    if (ptr_type)
+    {
+        option->type = *ptr_type;
+        if (weechat_config_option_get_pointer(ptr_option, "value"))
+        {
+            switch (option->type)
+            {
+                case JS_OPTION_TYPE_BOOLEAN:
+                    option->value = Persistent<Value>::New(
+                        (weechat_config_boolean(ptr_option)) ? True() : False());
+                    break;
+                case JS_OPTION_TYPE_INTEGER:
+                    option->value = Persistent<Value>::New(
+                        Integer::New(weechat_config_integer(ptr_option)));
+                    if (weechat_config_option_get_pointer(ptr_option,
+                                                          "string_values"))
+                    {
+                        value = weechat_config_string(ptr_option);
+                        if (value)
+                        {
+                            option->value_string = Persistent<Value>::New(
+                                String::New(value));
+                        }
+                    }
+                    break;
+                case JS_OPTION_TYPE_STRING:
+                    value = weechat_config_string(ptr_option);
+                    if (value)
+                        option->value = Persistent<Value>::New(String::New(value));
+                    break;
+                case JS_OPTION_TYPE_COLOR:
+                    value = weechat_config_color(ptr_option);
+                    if (value)
+                        option->value = Persistent<Value>::New(String::New(value));
+                    break;
+            }
+        }
+    }
+
+    option->changes = option->watch->changes;
+    option->valid = 1;
+}
+
+/*
+ * Returns cached value of option if it has given type, null otherwise.
+ */
+
+static Handle<Value>
+weechat_js_option_value (struct t_js_option *option, int type)
+{
+    weechat_js_option_refresh(option);
+
+    if ((option->type != type) || option->value.IsEmpty())
+        return Null();
+
+    return option->value;
+}
+
+/*
+ * Getters of handle properties.
+ */
+
+static Handle<Value>
+weechat_js_option_name_cb (Local<String> property, const AccessorInfo &info)
+{
+    struct t_js_option *option;
+
+    option = (struct t_js_option *) External::Unwrap(info.Data());
+
+    return String::New(option->watch->name);
+}
+
+static Handle<Value>
+weechat_js_option_exists_cb (Local<String> property, const AccessorInfo &info)
+{
+    struct t_js_option *option;
+
+    option = (struct t_js_option *) External::Unwrap(info.Data());
+    weechat_js_option_refresh(option);
+
+    return (option->exists) ? True() : False();
+}
+
+static Handle<Value>
+weechat_js_option_string_cb (Local<String> property, const AccessorInfo &info)
+{
+    struct t_js_option *option;
+
+    option = (struct t_js_option *) External::Unwrap(info.Data());
+    weechat_js_option_refresh(option);
+
+    /* integer with string values */
+    if ((option->type == JS_OPTION_TYPE_INTEGER)
+        && !option->value_string.IsEmpty())
+        return option->value_string;
+
+    return weechat_js_option_value(option, JS_OPTION_TYPE_STRING);
+}
+
+static Handle<Value>
+weechat_js_option_color_cb (Local<String> property, const AccessorInfo &info)
+{
+    return weechat_js_option_value(
+        (struct t_js_option *) External::Unwrap(info.Data()),
+        JS_OPTION_TYPE_COLOR);
+}
+
+static Handle<Value>
+weechat_js_option_integer_cb (Local<String> property, const AccessorInfo &info)
+{
+    return weechat_js_option_value(
+        (struct t_js_option *) External::Unwrap(info.Data()),
+        JS_OPTION_TYPE_INTEGER);
+}
+
+static Handle<Value>
+weechat_js_option_boolean_cb (Local<String> property, const AccessorInfo &info)
+{
+    return weechat_js_option_value(
+        (struct t_js_option *) External::Unwrap(info.Data()),
+        JS_OPTION_TYPE_BOOLEAN);
+}
+
+/*
+ * Returns handle on an option for a script (created on first call for this
+ * option name).
+ *
+ * Returns null if option is not found.
+ */
+
+Handle<Value>
+weechat_js_option_get (struct t_plugin_script *script, const char *name)
+{
+    HandleScope scope;
+    struct t_js_option *ptr_option, *new_option;
+    Handle<Value> data;
+    char *key;
+
+    if (!script || !name || !name[0])
+        return Null();
+
+    key = weechat_js_option_key(script, name);
+    if (!key)
+        return Null();
+
+    ptr_option = (struct t_js_option *) weechat_hashtable_get(js_options_by_key,
+                                                              key);
+    if (ptr_option)
+    {
+        free(key);
+        return scope.Close(Local<Object>::New(ptr_option->object));
+    }
+
+    if (!weechat_config_get(name))
+    {
+        free(key);
+        return Null();
+    }
+
+    new_option = new t_js_option;
+    new_option->script = script;
+    new_option->key = key;
+    new_option->watch = weechat_js_option_watch_add(name);
+    if (!new_option->watch)
+    {
+        free(key);
+        delete new_option;
+        return Null();
+    }
+    new_option->valid = 0;
+    new_option->changes = 0;
+    new_option->exists = 0;
+    new_option->pointer = NULL;
+    new_option->type = -1;
+
+    data = External::Wrap(new_option);
+    Local<Object> object = Object::New();
+    object->SetAccessor(String::New("name"), &weechat_js_option_name_cb,
+                        0, data);
+    object->SetAccessor(String::New("exists"), &weechat_js_option_exists_cb,
+                        0, data);
+    object->SetAccessor(String::New("string"), &weechat_js_option_string_cb,
+                        0, data);
+    object->SetAccessor(String::New("integer"), &weechat_js_option_integer_cb,
+                        0, data);
+    object->SetAccessor(String::New("boolean"), &weechat_js_option_boolean_cb,
+                        0, data);
+    object->SetAccessor(String::New("color"), &weechat_js_option_color_cb,
+                        0, data);
+    new_option->object = Persistent<Object>::New(object);
+
+    new_option->prev_option = last_js_option;
+    new_option->next_option = NULL;
+    if (last_js_option)
+        last_js_option->next_option = new_option;
+    else
+        js_options = new_option;
+    last_js_option = new_option;
+
+    weechat_hashtable_set(js_options_by_key, new_option->key, new_option);
+
+    return scope.Close(object);
+}
+
+/*
+ * Frees a handle.
+ */
+
+static void
+weechat_js_option_free (struct t_js_option *option)
+{
+    if (option->prev_option)
+        (option->prev_option)->next_option = option->next_option;
+    if (option->next_option)
+        (option->next_option)->prev_option = option->prev_option;
+    if (js_options == option)
+        js_options = option->next_option;
+    if (last_js_option == option)
+        last_js_option = option->prev_option;
+
+    weechat_hashtable_remove(js_options_by_key, option->key);
+    weechat_js_option_watch_remove(option->watch);
+    if (!option->object.IsEmpty())
+        option->object.Dispose();
+    if (!option->value.IsEmpty())
+        option->value.Dispose();
+    if (!option->value_string.IsEmpty())
+        option->value_string.Dispose();
+    free(option->key);
+
+    delete option;
+}
+
+/*
+ * Removes handles of a script.
+ */
+
+void
+weechat_js_option_remove_script (struct t_plugin_script *script)
+{
+    struct t_js_option *ptr_option, *next_option;
+
+    ptr_option = js_options;
+    while (ptr_option)
+    {
+        next_option = ptr_option->next_option;
+        if (ptr_option->script == script)
+            weechat_js_option_free(ptr_option);
+        ptr_option = next_option;
+    }
+}
+
+/*
+ * Removes all handles.
+ */
+
+void
+weechat_js_option_end ()
+{
+    while (js_options)
+    {
+        weechat_js_option_free(js_options);
+    }
+    if (js_options_by_key)
+    {
+        weechat_hashtable_free(js_options_by_key);
+        js_options_by_key = NULL;
+    }
+    if (js_option_hook_unloaded)
+    {
+        weechat_unhook(js_option_hook_unloaded);
+        js_option_hook_unloaded = NULL;
+    }
+    if (js_option_watches)
+    {
+        weechat_hashtable_free(js_option_watches);
+        js_option_watches = NULL;
+    }
+}
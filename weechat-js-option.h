@@ -0,0 +1,63 @@
+#ifndef __WEECHAT_JS_OPTION_H_
+#define __WEECHAT_JS_OPTION_H_
+
+#include <v8.h>
+
+/*
+ * Handles on WeeChat options (weechat.config_option(name)): an object with
+ * getters "string", "integer", "boolean" and "color". Values are read in
+ * WeeChat once and cached in the handle, until option is changed: one
+ * hook_config per option (shared by all scripts having a handle on it)
+ * increments a counter of changes, and a handle reads values again when
+ * counter differs from the one of its cache.
+ * Freeing an option does not run hook_config: each read compares pointer of
+ * option (found again by name) with the one of the cache, and all caches are
+ * invalid when a plugin is unloaded (its options are freed and may be
+ * created again at same address).
+ * A script gets the same handle for each call with same option name
+ * (handles are indexed by script and option name).
+ */
+
+/* types of options, as returned by config_option_get_pointer(, "type") */
+/* (same order as enum t_config_option_type in WeeChat core) */
+#define JS_OPTION_TYPE_BOOLEAN   0
+#define JS_OPTION_TYPE_INTEGER   1
+#define JS_OPTION_TYPE_STRING    2
+#define JS_OPTION_TYPE_COLOR     3
+
+struct t_js_option_watch
+{
+    char *name;                              /* full name of option         */
+    struct t_hook *hook;                     /* hook_config on option       */
+    int changes;                             /* number of changes of option */
+    int handles;                             /* number of handles on option */
+};
+
+struct t_js_option
+{
+    struct t_plugin_script *script;          /* script owning the handle    */
+    char *key;                               /* key in index of handles     */
+    struct t_js_option_watch *watch;         /* watch of option             */
+    v8::Persistent<v8::Object> object;       /* handle given to script      */
+    int valid;                               /* 1 if values below are valid */
+    int changes;                             /* changes of option when      */
+                                             /* values were read            */
+    int exists;                              /* 1 if option was found       */
+    struct t_config_option *pointer;         /* option read (only compared, */
+                                             /* never used)                 */
+    int type;                                /* type of option (-1 if none) */
+    v8::Persistent<v8::Value> value;         /* value (for type of option), */
+                                             /* empty if value is null      */
+    v8::Persistent<v8::Value> value_string;  /* string of integer option    */
+                                             /* with string values          */
+    struct t_js_option *prev_option;         /* link to previous handle     */
+    struct t_js_option *next_option;         /* link to next handle         */
+};
+
+extern void weechat_js_option_init (void);
+extern v8::Handle<v8::Value> weechat_js_option_get (struct t_plugin_script *script,
+                                                    const char *name);
+extern void weechat_js_option_remove_script (struct t_plugin_script *script);
+extern void weechat_js_option_end (void);
+
+#endif /* __WEECHAT_JS_OPTION_H_ */
@@ -0,0 +1,637 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-process.h"
+
+#define JS_PROCESS_WAIT_INTERVAL 100
+
+struct t_hashtable *js_processes = NULL;    /* script_cb -> process      */
+pid_t *js_process_zombies = NULL;           /* killed children to reap   */
+int js_process_num_zombies = 0;             /* number of children        */
+struct t_hook *js_process_reaper = NULL;    /* timer reaping children    */
+
+/*
+ * Initializes streaming processes.
+ */
+
+void
+weechat_js_process_init ()
+{
+    js_processes = weechat_hashtable_new(32,
+                                         WEECHAT_HASHTABLE_POINTER,
+                                         WEECHAT_HASHTABLE_POINTER,
+                                         NULL, NULL);
+}
+
+/*
+ * Closes a pipe of process.
+ */
+
+static void
+weechat_js_process_close_fd (struct t_js_process *process, int index)
+{
+    if (process->hook_fd[index])
+    {
+        weechat_unhook(process->hook_fd[index]);
+        process->hook_fd[index] = NULL;
+    }
+    if (process->fd[index] >= 0)
+    {
+        close(process->fd[index]);
+        process->fd[index] = -1;
+    }
+}
+
+/*
+ * Reaps killed children which have ended.
+ */
+
+static void
+weechat_js_process_reap_zombies ()
+{
+    int i;
+
+    i = 0;
+    while (i < js_process_num_zombies)
+    {
+        if (waitpid(js_process_zombies[i], NULL, WNOHANG) != 0)
+        {
+            js_process_zombies[i] =
+                js_process_zombies[js_process_num_zombies - 1];
+            js_process_num_zombies--;
+        }
+        else
+            i++;
+    }
+}
+
+/*
+ * Callback for timer reaping killed children (removed when all are reaped).
+ */
+
+static int
+weechat_js_process_reaper_cb (void *data, int remaining_calls)
+{
+    weechat_js_process_reap_zombies();
+
+    if ((js_process_num_zombies == 0) && js_process_reaper)
+    {
+        weechat_unhook(js_process_reaper);
+        js_process_reaper = NULL;
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Kills a child (and its process group) and reaps it without blocking: if it
+ * has not ended yet, it is reaped later by a timer.
+ */
+
+static void
+weechat_js_process_kill (pid_t pid)
+{
+    pid_t *new_zombies;
+
+    kill(-pid, SIGKILL);
+    kill(pid, SIGKILL);
+    if (waitpid(pid, NULL, WNOHANG) != 0)
+        return;
+
+    new_zombies = (pid_t *) realloc(js_process_zombies,
+                                    (js_process_num_zombies + 1) *
+                                    sizeof(*new_zombies));
+    if (!new_zombies)
+        return;
+    js_process_zombies = new_zombies;
+    js_process_zombies[js_process_num_zombies++] = pid;
+    if (!js_process_reaper)
+    {
+        js_process_reaper = weechat_hook_timer(JS_PROCESS_WAIT_INTERVAL, 0, 0,
+                                               &weechat_js_process_reaper_cb,
+                                               NULL);
+    }
+}
+
+/*
+ * Frees a process, killing the child if it is still running.
+ */
+
+static void
+weechat_js_process_free (struct t_js_process *process)
+{
+    int i;
+
+    for (i = 0; i < JS_PROCESS_NUM_FD; i++)
+    {
+        weechat_js_process_close_fd(process, i);
+    }
+    if (process->hook_timeout)
+    {
+        weechat_unhook(process->hook_timeout);
+        process->hook_timeout = NULL;
+    }
+    if (process->hook_wait)
+    {
+        weechat_unhook(process->hook_wait);
+        process->hook_wait = NULL;
+    }
+    if (process->pid > 0)
+    {
+        weechat_js_process_kill(process->pid);
+        process->pid = 0;
+    }
+
+    if (process->script_cb)
+    {
+        weechat_hashtable_remove(js_processes, process->script_cb);
+        plugin_script_callback_remove(process->script, process->script_cb);
+        process->script_cb = NULL;
+    }
+
+    /* when called from a callback of this process, free it later */
+    if (process->running)
+    {
+        process->deleted = 1;
+        return;
+    }
+
+    if (process->command)
+        free(process->command);
+    if (process->buffer)
+        free(process->buffer);
+    free(process);
+}
+
+/*
+ * Sends output (or end of process) to script.
+ *
+ * Returns 0 if process has been removed by the script, 1 otherwise.
+ */
+
+static int
+weechat_js_process_deliver (struct t_js_process *process, int return_code,
+                            int index, const char *data, int size)
+{
+    HandleScope scope;
+    Handle<Value> argv[5], chunk, empty;
+    struct t_plugin_script_cb *script_cb;
+    char *function;
+
+    script_cb = process->script_cb;
+
+    if (process->binary)
+    {
+        empty = weechat_js_buffer_new(NULL, 0);
+        chunk = (data && (size > 0)) ?
+            Handle<Value>(weechat_js_buffer_new(data, size)) : empty;
+    }
+    else
+    {
+        empty = String::New("");
+        chunk = (data && (size > 0)) ?
+            Handle<Value>(String::New(data, size)) : empty;
+    }
+
+    argv[0] = String::New((script_cb->data) ? script_cb->data : "");
+    argv[1] = String::New(process->command);
+    argv[2] = Integer::New(return_code);
+    argv[3] = (index == JS_PROCESS_STDOUT) ? chunk : empty;
+    argv[4] = (index == JS_PROCESS_STDERR) ? chunk : empty;
+
+    /* script callback may be removed by the function itself */
+    function = strdup(script_cb->function);
+    process->running = 1;
+    weechat_js_exec_function(process->script, function, 5, argv, "process");
+    process->running = 0;
+    free(function);
+
+    if (process->deleted)
+    {
+        weechat_js_process_free(process);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Reaps child and sends its return code to script.
+ *
+ * Returns 1 if child has been reaped (process is freed), 0 if it is still
+ * running.
+ */
+
+static int
+weechat_js_process_reap (struct t_js_process *process)
+{
+    int status, return_code;
+    pid_t pid;
+
+    pid = waitpid(process->pid, &status, WNOHANG);
+    if (pid == 0)
+        return 0;
+
+    if ((pid > 0) && WIFEXITED(status) && !process->timed_out)
+        return_code = WEXITSTATUS(status);
+    else
+        return_code = WEECHAT_HOOK_PROCESS_ERROR;
+    process->pid = 0;
+
+    if (weechat_js_process_deliver(process, return_code, -1, NULL, 0))
+        weechat_js_process_free(process);
+
+    return 1;
+}
+
+/*
+ * Callback for timer waiting end of child (after its pipes were closed).
+ */
+
+static int
+weechat_js_process_wait_cb (void *data, int remaining_calls)
+{
+    struct t_js_process *process;
+
+    process = (struct t_js_process *) data;
+
+    weechat_js_process_reap(process);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Checks if both pipes are closed, and then waits for end of child (timeout
+ * of command is kept while waiting).
+ */
+
+static void
+weechat_js_process_check_end (struct t_js_process *process)
+{
+    int i;
+
+    for (i = 0; i < JS_PROCESS_NUM_FD; i++)
+    {
+        if (process->fd[i] >= 0)
+            return;
+    }
+
+    if (process->hook_wait)
+        return;
+
+    if (!weechat_js_process_reap(process))
+    {
+        process->hook_wait = weechat_hook_timer(JS_PROCESS_WAIT_INTERVAL,
+                                                0, 0,
+                                                &weechat_js_process_wait_cb,
+                                                process);
+    }
+}
+
+/*
+ * Callback for data available on a pipe of process.
+ */
+
+static int
+weechat_js_process_fd_cb (void *data, int fd)
+{
+    struct t_js_process *process;
+    int index;
+    ssize_t num_read;
+
+    process = (struct t_js_process *) data;
+    index = (fd == process->fd[JS_PROCESS_STDOUT]) ?
+        JS_PROCESS_STDOUT : JS_PROCESS_STDERR;
+
+    num_read = read(fd, process->buffer, process->chunk_size);
+    if (num_read > 0)
+    {
+        weechat_js_process_deliver(process, WEECHAT_HOOK_PROCESS_RUNNING,
+                                   index, process->buffer, num_read);
+        return WEECHAT_RC_OK;
+    }
+
+    if ((num_read < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+        return WEECHAT_RC_OK;
+
+    weechat_js_process_close_fd(process, index);
+    weechat_js_process_check_end(process);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Callback for timeout of process: kills the child and its process group,
+ * its end is reported when pipes are closed and child is reaped.
+ */
+
+static int
+weechat_js_process_timeout_cb (void *data, int remaining_calls)
+{
+    struct t_js_process *process;
+
+    process = (struct t_js_process *) data;
+
+    /* hook is removed by WeeChat after this call (max calls = 1) */
+    process->hook_timeout = NULL;
+
+    if (process->pid > 0)
+    {
+        process->timed_out = 1;
+        kill(-process->pid, SIGKILL);
+        kill(process->pid, SIGKILL);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Hooks (or unhooks) pipes of process.
+ */
+
+static void
+weechat_js_process_hook_fds (struct t_js_process *process, int hook)
+{
+    int i;
+
+    for (i = 0; i < JS_PROCESS_NUM_FD; i++)
+    {
+        if (hook && !process->hook_fd[i] && (process->fd[i] >= 0))
+        {
+            process->hook_fd[i] = weechat_hook_fd(process->fd[i], 1, 0, 0,
+                                                  &weechat_js_process_fd_cb,
+                                                  process);
+        }
+        else if (!hook && process->hook_fd[i])
+        {
+            weechat_unhook(process->hook_fd[i]);
+            process->hook_fd[i] = NULL;
+        }
+    }
+}
+
+/*
+ * Runs a command in a child process, its output is streamed to a function
+ * of script.
+ *
+ * Returns the script callback, used as identifier for pause/unhook.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_process_new (struct t_plugin_script *script,
+                        const char *command,
+                        int timeout,
+                        int chunk_size,
+                        int binary,
+                        const char *function,
+                        const char *data)
+{
+    struct t_js_process *new_process;
+    struct t_plugin_script_cb *new_script_cb;
+    int pipe_out[2], pipe_err[2], fd_null, i;
+    pid_t pid;
+
+    if (!script || !command || !command[0] || !function || !function[0])
+        return NULL;
+
+    if (chunk_size <= 0)
+        chunk_size = JS_PROCESS_CHUNK_SIZE_DEFAULT;
+    if (chunk_size < JS_PROCESS_CHUNK_SIZE_MIN)
+        chunk_size = JS_PROCESS_CHUNK_SIZE_MIN;
+
+    new_process = (struct t_js_process *) malloc(sizeof(*new_process));
+    if (!new_process)
+        return NULL;
+    new_process->buffer = (char *) malloc(chunk_size);
+    if (!new_process->buffer)
+    {
+        free(new_process);
+        return NULL;
+    }
+
+    if (pipe(pipe_out) < 0)
+    {
+        free(new_process->buffer);
+        free(new_process);
+        return NULL;
+    }
+    if (pipe(pipe_err) < 0)
+    {
+        close(pipe_out[0]);
+        close(pipe_out[1]);
+        free(new_process->buffer);
+        free(new_process);
+        return NULL;
+    }
+
+    pid = fork();
+    switch (pid)
+    {
+        case -1: /* fork failed */
+            close(pipe_out[0]);
+            close(pipe_out[1]);
+            close(pipe_err[0]);
+            close(pipe_err[1]);
+            free(new_process->buffer);
+            free(new_process);
+            return NULL;
+        case 0: /* child */
+            /* own process group: kill reaches commands started by shell */
+            setpgid(0, 0);
+            fd_null = open("/dev/null", O_RDONLY);
+            if (fd_null >= 0)
+                dup2(fd_null, STDIN_FILENO);
+            dup2(pipe_out[1], STDOUT_FILENO);
+            dup2(pipe_err[1], STDERR_FILENO);
+            close(pipe_out[0]);
+            close(pipe_out[1]);
+            close(pipe_err[0]);
+            close(pipe_err[1]);
+            execl("/bin/sh", "sh", "-c", command, (char *) NULL);
+            _exit(127);
+    }
+
+    /* parent (group is set in both processes, whichever runs first) */
+    setpgid(pid, pid);
+    close(pipe_out[1]);
+    close(pipe_err[1]);
+
+    new_script_cb = plugin_script_callback_add(script, function, data);
+    if (!new_script_cb)
+    {
+        close(pipe_out[0]);
+        close(pipe_err[0]);
+        weechat_js_process_kill(pid);
+        free(new_process->buffer);
+        free(new_process);
+        return NULL;
+    }
+
+    new_process->script = script;
+    new_process->script_cb = new_script_cb;
+    new_process->command = strdup(command);
+    new_process->pid = pid;
+    new_process->fd[JS_PROCESS_STDOUT] = pipe_out[0];
+    new_process->fd[JS_PROCESS_STDERR] = pipe_err[0];
+    new_process->chunk_size = chunk_size;
+    new_process->binary = binary;
+    new_process->paused = 0;
+    new_process->timed_out = 0;
+    new_process->running = 0;
+    new_process->deleted = 0;
+    new_process->hook_timeout = NULL;
+    new_process->hook_wait = NULL;
+    for (i = 0; i < JS_PROCESS_NUM_FD; i++)
+    {
+        fcntl(new_process->fd[i], F_SETFL,
+              fcntl(new_process->fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(new_process->fd[i], F_SETFD, FD_CLOEXEC);
+        new_process->hook_fd[i] = NULL;
+    }
+
+    weechat_js_process_hook_fds(new_process, 1);
+    if (timeout > 0)
+    {
+        new_process->hook_timeout = weechat_hook_timer(timeout, 0, 1,
+                                                       &weechat_js_process_timeout_cb,
+                                                       new_process);
+    }
+
+    weechat_hashtable_set(js_processes, new_script_cb, new_process);
+
+    return new_script_cb;
+}
+
+/*
+ * Pauses or resumes reading output of a process.
+ *
+ * Returns 1 if pointer was a process of script, 0 otherwise.
+ */
+
+int
+weechat_js_process_pause (struct t_plugin_script *script, void *pointer,
+                          int pause)
+{
+    struct t_js_process *ptr_process;
+
+    if (!pointer)
+        return 0;
+
+    ptr_process = (struct t_js_process *) weechat_hashtable_get(js_processes,
+                                                                pointer);
+    if (!ptr_process || (ptr_process->script != script)
+        || ptr_process->deleted)
+        return 0;
+
+    ptr_process->paused = (pause) ? 1 : 0;
+    weechat_js_process_hook_fds(ptr_process, !ptr_process->paused);
+
+    return 1;
+}
+
+/*
+ * Removes a process (the child is killed if still running).
+ *
+ * Returns 1 if pointer was a process of script, 0 otherwise.
+ */
+
+int
+weechat_js_process_remove (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_process *ptr_process;
+
+    if (!pointer)
+        return 0;
+
+    ptr_process = (struct t_js_process *) weechat_hashtable_get(js_processes,
+                                                                pointer);
+    if (!ptr_process || (ptr_process->script != script))
+        return 0;
+
+    weechat_js_process_free(ptr_process);
+
+    return 1;
+}
+
+/*
+ * Removes all processes of a script.
+ */
+
+void
+weechat_js_process_remove_script (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+    struct t_js_process *ptr_process;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        ptr_process = (struct t_js_process *) weechat_hashtable_get(js_processes,
+                                                                    ptr_script_cb);
+        if (ptr_process)
+            weechat_js_process_free(ptr_process);
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Callback used to free all processes.
+ */
+
+static void
+weechat_js_process_free_cb (void *data, struct t_hashtable *hashtable,
+                            const void *key, const void *value)
+{
+    weechat_js_process_free((struct t_js_process *) value);
+}
+
+/*
+ * Kills and frees all processes.
+ */
+
+void
+weechat_js_process_end ()
+{
+    if (js_processes)
+    {
+        weechat_hashtable_map(js_processes,
+                              &weechat_js_process_free_cb, NULL);
+        weechat_hashtable_free(js_processes);
+        js_processes = NULL;
+    }
+
+    /* children not ended yet can not be reaped any more (no wait here) */
+    weechat_js_process_reap_zombies();
+    if (js_process_reaper)
+    {
+        weechat_unhook(js_process_reaper);
+        js_process_reaper = NULL;
+    }
+    if (js_process_zombies)
+    {
+        free(js_process_zombies);
+        js_process_zombies = NULL;
+    }
+    js_process_num_zombies = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef __WEECHAT_JS_PROCESS_H_
+#define __WEECHAT_JS_PROCESS_H_
+
+#include <sys/types.h>
+
+/*
+ * Streaming processes: output of command is read by the plugin (with
+ * hook_fd) and each chunk is given to the script as soon as it is read.
+ * Reading stops while the stream is paused, so that a slow script applies
+ * backpressure on the command (its pipe gets full).
+ *
+ * Option "max_buffer" of the script is the size of chunks (max bytes read
+ * at once on a pipe), it does not bound data pending in the pipe: only a
+ * pause does.
+ *
+ * Command runs in its own process group, so that kill on timeout or
+ * removal reaches all processes started by the shell. Children killed are
+ * reaped later by a timer (never waited on the main loop).
+ */
+
+#define JS_PROCESS_CHUNK_SIZE_DEFAULT 65536
+#define JS_PROCESS_CHUNK_SIZE_MIN 512
+
+enum t_js_process_fd
+{
+    JS_PROCESS_STDOUT = 0,
+    JS_PROCESS_STDERR,
+    /* number of fd read */
+    JS_PROCESS_NUM_FD,
+};
+
+struct t_js_process
+{
+    struct t_plugin_script *script;          /* script owning the process   */
+    struct t_plugin_script_cb *script_cb;    /* function/data called        */
+    char *command;                           /* command executed            */
+    pid_t pid;                               /* pid of child (0 if reaped)  */
+    int fd[JS_PROCESS_NUM_FD];               /* pipes (-1 if closed)        */
+    struct t_hook *hook_fd[JS_PROCESS_NUM_FD]; /* hooks on pipes            */
+    struct t_hook *hook_timeout;             /* timeout of command          */
+    struct t_hook *hook_wait;                /* wait for end of child       */
+    int chunk_size;                          /* max bytes read at once      */
+    int binary;                              /* 1 = chunks are byte arrays  */
+    int paused;                              /* 1 if reading is suspended   */
+    int timed_out;                           /* 1 if child was killed       */
+    int running;                             /* 1 if callback is running    */
+    int deleted;                             /* removed during callback     */
+    char *buffer;                            /* buffer for read             */
+};
+
+extern void weechat_js_process_init (void);
+extern void weechat_js_process_end (void);
+extern struct t_plugin_script_cb *weechat_js_process_new (struct t_plugin_script *script,
+                                                          const char *command,
+                                                          int timeout,
+                                                          int chunk_size,
+                                                          int binary,
+                                                          const char *function,
+                                                          const char *data);
+extern int weechat_js_process_pause (struct t_plugin_script *script,
+                                     void *pointer, int pause);
+extern int weechat_js_process_remove (struct t_plugin_script *script,
+                                      void *pointer);
+extern void weechat_js_process_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_PROCESS_H_ */
@@ -0,0 +1,377 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-profile.h"
+
+/* script name -> hashtable (function -> stats) */
+struct t_hashtable *js_profile_scripts = NULL;
+
+/*
+ * Initializes profiler.
+ */
+
+void
+weechat_js_profile_init ()
+{
+    js_profile_scripts = weechat_hashtable_new(32,
+                                               WEECHAT_HASHTABLE_STRING,
+                                               WEECHAT_HASHTABLE_POINTER,
+                                               NULL, NULL);
+}
+
+/*
+ * Returns monotonic time in nanoseconds.
+ */
+
+unsigned long long
+weechat_js_profile_now ()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ * Adds a call (started at "start") to stats of a script function.
+ */
+
+void
+weechat_js_profile_add (const char *script_name, const char *function,
+                        unsigned long long start)
+{
+    struct t_hashtable *functions;
+    struct t_js_profile_stats *stats;
+    unsigned long long duration, usec;
+    int bucket;
+
+    if (!js_profile_scripts || !script_name || !function)
+        return;
+
+    duration = weechat_js_profile_now() - start;
+
+    functions = (struct t_hashtable *) weechat_hashtable_get(js_profile_scripts,
+                                                             script_name);
+    if (!functions)
+    {
+        functions = weechat_hashtable_new(32,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          WEECHAT_HASHTABLE_POINTER,
+                                          NULL, NULL);
+        if (!functions)
+            return;
+        weechat_hashtable_set(js_profile_scripts, script_name, functions);
+    }
+
+    stats = (struct t_js_profile_stats *) weechat_hashtable_get(functions,
+                                                                function);
+    if (!stats)
+    {
+        stats = (struct t_js_profile_stats *) calloc(1, sizeof(*stats));
+        if (!stats)
+            return;
+        stats->script_name = strdup(script_name);
+        stats->function = strdup(function);
+        weechat_hashtable_set(functions, function, stats);
+    }
+
+    stats->count++;
+    stats->total_ns += duration;
+    if (duration > stats->max_ns)
+        stats->max_ns = duration;
+
+    /* bucket is number of bits of duration in microseconds */
+    usec = duration / 1000;
+    bucket = 0;
+    while (usec && (bucket < JS_PROFILE_HISTOGRAM_SIZE - 1))
+    {
+        usec >>= 1;
+        bucket++;
+    }
+    stats->histogram[bucket]++;
+}
+
+/*
+ * Callback used to free stats of functions.
+ */
+
+static void
+weechat_js_profile_free_stats_cb (void *data, struct t_hashtable *hashtable,
+                                  const void *key, const void *value)
+{
+    struct t_js_profile_stats *stats;
+
+    stats = (struct t_js_profile_stats *) value;
+
+    free(stats->script_name);
+    free(stats->function);
+    free(stats);
+}
+
+/*
+ * Callback used to free stats of scripts.
+ */
+
+static void
+weechat_js_profile_free_script_cb (void *data, struct t_hashtable *hashtable,
+                                   const void *key, const void *value)
+{
+    struct t_hashtable *functions;
+
+    functions = (struct t_hashtable *) value;
+
+    weechat_hashtable_map(functions, &weechat_js_profile_free_stats_cb, NULL);
+    weechat_hashtable_free(functions);
+}
+
+/*
+ * Resets all stats.
+ */
+
+void
+weechat_js_profile_reset ()
+{
+    if (!js_profile_scripts)
+        return;
+
+    weechat_hashtable_map(js_profile_scripts,
+                          &weechat_js_profile_free_script_cb, NULL);
+    weechat_hashtable_remove_all(js_profile_scripts);
+}
+
+struct t_js_profile_list
+{
+    struct t_js_profile_stats **stats;       /* array of stats              */
+    int count;                               /* number of stats in array    */
+    int size;                                /* allocated size of array     */
+};
+
+/*
+ * Callback used to add stats of a function in a list.
+ */
+
+static void
+weechat_js_profile_list_stats_cb (void *data, struct t_hashtable *hashtable,
+                                  const void *key, const void *value)
+{
+    struct t_js_profile_list *list;
+    struct t_js_profile_stats **new_stats;
+
+    list = (struct t_js_profile_list *) data;
+
+    if (list->count == list->size)
+    {
+        new_stats = (struct t_js_profile_stats **) realloc(list->stats,
+                                                           (list->size + 64) * sizeof(*new_stats));
+        if (!new_stats)
+            return;
+        list->stats = new_stats;
+        list->size += 64;
+    }
+    list->stats[list->count++] = (struct t_js_profile_stats *) value;
+}
+
+/*
+ * Callback used to add stats of a script in a list.
+ */
+
+static void
+weechat_js_profile_list_script_cb (void *data, struct t_hashtable *hashtable,
+                                   const void *key, const void *value)
+{
+    weechat_hashtable_map((struct t_hashtable *) value,
+                          &weechat_js_profile_list_stats_cb, data);
+}
+
+/*
+ * Compares two stats by total time (descending), for qsort.
+ */
+
+static int
+weechat_js_profile_compare (const void *p1, const void *p2)
+{
+    const struct t_js_profile_stats *stats1, *stats2;
+
+    stats1 = *((const struct t_js_profile_stats **) p1);
+    stats2 = *((const struct t_js_profile_stats **) p2);
+
+    if (stats1->total_ns > stats2->total_ns)
+        return -1;
+    if (stats1->total_ns < stats2->total_ns)
+        return 1;
+    return 0;
+}
+
+/*
+ * Builds list of all stats, sorted by total time.
+ *
+ * Note: list->stats must be freed after use.
+ */
+
+static void
+weechat_js_profile_list (struct t_js_profile_list *list)
+{
+    list->stats = NULL;
+    list->count = 0;
+    list->size = 0;
+
+    if (!js_profile_scripts)
+        return;
+
+    weechat_hashtable_map(js_profile_scripts,
+                          &weechat_js_profile_list_script_cb, list);
+    if (list->count > 1)
+    {
+        qsort(list->stats, list->count, sizeof(*list->stats),
+              &weechat_js_profile_compare);
+    }
+}
+
+/*
+ * Returns approximate percentile (upper bound of histogram bucket, in
+ * microseconds).
+ */
+
+static unsigned long long
+weechat_js_profile_percentile (struct t_js_profile_stats *stats,
+                               int percent)
+{
+    unsigned long long limit, sum;
+    int i;
+
+    limit = (stats->count * percent + 99) / 100;
+    sum = 0;
+    for (i = 0; i < JS_PROFILE_HISTOGRAM_SIZE; i++)
+    {
+        sum += stats->histogram[i];
+        if (sum >= limit)
+            return 1ULL << i;
+    }
+
+    return 1ULL << (JS_PROFILE_HISTOGRAM_SIZE - 1);
+}
+
+/*
+ * Displays functions with most time spent.
+ */
+
+void
+weechat_js_profile_display_top (int count)
+{
+    struct t_js_profile_list list;
+    struct t_js_profile_stats *stats;
+    int i;
+
+    weechat_js_profile_list(&list);
+
+    weechat_printf(NULL, "");
+    if (list.count == 0)
+    {
+        weechat_printf(NULL, weechat_gettext("%s: no callback called"),
+                       JS_PLUGIN_NAME);
+        return;
+    }
+
+    weechat_printf(NULL,
+                   weechat_gettext("%s callbacks (top %d by total time):"),
+                   JS_PLUGIN_NAME, count);
+    weechat_printf(NULL,
+                   "  %-16s %-24s %10s %12s %10s %10s %10s",
+                   "script", "function", "calls", "total ms", "mean us",
+                   "p99 us", "max us");
+    for (i = 0; (i < list.count) && (i < count); i++)
+    {
+        stats = list.stats[i];
+        weechat_printf(NULL,
+                       "  %-16s %-24s %10llu %12.3f %10llu %10llu %10llu",
+                       stats->script_name, stats->function,
+                       stats->count,
+                       (double) stats->total_ns / 1000000.0,
+                       (stats->total_ns / stats->count) / 1000,
+                       weechat_js_profile_percentile(stats, 99),
+                       stats->max_ns / 1000);
+    }
+
+    free(list.stats);
+}
+
+/*
+ * Returns infolist "js_callback_stats" (arguments: optional script name).
+ */
+
+struct t_infolist *
+weechat_js_profile_infolist (const char *arguments)
+{
+    struct t_infolist *infolist;
+    struct t_infolist_item *item;
+    struct t_js_profile_list list;
+    struct t_js_profile_stats *stats;
+    char value[64], name[32];
+    int i, j;
+
+    infolist = weechat_infolist_new();
+    if (!infolist)
+        return NULL;
+
+    weechat_js_profile_list(&list);
+
+    for (i = 0; i < list.count; i++)
+    {
+        stats = list.stats[i];
+        if (arguments && arguments[0]
+            && (strcmp(arguments, stats->script_name) != 0))
+            continue;
+
+        item = weechat_infolist_new_item(infolist);
+        if (!item)
+            break;
+        weechat_infolist_new_var_string(item, "script", stats->script_name);
+        weechat_infolist_new_var_string(item, "function", stats->function);
+        snprintf(value, sizeof(value), "%llu", stats->count);
+        weechat_infolist_new_var_string(item, "count", value);
+        snprintf(value, sizeof(value), "%llu", stats->total_ns / 1000);
+        weechat_infolist_new_var_string(item, "total_us", value);
+        snprintf(value, sizeof(value), "%llu",
+                 (stats->total_ns / stats->count) / 1000);
+        weechat_infolist_new_var_string(item, "mean_us", value);
+        snprintf(value, sizeof(value), "%llu", stats->max_ns / 1000);
+        weechat_infolist_new_var_string(item, "max_us", value);
+        /* histogram_N: calls with duration < 2^N us (last: all others) */
+        for (j = 0; j < JS_PROFILE_HISTOGRAM_SIZE; j++)
+        {
+            snprintf(name, sizeof(name), "histogram_%d", j);
+            snprintf(value, sizeof(value), "%llu", stats->histogram[j]);
+            weechat_infolist_new_var_string(item, name, value);
+        }
+    }
+
+    free(list.stats);
+
+    return infolist;
+}
+
+/*
+ * Frees all stats.
+ */
+
+void
+weechat_js_profile_end ()
+{
+    if (js_profile_scripts)
+    {
+        weechat_js_profile_reset();
+        weechat_hashtable_free(js_profile_scripts);
+        js_profile_scripts = NULL;
+    }
+}
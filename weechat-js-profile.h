@@ -0,0 +1,34 @@
+#ifndef __WEECHAT_JS_PROFILE_H_
+#define __WEECHAT_JS_PROFILE_H_
+
+/*
+ * Latency profiler: each entry into js (script load, callbacks, timers,
+ * microtasks) is timed with the monotonic clock, and counted per script
+ * and function. All entries into js are on main thread, so no lock is
+ * needed.
+ */
+
+#define JS_PROFILE_HISTOGRAM_SIZE 24         /* < 1us, < 2us, ..., >= 4s    */
+#define JS_PROFILE_TOP_DEFAULT 10
+
+struct t_js_profile_stats
+{
+    char *script_name;                       /* name of script              */
+    char *function;                          /* js function                 */
+    unsigned long long count;                /* number of calls             */
+    unsigned long long total_ns;             /* total time (nanoseconds)    */
+    unsigned long long max_ns;               /* max time (nanoseconds)      */
+    unsigned long long histogram[JS_PROFILE_HISTOGRAM_SIZE]; /* log2(us)    */
+};
+
+extern void weechat_js_profile_init (void);
+extern void weechat_js_profile_end (void);
+extern unsigned long long weechat_js_profile_now (void);
+extern void weechat_js_profile_add (const char *script_name,
+                                    const char *function,
+                                    unsigned long long start);
+extern void weechat_js_profile_reset (void);
+extern void weechat_js_profile_display_top (int count);
+extern struct t_infolist *weechat_js_profile_infolist (const char *arguments);
+
+#endif /* __WEECHAT_JS_PROFILE_H_ */
@@ -0,0 +1,366 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-signal.h"
+
+using namespace v8;
+
+struct t_hashtable *js_signal_routes = NULL;   /* signal -> route          */
+struct t_hashtable *js_signal_handlers = NULL; /* script_cb -> handler     */
+
+/*
+ * Creates tables used by signal router.
+ */
+
+void
+weechat_js_signal_init ()
+{
+    js_signal_routes = weechat_hashtable_new(32,
+                                             WEECHAT_HASHTABLE_STRING,
+                                             WEECHAT_HASHTABLE_POINTER,
+                                             NULL, NULL);
+    js_signal_handlers = weechat_hashtable_new(32,
+                                               WEECHAT_HASHTABLE_POINTER,
+                                               WEECHAT_HASHTABLE_POINTER,
+                                               NULL, NULL);
+}
+
+/*
+ * Frees a route and its WeeChat hook.
+ */
+
+static void
+weechat_js_signal_route_free (struct t_js_signal_route *route)
+{
+    struct t_js_signal_handler *ptr_handler, *next_handler;
+
+    ptr_handler = route->handlers;
+    while (ptr_handler)
+    {
+        next_handler = ptr_handler->next_handler;
+        if (ptr_handler->script_cb)
+            weechat_hashtable_remove(js_signal_handlers, ptr_handler->script_cb);
+        free(ptr_handler);
+        ptr_handler = next_handler;
+    }
+
+    if (route->hook)
+        weechat_unhook(route->hook);
+    weechat_hashtable_remove(js_signal_routes, route->signal);
+    free(route->signal);
+    free(route);
+}
+
+/*
+ * Frees handlers removed during a dispatch, and the route itself if no
+ * handler remains.
+ */
+
+static void
+weechat_js_signal_route_purge (struct t_js_signal_route *route)
+{
+    struct t_js_signal_handler *ptr_handler, *next_handler;
+
+    if (route->dispatching > 0)
+        return;
+
+    if (route->count == 0)
+    {
+        weechat_js_signal_route_free(route);
+        return;
+    }
+
+    ptr_handler = route->handlers;
+    while (ptr_handler)
+    {
+        next_handler = ptr_handler->next_handler;
+        if (ptr_handler->deleted)
+        {
+            if (ptr_handler->prev_handler)
+                (ptr_handler->prev_handler)->next_handler = ptr_handler->next_handler;
+            if (ptr_handler->next_handler)
+                (ptr_handler->next_handler)->prev_handler = ptr_handler->prev_handler;
+            if (route->handlers == ptr_handler)
+                route->handlers = ptr_handler->next_handler;
+            if (route->last_handler == ptr_handler)
+                route->last_handler = ptr_handler->prev_handler;
+            free(ptr_handler);
+        }
+        ptr_handler = next_handler;
+    }
+}
+
+/*
+ * Converts signal data to a JS value.
+ */
+
+static Handle<Value>
+weechat_js_signal_data_to_value (const char *type_data, void *signal_data)
+{
+    char value_str[64], *str_ptr;
+    Handle<Value> value;
+
+    if (strcmp(type_data, WEECHAT_HOOK_SIGNAL_STRING) == 0)
+        return String::New((signal_data) ? (const char *) signal_data : "");
+
+    if (strcmp(type_data, WEECHAT_HOOK_SIGNAL_INT) == 0)
+    {
+        snprintf(value_str, sizeof(value_str), "%d",
+                 (signal_data) ? *((int *) signal_data) : 0);
+        return String::New(value_str);
+    }
+
+    if (strcmp(type_data, WEECHAT_HOOK_SIGNAL_POINTER) == 0)
+    {
+        str_ptr = plugin_script_ptr2str(signal_data);
+        value = String::New((str_ptr) ? str_ptr : "");
+        if (str_ptr)
+            free(str_ptr);
+        return value;
+    }
+
+    return String::New("");
+}
+
+/*
+ * Callback for the WeeChat hook of a route: dispatches signal to handlers.
+ *
+ * Signal name and data are converted only once for all handlers.
+ */
+
+static int
+weechat_js_signal_route_cb (void *data, const char *signal,
+                            const char *type_data, void *signal_data)
+{
+    HandleScope scope;
+    struct t_js_signal_route *route;
+    struct t_js_signal_handler *ptr_handler, *last_handler;
+    Handle<Value> argv[4], ret_js;
+    int rc;
+
+    route = (struct t_js_signal_route *) data;
+    if (!route || !route->handlers)
+        return WEECHAT_RC_OK;
+
+    argv[1] = String::New((signal) ? signal : "");
+    argv[2] = String::New((type_data) ? type_data : "");
+    argv[3] = weechat_js_signal_data_to_value((type_data) ? type_data : "",
+                                              signal_data);
+
+    rc = WEECHAT_RC_OK;
+    route->dispatching++;
+
+    /* handlers added during this dispatch are not called */
+    last_handler = route->last_handler;
+    for (ptr_handler = route->handlers; ptr_handler;
+         ptr_handler = ptr_handler->next_handler)
+    {
+        if (!ptr_handler->deleted)
+        {
+            argv[0] = String::New((ptr_handler->script_cb->data) ?
+                                  ptr_handler->script_cb->data : "");
+            ret_js = weechat_js_exec_function(ptr_handler->script,
+                                              ptr_handler->script_cb->function,
+                                              4, argv, "signal");
+            if (!ret_js.IsEmpty() && ret_js->IsNumber()
+                && (ret_js->Int32Value() == WEECHAT_RC_OK_EAT))
+            {
+                rc = WEECHAT_RC_OK_EAT;
+                break;
+            }
+        }
+        if (ptr_handler == last_handler)
+            break;
+    }
+
+    route->dispatching--;
+    weechat_js_signal_route_purge(route);
+
+    return rc;
+}
+
+/*
+ * Subscribes a script function to a signal.
+ *
+ * Returns the script callback, used as identifier for unhook.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_signal_hook (struct t_plugin_script *script,
+                        const char *signal,
+                        const char *function,
+                        const char *data)
+{
+    struct t_js_signal_route *route;
+    struct t_js_signal_handler *new_handler;
+    struct t_plugin_script_cb *new_script_cb;
+
+    if (!script || !signal || !signal[0] || !function || !function[0])
+        return NULL;
+
+    route = (struct t_js_signal_route *) weechat_hashtable_get(js_signal_routes,
+                                                               signal);
+    if (!route)
+    {
+        route = (struct t_js_signal_route *) malloc(sizeof(*route));
+        if (!route)
+            return NULL;
+        route->signal = strdup(signal);
+        route->count = 0;
+        route->dispatching = 0;
+        route->handlers = NULL;
+        route->last_handler = NULL;
+        route->hook = weechat_hook_signal(signal,
+                                          &weechat_js_signal_route_cb,
+                                          route);
+        if (!route->hook)
+        {
+            free(route->signal);
+            free(route);
+            return NULL;
+        }
+        weechat_hashtable_set(js_signal_routes, route->signal, route);
+    }
+
+    new_handler = (struct t_js_signal_handler *) malloc(sizeof(*new_handler));
+    if (!new_handler)
+    {
+        weechat_js_signal_route_purge(route);
+        return NULL;
+    }
+
+    new_script_cb = plugin_script_callback_add(script, function, data);
+    if (!new_script_cb)
+    {
+        free(new_handler);
+        weechat_js_signal_route_purge(route);
+        return NULL;
+    }
+
+    new_handler->script = script;
+    new_handler->script_cb = new_script_cb;
+    new_handler->route = route;
+    new_handler->deleted = 0;
+    new_handler->prev_handler = route->last_handler;
+    new_handler->next_handler = NULL;
+    if (route->handlers)
+        (route->last_handler)->next_handler = new_handler;
+    else
+        route->handlers = new_handler;
+    route->last_handler = new_handler;
+    route->count++;
+
+    weechat_hashtable_set(js_signal_handlers, new_script_cb, new_handler);
+
+    return new_script_cb;
+}
+
+/*
+ * Removes a handler from its route.
+ */
+
+static void
+weechat_js_signal_handler_remove (struct t_js_signal_handler *handler)
+{
+    struct t_js_signal_route *route;
+
+    route = handler->route;
+
+    weechat_hashtable_remove(js_signal_handlers, handler->script_cb);
+    plugin_script_callback_remove(handler->script, handler->script_cb);
+    handler->script_cb = NULL;
+    handler->deleted = 1;
+    route->count--;
+
+    weechat_js_signal_route_purge(route);
+}
+
+/*
+ * Unsubscribes a handler.
+ *
+ * Returns 1 if pointer was a signal handler of script, 0 otherwise.
+ */
+
+int
+weechat_js_signal_unhook (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_signal_handler *ptr_handler;
+
+    if (!pointer)
+        return 0;
+
+    ptr_handler = (struct t_js_signal_handler *) weechat_hashtable_get(js_signal_handlers,
+                                                                       pointer);
+    if (!ptr_handler || (ptr_handler->script != script))
+        return 0;
+
+    weechat_js_signal_handler_remove(ptr_handler);
+
+    return 1;
+}
+
+/*
+ * Removes all handlers of a script.
+ */
+
+void
+weechat_js_signal_remove_script (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+    struct t_js_signal_handler *ptr_handler;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        ptr_handler = (struct t_js_signal_handler *) weechat_hashtable_get(js_signal_handlers,
+                                                                           ptr_script_cb);
+        if (ptr_handler)
+            weechat_js_signal_handler_remove(ptr_handler);
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Callback used to free all routes.
+ */
+
+static void
+weechat_js_signal_free_route_cb (void *data, struct t_hashtable *hashtable,
+                                 const void *key, const void *value)
+{
+    weechat_js_signal_route_free((struct t_js_signal_route *) value);
+}
+
+/*
+ * Frees all routes and tables used by signal router.
+ */
+
+void
+weechat_js_signal_end ()
+{
+    if (js_signal_routes)
+    {
+        weechat_hashtable_map(js_signal_routes,
+                              &weechat_js_signal_free_route_cb, NULL);
+        weechat_hashtable_free(js_signal_routes);
+        js_signal_routes = NULL;
+    }
+    if (js_signal_handlers)
+    {
+        weechat_hashtable_free(js_signal_handlers);
+        js_signal_handlers = NULL;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef __WEECHAT_JS_SIGNAL_H_
+#define __WEECHAT_JS_SIGNAL_H_
+
+/*
+ * Signal router: a single WeeChat hook is created per signal (or mask), and
+ * signals are dispatched to all js handlers subscribed to it.
+ */
+
+struct t_js_signal_route;
+
+struct t_js_signal_handler
+{
+    struct t_plugin_script *script;          /* script owning the handler   */
+    struct t_plugin_script_cb *script_cb;    /* function/data called        */
+    struct t_js_signal_route *route;         /* route of handler            */
+    int deleted;                             /* unhooked during a dispatch  */
+    struct t_js_signal_handler *prev_handler; /* link to previous handler   */
+    struct t_js_signal_handler *next_handler; /* link to next handler       */
+};
+
+struct t_js_signal_route
+{
+    char *signal;                            /* signal (or mask) hooked     */
+    struct t_hook *hook;                     /* WeeChat hook for the signal */
+    int count;                               /* number of live handlers     */
+    int dispatching;                         /* > 0 when running handlers   */
+    struct t_js_signal_handler *handlers;    /* handlers subscribed         */
+    struct t_js_signal_handler *last_handler; /* last handler               */
+};
+
+extern void weechat_js_signal_init (void);
+extern void weechat_js_signal_end (void);
+extern struct t_plugin_script_cb *weechat_js_signal_hook (struct t_plugin_script *script,
+                                                          const char *signal,
+                                                          const char *function,
+                                                          const char *data);
+extern int weechat_js_signal_unhook (struct t_plugin_script *script,
+                                     void *pointer);
+extern void weechat_js_signal_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_SIGNAL_H_ */
@@ -0,0 +1,249 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <v8.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-profile.h"
+#include "weechat-js-slowlog.h"
+
+using namespace v8;
+
+unsigned long long js_slowlog_threshold = 0;      /* ns, 0 = disabled      */
+struct t_js_slowlog_frame *js_slowlog_frame = NULL; /* innermost callback  */
+struct t_hook *js_slowlog_config_hook = NULL;     /* hook on option        */
+
+time_t js_slowlog_window_start = 0;               /* start of interval     */
+int js_slowlog_window_count = 0;                  /* messages in interval  */
+int js_slowlog_suppressed = 0;                    /* messages not logged   */
+
+/*
+ * Reads threshold in plugin options.
+ */
+
+static void
+weechat_js_slowlog_read_threshold ()
+{
+    const char *value;
+    char *error;
+    long number;
+
+    number = atol(JS_SLOWLOG_THRESHOLD_DEFAULT);
+
+    value = weechat_config_get_plugin("slow_callback_ms");
+    if (value && value[0])
+    {
+        error = NULL;
+        number = strtol(value, &error, 10);
+        if (!error || error[0] || (number < 0))
+            number = atol(JS_SLOWLOG_THRESHOLD_DEFAULT);
+    }
+
+    js_slowlog_threshold = (unsigned long long) number * 1000000ULL;
+}
+
+/*
+ * Callback called when threshold option is changed.
+ */
+
+static int
+weechat_js_slowlog_config_cb (void *data, const char *option,
+                              const char *value)
+{
+    weechat_js_slowlog_read_threshold();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes slow callback log and its option.
+ */
+
+void
+weechat_js_slowlog_init ()
+{
+    if (!weechat_config_is_set_plugin("slow_callback_ms"))
+    {
+        weechat_config_set_plugin("slow_callback_ms",
+                                  JS_SLOWLOG_THRESHOLD_DEFAULT);
+    }
+    weechat_config_set_desc_plugin("slow_callback_ms",
+                                   "log js callbacks running longer than this "
+                                   "time (in milliseconds) on core buffer, "
+                                   "with the js stack, 0 = disable");
+    weechat_js_slowlog_read_threshold();
+
+    js_slowlog_config_hook = weechat_hook_config("plugins.var."
+                                                 JS_PLUGIN_NAME
+                                                 ".slow_callback_ms",
+                                                 &weechat_js_slowlog_config_cb,
+                                                 NULL);
+}
+
+/*
+ * Starts timing of a callback (frame is on stack of caller).
+ */
+
+void
+weechat_js_slowlog_enter (struct t_js_slowlog_frame *frame,
+                          unsigned long long start)
+{
+    frame->start = start;
+    frame->stack = NULL;
+    frame->prev_frame = js_slowlog_frame;
+    js_slowlog_frame = frame;
+}
+
+/*
+ * Captures js stack if current callback is already slow (called by each
+ * call to weechat API).
+ */
+
+void
+weechat_js_slowlog_check ()
+{
+    HandleScope scope;
+    Local<StackTrace> stack_trace;
+    Local<StackFrame> stack_frame;
+    std::string stack;
+    char line[32];
+    int i;
+
+    if (!js_slowlog_frame || js_slowlog_frame->stack
+        || (js_slowlog_threshold == 0)
+        || (weechat_js_profile_now() - js_slowlog_frame->start
+            < js_slowlog_threshold))
+        return;
+
+    stack_trace = StackTrace::CurrentStackTrace(JS_SLOWLOG_STACK_FRAMES,
+                                                StackTrace::kOverview);
+    if (stack_trace.IsEmpty())
+        return;
+
+    for (i = 0; i < stack_trace->GetFrameCount(); i++)
+    {
+        stack_frame = stack_trace->GetFrame(i);
+        String::Utf8Value function_name(stack_frame->GetFunctionName());
+        String::Utf8Value script_name(stack_frame->GetScriptName());
+        snprintf(line, sizeof(line), ":%d:%d",
+                 stack_frame->GetLineNumber(), stack_frame->GetColumn());
+        if (i > 0)
+            stack += "\n";
+        stack += "    at ";
+        stack += (*function_name && (*function_name)[0]) ?
+            *function_name : "(anonymous)";
+        stack += " (";
+        stack += (*script_name) ? *script_name : "?";
+        stack += line;
+        stack += ")";
+    }
+
+    js_slowlog_frame->stack = strdup(stack.c_str());
+}
+
+/*
+ * Checks if a message can be logged (max JS_SLOWLOG_BURST messages every
+ * JS_SLOWLOG_INTERVAL seconds).
+ *
+ * Returns 1 if message can be logged, 0 if it must be dropped.
+ */
+
+static int
+weechat_js_slowlog_allowed ()
+{
+    time_t now;
+
+    now = time(NULL);
+    if (now - js_slowlog_window_start >= JS_SLOWLOG_INTERVAL)
+    {
+        js_slowlog_window_start = now;
+        js_slowlog_window_count = 0;
+    }
+
+    if (js_slowlog_window_count >= JS_SLOWLOG_BURST)
+    {
+        js_slowlog_suppressed++;
+        return 0;
+    }
+
+    js_slowlog_window_count++;
+
+    return 1;
+}
+
+/*
+ * Ends timing of a callback, and logs it if it was too long.
+ */
+
+void
+weechat_js_slowlog_leave (struct t_js_slowlog_frame *frame,
+                          const char *script_name, const char *function,
+                          const char *hook_type)
+{
+    unsigned long long duration;
+
+    js_slowlog_frame = frame->prev_frame;
+
+    if (js_slowlog_threshold == 0)
+        goto end;
+
+    duration = weechat_js_profile_now() - frame->start;
+    if ((duration < js_slowlog_threshold) || !weechat_js_slowlog_allowed())
+        goto end;
+
+    if (js_slowlog_suppressed > 0)
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: %d slow callbacks not logged"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME,
+                       js_slowlog_suppressed);
+        js_slowlog_suppressed = 0;
+    }
+    weechat_printf(NULL,
+                   weechat_gettext("%s%s: slow callback: script \"%s\", "
+                                   "function \"%s\" (%s): %.1f ms"),
+                   weechat_prefix("error"), JS_PLUGIN_NAME,
+                   script_name, function,
+                   (hook_type) ? hook_type : "callback",
+                   (double) duration / 1000000.0);
+    if (frame->stack)
+    {
+        weechat_printf(NULL, "%s", frame->stack);
+    }
+    else
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("    (no stack: no API call after "
+                                       "%llu ms)"),
+                       js_slowlog_threshold / 1000000ULL);
+    }
+
+end:
+    if (frame->stack)
+        free(frame->stack);
+}
+
+/*
+ * Ends slow callback log.
+ */
+
+void
+weechat_js_slowlog_end ()
+{
+    if (js_slowlog_config_hook)
+    {
+        weechat_unhook(js_slowlog_config_hook);
+        js_slowlog_config_hook = NULL;
+    }
+    js_slowlog_frame = NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef __WEECHAT_JS_SLOWLOG_H_
+#define __WEECHAT_JS_SLOWLOG_H_
+
+/*
+ * Log of slow callbacks: when a callback runs longer than option
+ * "slow_callback_ms", it is logged on core buffer with the js stack.
+ * The stack can not be read after the callback has returned, so it is
+ * captured by the first call to weechat API made once the threshold is
+ * exceeded (ie where script was still running while being slow).
+ */
+
+#define JS_SLOWLOG_THRESHOLD_DEFAULT "100"
+#define JS_SLOWLOG_STACK_FRAMES 8            /* max frames in stack trace   */
+#define JS_SLOWLOG_BURST 5                   /* max messages per interval   */
+#define JS_SLOWLOG_INTERVAL 60               /* interval for burst (secs)   */
+
+struct t_js_slowlog_frame
+{
+    unsigned long long start;                /* start of callback (ns)      */
+    char *stack;                             /* stack captured (or NULL)    */
+    struct t_js_slowlog_frame *prev_frame;   /* frame of outer callback     */
+};
+
+extern unsigned long long js_slowlog_threshold;
+extern struct t_js_slowlog_frame *js_slowlog_frame;
+
+extern void weechat_js_slowlog_init (void);
+extern void weechat_js_slowlog_end (void);
+extern void weechat_js_slowlog_enter (struct t_js_slowlog_frame *frame,
+                                      unsigned long long start);
+extern void weechat_js_slowlog_leave (struct t_js_slowlog_frame *frame,
+                                      const char *script_name,
+                                      const char *function,
+                                      const char *hook_type);
+extern void weechat_js_slowlog_check (void);
+
+#endif /* __WEECHAT_JS_SLOWLOG_H_ */
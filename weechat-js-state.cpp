@@ -0,0 +1,294 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <v8.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-state.h"
+
+using namespace v8;
+
+/* script filename -> state (JSON) */
+struct t_hashtable *js_state = NULL;
+struct t_hook *js_state_upgrade_hook = NULL;
+
+static int weechat_js_state_upgrade_cb (void *data, const char *signal,
+                                        const char *type_data,
+                                        void *signal_data);
+
+/*
+ * Initializes states of scripts.
+ */
+
+void
+weechat_js_state_init ()
+{
+    js_state = weechat_hashtable_new(16,
+                                     WEECHAT_HASHTABLE_STRING,
+                                     WEECHAT_HASHTABLE_STRING,
+                                     NULL, NULL);
+    js_state_upgrade_hook = weechat_hook_signal("upgrade",
+                                                &weechat_js_state_upgrade_cb,
+                                                NULL);
+}
+
+/*
+ * Sets state of a script file (NULL removes state).
+ */
+
+void
+weechat_js_state_set (const char *filename, const char *state)
+{
+    if (!js_state || !filename)
+        return;
+
+    if (state)
+        weechat_hashtable_set(js_state, filename, state);
+    else
+        weechat_hashtable_remove(js_state, filename);
+}
+
+/*
+ * Returns state of a script file, NULL if not set.
+ */
+
+const char *
+weechat_js_state_get (const char *filename)
+{
+    if (!js_state || !filename)
+        return NULL;
+
+    return (const char *) weechat_hashtable_get(js_state, filename);
+}
+
+/*
+ * Calls function "onUnload" of a script and keeps the value returned, for
+ * next load of script file.
+ *
+ * Returns:
+ *   1: state saved
+ *   0: no state (function not defined, or value can not be serialized)
+ */
+
+int
+weechat_js_state_save (struct t_plugin_script *script)
+{
+    HandleScope scope;
+    WeechatJsCore *core;
+    Handle<Value> value;
+    char *state;
+
+    if (!js_state || !script || !script->interpreter)
+        return 0;
+
+    core = (WeechatJsCore *) script->interpreter;
+    if (!core->functionExists(JS_STATE_FUNC_SAVE))
+        return 0;
+
+    value = weechat_js_exec_function(script, JS_STATE_FUNC_SAVE, 0, NULL,
+                                     "reload");
+    state = core->toJSON(value);
+    if (!state)
+        return 0;
+
+    weechat_js_state_set(script->filename, state);
+    free(state);
+
+    return 1;
+}
+
+/*
+ * Gives state saved for file of script to function "onLoad" of script (state
+ * is removed, even if function is not defined).
+ */
+
+void
+weechat_js_state_restore (struct t_plugin_script *script)
+{
+    HandleScope scope;
+    WeechatJsCore *core;
+    const char *state;
+    Handle<Value> argv[1];
+
+    if (!js_state || !script || !script->interpreter)
+        return;
+
+    state = weechat_js_state_get(script->filename);
+    if (!state)
+        return;
+
+    core = (WeechatJsCore *) script->interpreter;
+    if (core->functionExists(JS_STATE_FUNC_RESTORE))
+    {
+        argv[0] = core->fromJSON(state);
+        if (!argv[0].IsEmpty())
+        {
+            weechat_js_exec_function(script, JS_STATE_FUNC_RESTORE, 1, argv,
+                                     "reload");
+        }
+    }
+
+    weechat_js_state_set(script->filename, NULL);
+}
+
+/*
+ * Adds a state in infolist (callback of hashtable_map_string).
+ */
+
+static void
+weechat_js_state_upgrade_add_cb (void *data, struct t_hashtable *hashtable,
+                                 const char *key, const char *value)
+{
+    struct t_infolist_item *ptr_item;
+
+    ptr_item = weechat_infolist_new_item((struct t_infolist *) data);
+    if (!ptr_item)
+        return;
+
+    weechat_infolist_new_var_string(ptr_item, "filename", key);
+    weechat_infolist_new_var_buffer(ptr_item, "state", (void *) value,
+                                    strlen(value) + 1);
+}
+
+/*
+ * Saves states of scripts in upgrade file (callback of signal "upgrade"):
+ * function "onUnload" of each script is called, like for a reload.
+ */
+
+static int
+weechat_js_state_upgrade_cb (void *data, const char *signal,
+                             const char *type_data, void *signal_data)
+{
+    struct t_plugin_script *ptr_script;
+    struct t_upgrade_file *upgrade_file;
+    struct t_infolist *infolist;
+    int rc;
+
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        weechat_js_state_save(ptr_script);
+    }
+
+    if (weechat_hashtable_get_integer(js_state, "items_count") == 0)
+        return WEECHAT_RC_OK;
+
+    upgrade_file = weechat_upgrade_new(JS_UPGRADE_FILENAME, 1);
+    if (!upgrade_file)
+        return WEECHAT_RC_OK;
+
+    rc = 0;
+    infolist = weechat_infolist_new();
+    if (infolist)
+    {
+        weechat_hashtable_map_string(js_state,
+                                     &weechat_js_state_upgrade_add_cb,
+                                     infolist);
+        rc = weechat_upgrade_write_object(upgrade_file,
+                                          JS_UPGRADE_TYPE_STATE, infolist);
+        weechat_infolist_free(infolist);
+    }
+    weechat_upgrade_close(upgrade_file);
+
+    if (!rc)
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: unable to save state of "
+                                       "scripts in upgrade file"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Reads an object of upgrade file.
+ */
+
+static int
+weechat_js_state_upgrade_read_cb (void *data,
+                                  struct t_upgrade_file *upgrade_file,
+                                  int object_id,
+                                  struct t_infolist *infolist)
+{
+    const char *filename;
+    char *state;
+    void *buffer;
+    int size;
+
+    if (object_id != JS_UPGRADE_TYPE_STATE)
+        return WEECHAT_RC_OK;
+
+    weechat_infolist_reset_item_cursor(infolist);
+    while (weechat_infolist_next(infolist))
+    {
+        filename = weechat_infolist_string(infolist, "filename");
+        buffer = weechat_infolist_buffer(infolist, "state", &size);
+        if (!filename || !buffer || (size <= 0))
+            continue;
+        state = (char *) malloc(size + 1);
+        if (!state)
+            continue;
+        memcpy(state, buffer, size);
+        state[size] = '\0';
+        weechat_js_state_set(filename, state);
+        free(state);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Reads states of scripts saved in upgrade file (must be called before
+ * scripts are loaded).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+weechat_js_state_upgrade_load ()
+{
+    struct t_upgrade_file *upgrade_file;
+    int rc;
+
+    upgrade_file = weechat_upgrade_new(JS_UPGRADE_FILENAME, 0);
+    if (!upgrade_file)
+        return 0;
+
+    rc = weechat_upgrade_read(upgrade_file,
+                              &weechat_js_state_upgrade_read_cb, NULL);
+    weechat_upgrade_close(upgrade_file);
+
+    return rc;
+}
+
+/*
+ * Ends states of scripts.
+ */
+
+void
+weechat_js_state_end ()
+{
+    if (js_state_upgrade_hook)
+    {
+        weechat_unhook(js_state_upgrade_hook);
+        js_state_upgrade_hook = NULL;
+    }
+    if (js_state)
+    {
+        weechat_hashtable_free(js_state);
+        js_state = NULL;
+    }
+}
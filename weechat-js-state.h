@@ -0,0 +1,31 @@
+#ifndef __WEECHAT_JS_STATE_H_
+#define __WEECHAT_JS_STATE_H_
+
+/*
+ * State kept across reload of a script (opt-in): before unload, the value
+ * returned by function "onUnload" of script is serialized (JSON) and kept
+ * in plugin memory, by script filename; when the file is loaded again, the
+ * value is given to function "onLoad" of the new script.
+ */
+
+#define JS_STATE_FUNC_SAVE    "onUnload"
+#define JS_STATE_FUNC_RESTORE "onLoad"
+
+/*
+ * On /upgrade, states are written in upgrade file (one object per script
+ * file, state is a raw buffer), then read on next start before scripts
+ * are loaded.
+ */
+
+#define JS_UPGRADE_FILENAME   "js"
+#define JS_UPGRADE_TYPE_STATE 0
+
+extern void weechat_js_state_init (void);
+extern void weechat_js_state_end (void);
+extern int weechat_js_state_save (struct t_plugin_script *script);
+extern void weechat_js_state_restore (struct t_plugin_script *script);
+extern void weechat_js_state_set (const char *filename, const char *state);
+extern const char *weechat_js_state_get (const char *filename);
+extern int weechat_js_state_upgrade_load (void);
+
+#endif /* __WEECHAT_JS_STATE_H_ */
@@ -0,0 +1,1193 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-store.h"
+
+struct t_js_store *js_stores = NULL;
+struct t_js_store *last_js_store = NULL;
+
+/* end of compaction threads, signaled with a pipe */
+pthread_mutex_t js_store_mutex = PTHREAD_MUTEX_INITIALIZER;
+int js_store_pipe[2] = { -1, -1 };
+struct t_hook *js_store_hook_fd = NULL;
+
+/*
+ * Returns hash of a key (FNV-1a).
+ */
+
+static uint32_t
+weechat_js_store_hash (const char *key, size_t length)
+{
+    uint32_t hash;
+    size_t i;
+
+    hash = 2166136261U;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) key[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/*
+ * Returns check of a record (FNV-1a of lengths, key and value), never 0
+ * (0 is unused space at end of log).
+ */
+
+static uint32_t
+weechat_js_store_check (const char *key, uint32_t key_length,
+                        const char *value, uint32_t value_length)
+{
+    uint32_t lengths[2], hash;
+    size_t i;
+
+    lengths[0] = key_length;
+    lengths[1] = value_length;
+    hash = 2166136261U;
+    for (i = 0; i < sizeof(lengths); i++)
+    {
+        hash ^= ((unsigned char *) lengths)[i];
+        hash *= 16777619U;
+    }
+    for (i = 0; i < key_length; i++)
+    {
+        hash ^= (unsigned char) key[i];
+        hash *= 16777619U;
+    }
+    if (value_length != JS_STORE_DELETED)
+    {
+        for (i = 0; i < value_length; i++)
+        {
+            hash ^= (unsigned char) value[i];
+            hash *= 16777619U;
+        }
+    }
+
+    return (hash == 0) ? 1 : hash;
+}
+
+/*
+ * Returns size of a record.
+ */
+
+static size_t
+weechat_js_store_record_size (uint32_t key_length, uint32_t value_length)
+{
+    return JS_STORE_HEADER_SIZE + key_length
+        + ((value_length == JS_STORE_DELETED) ? 0 : value_length);
+}
+
+/*
+ * Reads header of a record (in a buffer).
+ */
+
+static void
+weechat_js_store_header (const char *record, uint32_t *check,
+                         uint32_t *key_length, uint32_t *value_length)
+{
+    memcpy(check, record, 4);
+    memcpy(key_length, record + 4, 4);
+    memcpy(value_length, record + 8, 4);
+}
+
+/*
+ * Searches slot of a key in index.
+ *
+ * Returns pointer to slot, NULL if key is not in index.
+ */
+
+static struct t_js_store_slot *
+weechat_js_store_index_search (struct t_js_store *store,
+                               const char *key, size_t key_length,
+                               uint32_t hash)
+{
+    struct t_js_store_slot *ptr_slot;
+    uint32_t check, record_key_length, value_length;
+    size_t i, mask;
+
+    mask = store->index_size - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask)
+    {
+        ptr_slot = &store->index[i];
+        if (ptr_slot->offset == JS_STORE_SLOT_EMPTY)
+            return NULL;
+        if ((ptr_slot->offset == JS_STORE_SLOT_REMOVED)
+            || (ptr_slot->hash != hash))
+            continue;
+        weechat_js_store_header(store->map + ptr_slot->offset, &check,
+                                &record_key_length, &value_length);
+        if ((record_key_length == key_length)
+            && (memcmp(store->map + ptr_slot->offset + JS_STORE_HEADER_SIZE,
+                       key, key_length) == 0))
+            return ptr_slot;
+    }
+}
+
+/*
+ * Resizes index (keys are inserted again, removed slots are dropped).
+ *
+ * Returns:
+ *   1: OK
+ *   0: error (not enough memory)
+ */
+
+static int
+weechat_js_store_index_resize (struct t_js_store *store, size_t size)
+{
+    struct t_js_store_slot *new_index;
+    size_t i, j, mask;
+
+    new_index = (struct t_js_store_slot *) calloc(size, sizeof(*new_index));
+    if (!new_index)
+        return 0;
+
+    mask = size - 1;
+    for (i = 0; i < store->index_size; i++)
+    {
+        if (store->index[i].offset < JS_STORE_MAGIC_SIZE)
+            continue;
+        for (j = store->index[i].hash & mask;
+             new_index[j].offset != JS_STORE_SLOT_EMPTY;
+             j = (j + 1) & mask)
+        {
+        }
+        new_index[j] = store->index[i];
+    }
+
+    if (store->index)
+        free(store->index);
+    store->index = new_index;
+    store->index_size = size;
+    store->index_used = store->index_count;
+
+    return 1;
+}
+
+/*
+ * Sets offset of a key in index.
+ *
+ * Returns offset of previous record of key, 0 if key was not in index
+ * (error is set to 1 if index can not be resized).
+ */
+
+static size_t
+weechat_js_store_index_set (struct t_js_store *store,
+                            const char *key, size_t key_length,
+                            uint32_t hash, size_t offset, int *error)
+{
+    struct t_js_store_slot *ptr_slot;
+    size_t i, mask, old_offset;
+
+    *error = 0;
+
+    ptr_slot = weechat_js_store_index_search(store, key, key_length, hash);
+    if (ptr_slot)
+    {
+        old_offset = ptr_slot->offset;
+        ptr_slot->offset = offset;
+        return old_offset;
+    }
+
+    /* keep at most 3/4 of slots used (keys + removed slots) */
+    if ((store->index_used + 1) * 4 > store->index_size * 3)
+    {
+        if (!weechat_js_store_index_resize (
+                store,
+                ((store->index_count + 1) * 2 > store->index_size) ?
+                store->index_size * 2 : store->index_size))
+        {
+            *error = 1;
+            return 0;
+        }
+    }
+
+    mask = store->index_size - 1;
+    for (i = hash & mask; store->index[i].offset >= JS_STORE_MAGIC_SIZE;
+         i = (i + 1) & mask)
+    {
+    }
+    if (store->index[i].offset == JS_STORE_SLOT_EMPTY)
+        store->index_used++;
+    store->index[i].hash = hash;
+    store->index[i].offset = offset;
+    store->index_count++;
+
+    return 0;
+}
+
+/*
+ * Removes a key from index.
+ *
+ * Returns offset of record of key, 0 if key was not in index.
+ */
+
+static size_t
+weechat_js_store_index_remove (struct t_js_store *store,
+                               const char *key, size_t key_length,
+                               uint32_t hash)
+{
+    struct t_js_store_slot *ptr_slot;
+    size_t old_offset;
+
+    ptr_slot = weechat_js_store_index_search(store, key, key_length, hash);
+    if (!ptr_slot)
+        return 0;
+
+    old_offset = ptr_slot->offset;
+    ptr_slot->offset = JS_STORE_SLOT_REMOVED;
+    store->index_count--;
+
+    return old_offset;
+}
+
+/*
+ * Maps log file with a new size.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+static int
+weechat_js_store_map (struct t_js_store *store, size_t capacity)
+{
+    char *new_map;
+
+    if (ftruncate(store->fd, capacity) < 0)
+        return 0;
+
+    new_map = (char *) mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, store->fd, 0);
+    if (new_map == MAP_FAILED)
+        return 0;
+
+    if (store->map)
+        munmap(store->map, store->capacity);
+    store->map = new_map;
+    store->capacity = capacity;
+
+    return 1;
+}
+
+/*
+ * Appends a record at end of log.
+ *
+ * Returns offset of record, 0 if error.
+ */
+
+static size_t
+weechat_js_store_append (struct t_js_store *store,
+                         const char *key, uint32_t key_length,
+                         const char *value, uint32_t value_length)
+{
+    uint32_t check;
+    size_t size, offset, capacity;
+    char *ptr_record;
+
+    size = weechat_js_store_record_size(key_length, value_length);
+    if (store->used + size > store->capacity)
+    {
+        capacity = store->capacity * 2;
+        while (store->used + size > capacity)
+        {
+            capacity *= 2;
+        }
+        if (!weechat_js_store_map(store, capacity))
+            return 0;
+    }
+
+    offset = store->used;
+    ptr_record = store->map + offset;
+    check = weechat_js_store_check(key, key_length, value, value_length);
+    memcpy(ptr_record + JS_STORE_HEADER_SIZE, key, key_length);
+    if (value_length != JS_STORE_DELETED)
+    {
+        memcpy(ptr_record + JS_STORE_HEADER_SIZE + key_length,
+               value, value_length);
+    }
+    memcpy(ptr_record + 4, &key_length, 4);
+    memcpy(ptr_record + 8, &value_length, 4);
+    memcpy(ptr_record, &check, 4);
+    store->used += size;
+
+    return offset;
+}
+
+/*
+ * Reads log and builds index: log ends at first record which is not valid
+ * (incomplete write), space after it is cleared.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+static int
+weechat_js_store_load (struct t_js_store *store)
+{
+    uint32_t check, key_length, value_length, hash;
+    size_t offset, size, old_offset;
+    const char *ptr_key;
+    int error;
+
+    offset = JS_STORE_MAGIC_SIZE;
+    while (offset + JS_STORE_HEADER_SIZE <= store->capacity)
+    {
+        weechat_js_store_header(store->map + offset, &check, &key_length,
+                                &value_length);
+        if ((check == 0) || (key_length == 0))
+            break;
+        size = weechat_js_store_record_size(key_length, value_length);
+        if (offset + size > store->capacity)
+            break;
+        ptr_key = store->map + offset + JS_STORE_HEADER_SIZE;
+        if (weechat_js_store_check(ptr_key, key_length,
+                                   ptr_key + key_length,
+                                   value_length) != check)
+            break;
+
+        hash = weechat_js_store_hash(ptr_key, key_length);
+        if (value_length == JS_STORE_DELETED)
+        {
+            old_offset = weechat_js_store_index_remove(store, ptr_key,
+                                                       key_length, hash);
+        }
+        else
+        {
+            old_offset = weechat_js_store_index_set(store, ptr_key,
+                                                    key_length, hash,
+                                                    offset, &error);
+            if (error)
+                return 0;
+            store->live_bytes += size;
+        }
+        if (old_offset)
+        {
+            weechat_js_store_header(store->map + old_offset, &check,
+                                    &key_length, &value_length);
+            store->live_bytes -= weechat_js_store_record_size(key_length,
+                                                              value_length);
+        }
+        offset += size;
+    }
+
+    store->used = offset;
+    if (store->used < store->capacity)
+        memset(store->map + store->used, 0, store->capacity - store->used);
+
+    return 1;
+}
+
+/*
+ * Thread copying live records to new log file.
+ */
+
+static void *
+weechat_js_store_compact_run (void *arg)
+{
+    struct t_js_store *store;
+    uint32_t check, key_length, value_length;
+    char header[JS_STORE_HEADER_SIZE], *buffer, *new_buffer;
+    size_t i, size, buffer_size, position;
+    int error;
+
+    store = (struct t_js_store *) arg;
+
+    buffer = NULL;
+    buffer_size = 0;
+    error = 0;
+    position = JS_STORE_MAGIC_SIZE;
+
+    if (pwrite(store->compact_fd, JS_STORE_MAGIC, JS_STORE_MAGIC_SIZE, 0)
+        != JS_STORE_MAGIC_SIZE)
+        error = (errno) ? errno : EIO;
+
+    /* records before compact_end are never changed by main thread */
+    for (i = 0; !error && (i < store->compact_count); i++)
+    {
+        if (pread(store->fd, header, sizeof(header),
+                  store->compact_offsets[i]) != (ssize_t) sizeof(header))
+        {
+            error = (errno) ? errno : EIO;
+            break;
+        }
+        weechat_js_store_header(header, &check, &key_length, &value_length);
+        size = weechat_js_store_record_size(key_length, value_length);
+        if (size > buffer_size)
+        {
+            new_buffer = (char *) realloc(buffer, size);
+            if (!new_buffer)
+            {
+                error = ENOMEM;
+                break;
+            }
+            buffer = new_buffer;
+            buffer_size = size;
+        }
+        if ((pread(store->fd, buffer, size, store->compact_offsets[i])
+             != (ssize_t) size)
+            || (pwrite(store->compact_fd, buffer, size, position)
+                != (ssize_t) size))
+        {
+            error = (errno) ? errno : EIO;
+            break;
+        }
+        store->compact_new_offsets[i] = position;
+        position += size;
+    }
+
+    if (!error && (fdatasync(store->compact_fd) < 0))
+        error = errno;
+
+    if (buffer)
+        free(buffer);
+
+    pthread_mutex_lock(&js_store_mutex);
+    store->compact_used = position;
+    store->compact_error = error;
+    store->compact_done = 1;
+    pthread_mutex_unlock(&js_store_mutex);
+
+    if (js_store_pipe[1] >= 0)
+    {
+        if (write(js_store_pipe[1], "c", 1) < 0)
+        {
+            /* pipe is full: main loop will read it anyway */
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Compares two offsets (for qsort).
+ */
+
+static int
+weechat_js_store_offset_cmp (const void *offset1, const void *offset2)
+{
+    size_t value1, value2;
+
+    value1 = *((const size_t *) offset1);
+    value2 = *((const size_t *) offset2);
+
+    return (value1 < value2) ? -1 : ((value1 > value2) ? 1 : 0);
+}
+
+/*
+ * Frees data of compaction (thread must be finished).
+ */
+
+static void
+weechat_js_store_compact_free (struct t_js_store *store, int remove_file)
+{
+    if (store->compact_fd >= 0)
+    {
+        close(store->compact_fd);
+        store->compact_fd = -1;
+    }
+    if (store->compact_path)
+    {
+        if (remove_file)
+            unlink(store->compact_path);
+        free(store->compact_path);
+        store->compact_path = NULL;
+    }
+    if (store->compact_offsets)
+    {
+        free(store->compact_offsets);
+        store->compact_offsets = NULL;
+    }
+    if (store->compact_new_offsets)
+    {
+        free(store->compact_new_offsets);
+        store->compact_new_offsets = NULL;
+    }
+    store->compact_count = 0;
+    store->compacting = 0;
+    store->compact_done = 0;
+}
+
+/*
+ * Records a failed compaction: next one is delayed, so that a lasting error
+ * (for example no space left on device) does not copy the whole log on
+ * each write.
+ */
+
+static void
+weechat_js_store_compact_failed (struct t_js_store *store)
+{
+    store->compact_retry_used = store->used + JS_STORE_COMPACT_MIN;
+    store->compact_retry_time = time(NULL) + JS_STORE_COMPACT_RETRY;
+}
+
+/*
+ * Starts compaction of log if dead records take more space than live ones.
+ */
+
+static void
+weechat_js_store_compact_start (struct t_js_store *store)
+{
+    size_t dead_bytes, i, length;
+
+    if (store->compacting || (js_store_pipe[1] < 0))
+        return;
+
+    dead_bytes = store->used - JS_STORE_MAGIC_SIZE - store->live_bytes;
+    if ((dead_bytes < JS_STORE_COMPACT_MIN) || (dead_bytes < store->live_bytes))
+        return;
+
+    /* back off after a failure */
+    if ((store->compact_retry_time > 0)
+        && (store->used < store->compact_retry_used)
+        && (time(NULL) < store->compact_retry_time))
+        return;
+
+    length = strlen(store->path) + 16;
+    store->compact_path = (char *) malloc(length);
+    store->compact_offsets = (size_t *) malloc(
+        (store->index_count + 1) * sizeof(size_t));
+    store->compact_new_offsets = (size_t *) malloc(
+        (store->index_count + 1) * sizeof(size_t));
+    if (!store->compact_path || !store->compact_offsets
+        || !store->compact_new_offsets)
+    {
+        weechat_js_store_compact_free(store, 0);
+        return;
+    }
+    snprintf(store->compact_path, length, "%s.compact", store->path);
+
+    store->compact_fd = open(store->compact_path,
+                             O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (store->compact_fd < 0)
+    {
+        weechat_js_store_compact_free(store, 0);
+        weechat_js_store_compact_failed(store);
+        return;
+    }
+
+    store->compact_count = 0;
+    for (i = 0; i < store->index_size; i++)
+    {
+        if (store->index[i].offset >= JS_STORE_MAGIC_SIZE)
+            store->compact_offsets[store->compact_count++] = store->index[i].offset;
+    }
+    qsort(store->compact_offsets, store->compact_count, sizeof(size_t),
+          &weechat_js_store_offset_cmp);
+    store->compact_end = store->used;
+    store->compact_used = 0;
+    store->compact_error = 0;
+    store->compact_done = 0;
+    store->compacting = 1;
+
+    /* log written so far is read by thread from file */
+    msync(store->map, store->used, MS_ASYNC);
+
+    if (pthread_create(&store->compact_thread, NULL,
+                       &weechat_js_store_compact_run, store) != 0)
+    {
+        weechat_js_store_compact_free(store, 1);
+        weechat_js_store_compact_failed(store);
+    }
+}
+
+/*
+ * Ends compaction (on main loop, thread is finished): records written
+ * since start of compaction are copied in new log, then new log replaces
+ * old one and index is updated.
+ */
+
+static void
+weechat_js_store_compact_finish (struct t_js_store *store)
+{
+    uint32_t check, key_length, value_length;
+    size_t i, *new_offsets, *found, position, size, capacity, live_bytes;
+    char *new_map;
+    int error;
+
+    pthread_join(store->compact_thread, NULL);
+
+    error = store->compact_error;
+    new_offsets = NULL;
+    new_map = NULL;
+    position = store->compact_used;
+    capacity = 0;
+    live_bytes = 0;
+
+    if (!error)
+    {
+        new_offsets = (size_t *) malloc(store->index_size * sizeof(size_t));
+        if (!new_offsets)
+            error = ENOMEM;
+    }
+
+    /*
+     * records written since start are copied as is (with deletions: a key
+     * deleted since start is still in records copied by thread)
+     */
+    if (!error && (store->used > store->compact_end))
+    {
+        size = store->used - store->compact_end;
+        if (pwrite(store->compact_fd, store->map + store->compact_end, size,
+                   position) != (ssize_t) size)
+            error = (errno) ? errno : EIO;
+    }
+
+    /* offsets of live records in new log */
+    for (i = 0; !error && (i < store->index_size); i++)
+    {
+        if (store->index[i].offset < JS_STORE_MAGIC_SIZE)
+            continue;
+        weechat_js_store_header(store->map + store->index[i].offset,
+                                &check, &key_length, &value_length);
+        size = weechat_js_store_record_size(key_length, value_length);
+        live_bytes += size;
+        if (store->index[i].offset < store->compact_end)
+        {
+            found = (size_t *) bsearch(&store->index[i].offset,
+                                       store->compact_offsets,
+                                       store->compact_count, sizeof(size_t),
+                                       &weechat_js_store_offset_cmp);
+            if (!found)
+            {
+                error = EINVAL;
+                break;
+            }
+            new_offsets[i] = store->compact_new_offsets[found - store->compact_offsets];
+        }
+        else
+        {
+            new_offsets[i] = position
+                + (store->index[i].offset - store->compact_end);
+        }
+    }
+    position += store->used - store->compact_end;
+
+    if (!error)
+    {
+        capacity = JS_STORE_MIN_SIZE;
+        while (capacity < position * 2)
+        {
+            capacity *= 2;
+        }
+        if (ftruncate(store->compact_fd, capacity) < 0)
+            error = errno;
+    }
+    if (!error)
+    {
+        new_map = (char *) mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, store->compact_fd, 0);
+        if (new_map == MAP_FAILED)
+        {
+            new_map = NULL;
+            error = errno;
+        }
+    }
+    if (!error && (rename(store->compact_path, store->path) < 0))
+        error = errno;
+
+    if (error)
+    {
+        if (new_map)
+            munmap(new_map, capacity);
+        if (new_offsets)
+            free(new_offsets);
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: unable to compact store "
+                                       "\"%s\": %s"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME,
+                       store->name, strerror(error));
+        weechat_js_store_compact_free(store, 1);
+        weechat_js_store_compact_failed(store);
+        return;
+    }
+
+    munmap(store->map, store->capacity);
+    close(store->fd);
+    store->fd = store->compact_fd;
+    store->compact_fd = -1;
+    store->map = new_map;
+    store->capacity = capacity;
+    store->used = position;
+    /* records changed during compaction are dead in new log */
+    store->live_bytes = live_bytes;
+    for (i = 0; i < store->index_size; i++)
+    {
+        if (store->index[i].offset >= JS_STORE_MAGIC_SIZE)
+            store->index[i].offset = new_offsets[i];
+    }
+    free(new_offsets);
+
+    store->compact_retry_used = 0;
+    store->compact_retry_time = 0;
+
+    weechat_js_store_compact_free(store, 0);
+}
+
+/*
+ * Callback for end of compaction threads signaled on pipe.
+ */
+
+static int
+weechat_js_store_fd_cb (void *data, int fd)
+{
+    struct t_js_store *ptr_store;
+    char buffer[64];
+    int done;
+
+    while (read(fd, buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    for (ptr_store = js_stores; ptr_store; ptr_store = ptr_store->next_store)
+    {
+        if (!ptr_store->compacting)
+            continue;
+        pthread_mutex_lock(&js_store_mutex);
+        done = ptr_store->compact_done;
+        pthread_mutex_unlock(&js_store_mutex);
+        if (done)
+            weechat_js_store_compact_finish(ptr_store);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes stores.
+ */
+
+void
+weechat_js_store_init ()
+{
+    int i;
+
+    if (pipe(js_store_pipe) < 0)
+    {
+        js_store_pipe[0] = -1;
+        js_store_pipe[1] = -1;
+        return;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        fcntl(js_store_pipe[i], F_SETFL,
+              fcntl(js_store_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(js_store_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    js_store_hook_fd = weechat_hook_fd(js_store_pipe[0], 1, 0, 0,
+                                       &weechat_js_store_fd_cb, NULL);
+}
+
+/*
+ * Checks if a store name is valid (it is used as file name).
+ */
+
+static int
+weechat_js_store_valid_name (const char *name)
+{
+    const char *ptr_name;
+
+    if (!name || !name[0] || (name[0] == '.') || (strlen(name) > 64))
+        return 0;
+
+    for (ptr_name = name; ptr_name[0]; ptr_name++)
+    {
+        if (!((ptr_name[0] >= 'a') && (ptr_name[0] <= 'z'))
+            && !((ptr_name[0] >= 'A') && (ptr_name[0] <= 'Z'))
+            && !((ptr_name[0] >= '0') && (ptr_name[0] <= '9'))
+            && (ptr_name[0] != '_') && (ptr_name[0] != '-')
+            && (ptr_name[0] != '.'))
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Frees a store (file is closed, compaction in progress is canceled).
+ */
+
+static void
+weechat_js_store_free (struct t_js_store *store)
+{
+    if (store->compacting)
+    {
+        pthread_join(store->compact_thread, NULL);
+        weechat_js_store_compact_free(store, 1);
+    }
+
+    if (store->map)
+    {
+        msync(store->map, store->used, MS_ASYNC);
+        munmap(store->map, store->capacity);
+    }
+    if (store->fd >= 0)
+    {
+        /* unused space is not kept in file */
+        if ((store->used > 0) && (ftruncate(store->fd, store->used) < 0))
+        {
+            /* file is valid anyway: log ends at first record not valid */
+        }
+        close(store->fd);
+    }
+    if (store->index)
+        free(store->index);
+    if (store->name)
+        free(store->name);
+    if (store->path)
+        free(store->path);
+
+    free(store);
+}
+
+/*
+ * Opens a store (created if not found).
+ *
+ * Returns pointer to store, NULL if error.
+ */
+
+struct t_js_store *
+weechat_js_store_open (struct t_plugin_script *script, const char *name)
+{
+    struct t_js_store *new_store, *ptr_store;
+    const char *weechat_dir;
+    struct stat st;
+    int length;
+
+    if (!script || !weechat_js_store_valid_name(name))
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: invalid store name \"%s\""),
+                       weechat_prefix("error"), JS_PLUGIN_NAME,
+                       (name) ? name : "");
+        return NULL;
+    }
+
+    for (ptr_store = js_stores; ptr_store; ptr_store = ptr_store->next_store)
+    {
+        if (strcmp(ptr_store->name, name) == 0)
+        {
+            if (ptr_store->script == script)
+                return ptr_store;
+            weechat_printf(NULL,
+                           weechat_gettext("%s%s: store \"%s\" is already "
+                                           "opened by script \"%s\""),
+                           weechat_prefix("error"), JS_PLUGIN_NAME, name,
+                           ptr_store->script->name);
+            return NULL;
+        }
+    }
+
+    weechat_dir = weechat_info_get("weechat_dir", "");
+    if (!weechat_dir)
+        return NULL;
+    weechat_mkdir_home(JS_STORE_DIR, 0700);
+
+    new_store = (struct t_js_store *) calloc(1, sizeof(*new_store));
+    if (!new_store)
+        return NULL;
+    new_store->script = script;
+    new_store->name = strdup(name);
+    length = strlen(weechat_dir) + strlen(name) + 64;
+    new_store->path = (char *) malloc(length);
+    new_store->fd = -1;
+    new_store->compact_fd = -1;
+
+    if (!new_store->name || !new_store->path
+        || !weechat_js_store_index_resize(new_store, JS_STORE_INDEX_MIN))
+        goto error;
+    snprintf(new_store->path, length, "%s/%s/%s.%s",
+             weechat_dir, JS_STORE_DIR, name, JS_STORE_EXTENSION);
+
+    new_store->fd = open(new_store->path, O_RDWR | O_CREAT | O_CLOEXEC,
+                         0600);
+    if ((new_store->fd < 0) || (fstat(new_store->fd, &st) < 0))
+        goto error;
+
+    if (st.st_size == 0)
+    {
+        if (!weechat_js_store_map(new_store, JS_STORE_MIN_SIZE))
+            goto error;
+        memcpy(new_store->map, JS_STORE_MAGIC, JS_STORE_MAGIC_SIZE);
+        new_store->used = JS_STORE_MAGIC_SIZE;
+    }
+    else
+    {
+        if ((st.st_size < JS_STORE_MAGIC_SIZE)
+            || !weechat_js_store_map(new_store,
+                                     (st.st_size < JS_STORE_MIN_SIZE) ?
+                                     JS_STORE_MIN_SIZE : st.st_size)
+            || (memcmp(new_store->map, JS_STORE_MAGIC,
+                       JS_STORE_MAGIC_SIZE) != 0))
+        {
+            errno = EINVAL;
+            goto error;
+        }
+        if (!weechat_js_store_load(new_store))
+            goto error;
+    }
+
+    new_store->prev_store = last_js_store;
+    if (last_js_store)
+        last_js_store->next_store = new_store;
+    else
+        js_stores = new_store;
+    last_js_store = new_store;
+
+    weechat_js_store_compact_start(new_store);
+
+    return new_store;
+
+error:
+    weechat_printf(NULL,
+                   weechat_gettext("%s%s: unable to open store \"%s\": %s"),
+                   weechat_prefix("error"), JS_PLUGIN_NAME, name,
+                   strerror(errno));
+    if (new_store->map)
+    {
+        munmap(new_store->map, new_store->capacity);
+        new_store->map = NULL;
+    }
+    new_store->used = 0;
+    weechat_js_store_free(new_store);
+    return NULL;
+}
+
+/*
+ * Searches a store of a script by pointer.
+ *
+ * Returns pointer to store, NULL if not found.
+ */
+
+struct t_js_store *
+weechat_js_store_search (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_store *ptr_store;
+
+    if (!pointer)
+        return NULL;
+
+    for (ptr_store = js_stores; ptr_store; ptr_store = ptr_store->next_store)
+    {
+        if ((ptr_store == pointer) && (ptr_store->script == script))
+            return ptr_store;
+    }
+
+    return NULL;
+}
+
+/*
+ * Gets value of a key (pointer in mapping, valid until next write in
+ * store).
+ *
+ * Returns pointer to value, NULL if key is not found.
+ */
+
+const char *
+weechat_js_store_get (struct t_js_store *store,
+                      const char *key, size_t key_length,
+                      size_t *value_length)
+{
+    struct t_js_store_slot *ptr_slot;
+    uint32_t check, record_key_length, record_value_length;
+
+    if (!store || !key || (key_length == 0))
+        return NULL;
+
+    ptr_slot = weechat_js_store_index_search(
+        store, key, key_length, weechat_js_store_hash(key, key_length));
+    if (!ptr_slot)
+        return NULL;
+
+    weechat_js_store_header(store->map + ptr_slot->offset, &check,
+                            &record_key_length, &record_value_length);
+    *value_length = record_value_length;
+
+    return store->map + ptr_slot->offset + JS_STORE_HEADER_SIZE
+        + record_key_length;
+}
+
+/*
+ * Sets value of a key.
+ *
+ * Returns:
+ *   1: OK
+ *   0: error
+ */
+
+int
+weechat_js_store_set (struct t_js_store *store,
+                      const char *key, size_t key_length,
+                      const char *value, size_t value_length)
+{
+    uint32_t check, old_key_length, old_value_length;
+    size_t offset, old_offset;
+    int error;
+
+    if (!store || !key || (key_length == 0) || (key_length > 0xFFFF)
+        || (value_length >= JS_STORE_DELETED))
+        return 0;
+
+    offset = weechat_js_store_append(store, key, key_length,
+                                     value, value_length);
+    if (offset == 0)
+        return 0;
+
+    old_offset = weechat_js_store_index_set(
+        store, key, key_length, weechat_js_store_hash(key, key_length),
+        offset, &error);
+    if (error)
+    {
+        /* record is dead in log (index unchanged) */
+        return 0;
+    }
+    store->live_bytes += weechat_js_store_record_size(key_length,
+                                                      value_length);
+    if (old_offset)
+    {
+        weechat_js_store_header(store->map + old_offset, &check,
+                                &old_key_length, &old_value_length);
+        store->live_bytes -= weechat_js_store_record_size(old_key_length,
+                                                          old_value_length);
+    }
+
+    weechat_js_store_compact_start(store);
+
+    return 1;
+}
+
+/*
+ * Deletes a key.
+ *
+ * Returns:
+ *   1: key deleted
+ *   0: key not found or error
+ */
+
+int
+weechat_js_store_delete (struct t_js_store *store,
+                         const char *key, size_t key_length)
+{
+    uint32_t hash, check, old_key_length, old_value_length;
+    size_t old_offset;
+
+    if (!store || !key || (key_length == 0))
+        return 0;
+
+    hash = weechat_js_store_hash(key, key_length);
+    if (!weechat_js_store_index_search(store, key, key_length, hash))
+        return 0;
+
+    if (weechat_js_store_append(store, key, key_length, NULL,
+                                JS_STORE_DELETED) == 0)
+        return 0;
+
+    old_offset = weechat_js_store_index_remove(store, key, key_length, hash);
+    weechat_js_store_header(store->map + old_offset, &check,
+                            &old_key_length, &old_value_length);
+    store->live_bytes -= weechat_js_store_record_size(old_key_length,
+                                                      old_value_length);
+
+    weechat_js_store_compact_start(store);
+
+    return 1;
+}
+
+/*
+ * Returns number of keys in a store.
+ */
+
+size_t
+weechat_js_store_count (struct t_js_store *store)
+{
+    return (store) ? store->index_count : 0;
+}
+
+/*
+ * Closes a store.
+ */
+
+void
+weechat_js_store_close (struct t_js_store *store)
+{
+    if (!store)
+        return;
+
+    if (store->prev_store)
+        (store->prev_store)->next_store = store->next_store;
+    if (store->next_store)
+        (store->next_store)->prev_store = store->prev_store;
+    if (js_stores == store)
+        js_stores = store->next_store;
+    if (last_js_store == store)
+        last_js_store = store->prev_store;
+
+    weechat_js_store_free(store);
+}
+
+/*
+ * Closes all stores of a script.
+ */
+
+void
+weechat_js_store_remove_script (struct t_plugin_script *script)
+{
+    struct t_js_store *ptr_store, *next_store;
+
+    ptr_store = js_stores;
+    while (ptr_store)
+    {
+        next_store = ptr_store->next_store;
+        if (ptr_store->script == script)
+            weechat_js_store_close(ptr_store);
+        ptr_store = next_store;
+    }
+}
+
+/*
+ * Closes all stores.
+ */
+
+void
+weechat_js_store_end ()
+{
+    int i;
+
+    while (js_stores)
+    {
+        weechat_js_store_close(js_stores);
+    }
+
+    if (js_store_hook_fd)
+    {
+        weechat_unhook(js_store_hook_fd);
+        js_store_hook_fd = NULL;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (js_store_pipe[i] >= 0)
+        {
+            close(js_store_pipe[i]);
+            js_store_pipe[i] = -1;
+        }
+    }
+}
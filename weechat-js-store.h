@@ -0,0 +1,102 @@
+#ifndef __WEECHAT_JS_STORE_H_
+#define __WEECHAT_JS_STORE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <ctime>
+#include <cstddef>
+
+/*
+ * Persistent key/value stores for scripts: a store is an append-only log
+ * of records (key + value, or key + deletion mark), mapped in memory, with
+ * a hash index key -> offset of last record of key (keys are not copied:
+ * they are compared with keys in log). Values are read in the mapping
+ * (copied only when given to the script). When dead records take
+ * more space than live ones, the log is compacted by a thread (records are
+ * never changed once written, so they can be copied while the script keeps
+ * writing at end of log); end of thread is signaled with a pipe watched by
+ * hook_fd, and new file replaces the old one on the WeeChat main loop.
+ * After a failed compaction, next one is not started before log has grown
+ * by JS_STORE_COMPACT_MIN or JS_STORE_COMPACT_RETRY seconds have passed.
+ *
+ * File format: JS_STORE_MAGIC, then records:
+ *   uint32 check (FNV-1a of record, never 0)
+ *   uint32 length of key (> 0)
+ *   uint32 length of value (JS_STORE_DELETED for a deleted key)
+ *   key, value
+ * Log ends at first record which is not valid (unused space is zero).
+ */
+
+#define JS_STORE_DIR             "js_store"
+#define JS_STORE_EXTENSION       "store"
+#define JS_STORE_MAGIC           "WJSSTOR1"
+#define JS_STORE_MAGIC_SIZE      8
+#define JS_STORE_HEADER_SIZE     12
+#define JS_STORE_DELETED         0xFFFFFFFFU
+#define JS_STORE_MIN_SIZE        (64 * 1024)
+#define JS_STORE_COMPACT_MIN     (1024 * 1024)
+#define JS_STORE_COMPACT_RETRY   60         /* seconds before new try      */
+                                            /* after a failed compaction   */
+#define JS_STORE_INDEX_MIN       64
+
+#define JS_STORE_SLOT_EMPTY      0          /* offsets < magic size are    */
+#define JS_STORE_SLOT_REMOVED    1          /* not records                 */
+
+struct t_js_store_slot
+{
+    uint32_t hash;                           /* hash of key                 */
+    size_t offset;                           /* offset of record in log     */
+};
+
+struct t_js_store
+{
+    struct t_plugin_script *script;          /* script owning the store     */
+    char *name;                              /* name of store               */
+    char *path;                              /* path of log file            */
+    int fd;                                  /* log file                    */
+    char *map;                               /* mapping of log file         */
+    size_t capacity;                         /* size of file/mapping        */
+    size_t used;                             /* end of last record          */
+    size_t live_bytes;                       /* size of live records        */
+    struct t_js_store_slot *index;           /* open addressing, 2^n slots  */
+    size_t index_size;                       /* number of slots             */
+    size_t index_count;                      /* number of keys              */
+    size_t index_used;                       /* keys + removed slots        */
+    /* compaction (thread) */
+    int compacting;                          /* 1 if thread is running      */
+    int compact_done;                        /* 1 when thread has finished  */
+    int compact_error;                       /* errno of thread (0 if OK)   */
+    pthread_t compact_thread;                /* thread copying records      */
+    char *compact_path;                      /* path of new log file        */
+    int compact_fd;                          /* new log file                */
+    size_t compact_end;                      /* end of log copied by thread */
+    size_t compact_used;                     /* end of new log              */
+    size_t *compact_offsets;                 /* live records (sorted)       */
+    size_t *compact_new_offsets;             /* offsets in new log          */
+    size_t compact_count;                    /* number of records copied    */
+    size_t compact_retry_used;               /* after failure: retry when   */
+    time_t compact_retry_time;               /* log reaches this size, or   */
+                                             /* at this time (0 = no wait)  */
+    struct t_js_store *prev_store;           /* link to previous store      */
+    struct t_js_store *next_store;           /* link to next store          */
+};
+
+extern void weechat_js_store_init (void);
+extern void weechat_js_store_end (void);
+extern struct t_js_store *weechat_js_store_open (struct t_plugin_script *script,
+                                                 const char *name);
+extern struct t_js_store *weechat_js_store_search (struct t_plugin_script *script,
+                                                   void *pointer);
+extern const char *weechat_js_store_get (struct t_js_store *store,
+                                         const char *key, size_t key_length,
+                                         size_t *value_length);
+extern int weechat_js_store_set (struct t_js_store *store,
+                                 const char *key, size_t key_length,
+                                 const char *value, size_t value_length);
+extern int weechat_js_store_delete (struct t_js_store *store,
+                                    const char *key, size_t key_length);
+extern size_t weechat_js_store_count (struct t_js_store *store);
+extern void weechat_js_store_close (struct t_js_store *store);
+extern void weechat_js_store_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_STORE_H_ */
@@ -0,0 +1,685 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-stream.h"
+
+struct t_hashtable *js_streams = NULL;      /* script_cb -> stream       */
+
+const char *js_stream_event_string[JS_STREAM_NUM_EVENTS] =
+{ "connect", "data", "drain", "end", "error" };
+
+/*
+ * Initializes streams.
+ */
+
+void
+weechat_js_stream_init ()
+{
+    js_streams = weechat_hashtable_new(32,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+}
+
+/*
+ * Frees a stream: pending writes are lost.
+ */
+
+static void
+weechat_js_stream_free (struct t_js_stream *stream)
+{
+    struct t_js_stream_write *next_write;
+
+    if (stream->hook_fd)
+    {
+        weechat_unhook(stream->hook_fd);
+        stream->hook_fd = NULL;
+    }
+    stream->hook_read = 0;
+    stream->hook_write = 0;
+    if (stream->fd >= 0)
+    {
+        close(stream->fd);
+        stream->fd = -1;
+    }
+    while (stream->writes)
+    {
+        next_write = stream->writes->next_write;
+        weechat_js_buffer_release(stream->writes->data);
+        free(stream->writes);
+        stream->writes = next_write;
+    }
+    stream->last_write = NULL;
+    stream->write_pending = 0;
+
+    if (stream->script_cb)
+    {
+        weechat_hashtable_remove(js_streams, stream->script_cb);
+        plugin_script_callback_remove(stream->script, stream->script_cb);
+        stream->script_cb = NULL;
+    }
+
+    /* when called from a callback of this stream, free it later */
+    if (stream->running)
+    {
+        stream->deleted = 1;
+        return;
+    }
+
+    if (stream->path)
+        free(stream->path);
+    free(stream);
+}
+
+/*
+ * Sends an event to script; for binary data, block is given to the script
+ * (not copied), otherwise it is released after the call.
+ *
+ * Returns 0 if stream has been removed by the script, 1 otherwise.
+ */
+
+static int
+weechat_js_stream_deliver (struct t_js_stream *stream, int event,
+                           char *bytes, int size, const char *message)
+{
+    HandleScope scope;
+    Handle<Value> argv[4];
+    struct t_plugin_script_cb *script_cb;
+    char *function, *str_stream;
+
+    script_cb = stream->script_cb;
+
+    str_stream = plugin_script_ptr2str(script_cb);
+
+    argv[0] = String::New((script_cb->data) ? script_cb->data : "");
+    argv[1] = String::New((str_stream) ? str_stream : "");
+    argv[2] = String::New(js_stream_event_string[event]);
+    if (bytes && stream->binary)
+        argv[3] = weechat_js_buffer_wrap(bytes, size);
+    else if (bytes)
+    {
+        argv[3] = String::New(bytes, size);
+        weechat_js_buffer_release(bytes);
+    }
+    else
+        argv[3] = String::New((message) ? message : "");
+
+    if (str_stream)
+        free(str_stream);
+
+    /* script callback may be removed by the function itself */
+    function = strdup(script_cb->function);
+    stream->running = 1;
+    weechat_js_exec_function(stream->script, function, 4, argv, "stream");
+    stream->running = 0;
+    free(function);
+
+    if (stream->deleted)
+    {
+        weechat_js_stream_free(stream);
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Sends an error to script, then frees stream.
+ */
+
+static void
+weechat_js_stream_error (struct t_js_stream *stream, int error)
+{
+    if (weechat_js_stream_deliver(stream, JS_STREAM_EVENT_ERROR,
+                                  NULL, 0, strerror(error)))
+    {
+        weechat_js_stream_free(stream);
+    }
+}
+
+static int weechat_js_stream_fd_cb (void *data, int fd);
+
+/*
+ * Hooks fd for read and/or write, according to state of stream.
+ */
+
+static void
+weechat_js_stream_hook (struct t_js_stream *stream)
+{
+    int hook_read, hook_write;
+
+    if (stream->fd < 0)
+        return;
+
+    hook_read = (stream->readable && !stream->paused && !stream->connecting
+                 && !stream->closing) ? 1 : 0;
+    hook_write = (stream->connecting || stream->writes) ? 1 : 0;
+
+    if (stream->hook_fd && (hook_read == stream->hook_read)
+        && (hook_write == stream->hook_write))
+        return;
+
+    if (stream->hook_fd)
+    {
+        weechat_unhook(stream->hook_fd);
+        stream->hook_fd = NULL;
+    }
+    stream->hook_read = hook_read;
+    stream->hook_write = hook_write;
+
+    if (hook_read || hook_write)
+    {
+        stream->hook_fd = weechat_hook_fd(stream->fd, hook_read, hook_write, 0,
+                                          &weechat_js_stream_fd_cb, stream);
+    }
+}
+
+/*
+ * Writes queued data (with a single writev for up to JS_STREAM_IOV_MAX
+ * writes).
+ *
+ * Returns 0 if OK (maybe with data still queued), errno if error.
+ */
+
+static int
+weechat_js_stream_flush (struct t_js_stream *stream)
+{
+    struct iovec iov[JS_STREAM_IOV_MAX];
+    struct t_js_stream_write *ptr_write, *next_write;
+    ssize_t num_written;
+    int count;
+
+    while (stream->writes)
+    {
+        count = 0;
+        for (ptr_write = stream->writes; ptr_write && (count < JS_STREAM_IOV_MAX);
+             ptr_write = ptr_write->next_write)
+        {
+            iov[count].iov_base = ptr_write->data + ptr_write->offset;
+            iov[count].iov_len = ptr_write->size - ptr_write->offset;
+            count++;
+        }
+
+        num_written = writev(stream->fd, iov, count);
+        if (num_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : errno;
+        }
+
+        stream->write_pending -= num_written;
+        while (stream->writes && (num_written > 0))
+        {
+            ptr_write = stream->writes;
+            if (num_written < ptr_write->size - ptr_write->offset)
+            {
+                ptr_write->offset += num_written;
+                return 0;
+            }
+            num_written -= ptr_write->size - ptr_write->offset;
+            next_write = ptr_write->next_write;
+            weechat_js_buffer_release(ptr_write->data);
+            free(ptr_write);
+            stream->writes = next_write;
+        }
+        if (!stream->writes)
+            stream->last_write = NULL;
+    }
+
+    return 0;
+}
+
+/*
+ * Callback for fd of stream ready.
+ */
+
+static int
+weechat_js_stream_fd_cb (void *data, int fd)
+{
+    struct t_js_stream *stream;
+    char *bytes;
+    ssize_t num_read;
+    socklen_t length;
+    int error;
+
+    stream = (struct t_js_stream *) data;
+
+    if (stream->connecting)
+    {
+        error = 0;
+        length = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+            error = errno;
+        if (error)
+        {
+            weechat_js_stream_error(stream, error);
+            return WEECHAT_RC_OK;
+        }
+        stream->connecting = 0;
+        weechat_js_stream_hook(stream);
+        weechat_js_stream_deliver(stream, JS_STREAM_EVENT_CONNECT,
+                                  NULL, 0, NULL);
+        /* next events are handled on next call */
+        return WEECHAT_RC_OK;
+    }
+
+    if (stream->hook_write && stream->writes)
+    {
+        error = weechat_js_stream_flush(stream);
+        if (error)
+        {
+            weechat_js_stream_error(stream, error);
+            return WEECHAT_RC_OK;
+        }
+        if (!stream->writes)
+        {
+            if (stream->closing)
+            {
+                weechat_js_stream_free(stream);
+                return WEECHAT_RC_OK;
+            }
+            weechat_js_stream_hook(stream);
+            if (!weechat_js_stream_deliver(stream, JS_STREAM_EVENT_DRAIN,
+                                           NULL, 0, NULL))
+                return WEECHAT_RC_OK;
+        }
+    }
+
+    if (!stream->hook_read || stream->paused || stream->closing)
+        return WEECHAT_RC_OK;
+
+    /* read directly in a block of pool, given as-is to script */
+    bytes = weechat_js_buffer_alloc(stream->read_size);
+    if (!bytes)
+        return WEECHAT_RC_OK;
+
+    num_read = read(fd, bytes, stream->read_size);
+    if (num_read > 0)
+    {
+        weechat_js_stream_deliver(stream, JS_STREAM_EVENT_DATA,
+                                  bytes, num_read, NULL);
+        return WEECHAT_RC_OK;
+    }
+
+    weechat_js_buffer_release(bytes);
+
+    if (num_read == 0)
+    {
+        if (weechat_js_stream_deliver(stream, JS_STREAM_EVENT_END,
+                                      NULL, 0, NULL))
+            weechat_js_stream_free(stream);
+    }
+    else if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        weechat_js_stream_error(stream, errno);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Creates a stream on an open fd.
+ *
+ * Returns the script callback, used as identifier of stream.
+ */
+
+static struct t_plugin_script_cb *
+weechat_js_stream_new (struct t_plugin_script *script, const char *path,
+                       int fd, int readable, int writable, int connecting,
+                       int binary, int read_size,
+                       const char *function, const char *data)
+{
+    struct t_js_stream *new_stream;
+    struct t_plugin_script_cb *new_script_cb;
+
+    new_stream = (struct t_js_stream *) malloc(sizeof(*new_stream));
+    if (!new_stream)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    new_script_cb = plugin_script_callback_add(script, function, data);
+    if (!new_script_cb)
+    {
+        free(new_stream);
+        close(fd);
+        return NULL;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    new_stream->script = script;
+    new_stream->script_cb = new_script_cb;
+    new_stream->path = strdup(path);
+    new_stream->fd = fd;
+    new_stream->hook_fd = NULL;
+    new_stream->hook_read = 0;
+    new_stream->hook_write = 0;
+    new_stream->readable = readable;
+    new_stream->writable = writable;
+    new_stream->binary = binary;
+    new_stream->read_size = (read_size > 0) ?
+        read_size : JS_STREAM_READ_SIZE_DEFAULT;
+    new_stream->connecting = connecting;
+    new_stream->paused = 0;
+    new_stream->closing = 0;
+    new_stream->running = 0;
+    new_stream->deleted = 0;
+    new_stream->writes = NULL;
+    new_stream->last_write = NULL;
+    new_stream->write_pending = 0;
+
+    weechat_hashtable_set(js_streams, new_script_cb, new_stream);
+
+    weechat_js_stream_hook(new_stream);
+
+    return new_script_cb;
+}
+
+/*
+ * Opens a file or named pipe; mode is "r", "w", "a" or "rw".
+ *
+ * Returns the script callback, used as identifier of stream.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_stream_open (struct t_plugin_script *script, const char *path,
+                        const char *mode, int binary, int read_size,
+                        const char *function, const char *data)
+{
+    int fd, flags, readable, writable;
+
+    if (!script || !path || !path[0] || !function || !function[0])
+        return NULL;
+
+    if (!mode || !mode[0] || (strcmp(mode, "r") == 0))
+    {
+        flags = O_RDONLY;
+        readable = 1;
+        writable = 0;
+    }
+    else if (strcmp(mode, "w") == 0)
+    {
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+        readable = 0;
+        writable = 1;
+    }
+    else if (strcmp(mode, "a") == 0)
+    {
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+        readable = 0;
+        writable = 1;
+    }
+    else if (strcmp(mode, "rw") == 0)
+    {
+        flags = O_RDWR | O_CREAT;
+        readable = 1;
+        writable = 1;
+    }
+    else
+        return NULL;
+
+    fd = open(path, flags | O_NONBLOCK, 0644);
+    if (fd < 0)
+        return NULL;
+
+    return weechat_js_stream_new(script, path, fd, readable, writable, 0,
+                                 binary, read_size, function, data);
+}
+
+/*
+ * Connects to a Unix socket (event "connect" is sent when connected).
+ *
+ * Returns the script callback, used as identifier of stream.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_stream_connect (struct t_plugin_script *script, const char *path,
+                           int binary, int read_size,
+                           const char *function, const char *data)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!script || !path || !path[0] || !function || !function[0])
+        return NULL;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return NULL;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return NULL;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if ((connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        && (errno != EINPROGRESS))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    return weechat_js_stream_new(script, path, fd, 1, 1, 1,
+                                 binary, read_size, function, data);
+}
+
+/*
+ * Searches a stream of script.
+ */
+
+static struct t_js_stream *
+weechat_js_stream_search (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_stream *ptr_stream;
+
+    if (!pointer)
+        return NULL;
+
+    ptr_stream = (struct t_js_stream *) weechat_hashtable_get(js_streams,
+                                                              pointer);
+    if (!ptr_stream || (ptr_stream->script != script))
+        return NULL;
+
+    return ptr_stream;
+}
+
+/*
+ * Queues data to write on stream; consecutive small writes are copied in
+ * the same block.
+ *
+ * Returns number of bytes waiting to be written, -1 if error.
+ */
+
+int
+weechat_js_stream_write (struct t_plugin_script *script, void *pointer,
+                         const char *data, int size)
+{
+    struct t_js_stream *ptr_stream;
+    struct t_js_stream_write *ptr_write, *new_write;
+
+    ptr_stream = weechat_js_stream_search(script, pointer);
+    if (!ptr_stream || ptr_stream->deleted || !ptr_stream->writable
+        || ptr_stream->closing || !data || (size < 0))
+        return -1;
+
+    if (size == 0)
+        return ptr_stream->write_pending;
+
+    ptr_write = ptr_stream->last_write;
+    if (ptr_write
+        && (weechat_js_buffer_capacity(ptr_write->data) - ptr_write->size >= size))
+    {
+        memcpy(ptr_write->data + ptr_write->size, data, size);
+        ptr_write->size += size;
+    }
+    else
+    {
+        new_write = (struct t_js_stream_write *) malloc(sizeof(*new_write));
+        if (!new_write)
+            return -1;
+        new_write->data = weechat_js_buffer_alloc((size > JS_STREAM_WRITE_BLOCK) ?
+                                                  size : JS_STREAM_WRITE_BLOCK);
+        if (!new_write->data)
+        {
+            free(new_write);
+            return -1;
+        }
+        memcpy(new_write->data, data, size);
+        new_write->size = size;
+        new_write->offset = 0;
+        new_write->next_write = NULL;
+        if (ptr_stream->last_write)
+            ptr_stream->last_write->next_write = new_write;
+        else
+            ptr_stream->writes = new_write;
+        ptr_stream->last_write = new_write;
+    }
+    ptr_stream->write_pending += size;
+
+    weechat_js_stream_hook(ptr_stream);
+
+    return ptr_stream->write_pending;
+}
+
+/*
+ * Pauses or resumes reading on a stream.
+ *
+ * Returns 1 if pointer was a stream of script, 0 otherwise.
+ */
+
+int
+weechat_js_stream_pause (struct t_plugin_script *script, void *pointer,
+                         int pause)
+{
+    struct t_js_stream *ptr_stream;
+
+    ptr_stream = weechat_js_stream_search(script, pointer);
+    if (!ptr_stream || ptr_stream->deleted)
+        return 0;
+
+    ptr_stream->paused = (pause) ? 1 : 0;
+    weechat_js_stream_hook(ptr_stream);
+
+    return 1;
+}
+
+/*
+ * Closes a stream after queued data has been written.
+ *
+ * Returns 1 if pointer was a stream of script, 0 otherwise.
+ */
+
+int
+weechat_js_stream_close (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_stream *ptr_stream;
+
+    ptr_stream = weechat_js_stream_search(script, pointer);
+    if (!ptr_stream || ptr_stream->deleted)
+        return 0;
+
+    if (!ptr_stream->writes)
+    {
+        weechat_js_stream_free(ptr_stream);
+        return 1;
+    }
+
+    ptr_stream->closing = 1;
+    weechat_js_stream_hook(ptr_stream);
+
+    return 1;
+}
+
+/*
+ * Removes a stream immediately (queued data is lost).
+ *
+ * Returns 1 if pointer was a stream of script, 0 otherwise.
+ */
+
+int
+weechat_js_stream_remove (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_stream *ptr_stream;
+
+    ptr_stream = weechat_js_stream_search(script, pointer);
+    if (!ptr_stream)
+        return 0;
+
+    weechat_js_stream_free(ptr_stream);
+
+    return 1;
+}
+
+/*
+ * Removes all streams of a script.
+ */
+
+void
+weechat_js_stream_remove_script (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+    struct t_js_stream *ptr_stream;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        ptr_stream = (struct t_js_stream *) weechat_hashtable_get(js_streams,
+                                                                  ptr_script_cb);
+        if (ptr_stream)
+            weechat_js_stream_free(ptr_stream);
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Callback used to free all streams.
+ */
+
+static void
+weechat_js_stream_free_cb (void *data, struct t_hashtable *hashtable,
+                           const void *key, const void *value)
+{
+    weechat_js_stream_free((struct t_js_stream *) value);
+}
+
+/*
+ * Closes and frees all streams.
+ */
+
+void
+weechat_js_stream_end ()
+{
+    if (js_streams)
+    {
+        weechat_hashtable_map(js_streams, &weechat_js_stream_free_cb, NULL);
+        weechat_hashtable_free(js_streams);
+        js_streams = NULL;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef __WEECHAT_JS_STREAM_H_
+#define __WEECHAT_JS_STREAM_H_
+
+/*
+ * Non-blocking streams on local sockets, pipes and files, watched with
+ * hook_fd. Data read is given to the script in blocks of the buffer pool;
+ * writes are queued and sent with writev when the fd is writable, so that
+ * all writes done in one callback are sent together.
+ */
+
+#define JS_STREAM_READ_SIZE_DEFAULT 16384
+#define JS_STREAM_WRITE_BLOCK 4096
+#define JS_STREAM_IOV_MAX 64
+
+enum t_js_stream_event
+{
+    JS_STREAM_EVENT_CONNECT = 0,
+    JS_STREAM_EVENT_DATA,
+    JS_STREAM_EVENT_DRAIN,
+    JS_STREAM_EVENT_END,
+    JS_STREAM_EVENT_ERROR,
+    /* number of events */
+    JS_STREAM_NUM_EVENTS,
+};
+
+struct t_js_stream_write
+{
+    char *data;                              /* block of buffer pool        */
+    int size;                                /* bytes used in block         */
+    int offset;                              /* bytes already written       */
+    struct t_js_stream_write *next_write;    /* link to next write          */
+};
+
+struct t_js_stream
+{
+    struct t_plugin_script *script;          /* script owning the stream    */
+    struct t_plugin_script_cb *script_cb;    /* function/data called        */
+    char *path;                              /* file or socket path         */
+    int fd;                                  /* file descriptor             */
+    struct t_hook *hook_fd;                  /* hook on fd                  */
+    int hook_read;                           /* hook_fd watches read        */
+    int hook_write;                          /* hook_fd watches write       */
+    int readable;                            /* 1 if opened for reading     */
+    int writable;                            /* 1 if opened for writing     */
+    int binary;                              /* 1 = data are byte arrays    */
+    int read_size;                           /* max bytes read at once      */
+    int connecting;                          /* 1 until socket is connected */
+    int paused;                              /* 1 if reading is suspended   */
+    int closing;                             /* close when writes are done  */
+    int running;                             /* 1 if callback is running    */
+    int deleted;                             /* removed during callback     */
+    struct t_js_stream_write *writes;        /* queued writes               */
+    struct t_js_stream_write *last_write;    /* last queued write           */
+    int write_pending;                       /* bytes not yet written       */
+};
+
+extern void weechat_js_stream_init (void);
+extern void weechat_js_stream_end (void);
+extern struct t_plugin_script_cb *weechat_js_stream_open (struct t_plugin_script *script,
+                                                          const char *path,
+                                                          const char *mode,
+                                                          int binary,
+                                                          int read_size,
+                                                          const char *function,
+                                                          const char *data);
+extern struct t_plugin_script_cb *weechat_js_stream_connect (struct t_plugin_script *script,
+                                                             const char *path,
+                                                             int binary,
+                                                             int read_size,
+                                                             const char *function,
+                                                             const char *data);
+extern int weechat_js_stream_write (struct t_plugin_script *script,
+                                    void *pointer,
+                                    const char *data, int size);
+extern int weechat_js_stream_pause (struct t_plugin_script *script,
+                                    void *pointer, int pause);
+extern int weechat_js_stream_close (struct t_plugin_script *script,
+                                    void *pointer);
+extern int weechat_js_stream_remove (struct t_plugin_script *script,
+                                     void *pointer);
+extern void weechat_js_stream_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_STREAM_H_ */
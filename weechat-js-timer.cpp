@@ -0,0 +1,584 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-timer.h"
+
+using namespace v8;
+
+#define JS_TIMER_MAX_ARGS 16
+#define JS_TIMER_MAX_DELAY 0xFFFFFFFFULL
+
+struct t_js_timer *js_timer_wheel[JS_TIMER_WHEEL_LEVELS][JS_TIMER_WHEEL_ROOT_SIZE];
+struct t_js_timer *js_timer_wheel_last[JS_TIMER_WHEEL_LEVELS][JS_TIMER_WHEEL_ROOT_SIZE];
+int js_timer_wheel_count[JS_TIMER_WHEEL_LEVELS];
+unsigned long long js_timer_current = 0;    /* next tick to process      */
+
+struct t_hashtable *js_timers = NULL;       /* script_cb -> timer        */
+struct t_hook *js_timer_hook = NULL;        /* single WeeChat timer      */
+unsigned long long js_timer_hook_expiry = 0; /* tick when hook will fire */
+int js_timer_advancing = 0;                 /* 1 when running timers     */
+
+/*
+ * Returns current time in milliseconds (monotonic clock).
+ */
+
+static unsigned long long
+weechat_js_timer_now ()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((unsigned long long) ts.tv_sec * 1000ULL)
+        + ((unsigned long long) ts.tv_nsec / 1000000ULL);
+}
+
+/*
+ * Returns number of bits of ticks covered by levels below given level.
+ */
+
+static int
+weechat_js_timer_level_shift (int level)
+{
+    if (level == 0)
+        return 0;
+
+    return JS_TIMER_WHEEL_ROOT_BITS + ((level - 1) * JS_TIMER_WHEEL_BITS);
+}
+
+/*
+ * Initializes timer wheel.
+ */
+
+void
+weechat_js_timer_init ()
+{
+    memset(js_timer_wheel, 0, sizeof(js_timer_wheel));
+    memset(js_timer_wheel_last, 0, sizeof(js_timer_wheel_last));
+    memset(js_timer_wheel_count, 0, sizeof(js_timer_wheel_count));
+    js_timer_current = weechat_js_timer_now();
+    js_timers = weechat_hashtable_new(32,
+                                      WEECHAT_HASHTABLE_POINTER,
+                                      WEECHAT_HASHTABLE_POINTER,
+                                      NULL, NULL);
+    js_timer_hook = NULL;
+    js_timer_hook_expiry = 0;
+}
+
+/*
+ * Adds a timer in the wheel, according to its expiration tick.
+ */
+
+static void
+weechat_js_timer_wheel_insert (struct t_js_timer *timer)
+{
+    unsigned long long delta, expires;
+    int level;
+
+    expires = (timer->expires > js_timer_current) ?
+        timer->expires : js_timer_current;
+    delta = expires - js_timer_current;
+    if (delta > JS_TIMER_MAX_DELAY)
+    {
+        delta = JS_TIMER_MAX_DELAY;
+        expires = js_timer_current + delta;
+        timer->expires = expires;
+    }
+
+    if (delta < JS_TIMER_WHEEL_ROOT_SIZE)
+    {
+        level = 0;
+        timer->slot = expires & (JS_TIMER_WHEEL_ROOT_SIZE - 1);
+    }
+    else
+    {
+        for (level = 1; level < JS_TIMER_WHEEL_LEVELS - 1; level++)
+        {
+            if (delta < (1ULL << weechat_js_timer_level_shift(level + 1)))
+                break;
+        }
+        timer->slot = (expires >> weechat_js_timer_level_shift(level))
+            & (JS_TIMER_WHEEL_SIZE - 1);
+    }
+    timer->level = level;
+
+    /* append timer to slot, so that timers with same tick run in order */
+    timer->prev_timer = js_timer_wheel_last[level][timer->slot];
+    timer->next_timer = NULL;
+    if (js_timer_wheel[level][timer->slot])
+        (js_timer_wheel_last[level][timer->slot])->next_timer = timer;
+    else
+        js_timer_wheel[level][timer->slot] = timer;
+    js_timer_wheel_last[level][timer->slot] = timer;
+    js_timer_wheel_count[level]++;
+}
+
+/*
+ * Checks if the wheel is empty.
+ */
+
+static int
+weechat_js_timer_wheel_is_empty ()
+{
+    int level;
+
+    for (level = 0; level < JS_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (js_timer_wheel_count[level] > 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Removes a timer from the wheel.
+ */
+
+static void
+weechat_js_timer_wheel_unlink (struct t_js_timer *timer)
+{
+    if (timer->level < 0)
+        return;
+
+    if (timer->prev_timer)
+        (timer->prev_timer)->next_timer = timer->next_timer;
+    if (timer->next_timer)
+        (timer->next_timer)->prev_timer = timer->prev_timer;
+    if (js_timer_wheel[timer->level][timer->slot] == timer)
+        js_timer_wheel[timer->level][timer->slot] = timer->next_timer;
+    if (js_timer_wheel_last[timer->level][timer->slot] == timer)
+        js_timer_wheel_last[timer->level][timer->slot] = timer->prev_timer;
+    js_timer_wheel_count[timer->level]--;
+
+    timer->level = -1;
+    timer->prev_timer = NULL;
+    timer->next_timer = NULL;
+}
+
+/*
+ * Frees a timer.
+ */
+
+static void
+weechat_js_timer_free (struct t_js_timer *timer)
+{
+    weechat_js_timer_wheel_unlink(timer);
+    weechat_hashtable_remove(js_timers, timer->script_cb);
+    plugin_script_callback_remove(timer->script, timer->script_cb);
+    if (!timer->function.IsEmpty())
+        timer->function.Dispose();
+    if (!timer->arguments.IsEmpty())
+        timer->arguments.Dispose();
+    delete timer;
+}
+
+/*
+ * Callback for the WeeChat timer.
+ */
+
+static int weechat_js_timer_cb (void *data, int remaining_calls);
+
+/*
+ * Arms WeeChat timer so that it fires at given tick.
+ */
+
+static void
+weechat_js_timer_arm (unsigned long long expiry)
+{
+    unsigned long long now;
+    long interval;
+
+    if (js_timer_hook)
+        weechat_unhook(js_timer_hook);
+
+    now = weechat_js_timer_now();
+    interval = (expiry > now) ? (long) (expiry - now) : 1;
+
+    js_timer_hook = weechat_hook_timer(interval, 0, 1,
+                                       &weechat_js_timer_cb, NULL);
+    js_timer_hook_expiry = expiry;
+}
+
+/*
+ * Searches next tick where something has to be done in the wheel: expiration
+ * of a timer in first level or cascade of a slot in upper levels.
+ *
+ * Returns 1 if found, 0 if wheel is empty.
+ */
+
+static int
+weechat_js_timer_next_expiry (unsigned long long *expiry)
+{
+    unsigned long long tick;
+    int found, level, shift, i;
+
+    found = 0;
+
+    if (js_timer_wheel_count[0] > 0)
+    {
+        for (i = 0; i < JS_TIMER_WHEEL_ROOT_SIZE; i++)
+        {
+            tick = js_timer_current + i;
+            if (js_timer_wheel[0][tick & (JS_TIMER_WHEEL_ROOT_SIZE - 1)])
+            {
+                *expiry = tick;
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    for (level = 1; level < JS_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (js_timer_wheel_count[level] == 0)
+            continue;
+        shift = weechat_js_timer_level_shift(level);
+        for (i = 0; i <= JS_TIMER_WHEEL_SIZE; i++)
+        {
+            tick = ((js_timer_current >> shift) + i) << shift;
+            if (tick < js_timer_current)
+                continue;
+            if (js_timer_wheel[level][(tick >> shift) & (JS_TIMER_WHEEL_SIZE - 1)])
+            {
+                if (!found || (tick < *expiry))
+                    *expiry = tick;
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Re-arms (or removes) WeeChat timer for next deadline of the wheel.
+ */
+
+static void
+weechat_js_timer_schedule ()
+{
+    unsigned long long expiry;
+
+    if (!weechat_js_timer_next_expiry(&expiry))
+    {
+        if (js_timer_hook)
+        {
+            weechat_unhook(js_timer_hook);
+            js_timer_hook = NULL;
+        }
+        return;
+    }
+
+    if (js_timer_hook && (js_timer_hook_expiry <= expiry))
+        return;
+
+    weechat_js_timer_arm(expiry);
+}
+
+/*
+ * Moves timers of current slot of a level to lower levels.
+ *
+ * Returns index of slot cascaded.
+ */
+
+static int
+weechat_js_timer_cascade (int level)
+{
+    struct t_js_timer *ptr_timer, *next_timer;
+    int index;
+
+    index = (js_timer_current >> weechat_js_timer_level_shift(level))
+        & (JS_TIMER_WHEEL_SIZE - 1);
+
+    ptr_timer = js_timer_wheel[level][index];
+    js_timer_wheel[level][index] = NULL;
+    js_timer_wheel_last[level][index] = NULL;
+    while (ptr_timer)
+    {
+        next_timer = ptr_timer->next_timer;
+        js_timer_wheel_count[level]--;
+        weechat_js_timer_wheel_insert(ptr_timer);
+        ptr_timer = next_timer;
+    }
+
+    return index;
+}
+
+/*
+ * Runs a timer which has expired.
+ *
+ * A one-shot timer is freed before its function is called, an interval is
+ * rescheduled first: in both cases the script can clear any timer from the
+ * callback.
+ */
+
+static void
+weechat_js_timer_run (struct t_js_timer *timer, unsigned long long now)
+{
+    HandleScope scope;
+    struct t_plugin_script *script;
+    Handle<Function> function;
+    Handle<Value> argv[JS_TIMER_MAX_ARGS];
+    char *function_name;
+    int i, argc;
+
+    script = timer->script;
+    function_name = NULL;
+    if (!timer->function.IsEmpty())
+        function = Local<Function>::New(timer->function);
+    else if (timer->script_cb->function)
+        function_name = strdup(timer->script_cb->function);
+
+    argc = 0;
+    if (!timer->arguments.IsEmpty())
+    {
+        argc = timer->arguments->Length();
+        if (argc > JS_TIMER_MAX_ARGS)
+            argc = JS_TIMER_MAX_ARGS;
+        for (i = 0; i < argc; i++)
+            argv[i] = timer->arguments->Get(i);
+    }
+
+    if (timer->interval > 0)
+    {
+        timer->expires = now + timer->interval;
+        weechat_js_timer_wheel_insert(timer);
+    }
+    else
+        weechat_js_timer_free(timer);
+
+    if (!function.IsEmpty())
+        weechat_js_exec_function(script, function, argc, argv, "timer");
+    else if (function_name)
+        weechat_js_exec_function(script, function_name, argc, argv, "timer");
+
+    if (function_name)
+        free(function_name);
+}
+
+/*
+ * Processes all ticks of the wheel up to now.
+ */
+
+static void
+weechat_js_timer_advance (unsigned long long now)
+{
+    struct t_js_timer *ptr_timer;
+    unsigned long long next;
+    int level, shift, index;
+
+    js_timer_advancing = 1;
+
+    while (js_timer_current <= now)
+    {
+        for (level = 0; level < JS_TIMER_WHEEL_LEVELS; level++)
+        {
+            if (js_timer_wheel_count[level] > 0)
+                break;
+        }
+        if (level == JS_TIMER_WHEEL_LEVELS)
+        {
+            /* wheel is empty */
+            js_timer_current = now + 1;
+            break;
+        }
+
+        /* nothing can happen before next cascade of first used level */
+        shift = weechat_js_timer_level_shift(level);
+        if ((level > 0)
+            && ((js_timer_current & ((1ULL << shift) - 1)) != 0))
+        {
+            next = ((js_timer_current >> shift) + 1) << shift;
+            js_timer_current = (next > now) ? now + 1 : next;
+            continue;
+        }
+
+        index = js_timer_current & (JS_TIMER_WHEEL_ROOT_SIZE - 1);
+        if (index == 0)
+        {
+            for (level = 1; level < JS_TIMER_WHEEL_LEVELS; level++)
+            {
+                if (weechat_js_timer_cascade(level) != 0)
+                    break;
+            }
+        }
+
+        while ((ptr_timer = js_timer_wheel[0][index]))
+        {
+            weechat_js_timer_wheel_unlink(ptr_timer);
+            weechat_js_timer_run(ptr_timer, now);
+        }
+
+        js_timer_current++;
+    }
+
+    js_timer_advancing = 0;
+}
+
+static int
+weechat_js_timer_cb (void *data, int remaining_calls)
+{
+    /* hook is removed by WeeChat after this call (max calls = 1) */
+    js_timer_hook = NULL;
+
+    weechat_js_timer_advance(weechat_js_timer_now());
+    weechat_js_timer_schedule();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Adds a timer for a script.
+ *
+ * Function is either a function object or the name of a global function.
+ * Returns the script callback, used as identifier for clearTimeout.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_timer_add (struct t_plugin_script *script,
+                      Handle<Value> function,
+                      long delay,
+                      int repeat,
+                      Handle<Array> arguments)
+{
+    struct t_js_timer *new_timer;
+    struct t_plugin_script_cb *new_script_cb;
+    unsigned long long now;
+
+    if (!script || (!function->IsFunction() && !function->IsString()))
+        return NULL;
+
+    if (function->IsString())
+    {
+        String::Utf8Value function_name(function);
+        new_script_cb = plugin_script_callback_add(script, *function_name,
+                                                   NULL);
+    }
+    else
+        new_script_cb = plugin_script_callback_add(script, "", NULL);
+    if (!new_script_cb)
+        return NULL;
+
+    new_timer = new t_js_timer;
+    new_timer->script = script;
+    new_timer->script_cb = new_script_cb;
+    if (function->IsFunction())
+        new_timer->function = Persistent<Function>::New(Handle<Function>::Cast(function));
+    if (!arguments.IsEmpty() && (arguments->Length() > 0))
+        new_timer->arguments = Persistent<Array>::New(arguments);
+
+    /* like browsers, never run a timer in the same tick */
+    if (delay < 1)
+        delay = 1;
+
+    /* an empty wheel may be far behind: catch up before inserting */
+    now = weechat_js_timer_now();
+    if (!js_timer_advancing && weechat_js_timer_wheel_is_empty())
+        js_timer_current = now;
+
+    new_timer->expires = now + delay;
+    new_timer->interval = (repeat) ? delay : 0;
+    new_timer->level = -1;
+    new_timer->slot = 0;
+    new_timer->prev_timer = NULL;
+    new_timer->next_timer = NULL;
+
+    weechat_js_timer_wheel_insert(new_timer);
+    weechat_hashtable_set(js_timers, new_script_cb, new_timer);
+
+    if (!js_timer_hook || (new_timer->expires < js_timer_hook_expiry))
+        weechat_js_timer_arm(new_timer->expires);
+
+    return new_script_cb;
+}
+
+/*
+ * Removes a timer.
+ *
+ * Returns 1 if pointer was a timer of script, 0 otherwise.
+ */
+
+int
+weechat_js_timer_remove (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_timer *ptr_timer;
+
+    if (!pointer)
+        return 0;
+
+    ptr_timer = (struct t_js_timer *) weechat_hashtable_get(js_timers, pointer);
+    if (!ptr_timer || (ptr_timer->script != script))
+        return 0;
+
+    weechat_js_timer_free(ptr_timer);
+
+    return 1;
+}
+
+/*
+ * Removes all timers of a script.
+ */
+
+void
+weechat_js_timer_remove_script (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+    struct t_js_timer *ptr_timer;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        ptr_timer = (struct t_js_timer *) weechat_hashtable_get(js_timers,
+                                                                ptr_script_cb);
+        if (ptr_timer)
+            weechat_js_timer_free(ptr_timer);
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Callback used to free all timers.
+ */
+
+static void
+weechat_js_timer_free_cb (void *data, struct t_hashtable *hashtable,
+                          const void *key, const void *value)
+{
+    weechat_js_timer_free((struct t_js_timer *) value);
+}
+
+/*
+ * Frees all timers and the WeeChat timer.
+ */
+
+void
+weechat_js_timer_end ()
+{
+    if (js_timers)
+    {
+        weechat_hashtable_map(js_timers, &weechat_js_timer_free_cb, NULL);
+        weechat_hashtable_free(js_timers);
+        js_timers = NULL;
+    }
+    if (js_timer_hook)
+    {
+        weechat_unhook(js_timer_hook);
+        js_timer_hook = NULL;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __WEECHAT_JS_TIMER_H_
+#define __WEECHAT_JS_TIMER_H_
+
+#include <v8.h>
+
+/*
+ * Timers for setTimeout/setInterval: all js timers are kept in a
+ * hierarchical timer wheel (1 ms tick), driven by a single WeeChat timer
+ * re-armed for the next deadline.
+ */
+
+#define JS_TIMER_WHEEL_LEVELS 5
+#define JS_TIMER_WHEEL_ROOT_BITS 8
+#define JS_TIMER_WHEEL_ROOT_SIZE (1 << JS_TIMER_WHEEL_ROOT_BITS)
+#define JS_TIMER_WHEEL_BITS 6
+#define JS_TIMER_WHEEL_SIZE (1 << JS_TIMER_WHEEL_BITS)
+
+struct t_js_timer
+{
+    struct t_plugin_script *script;          /* script owning the timer     */
+    struct t_plugin_script_cb *script_cb;    /* function name (if string)   */
+    v8::Persistent<v8::Function> function;   /* function (if object)        */
+    v8::Persistent<v8::Array> arguments;     /* extra arguments for call    */
+    unsigned long long expires;              /* tick of expiration          */
+    long interval;                           /* > 0 for setInterval         */
+    int level;                               /* wheel level (-1 if none)    */
+    int slot;                                /* slot in level               */
+    struct t_js_timer *prev_timer;           /* link to previous timer      */
+    struct t_js_timer *next_timer;           /* link to next timer          */
+};
+
+extern void weechat_js_timer_init (void);
+extern void weechat_js_timer_end (void);
+extern struct t_plugin_script_cb *weechat_js_timer_add (struct t_plugin_script *script,
+                                                        v8::Handle<v8::Value> function,
+                                                        long delay,
+                                                        int repeat,
+                                                        v8::Handle<v8::Array> arguments);
+extern int weechat_js_timer_remove (struct t_plugin_script *script,
+                                    void *pointer);
+extern void weechat_js_timer_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_TIMER_H_ */
@@ -0,0 +1,258 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-profile.h"
+#include "weechat-js-trace.h"
+
+int js_trace_level = JS_TRACE_LEVEL_OFF;
+
+/* ring buffer: head is written by main thread, tail by writer thread */
+struct t_js_trace_event *js_trace_ring = NULL;
+unsigned long js_trace_head = 0;
+unsigned long js_trace_tail = 0;
+unsigned long js_trace_dropped = 0;
+int js_trace_stop_thread = 0;
+
+pthread_t js_trace_thread;
+FILE *js_trace_file = NULL;
+char *js_trace_filename = NULL;
+int js_trace_count = 0;                     /* events written (for ",")  */
+int js_trace_pid = 0;
+int js_trace_tid = 0;
+
+/*
+ * Copies a string in a fixed-size field (truncated if needed).
+ */
+
+static void
+weechat_js_trace_copy (char *dest, const char *src, int size)
+{
+    int i;
+
+    for (i = 0; src && src[i] && (i < size - 1); i++)
+    {
+        dest[i] = src[i];
+    }
+    dest[i] = '\0';
+}
+
+/*
+ * Adds a span (from start to now) in ring buffer; the span is dropped if
+ * the ring buffer is full.
+ */
+
+void
+weechat_js_trace_add (const char *category, const char *script,
+                      const char *name, const char *hook,
+                      unsigned long long start)
+{
+    struct t_js_trace_event *event;
+    unsigned long head, tail;
+
+    if (!js_trace_ring)
+        return;
+
+    head = __atomic_load_n(&js_trace_head, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&js_trace_tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= JS_TRACE_RING_SIZE)
+    {
+        js_trace_dropped++;
+        return;
+    }
+
+    event = &js_trace_ring[head & (JS_TRACE_RING_SIZE - 1)];
+    weechat_js_trace_copy(event->category, category, sizeof(event->category));
+    weechat_js_trace_copy(event->script, script, sizeof(event->script));
+    weechat_js_trace_copy(event->name, name, sizeof(event->name));
+    weechat_js_trace_copy(event->hook, hook, sizeof(event->hook));
+    event->start = start;
+    event->duration = weechat_js_profile_now() - start;
+    event->tid = js_trace_tid;
+
+    __atomic_store_n(&js_trace_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Writes events of ring buffer in file (called by writer thread).
+ */
+
+static void
+weechat_js_trace_flush ()
+{
+    struct t_js_trace_event *event;
+    unsigned long head, tail;
+
+    head = __atomic_load_n(&js_trace_head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&js_trace_tail, __ATOMIC_RELAXED);
+
+    while (tail != head)
+    {
+        event = &js_trace_ring[tail & (JS_TRACE_RING_SIZE - 1)];
+        fputs((js_trace_count > 0) ? ",\n{\"name\":" : "\n{\"name\":",
+              js_trace_file);
+        weechat_js_fprint_json_string(js_trace_file, event->name);
+        fputs(",\"cat\":", js_trace_file);
+        weechat_js_fprint_json_string(js_trace_file, event->category);
+        fprintf(js_trace_file,
+                ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"script\":",
+                (double) event->start / 1000.0,
+                (double) event->duration / 1000.0,
+                js_trace_pid, event->tid);
+        weechat_js_fprint_json_string(js_trace_file, event->script);
+        if (event->hook[0])
+        {
+            fputs(",\"hook\":", js_trace_file);
+            weechat_js_fprint_json_string(js_trace_file, event->hook);
+        }
+        fputs("}}", js_trace_file);
+        js_trace_count++;
+        tail++;
+        __atomic_store_n(&js_trace_tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * Main function of writer thread.
+ */
+
+static void *
+weechat_js_trace_run (void *arg)
+{
+    struct timespec interval;
+
+    interval.tv_sec = JS_TRACE_FLUSH_INTERVAL / 1000;
+    interval.tv_nsec = (JS_TRACE_FLUSH_INTERVAL % 1000) * 1000000L;
+
+    while (!__atomic_load_n(&js_trace_stop_thread, __ATOMIC_ACQUIRE))
+    {
+        nanosleep(&interval, NULL);
+        weechat_js_trace_flush();
+    }
+    weechat_js_trace_flush();
+
+    return NULL;
+}
+
+/*
+ * Starts tracing in a file in WeeChat home.
+ *
+ * Returns 1 if OK, 0 if error (already started or file error).
+ */
+
+int
+weechat_js_trace_start (int level)
+{
+    if (js_trace_file || (level <= JS_TRACE_LEVEL_OFF))
+        return 0;
+
+    js_trace_filename = weechat_js_dump_filename("trace", "json");
+    if (!js_trace_filename)
+        return 0;
+    js_trace_file = fopen(js_trace_filename, "w");
+    js_trace_ring = (struct t_js_trace_event *) malloc(JS_TRACE_RING_SIZE
+                                                       * sizeof(*js_trace_ring));
+    if (!js_trace_file || !js_trace_ring)
+        goto error;
+
+    js_trace_head = 0;
+    js_trace_tail = 0;
+    js_trace_dropped = 0;
+    js_trace_count = 0;
+    js_trace_stop_thread = 0;
+    js_trace_pid = getpid();
+    js_trace_tid = syscall(SYS_gettid);
+
+    fprintf(js_trace_file,
+            "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"weechat main\"}}",
+            js_trace_pid, js_trace_tid);
+    js_trace_count = 1;
+
+    if (pthread_create(&js_trace_thread, NULL, &weechat_js_trace_run, NULL) != 0)
+        goto error;
+
+    js_trace_level = level;
+
+    return 1;
+
+error:
+    if (js_trace_file)
+    {
+        fclose(js_trace_file);
+        js_trace_file = NULL;
+    }
+    if (js_trace_ring)
+    {
+        free(js_trace_ring);
+        js_trace_ring = NULL;
+    }
+    free(js_trace_filename);
+    js_trace_filename = NULL;
+    return 0;
+}
+
+/*
+ * Stops tracing: remaining events are written and file is closed.
+ *
+ * Returns name of file written (must be freed after use), NULL if tracing
+ * was not started.
+ */
+
+char *
+weechat_js_trace_stop ()
+{
+    char *filename;
+
+    if (!js_trace_file)
+        return NULL;
+
+    js_trace_level = JS_TRACE_LEVEL_OFF;
+
+    __atomic_store_n(&js_trace_stop_thread, 1, __ATOMIC_RELEASE);
+    pthread_join(js_trace_thread, NULL);
+
+    fprintf(js_trace_file,
+            ",\n{\"name\":\"dropped_events\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"count\":%lu}}\n]}\n",
+            js_trace_pid, js_trace_tid, js_trace_dropped);
+    fclose(js_trace_file);
+    js_trace_file = NULL;
+
+    free(js_trace_ring);
+    js_trace_ring = NULL;
+
+    filename = js_trace_filename;
+    js_trace_filename = NULL;
+
+    return filename;
+}
+
+/*
+ * Stops tracing (if started).
+ */
+
+void
+weechat_js_trace_end ()
+{
+    char *filename;
+
+    filename = weechat_js_trace_stop();
+    if (filename)
+        free(filename);
+}
@@ -0,0 +1,41 @@
+#ifndef __WEECHAT_JS_TRACE_H_
+#define __WEECHAT_JS_TRACE_H_
+
+/*
+ * Tracing in Chrome trace-event format (viewable in chrome://tracing or
+ * Perfetto): spans are stored by main thread in a lock-free ring buffer,
+ * and written to file by a background thread.
+ */
+
+#define JS_TRACE_RING_SIZE 16384             /* must be a power of 2        */
+#define JS_TRACE_FLUSH_INTERVAL 100          /* ms between writes to file   */
+#define JS_TRACE_NAME_SIZE 64
+
+enum t_js_trace_level
+{
+    JS_TRACE_LEVEL_OFF = 0,
+    JS_TRACE_LEVEL_CALLBACK,                 /* entries into js             */
+    JS_TRACE_LEVEL_API,                      /* + calls to weechat API      */
+};
+
+struct t_js_trace_event
+{
+    char category[16];                       /* "callback", "api", "load"   */
+    char name[JS_TRACE_NAME_SIZE];           /* function or API name        */
+    char script[JS_TRACE_NAME_SIZE];         /* script name                 */
+    char hook[16];                           /* hook type (callbacks)       */
+    unsigned long long start;                /* start (ns, monotonic)       */
+    unsigned long long duration;             /* duration (ns)               */
+    int tid;                                 /* thread id                   */
+};
+
+extern int js_trace_level;
+
+extern int weechat_js_trace_start (int level);
+extern char *weechat_js_trace_stop (void);
+extern void weechat_js_trace_add (const char *category, const char *script,
+                                  const char *name, const char *hook,
+                                  unsigned long long start);
+extern void weechat_js_trace_end (void);
+
+#endif /* __WEECHAT_JS_TRACE_H_ */
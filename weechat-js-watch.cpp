@@ -0,0 +1,349 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-watch.h"
+
+int js_watch_enabled = 0;                     /* 1 if files are watched    */
+int js_watch_fd = -1;                         /* inotify fd                */
+struct t_hook *js_watch_hook_fd = NULL;       /* hook on inotify fd        */
+struct t_hook *js_watch_timer = NULL;         /* timer before reload       */
+struct t_hook *js_watch_config_hook = NULL;   /* hook on option "watch"    */
+struct t_hashtable *js_watch_dirs = NULL;     /* watch descriptor -> dir   */
+struct t_weelist *js_watch_changed = NULL;    /* files changed             */
+struct t_weelist *js_watch_failed = NULL;     /* reload failed: file is    */
+                                              /* loaded on next change     */
+
+#ifdef __linux__
+
+/*
+ * Watches a directory (nothing is done if it is already watched).
+ */
+
+static void
+weechat_js_watch_add_dir (const char *directory)
+{
+    int wd;
+
+    if ((js_watch_fd < 0) || !directory || !directory[0])
+        return;
+
+    wd = inotify_add_watch(js_watch_fd, directory,
+                           IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd >= 0)
+        weechat_hashtable_set(js_watch_dirs, &wd, directory);
+}
+
+/*
+ * Watches directory of a script file.
+ */
+
+void
+weechat_js_watch_add_script (struct t_plugin_script *script)
+{
+    char *directory, *pos;
+
+    if (!js_watch_enabled || !script || !script->filename)
+        return;
+
+    directory = strdup(script->filename);
+    if (!directory)
+        return;
+    pos = strrchr(directory, '/');
+    if (pos)
+    {
+        pos[0] = '\0';
+        weechat_js_watch_add_dir((directory[0]) ? directory : "/");
+    }
+    free(directory);
+}
+
+/*
+ * Reloads scripts whose file has changed (called when no change happened
+ * during JS_WATCH_DELAY).
+ */
+
+static int
+weechat_js_watch_timer_cb (void *data, int remaining_calls)
+{
+    struct t_weelist_item *ptr_item;
+    struct t_weelist_item *ptr_failed;
+    struct t_plugin_script *ptr_script, *next_script;
+    char path_changed[PATH_MAX], path_script[PATH_MAX];
+
+    js_watch_timer = NULL;
+
+    for (ptr_item = weechat_list_get(js_watch_changed, 0); ptr_item;
+         ptr_item = weechat_list_next(ptr_item))
+    {
+        if (!realpath(weechat_list_string(ptr_item), path_changed))
+            continue;
+
+        /* script unloaded by a failed reload: load it again */
+        ptr_failed = weechat_list_search(js_watch_failed, path_changed);
+        if (ptr_failed)
+        {
+            weechat_list_remove(js_watch_failed, ptr_failed);
+            if (!weechat_js_load(path_changed))
+            {
+                weechat_list_add(js_watch_failed, path_changed,
+                                 WEECHAT_LIST_POS_END, NULL);
+            }
+            continue;
+        }
+
+        ptr_script = js_scripts;
+        while (ptr_script)
+        {
+            next_script = ptr_script->next_script;
+            if (realpath(ptr_script->filename, path_script)
+                && (strcmp(path_changed, path_script) == 0))
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s: file \"%s\" changed, "
+                                               "reloading script \"%s\""),
+                               JS_PLUGIN_NAME, weechat_list_string(ptr_item),
+                               ptr_script->name);
+                if (!weechat_js_reload(ptr_script)
+                    && !weechat_list_search(js_watch_failed, path_changed))
+                {
+                    weechat_list_add(js_watch_failed, path_changed,
+                                     WEECHAT_LIST_POS_END, NULL);
+                }
+                break;
+            }
+            ptr_script = next_script;
+        }
+    }
+    weechat_list_remove_all(js_watch_changed);
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Reads inotify events: changed js files are queued and reload is delayed
+ * until files are not changed any more.
+ */
+
+static int
+weechat_js_watch_fd_cb (void *data, int fd)
+{
+    char events[4096], path[PATH_MAX];
+    const struct inotify_event *event;
+    const char *directory;
+    ssize_t length, i;
+    size_t name_length;
+    int changed;
+
+    changed = 0;
+    while ((length = read(fd, events, sizeof(events))) > 0)
+    {
+        for (i = 0; i < length;
+             i += sizeof(struct inotify_event) + event->len)
+        {
+            event = (const struct inotify_event *) &events[i];
+            if (event->len == 0)
+                continue;
+            name_length = strlen(event->name);
+            if ((name_length < 4)
+                || (strcmp(event->name + name_length - 3, ".js") != 0))
+                continue;
+            directory = (const char *) weechat_hashtable_get(js_watch_dirs,
+                                                             &event->wd);
+            if (!directory)
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", directory, event->name);
+            if (!weechat_list_search(js_watch_changed, path))
+            {
+                weechat_list_add(js_watch_changed, path, WEECHAT_LIST_POS_END,
+                                 NULL);
+            }
+            changed = 1;
+        }
+    }
+
+    if (changed)
+    {
+        /* restart delay on each change */
+        if (js_watch_timer)
+            weechat_unhook(js_watch_timer);
+        js_watch_timer = weechat_hook_timer(JS_WATCH_DELAY, 0, 1,
+                                            &weechat_js_watch_timer_cb, NULL);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Starts watch of scripts directories.
+ */
+
+static void
+weechat_js_watch_start ()
+{
+    struct t_plugin_script *ptr_script;
+    const char *weechat_dir;
+    char directory[PATH_MAX];
+
+    if (js_watch_enabled)
+        return;
+
+    js_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (js_watch_fd < 0)
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: unable to watch scripts "
+                                       "(inotify)"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME);
+        return;
+    }
+    js_watch_enabled = 1;
+    js_watch_dirs = weechat_hashtable_new(16,
+                                          WEECHAT_HASHTABLE_INTEGER,
+                                          WEECHAT_HASHTABLE_STRING,
+                                          NULL, NULL);
+    js_watch_changed = weechat_list_new();
+    js_watch_failed = weechat_list_new();
+    js_watch_hook_fd = weechat_hook_fd(js_watch_fd, 1, 0, 0,
+                                       &weechat_js_watch_fd_cb, NULL);
+
+    weechat_dir = weechat_info_get("weechat_dir", "");
+    if (weechat_dir)
+    {
+        snprintf(directory, sizeof(directory), "%s/%s",
+                 weechat_dir, JS_PLUGIN_NAME);
+        weechat_js_watch_add_dir(directory);
+        snprintf(directory, sizeof(directory), "%s/%s/autoload",
+                 weechat_dir, JS_PLUGIN_NAME);
+        weechat_js_watch_add_dir(directory);
+    }
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        weechat_js_watch_add_script(ptr_script);
+    }
+}
+
+/*
+ * Stops watch of scripts directories.
+ */
+
+static void
+weechat_js_watch_stop ()
+{
+    if (!js_watch_enabled)
+        return;
+
+    if (js_watch_timer)
+    {
+        weechat_unhook(js_watch_timer);
+        js_watch_timer = NULL;
+    }
+    if (js_watch_hook_fd)
+    {
+        weechat_unhook(js_watch_hook_fd);
+        js_watch_hook_fd = NULL;
+    }
+    close(js_watch_fd);
+    js_watch_fd = -1;
+    weechat_hashtable_free(js_watch_dirs);
+    js_watch_dirs = NULL;
+    weechat_list_free(js_watch_changed);
+    js_watch_changed = NULL;
+    weechat_list_free(js_watch_failed);
+    js_watch_failed = NULL;
+    js_watch_enabled = 0;
+}
+
+#else
+
+void
+weechat_js_watch_add_script (struct t_plugin_script *script)
+{
+}
+
+static void
+weechat_js_watch_start ()
+{
+    weechat_printf(NULL,
+                   weechat_gettext("%s%s: watch of scripts is not supported "
+                                   "on this system"),
+                   weechat_prefix("error"), JS_PLUGIN_NAME);
+}
+
+static void
+weechat_js_watch_stop ()
+{
+}
+
+#endif /* __linux__ */
+
+/*
+ * Callback called when option "watch" is changed.
+ */
+
+static int
+weechat_js_watch_config_cb (void *data, const char *option,
+                            const char *value)
+{
+    if (value && (weechat_strcasecmp(value, "on") == 0))
+        weechat_js_watch_start();
+    else
+        weechat_js_watch_stop();
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes watch mode and its option.
+ */
+
+void
+weechat_js_watch_init ()
+{
+    const char *value;
+
+    if (!weechat_config_is_set_plugin("watch"))
+        weechat_config_set_plugin("watch", "off");
+    weechat_config_set_desc_plugin("watch",
+                                   "reload js scripts when their file is "
+                                   "changed (on/off)");
+
+    value = weechat_config_get_plugin("watch");
+    if (value && (weechat_strcasecmp(value, "on") == 0))
+        weechat_js_watch_start();
+
+    js_watch_config_hook = weechat_hook_config("plugins.var."
+                                               JS_PLUGIN_NAME ".watch",
+                                               &weechat_js_watch_config_cb,
+                                               NULL);
+}
+
+/*
+ * Ends watch mode.
+ */
+
+void
+weechat_js_watch_end ()
+{
+    if (js_watch_config_hook)
+    {
+        weechat_unhook(js_watch_config_hook);
+        js_watch_config_hook = NULL;
+    }
+    weechat_js_watch_stop();
+}
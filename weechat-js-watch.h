@@ -0,0 +1,19 @@
+#ifndef __WEECHAT_JS_WATCH_H_
+#define __WEECHAT_JS_WATCH_H_
+
+/*
+ * Watch mode (option "watch"): directories of js scripts are watched with
+ * inotify, and scripts whose file is changed are reloaded. Changes are
+ * grouped during JS_WATCH_DELAY milliseconds (editors write files in many
+ * steps), then each script changed is reloaded once.
+ */
+
+#define JS_WATCH_DELAY 200                   /* delay before reload (ms)    */
+
+extern int js_watch_enabled;
+
+extern void weechat_js_watch_init (void);
+extern void weechat_js_watch_end (void);
+extern void weechat_js_watch_add_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_WATCH_H_ */
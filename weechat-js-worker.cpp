@@ -0,0 +1,911 @@
+#undef _
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+extern "C"
+{
+#include "weechat-plugin.h"
+#include "plugin-script.h"
+#include "plugin-script-callback.h"
+#include "weechat-js.h"
+}
+
+#include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-worker.h"
+
+struct t_hashtable *js_workers = NULL;      /* script_cb -> worker       */
+
+/* messages from workers to main thread, signaled with a pipe */
+struct t_js_worker_message *js_worker_outbox = NULL;
+struct t_js_worker_message *js_worker_last_outbox = NULL;
+pthread_mutex_t js_worker_outbox_mutex = PTHREAD_MUTEX_INITIALIZER;
+int js_worker_pipe[2] = { -1, -1 };
+struct t_hook *js_worker_hook_fd = NULL;
+
+const char *js_worker_event_string[JS_WORKER_NUM_EVENTS] =
+{ "message", "error", "exit" };
+
+/*
+ * Frees a message.
+ */
+
+static void
+weechat_js_worker_message_free (struct t_js_worker_message *message)
+{
+    if (message->data)
+        free(message->data);
+    free(message);
+}
+
+/*
+ * Creates a message with a copy of a js value (in current context): byte
+ * arrays are copied as raw bytes, other values are converted to JSON.
+ *
+ * Returns pointer to message, NULL if value can not be sent.
+ */
+
+static struct t_js_worker_message *
+weechat_js_worker_message_new (struct t_js_worker *worker, int event,
+                               Handle<Value> value)
+{
+    HandleScope scope;
+    struct t_js_worker_message *new_message;
+    Handle<Object> json;
+    Handle<Value> json_value;
+    char *bytes;
+    int size;
+
+    new_message = (struct t_js_worker_message *) malloc(sizeof(*new_message));
+    if (!new_message)
+        return NULL;
+
+    new_message->worker = worker;
+    new_message->event = event;
+    new_message->next_message = NULL;
+
+    bytes = weechat_js_buffer_data(value, &size);
+    if (bytes)
+    {
+        new_message->binary = 1;
+        new_message->data = (char *) malloc((size > 0) ? size : 1);
+        if (new_message->data && (size > 0))
+            memcpy(new_message->data, bytes, size);
+        new_message->size = size;
+    }
+    else
+    {
+        new_message->binary = 0;
+        json = Context::GetCurrent()->Global()->Get(String::New("JSON"))->ToObject();
+        json_value = Handle<Function>::Cast(json->Get(String::New("stringify")))->Call(json, 1, &value);
+        if (json_value.IsEmpty() || !json_value->IsString())
+        {
+            free(new_message);
+            return NULL;
+        }
+        String::Utf8Value json_text(json_value);
+        new_message->data = strdup(*json_text);
+        new_message->size = json_text.length();
+    }
+
+    if (!new_message->data)
+    {
+        free(new_message);
+        return NULL;
+    }
+
+    return new_message;
+}
+
+/*
+ * Creates a message with a string (used for errors).
+ */
+
+static struct t_js_worker_message *
+weechat_js_worker_message_new_string (struct t_js_worker *worker, int event,
+                                      const char *string)
+{
+    struct t_js_worker_message *new_message;
+
+    new_message = (struct t_js_worker_message *) malloc(sizeof(*new_message));
+    if (!new_message)
+        return NULL;
+
+    new_message->worker = worker;
+    new_message->event = event;
+    new_message->binary = 0;
+    new_message->data = (string) ? strdup(string) : NULL;
+    new_message->size = (new_message->data) ? strlen(new_message->data) : 0;
+    new_message->next_message = NULL;
+
+    return new_message;
+}
+
+/*
+ * Frees a byte array of a worker (its data and handle).
+ */
+
+static void
+weechat_js_worker_bytes_free (struct t_js_worker_bytes *bytes)
+{
+    if (bytes->prev_bytes)
+        (bytes->prev_bytes)->next_bytes = bytes->next_bytes;
+    if (bytes->next_bytes)
+        (bytes->next_bytes)->prev_bytes = bytes->prev_bytes;
+    if (bytes->worker->bytes == bytes)
+        bytes->worker->bytes = bytes->next_bytes;
+
+    bytes->object.Dispose();
+    bytes->object.Clear();
+    free(bytes->data);
+    delete bytes;
+}
+
+/*
+ * Callback called when a byte array of a worker is garbage collected.
+ */
+
+static void
+weechat_js_worker_bytes_weak_cb (Persistent<Value> object, void *parameter)
+{
+    weechat_js_worker_bytes_free((struct t_js_worker_bytes *) parameter);
+}
+
+/*
+ * Converts a message to a js value (in current context); data of message
+ * is given to the byte array in worker (main thread uses buffer pool).
+ */
+
+static Handle<Value>
+weechat_js_worker_message_value (struct t_js_worker_message *message,
+                                 int main_thread)
+{
+    HandleScope scope;
+    TryCatch try_catch;
+    Handle<Object> json, obj;
+    Handle<Value> argv[1], value;
+    struct t_js_worker_bytes *new_bytes;
+
+    if (message->binary && main_thread)
+        return scope.Close(weechat_js_buffer_new(message->data, message->size));
+
+    if (message->binary)
+    {
+        obj = Object::New();
+        obj->SetIndexedPropertiesToExternalArrayData(message->data,
+                                                     kExternalUnsignedByteArray,
+                                                     message->size);
+        obj->Set(String::New("length"), Integer::New(message->size), ReadOnly);
+        new_bytes = new t_js_worker_bytes;
+        new_bytes->data = message->data;
+        new_bytes->worker = message->worker;
+        new_bytes->object = Persistent<Object>::New(obj);
+        new_bytes->object.MakeWeak(new_bytes, &weechat_js_worker_bytes_weak_cb);
+        new_bytes->prev_bytes = NULL;
+        new_bytes->next_bytes = message->worker->bytes;
+        if (message->worker->bytes)
+            message->worker->bytes->prev_bytes = new_bytes;
+        message->worker->bytes = new_bytes;
+        message->data = NULL;
+        return scope.Close(obj);
+    }
+
+    if (message->event != JS_WORKER_EVENT_MESSAGE)
+        return scope.Close(String::New((message->data) ? message->data : ""));
+
+    json = Context::GetCurrent()->Global()->Get(String::New("JSON"))->ToObject();
+    argv[0] = String::New(message->data, message->size);
+    value = Handle<Function>::Cast(json->Get(String::New("parse")))->Call(json, 1, argv);
+    if (value.IsEmpty())
+        return scope.Close(Undefined());
+
+    return scope.Close(value);
+}
+
+/*
+ * Formats exception caught in a worker.
+ *
+ * Note: result must be freed after use.
+ */
+
+static char *
+weechat_js_worker_exception (struct t_js_worker *worker, TryCatch &try_catch)
+{
+    HandleScope scope;
+    Handle<Message> message = try_catch.Message();
+    String::Utf8Value exception(try_catch.Exception());
+    char *result;
+    int length;
+
+    length = strlen(worker->filename) + 32
+        + ((*exception) ? strlen(*exception) : 0);
+    result = (char *) malloc(length);
+    if (!result)
+        return NULL;
+
+    snprintf(result, length, "%s:%d: %s",
+             worker->filename,
+             (message.IsEmpty()) ? 0 : message->GetLineNumber(),
+             (*exception) ? *exception : "?");
+
+    return result;
+}
+
+/*
+ * Sends a message to the main thread (called by worker thread).
+ */
+
+static void
+weechat_js_worker_send (struct t_js_worker_message *message)
+{
+    int was_empty;
+
+    if (!message)
+        return;
+
+    pthread_mutex_lock(&js_worker_outbox_mutex);
+    was_empty = (js_worker_outbox == NULL);
+    if (js_worker_last_outbox)
+        js_worker_last_outbox->next_message = message;
+    else
+        js_worker_outbox = message;
+    js_worker_last_outbox = message;
+    /* one byte in pipe for a batch of messages */
+    if (was_empty && (js_worker_pipe[1] >= 0))
+    {
+        if (write(js_worker_pipe[1], "w", 1) < 0)
+        {
+            /* pipe full: main thread will be woken up anyway */
+        }
+    }
+    pthread_mutex_unlock(&js_worker_outbox_mutex);
+}
+
+/*
+ * Sends an error to the main thread (called by worker thread).
+ */
+
+static void
+weechat_js_worker_send_error (struct t_js_worker *worker, TryCatch &try_catch)
+{
+    char *error;
+
+    error = weechat_js_worker_exception(worker, try_catch);
+    weechat_js_worker_send(weechat_js_worker_message_new_string(worker,
+                                                                JS_WORKER_EVENT_ERROR,
+                                                                error));
+    if (error)
+        free(error);
+}
+
+/*
+ * Function "postMessage" in worker: sends a message to script.
+ */
+
+static Handle<Value>
+weechat_js_worker_post_message_cb (const Arguments &args)
+{
+    struct t_js_worker *worker;
+    struct t_js_worker_message *message;
+
+    worker = (struct t_js_worker *) External::Unwrap(args.Data());
+
+    message = weechat_js_worker_message_new(worker, JS_WORKER_EVENT_MESSAGE,
+                                            (args.Length() > 0) ?
+                                            args[0] : Handle<Value>(Undefined()));
+    if (!message)
+    {
+        return ThrowException(Exception::TypeError(
+                                  String::New("postMessage: message can not be cloned")));
+    }
+    weechat_js_worker_send(message);
+
+    return Undefined();
+}
+
+/*
+ * Function "close" in worker: stops worker after current message.
+ */
+
+static Handle<Value>
+weechat_js_worker_close_cb (const Arguments &args)
+{
+    struct t_js_worker *worker;
+
+    worker = (struct t_js_worker *) External::Unwrap(args.Data());
+
+    pthread_mutex_lock(&worker->mutex);
+    worker->terminate = 1;
+    pthread_mutex_unlock(&worker->mutex);
+
+    return Undefined();
+}
+
+/*
+ * Runs the worker file, then calls its function "onmessage" for each
+ * message received, until worker is terminated.
+ */
+
+static void
+weechat_js_worker_loop (struct t_js_worker *worker, Handle<Context> context)
+{
+    HandleScope scope;
+    TryCatch try_catch;
+    struct t_js_worker_message *message;
+    Handle<Value> onmessage, argv[1];
+
+    Handle<Script> script = Script::Compile(String::New(worker->source),
+                                            String::New(worker->filename));
+    if (script.IsEmpty() || script->Run().IsEmpty())
+    {
+        if (try_catch.CanContinue())
+            weechat_js_worker_send_error(worker, try_catch);
+        return;
+    }
+
+    while (1)
+    {
+        pthread_mutex_lock(&worker->mutex);
+        while (!worker->inbox && !worker->terminate)
+        {
+            pthread_cond_wait(&worker->cond, &worker->mutex);
+        }
+        if (worker->terminate)
+        {
+            pthread_mutex_unlock(&worker->mutex);
+            break;
+        }
+        message = worker->inbox;
+        worker->inbox = message->next_message;
+        if (!worker->inbox)
+            worker->last_inbox = NULL;
+        pthread_mutex_unlock(&worker->mutex);
+
+        HandleScope message_scope;
+        onmessage = context->Global()->Get(String::New("onmessage"));
+        if (onmessage->IsFunction())
+        {
+            argv[0] = weechat_js_worker_message_value(message, 0);
+            try_catch.Reset();
+            if (Handle<Function>::Cast(onmessage)->Call(context->Global(),
+                                                        1, argv).IsEmpty())
+            {
+                if (!try_catch.CanContinue())
+                {
+                    /* execution terminated by main thread */
+                    weechat_js_worker_message_free(message);
+                    break;
+                }
+                weechat_js_worker_send_error(worker, try_catch);
+            }
+        }
+        weechat_js_worker_message_free(message);
+    }
+}
+
+/*
+ * Main function of worker thread: the isolate is created and disposed in
+ * this thread, and used by no other thread.
+ */
+
+static void *
+weechat_js_worker_run (void *arg)
+{
+    struct t_js_worker *worker;
+    Isolate *isolate;
+
+    worker = (struct t_js_worker *) arg;
+
+    isolate = Isolate::New();
+
+    pthread_mutex_lock(&worker->mutex);
+    worker->isolate = isolate;
+    pthread_mutex_unlock(&worker->mutex);
+
+    {
+        Isolate::Scope isolate_scope(isolate);
+        HandleScope scope;
+        Handle<ObjectTemplate> global = ObjectTemplate::New();
+        Handle<Value> data = External::Wrap(worker);
+
+        global->Set(String::New("postMessage"),
+                    FunctionTemplate::New(&weechat_js_worker_post_message_cb,
+                                          data));
+        global->Set(String::New("close"),
+                    FunctionTemplate::New(&weechat_js_worker_close_cb, data));
+
+        Persistent<Context> context = Context::New(NULL, global);
+        {
+            Context::Scope context_scope(context);
+            weechat_js_worker_loop(worker, context);
+        }
+        context.Dispose();
+
+        /* weak callbacks are not called when isolate is disposed */
+        while (worker->bytes)
+        {
+            weechat_js_worker_bytes_free(worker->bytes);
+        }
+    }
+
+    /* no TerminateExecution on this isolate after it is disposed */
+    pthread_mutex_lock(&worker->mutex);
+    worker->isolate = NULL;
+    pthread_mutex_unlock(&worker->mutex);
+    isolate->Dispose();
+
+    weechat_js_worker_send(weechat_js_worker_message_new_string(worker,
+                                                                JS_WORKER_EVENT_EXIT,
+                                                                NULL));
+
+    return NULL;
+}
+
+/*
+ * Frees a worker: it is terminated (even if running js code) and its
+ * thread is joined.
+ */
+
+static void
+weechat_js_worker_free (struct t_js_worker *worker)
+{
+    struct t_js_worker_message *ptr_message, *prev_message, *next_message;
+
+    if (worker->script_cb)
+    {
+        pthread_mutex_lock(&worker->mutex);
+        worker->terminate = 1;
+        if (worker->isolate)
+            V8::TerminateExecution(worker->isolate);
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->mutex);
+
+        pthread_join(worker->thread, NULL);
+
+        while (worker->inbox)
+        {
+            next_message = worker->inbox->next_message;
+            weechat_js_worker_message_free(worker->inbox);
+            worker->inbox = next_message;
+        }
+        worker->last_inbox = NULL;
+
+        /* remove messages not yet received by script */
+        pthread_mutex_lock(&js_worker_outbox_mutex);
+        prev_message = NULL;
+        ptr_message = js_worker_outbox;
+        while (ptr_message)
+        {
+            next_message = ptr_message->next_message;
+            if (ptr_message->worker == worker)
+            {
+                if (prev_message)
+                    prev_message->next_message = next_message;
+                else
+                    js_worker_outbox = next_message;
+                if (js_worker_last_outbox == ptr_message)
+                    js_worker_last_outbox = prev_message;
+                weechat_js_worker_message_free(ptr_message);
+            }
+            else
+                prev_message = ptr_message;
+            ptr_message = next_message;
+        }
+        pthread_mutex_unlock(&js_worker_outbox_mutex);
+
+        weechat_hashtable_remove(js_workers, worker->script_cb);
+        plugin_script_callback_remove(worker->script, worker->script_cb);
+        worker->script_cb = NULL;
+    }
+
+    /* when called from a callback of this worker, free it later */
+    if (worker->running)
+    {
+        worker->deleted = 1;
+        return;
+    }
+
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->mutex);
+    if (worker->filename)
+        free(worker->filename);
+    if (worker->source)
+        free(worker->source);
+    free(worker);
+}
+
+/*
+ * Gives a message of worker to script (on main thread).
+ */
+
+static void
+weechat_js_worker_deliver (struct t_js_worker *worker,
+                           struct t_js_worker_message *message)
+{
+    HandleScope scope;
+    Handle<Value> argv[4];
+    struct t_plugin_script_cb *script_cb;
+    WeechatJsCore *js_core;
+    char *function, *str_worker;
+
+    script_cb = worker->script_cb;
+    js_core = (WeechatJsCore *) worker->script->interpreter;
+    if (!js_core)
+    {
+        /* script can not be called, but worker has ended anyway */
+        if (message->event == JS_WORKER_EVENT_EXIT)
+            weechat_js_worker_free(worker);
+        return;
+    }
+
+    Context::Scope context_scope(js_core->getContext());
+
+    str_worker = plugin_script_ptr2str(script_cb);
+
+    argv[0] = String::New((script_cb->data) ? script_cb->data : "");
+    argv[1] = String::New((str_worker) ? str_worker : "");
+    argv[2] = String::New(js_worker_event_string[message->event]);
+    argv[3] = weechat_js_worker_message_value(message, 1);
+
+    if (str_worker)
+        free(str_worker);
+
+    /* script callback may be removed by the function itself */
+    function = strdup(script_cb->function);
+    worker->running = 1;
+    weechat_js_exec_function(worker->script, function, 4, argv, "worker");
+    worker->running = 0;
+    free(function);
+
+    if (worker->deleted)
+        weechat_js_worker_free(worker);
+    else if (message->event == JS_WORKER_EVENT_EXIT)
+        weechat_js_worker_free(worker);
+}
+
+/*
+ * Callback for messages of workers signaled on pipe.
+ */
+
+static int
+weechat_js_worker_fd_cb (void *data, int fd)
+{
+    struct t_js_worker_message *message;
+    char buffer[64];
+
+    while (read(fd, buffer, sizeof(buffer)) > 0)
+    {
+    }
+
+    while (1)
+    {
+        pthread_mutex_lock(&js_worker_outbox_mutex);
+        message = js_worker_outbox;
+        if (message)
+        {
+            js_worker_outbox = message->next_message;
+            if (!js_worker_outbox)
+                js_worker_last_outbox = NULL;
+        }
+        pthread_mutex_unlock(&js_worker_outbox_mutex);
+
+        if (!message)
+            break;
+
+        weechat_js_worker_deliver(message->worker, message);
+        weechat_js_worker_message_free(message);
+    }
+
+    return WEECHAT_RC_OK;
+}
+
+/*
+ * Initializes workers.
+ */
+
+void
+weechat_js_worker_init ()
+{
+    int i;
+
+    js_workers = weechat_hashtable_new(32,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       WEECHAT_HASHTABLE_POINTER,
+                                       NULL, NULL);
+
+    if (pipe(js_worker_pipe) < 0)
+    {
+        js_worker_pipe[0] = -1;
+        js_worker_pipe[1] = -1;
+        return;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        fcntl(js_worker_pipe[i], F_SETFL,
+              fcntl(js_worker_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(js_worker_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    js_worker_hook_fd = weechat_hook_fd(js_worker_pipe[0], 1, 0, 0,
+                                        &weechat_js_worker_fd_cb, NULL);
+}
+
+/*
+ * Reads content of a js file.
+ *
+ * Note: result must be freed after use.
+ */
+
+static char *
+weechat_js_worker_read_file (const char *filename)
+{
+    FILE *fp;
+    char *source;
+    long size;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+
+    source = (size >= 0) ? (char *) malloc(size + 1) : NULL;
+    if (source)
+    {
+        size = fread(source, 1, size, fp);
+        source[size] = '\0';
+    }
+    fclose(fp);
+
+    return source;
+}
+
+/*
+ * Starts a worker running a js file; a relative filename is searched in
+ * directory of script.
+ *
+ * Returns the script callback, used as identifier of worker.
+ */
+
+struct t_plugin_script_cb *
+weechat_js_worker_new (struct t_plugin_script *script, const char *filename,
+                       const char *function, const char *data)
+{
+    struct t_js_worker *new_worker;
+    struct t_plugin_script_cb *new_script_cb;
+    const char *pos;
+    char *path;
+    int length;
+
+    if (!script || !filename || !filename[0] || !function || !function[0]
+        || (js_worker_pipe[0] < 0))
+        return NULL;
+
+    pos = (script->filename && (filename[0] != '/')) ?
+        strrchr(script->filename, '/') : NULL;
+    if (pos)
+    {
+        length = (pos - script->filename) + 1 + strlen(filename) + 1;
+        path = (char *) malloc(length);
+        if (!path)
+            return NULL;
+        snprintf(path, length, "%.*s/%s",
+                 (int) (pos - script->filename), script->filename, filename);
+    }
+    else
+        path = strdup(filename);
+    if (!path)
+        return NULL;
+
+    new_worker = (struct t_js_worker *) malloc(sizeof(*new_worker));
+    if (!new_worker)
+    {
+        free(path);
+        return NULL;
+    }
+
+    new_worker->source = weechat_js_worker_read_file(path);
+    if (!new_worker->source)
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: unable to open file \"%s\""),
+                       weechat_prefix("error"), JS_PLUGIN_NAME, path);
+        free(path);
+        free(new_worker);
+        return NULL;
+    }
+
+    new_script_cb = plugin_script_callback_add(script, function, data);
+    if (!new_script_cb)
+    {
+        free(new_worker->source);
+        free(path);
+        free(new_worker);
+        return NULL;
+    }
+
+    new_worker->script = script;
+    new_worker->script_cb = new_script_cb;
+    new_worker->filename = path;
+    new_worker->isolate = NULL;
+    pthread_mutex_init(&new_worker->mutex, NULL);
+    pthread_cond_init(&new_worker->cond, NULL);
+    new_worker->inbox = NULL;
+    new_worker->last_inbox = NULL;
+    new_worker->bytes = NULL;
+    new_worker->terminate = 0;
+    new_worker->running = 0;
+    new_worker->deleted = 0;
+
+    if (pthread_create(&new_worker->thread, NULL,
+                       &weechat_js_worker_run, new_worker) != 0)
+    {
+        plugin_script_callback_remove(script, new_script_cb);
+        pthread_cond_destroy(&new_worker->cond);
+        pthread_mutex_destroy(&new_worker->mutex);
+        free(new_worker->source);
+        free(path);
+        free(new_worker);
+        return NULL;
+    }
+
+    weechat_hashtable_set(js_workers, new_script_cb, new_worker);
+
+    return new_script_cb;
+}
+
+/*
+ * Searches a worker of script.
+ */
+
+static struct t_js_worker *
+weechat_js_worker_search (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_worker *ptr_worker;
+
+    if (!pointer)
+        return NULL;
+
+    ptr_worker = (struct t_js_worker *) weechat_hashtable_get(js_workers,
+                                                              pointer);
+    if (!ptr_worker || (ptr_worker->script != script))
+        return NULL;
+
+    return ptr_worker;
+}
+
+/*
+ * Sends a message to a worker (value is copied, in current context).
+ *
+ * Returns 1 if OK, 0 if error.
+ */
+
+int
+weechat_js_worker_post (struct t_plugin_script *script, void *pointer,
+                        Handle<Value> message)
+{
+    struct t_js_worker *ptr_worker;
+    struct t_js_worker_message *new_message;
+
+    ptr_worker = weechat_js_worker_search(script, pointer);
+    if (!ptr_worker || ptr_worker->deleted)
+        return 0;
+
+    new_message = weechat_js_worker_message_new(ptr_worker,
+                                                JS_WORKER_EVENT_MESSAGE,
+                                                message);
+    if (!new_message)
+        return 0;
+
+    pthread_mutex_lock(&ptr_worker->mutex);
+    if (ptr_worker->last_inbox)
+        ptr_worker->last_inbox->next_message = new_message;
+    else
+        ptr_worker->inbox = new_message;
+    ptr_worker->last_inbox = new_message;
+    pthread_cond_signal(&ptr_worker->cond);
+    pthread_mutex_unlock(&ptr_worker->mutex);
+
+    return 1;
+}
+
+/*
+ * Terminates and removes a worker.
+ *
+ * Returns 1 if pointer was a worker of script, 0 otherwise.
+ */
+
+int
+weechat_js_worker_remove (struct t_plugin_script *script, void *pointer)
+{
+    struct t_js_worker *ptr_worker;
+
+    ptr_worker = weechat_js_worker_search(script, pointer);
+    if (!ptr_worker)
+        return 0;
+
+    weechat_js_worker_free(ptr_worker);
+
+    return 1;
+}
+
+/*
+ * Removes all workers of a script.
+ */
+
+void
+weechat_js_worker_remove_script (struct t_plugin_script *script)
+{
+    struct t_plugin_script_cb *ptr_script_cb, *next_script_cb;
+    struct t_js_worker *ptr_worker;
+
+    ptr_script_cb = script->callbacks;
+    while (ptr_script_cb)
+    {
+        next_script_cb = ptr_script_cb->next_callback;
+        ptr_worker = (struct t_js_worker *) weechat_hashtable_get(js_workers,
+                                                                  ptr_script_cb);
+        if (ptr_worker)
+            weechat_js_worker_free(ptr_worker);
+        ptr_script_cb = next_script_cb;
+    }
+}
+
+/*
+ * Callback used to free all workers.
+ */
+
+static void
+weechat_js_worker_free_cb (void *data, struct t_hashtable *hashtable,
+                           const void *key, const void *value)
+{
+    weechat_js_worker_free((struct t_js_worker *) value);
+}
+
+/*
+ * Terminates all workers and closes pipe.
+ */
+
+void
+weechat_js_worker_end ()
+{
+    struct t_js_worker_message *next_message;
+    int i;
+
+    if (js_workers)
+    {
+        weechat_hashtable_map(js_workers, &weechat_js_worker_free_cb, NULL);
+        weechat_hashtable_free(js_workers);
+        js_workers = NULL;
+    }
+
+    if (js_worker_hook_fd)
+    {
+        weechat_unhook(js_worker_hook_fd);
+        js_worker_hook_fd = NULL;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (js_worker_pipe[i] >= 0)
+        {
+            close(js_worker_pipe[i]);
+            js_worker_pipe[i] = -1;
+        }
+    }
+
+    while (js_worker_outbox)
+    {
+        next_message = js_worker_outbox->next_message;
+        weechat_js_worker_message_free(js_worker_outbox);
+        js_worker_outbox = next_message;
+    }
+    js_worker_last_outbox = NULL;
+}
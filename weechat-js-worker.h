@@ -0,0 +1,77 @@
+#ifndef __WEECHAT_JS_WORKER_H_
+#define __WEECHAT_JS_WORKER_H_
+
+#include <pthread.h>
+#include <v8.h>
+
+/*
+ * Workers: a js file run in its own isolate on a background thread.
+ * Messages are copied between threads (JSON, or raw bytes for byte
+ * arrays); messages for the main thread are signaled with a pipe watched
+ * by hook_fd, and given to the script on the WeeChat main loop.
+ * Byte arrays received by a worker use data of message (freed when array is
+ * garbage collected, or when isolate is disposed: weak callbacks are not
+ * called then).
+ */
+
+enum t_js_worker_event
+{
+    JS_WORKER_EVENT_MESSAGE = 0,
+    JS_WORKER_EVENT_ERROR,
+    JS_WORKER_EVENT_EXIT,
+    /* number of events */
+    JS_WORKER_NUM_EVENTS,
+};
+
+struct t_js_worker_message
+{
+    struct t_js_worker *worker;              /* worker (sender or receiver) */
+    int event;                               /* message, error or exit      */
+    int binary;                              /* 1 = data is a byte array    */
+    char *data;                              /* JSON text or bytes          */
+    int size;                                /* size of data                */
+    struct t_js_worker_message *next_message; /* link to next message       */
+};
+
+struct t_js_worker_bytes
+{
+    char *data;                              /* data of byte array          */
+    v8::Persistent<v8::Object> object;       /* byte array (weak)           */
+    struct t_js_worker *worker;              /* worker using byte array     */
+    struct t_js_worker_bytes *prev_bytes;    /* link to previous array      */
+    struct t_js_worker_bytes *next_bytes;    /* link to next array          */
+};
+
+struct t_js_worker
+{
+    struct t_plugin_script *script;          /* script owning the worker    */
+    struct t_plugin_script_cb *script_cb;    /* function/data called        */
+    char *filename;                          /* js file run by worker       */
+    char *source;                            /* content of file             */
+    v8::Isolate *isolate;                    /* isolate of worker           */
+    pthread_t thread;                        /* thread running the isolate  */
+    pthread_mutex_t mutex;                   /* lock for inbox/terminate    */
+    pthread_cond_t cond;                     /* signaled on new message     */
+    struct t_js_worker_message *inbox;       /* messages for worker         */
+    struct t_js_worker_message *last_inbox;  /* last message for worker     */
+    struct t_js_worker_bytes *bytes;         /* byte arrays alive (only     */
+                                             /* used by worker thread)      */
+    int terminate;                           /* 1 if worker must stop       */
+    int running;                             /* 1 if callback is running    */
+    int deleted;                             /* removed during callback     */
+};
+
+extern void weechat_js_worker_init (void);
+extern void weechat_js_worker_end (void);
+extern struct t_plugin_script_cb *weechat_js_worker_new (struct t_plugin_script *script,
+                                                         const char *filename,
+                                                         const char *function,
+                                                         const char *data);
+extern int weechat_js_worker_post (struct t_plugin_script *script,
+                                   void *pointer,
+                                   v8::Handle<v8::Value> message);
+extern int weechat_js_worker_remove (struct t_plugin_script *script,
+                                     void *pointer);
+extern void weechat_js_worker_remove_script (struct t_plugin_script *script);
+
+#endif /* __WEECHAT_JS_WORKER_H_ */
@@ -1,6 +1,8 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <string>
 
 extern "C"
 {
@@ -10,6 +12,27 @@ extern "C"
 }
 
 #include "weechat-js-core.h"
+#include "weechat-js-api.h"
+#include "weechat-js-signal.h"
+#include "weechat-js-timer.h"
+#include "weechat-js-microtask.h"
+#include "weechat-js-process.h"
+#include "weechat-js-buffer.h"
+#include "weechat-js-stream.h"
+#include "weechat-js-worker.h"
+#include "weechat-js-fs.h"
+#include "weechat-js-profile.h"
+#include "weechat-js-cpuprofile.h"
+#include "weechat-js-heap.h"
+#include "weechat-js-trace.h"
+#include "weechat-js-apistats.h"
+#include "weechat-js-slowlog.h"
+#include "weechat-js-cbindex.h"
+#include "weechat-js-cache.h"
+#include "weechat-js-watch.h"
+#include "weechat-js-state.h"
+#include "weechat-js-store.h"
+#include "weechat-js-option.h"
 
 WEECHAT_PLUGIN_NAME(JS_PLUGIN_NAME);
 WEECHAT_PLUGIN_DESCRIPTION("Support of js scripts");
@@ -26,6 +49,393 @@ struct t_plugin_script *js_current_script = NULL;
 struct t_plugin_script *js_registered_script = NULL;
 const char *js_current_script_filename = NULL;
 
+int js_exec_depth = 0;              /* > 0 when js code is running          */
+
+struct t_hashtable *js_scripts_by_name = NULL; /* lower name -> script     */
+
+char *js_action_install_list = NULL;  /* scripts to install (comma sep.)  */
+char *js_action_remove_list = NULL;   /* scripts to remove (comma sep.)   */
+struct t_hook *js_action_timer = NULL; /* timer running queued actions    */
+
+/*
+ * Builds key of a script in index (names are case insensitive, like in
+ * plugin_script_search).
+ */
+
+static std::string
+weechat_js_script_key (const char *name)
+{
+    std::string key;
+    const char *ptr_name;
+
+    for (ptr_name = name; ptr_name[0]; ptr_name++)
+    {
+        key += ((ptr_name[0] >= 'A') && (ptr_name[0] <= 'Z')) ?
+            (char)(ptr_name[0] - 'A' + 'a') : ptr_name[0];
+    }
+
+    return key;
+}
+
+/*
+ * Searches a js script by name (with index, instead of walking list of
+ * scripts).
+ *
+ * Returns pointer to script, NULL if not found.
+ */
+
+struct t_plugin_script *
+weechat_js_script_search (const char *name)
+{
+    if (!name || !js_scripts_by_name)
+        return NULL;
+
+    return (struct t_plugin_script *)weechat_hashtable_get(
+        js_scripts_by_name, weechat_js_script_key(name).c_str());
+}
+
+/*
+ * Adds a js script (registered) in list and index of scripts.
+ *
+ * Returns pointer to script, NULL if error.
+ */
+
+struct t_plugin_script *
+weechat_js_script_add (const char *filename, const char *name,
+                       const char *author, const char *version,
+                       const char *license, const char *description,
+                       const char *shutdown_func, const char *charset)
+{
+    struct t_plugin_script *new_script;
+
+    new_script = plugin_script_add(weechat_js_plugin,
+                                   &js_scripts, &last_js_script,
+                                   filename, name, author, version,
+                                   license, description, shutdown_func,
+                                   charset);
+    if (new_script && js_scripts_by_name)
+    {
+        weechat_hashtable_set(js_scripts_by_name,
+                              weechat_js_script_key(new_script->name).c_str(),
+                              new_script);
+    }
+
+    return new_script;
+}
+
+/*
+ * Removes a js script from index and list of scripts.
+ */
+
+void
+weechat_js_script_remove (struct t_plugin_script *script)
+{
+    if (js_scripts_by_name && script->name
+        && (weechat_js_script_search(script->name) == script))
+    {
+        weechat_hashtable_remove(js_scripts_by_name,
+                                 weechat_js_script_key(script->name).c_str());
+    }
+
+    weechat_js_cbindex_remove_script(script);
+
+    plugin_script_remove(weechat_js_plugin, &js_scripts, &last_js_script,
+                         script);
+}
+
+/*
+ * Calls a function of a script, by name or function object (if not empty),
+ * with arguments already converted to JS values.
+ *
+ * Names of script and function are copied before the call: the callback may
+ * unload the script (or remove the callback holding the name).
+ */
+
+static Handle<Value>
+weechat_js_exec_call (struct t_plugin_script *script,
+                      const char *function, Handle<Function> function_object,
+                      int argc, Handle<Value> *argv,
+                      const char *hook_type)
+{
+    HandleScope scope;
+    struct t_plugin_script *old_js_current_script;
+    WeechatJsCore *old_js_current_core;
+    Handle<Value> ret_js;
+    unsigned long long start;
+    struct t_js_slowlog_frame slowlog_frame;
+    char *script_name, *function_name;
+
+    if (function_object.IsEmpty())
+        function_name = strdup(function);
+    else
+    {
+        String::Utf8Value name(function_object->GetName());
+        function_name = strdup((*name && (*name)[0]) ? *name : "(anonymous)");
+    }
+    script_name = strdup(script->name);
+    if (!function_name || !script_name)
+    {
+        if (function_name)
+            free(function_name);
+        if (script_name)
+            free(script_name);
+        return Handle<Value>();
+    }
+
+    old_js_current_script = js_current_script;
+    old_js_current_core = js_current_core;
+    js_current_script = script;
+    js_current_core = (WeechatJsCore *) script->interpreter;
+
+    start = weechat_js_profile_now();
+    weechat_js_slowlog_enter(&slowlog_frame, start);
+    js_exec_depth++;
+    if (function_object.IsEmpty())
+        ret_js = js_current_core->execFunction(function_name, argc, argv);
+    else
+        ret_js = js_current_core->callFunction(function_object, argc, argv);
+    js_exec_depth--;
+    weechat_js_profile_add(script_name, function_name, start);
+    weechat_js_slowlog_leave(&slowlog_frame, script_name, function_name,
+                             hook_type);
+    if (js_trace_level)
+    {
+        weechat_js_trace_add("callback", script_name, function_name,
+                             (hook_type) ? hook_type : "callback", start);
+    }
+
+    js_current_script = old_js_current_script;
+    js_current_core = old_js_current_core;
+
+    free(script_name);
+    free(function_name);
+
+    /* run tasks queued by the callback (promise reactions) */
+    if (js_exec_depth == 0)
+        weechat_js_microtask_drain();
+
+    if (ret_js.IsEmpty())
+        return Handle<Value>();
+
+    return scope.Close(ret_js);
+}
+
+/*
+ * Calls a function of a script with arguments already converted to JS values.
+ *
+ * Current script/core are set during the call and restored afterwards, so
+ * this is safe to use from nested callbacks.
+ */
+
+Handle<Value>
+weechat_js_exec_function (struct t_plugin_script *script,
+                          const char *function,
+                          int argc, Handle<Value> *argv,
+                          const char *hook_type)
+{
+    if (!script || !script->interpreter || !function || !function[0])
+        return Handle<Value>();
+
+    return weechat_js_exec_call(script, function, Handle<Function>(),
+                                argc, argv, hook_type);
+}
+
+/*
+ * Calls a function object of a script (for example a callback given to
+ * setTimeout).
+ */
+
+Handle<Value>
+weechat_js_exec_function (struct t_plugin_script *script,
+                          Handle<Function> function,
+                          int argc, Handle<Value> *argv,
+                          const char *hook_type)
+{
+    if (!script || !script->interpreter || function.IsEmpty())
+        return Handle<Value>();
+
+    return weechat_js_exec_call(script, NULL, function,
+                                argc, argv, hook_type);
+}
+
+/*
+ * Executes a js function.
+ *
+ * Format is a string with one char per argument: "s" for a string,
+ * "i" for an integer and "h" for a hashtable.
+ */
+
+void *
+weechat_js_exec (struct t_plugin_script *script,
+                 int ret_type, const char *function,
+                 const char *format, void **argv)
+{
+    HandleScope scope;
+    Handle<Value> argv2[16], ret_js;
+    int i, argc, *ret_int;
+    void *ret_value;
+
+    argc = 0;
+    if (format && format[0])
+    {
+        argc = strlen(format);
+        if (argc > 16)
+            argc = 16;
+        for (i = 0; i < argc; i++)
+        {
+            switch (format[i])
+            {
+                case 's': /* string */
+                    argv2[i] = String::New((argv[i]) ? (char *) argv[i] : "");
+                    break;
+                case 'i': /* integer */
+                    argv2[i] = Integer::New(*((int *) argv[i]));
+                    break;
+                case 'h': /* hash */
+                    argv2[i] = weechat_js_hashtable_to_object((struct t_hashtable *) argv[i]);
+                    break;
+                default:
+                    argv2[i] = Undefined();
+                    break;
+            }
+        }
+    }
+
+    ret_js = weechat_js_exec_function(script, function, argc, argv2);
+    if (ret_js.IsEmpty())
+        return NULL;
+
+    ret_value = NULL;
+    if ((ret_type == WEECHAT_SCRIPT_EXEC_INT)
+        && weechat_js_microtask_watch_promise(script, ret_js, function))
+    {
+        /* asynchronous callback: result is not known yet */
+        ret_int = (int *) malloc(sizeof(*ret_int));
+        if (ret_int)
+            *ret_int = WEECHAT_RC_OK;
+        ret_value = ret_int;
+    }
+    else if ((ret_type == WEECHAT_SCRIPT_EXEC_STRING) && ret_js->IsString())
+    {
+        String::Utf8Value str(ret_js);
+        ret_value = strdup(*str);
+    }
+    else if ((ret_type == WEECHAT_SCRIPT_EXEC_INT)
+             && (ret_js->IsNumber() || ret_js->IsBoolean()))
+    {
+        ret_int = (int *) malloc(sizeof(*ret_int));
+        if (ret_int)
+            *ret_int = ret_js->Int32Value();
+        ret_value = ret_int;
+    }
+    else if ((ret_type == WEECHAT_SCRIPT_EXEC_HASHTABLE) && ret_js->IsObject())
+    {
+        ret_value = weechat_js_object_to_hashtable(ret_js->ToObject(),
+                                                   WEECHAT_SCRIPT_HASHTABLE_DEFAULT_SIZE,
+                                                   WEECHAT_HASHTABLE_STRING,
+                                                   WEECHAT_HASHTABLE_STRING);
+    }
+    else
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: function \"%s\" must return "
+                                       "a valid value"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME, function);
+    }
+
+    return ret_value;
+}
+
+/*
+ * Builds name of a dump file in WeeChat home:
+ * "<weechat_dir>/js_<name>_<date>.<extension>".
+ *
+ * Note: result must be freed after use.
+ */
+
+char *
+weechat_js_dump_filename (const char *name, const char *extension)
+{
+    const char *weechat_dir;
+    char date[32], *filename;
+    time_t now;
+    int length;
+
+    weechat_dir = weechat_info_get("weechat_dir", "");
+    if (!weechat_dir || !name || !extension)
+        return NULL;
+
+    now = time(NULL);
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+
+    length = strlen(weechat_dir) + strlen(name) + strlen(date)
+        + strlen(extension) + 16;
+    filename = (char *) malloc(length);
+    if (!filename)
+        return NULL;
+    snprintf(filename, length, "%s/js_%s_%s.%s",
+             weechat_dir, name, date, extension);
+
+    return filename;
+}
+
+/*
+ * Writes a string as a JSON string (with quotes) in a file.
+ */
+
+void
+weechat_js_fprint_json_string (FILE *file, const char *string)
+{
+    const unsigned char *ptr_string;
+
+    fputc('"', file);
+    for (ptr_string = (const unsigned char *) string;
+         ptr_string && ptr_string[0]; ptr_string++)
+    {
+        switch (ptr_string[0])
+        {
+            case '"':
+                fputs("\\\"", file);
+                break;
+            case '\\':
+                fputs("\\\\", file);
+                break;
+            case '\n':
+                fputs("\\n", file);
+                break;
+            case '\t':
+                fputs("\\t", file);
+                break;
+            default:
+                if (ptr_string[0] < 0x20)
+                    fprintf(file, "\\u%04x", ptr_string[0]);
+                else
+                    fputc(ptr_string[0], file);
+                break;
+        }
+    }
+    fputc('"', file);
+}
+
+/*
+ * Removes signals, timers, processes, streams, workers, file jobs, stores,
+ * option handles and queued tasks of a script.
+ */
+
+void
+weechat_js_remove_script_hooks (struct t_plugin_script *script)
+{
+    weechat_js_signal_remove_script(script);
+    weechat_js_timer_remove_script(script);
+    weechat_js_process_remove_script(script);
+    weechat_js_stream_remove_script(script);
+    weechat_js_worker_remove_script(script);
+    weechat_js_fs_remove_script(script);
+    weechat_js_store_remove_script(script);
+    weechat_js_option_remove_script(script);
+    weechat_js_microtask_remove_script(script);
+}
+
 /*
  * Load a js script.
  */
@@ -33,7 +443,10 @@ const char *js_current_script_filename = NULL;
 int
 weechat_js_load (const char *filename)
 {
+    HandleScope scope;
     FILE *fp;
+    bool rc;
+    unsigned long long start;
 
     if ((fp = fopen(filename, "r")) == NULL)
     {
@@ -81,14 +494,28 @@ weechat_js_load (const char *filename)
         /* if script was registered, remove it from list */
         if (js_current_script)
         {
-            plugin_script_remove (weechat_js_plugin, &js_scripts, &last_js_script,
-                                  js_current_script);
+            weechat_js_script_remove(js_current_script);
         }
 
         return 0;
     }
 
-    if (!js_current_core->execute())
+    start = weechat_js_profile_now();
+    js_exec_depth++;
+    rc = js_current_core->execute();
+    js_exec_depth--;
+    weechat_js_profile_add((js_registered_script) ?
+                           js_registered_script->name : filename,
+                           "(load)", start);
+    if (js_trace_level)
+    {
+        weechat_js_trace_add("load",
+                             (js_registered_script) ?
+                             js_registered_script->name : filename,
+                             "(load)", NULL, start);
+    }
+
+    if (!rc)
     {
         weechat_printf (NULL,
                         weechat_gettext("%s%s: unable to execute file "
@@ -96,6 +523,14 @@ weechat_js_load (const char *filename)
                         weechat_prefix("error"), JS_PLUGIN_NAME, filename);
         delete js_current_core;
         fclose(fp);
+
+        /* if script was registered, remove it from list */
+        if (js_registered_script)
+        {
+            weechat_js_remove_script_hooks(js_registered_script);
+            weechat_js_script_remove(js_registered_script);
+        }
+
         return 0;
     }
 
@@ -115,6 +550,13 @@ weechat_js_load (const char *filename)
 
     js_current_script->interpreter = js_current_core;
 
+    weechat_js_watch_add_script(js_current_script);
+
+    /* state kept by previous instance of script (reload) */
+    weechat_js_state_restore(js_current_script);
+
+    weechat_js_microtask_drain();
+
     weechat_hook_signal_send ("lua_script_loaded", WEECHAT_HOOK_SIGNAL_STRING,
                               js_current_script->filename);
 
@@ -149,8 +591,10 @@ weechat_js_unload (struct t_plugin_script *script)
         js_current_script = (js_current_script->prev_script) ?
             js_current_script->prev_script : js_current_script->next_script;
 
-    plugin_script_remove(weechat_js_plugin, &js_scripts,
-                         &last_js_script, script);
+    weechat_js_remove_script_hooks(script);
+    weechat_js_heap_remove_script(script);
+
+    weechat_js_script_remove(script);
 
     if (interpreter)
         delete ((WeechatJsCore *) interpreter);
@@ -162,6 +606,91 @@ weechat_js_unload (struct t_plugin_script *script)
         free(filename);
 }
 
+/*
+ * Unloads a js script by name.
+ */
+
+void
+weechat_js_unload_name (const char *name)
+{
+    struct t_plugin_script *ptr_script;
+
+    ptr_script = weechat_js_script_search(name);
+    if (ptr_script)
+    {
+        weechat_js_unload(ptr_script);
+        if (!js_quiet)
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("%s: script \"%s\" unloaded"),
+                           JS_PLUGIN_NAME, name);
+        }
+    }
+    else
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: script \"%s\" not loaded"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME, name);
+    }
+}
+
+/*
+ * Reloads a js script: hooks, config and interpreter of script are freed,
+ * then file is loaded again (its pre-parse data is reused if file did not
+ * change). The value returned by "onUnload" of script (if defined) is given
+ * to "onLoad" of new script; if load fails, it is kept for next load of file.
+ *
+ * Returns:
+ *   1: script reloaded
+ *   0: error (script is unloaded)
+ */
+
+int
+weechat_js_reload (struct t_plugin_script *script)
+{
+    char *filename;
+    int rc;
+
+    filename = strdup(script->filename);
+    if (!filename)
+        return 0;
+
+    weechat_js_state_save(script);
+    weechat_js_unload(script);
+    rc = weechat_js_load(filename);
+
+    free(filename);
+
+    return rc;
+}
+
+/*
+ * Reloads a js script by name.
+ */
+
+void
+weechat_js_reload_name (const char *name)
+{
+    struct t_plugin_script *ptr_script;
+
+    ptr_script = weechat_js_script_search(name);
+    if (ptr_script)
+    {
+        if (weechat_js_reload(ptr_script) && !js_quiet)
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("%s: script \"%s\" reloaded"),
+                           JS_PLUGIN_NAME, name);
+        }
+    }
+    else
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: script \"%s\" not loaded"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME, name);
+    }
+}
+
 /*
  * Unload all js scripts.
  */
@@ -175,6 +704,24 @@ weechat_js_unload_all ()
     }
 }
 
+/*
+ * Reloads all js scripts (scripts in autoload directory are loaded).
+ */
+
+void
+weechat_js_reload_all ()
+{
+    struct t_plugin_script *ptr_script;
+
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        weechat_js_state_save(ptr_script);
+    }
+    weechat_js_unload_all();
+    plugin_script_auto_load(weechat_js_plugin, &weechat_js_load_cb);
+}
+
 /*
  * Callback for command "/js"
  */
@@ -183,13 +730,194 @@ int
 weechat_js_command_cb (void *data, struct t_gui_buffer *buffer,
                        int argc, char **argv, char **argv_eol)
 {
-    char *ptr_name, *path_script;
+    struct t_plugin_script *ptr_script;
+    char *ptr_name, *path_script, *error;
+    long number;
+    long long size;
 
     if (argc == 1)
     {
         plugin_script_display_list(weechat_js_plugin, js_scripts,
                                    NULL, 0);
     }
+    else if (weechat_strcasecmp(argv[1], "profile") == 0)
+    {
+        if ((argc >= 3) && (weechat_strcasecmp(argv[2], "reset") == 0))
+        {
+            weechat_js_profile_reset();
+            weechat_printf(NULL, weechat_gettext("%s: profile reset"),
+                           JS_PLUGIN_NAME);
+        }
+        else if ((argc >= 3) && (weechat_strcasecmp(argv[2], "top") == 0))
+        {
+            number = (argc >= 4) ? strtol(argv[3], &error, 10) : 0;
+            weechat_js_profile_display_top((argc >= 4) && error && !error[0]
+                                           && (number > 0) ?
+                                           (int) number : JS_PROFILE_TOP_DEFAULT);
+        }
+        else
+            weechat_js_profile_display_top(JS_PROFILE_TOP_DEFAULT);
+    }
+    else if (weechat_strcasecmp(argv[1], "cpuprofile") == 0)
+    {
+        if ((argc < 4)
+            || ((weechat_strcasecmp(argv[2], "start") != 0)
+                && (weechat_strcasecmp(argv[2], "stop") != 0)))
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("%s%s: usage: /js cpuprofile "
+                                           "start|stop <script>"),
+                           weechat_prefix("error"), JS_PLUGIN_NAME);
+        }
+        else if (weechat_strcasecmp(argv[2], "start") == 0)
+        {
+            if (!weechat_js_script_search(argv[3]))
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: script \"%s\" not loaded"),
+                               weechat_prefix("error"), JS_PLUGIN_NAME,
+                               argv[3]);
+            }
+            else if (!weechat_js_cpuprofile_start(argv[3]))
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: CPU profile already "
+                                               "running for script \"%s\""),
+                               weechat_prefix("error"), JS_PLUGIN_NAME,
+                               argv[3]);
+            }
+            else
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s: CPU profile started for "
+                                               "script \"%s\""),
+                               JS_PLUGIN_NAME, argv[3]);
+            }
+        }
+        else
+        {
+            path_script = weechat_js_cpuprofile_stop(argv[3]);
+            if (path_script)
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s: CPU profile of script "
+                                               "\"%s\" written in \"%s\""),
+                               JS_PLUGIN_NAME, argv[3], path_script);
+                free(path_script);
+            }
+            else
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: unable to write CPU "
+                                               "profile of script \"%s\""),
+                               weechat_prefix("error"), JS_PLUGIN_NAME,
+                               argv[3]);
+            }
+        }
+    }
+    else if (weechat_strcasecmp(argv[1], "heap") == 0)
+    {
+        ptr_script = (argc >= 3) ?
+            weechat_js_script_search(argv[2]) : NULL;
+        if ((argc >= 3) && !ptr_script)
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("%s%s: script \"%s\" not loaded"),
+                           weechat_prefix("error"), JS_PLUGIN_NAME, argv[2]);
+        }
+        else if ((argc >= 4) && (weechat_strcasecmp(argv[3], "snapshot") == 0))
+        {
+            path_script = weechat_js_heap_snapshot(ptr_script, &size);
+            weechat_js_heap_display(ptr_script);
+            if (path_script)
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s: heap snapshot written in "
+                                               "\"%s\""),
+                               JS_PLUGIN_NAME, path_script);
+                free(path_script);
+            }
+            else
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: unable to write heap "
+                                               "snapshot"),
+                               weechat_prefix("error"), JS_PLUGIN_NAME);
+            }
+        }
+        else
+            weechat_js_heap_display(ptr_script);
+    }
+    else if (weechat_strcasecmp(argv[1], "apistats") == 0)
+    {
+        if ((argc >= 3) && (weechat_strcasecmp(argv[2], "on") == 0))
+        {
+            js_apistats_enabled = 1;
+            weechat_printf(NULL, weechat_gettext("%s: API stats enabled"),
+                           JS_PLUGIN_NAME);
+        }
+        else if ((argc >= 3) && (weechat_strcasecmp(argv[2], "off") == 0))
+        {
+            js_apistats_enabled = 0;
+            weechat_printf(NULL, weechat_gettext("%s: API stats disabled"),
+                           JS_PLUGIN_NAME);
+        }
+        else if ((argc >= 3) && (weechat_strcasecmp(argv[2], "reset") == 0))
+        {
+            weechat_js_apistats_reset();
+            weechat_printf(NULL, weechat_gettext("%s: API stats reset"),
+                           JS_PLUGIN_NAME);
+        }
+        else
+        {
+            weechat_js_apistats_display((argc >= 3) ? argv[2] : NULL,
+                                        JS_APISTATS_TOP_DEFAULT);
+        }
+    }
+    else if (weechat_strcasecmp(argv[1], "trace") == 0)
+    {
+        if ((argc >= 3) && (weechat_strcasecmp(argv[2], "start") == 0))
+        {
+            if (!weechat_js_trace_start((argc >= 4)
+                                        && (weechat_strcasecmp(argv[3], "api") == 0) ?
+                                        JS_TRACE_LEVEL_API : JS_TRACE_LEVEL_CALLBACK))
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: unable to start trace "
+                                               "(already running?)"),
+                               weechat_prefix("error"), JS_PLUGIN_NAME);
+            }
+            else
+            {
+                weechat_printf(NULL, weechat_gettext("%s: trace started"),
+                               JS_PLUGIN_NAME);
+            }
+        }
+        else if ((argc >= 3) && (weechat_strcasecmp(argv[2], "stop") == 0))
+        {
+            path_script = weechat_js_trace_stop();
+            if (path_script)
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s: trace written in \"%s\""),
+                               JS_PLUGIN_NAME, path_script);
+                free(path_script);
+            }
+            else
+            {
+                weechat_printf(NULL,
+                               weechat_gettext("%s%s: trace not running"),
+                               weechat_prefix("error"), JS_PLUGIN_NAME);
+            }
+        }
+        else
+        {
+            weechat_printf(NULL,
+                           weechat_gettext("%s%s: usage: /js trace "
+                                           "start [api]|stop"),
+                           weechat_prefix("error"), JS_PLUGIN_NAME);
+        }
+    }
     else if (argc == 2)
     {
         if (weechat_strcasecmp(argv[1], "list") == 0)
@@ -202,7 +930,11 @@ weechat_js_command_cb (void *data, struct t_gui_buffer *buffer,
             plugin_script_display_list(weechat_js_plugin, js_scripts,
                                        NULL, 1);
         }
-        else if (weechat_strcasecmp(argv[1], "unload"))
+        else if (weechat_strcasecmp(argv[1], "reload") == 0)
+        {
+            weechat_js_reload_all();
+        }
+        else if (weechat_strcasecmp(argv[1], "unload") == 0)
         {
             weechat_js_unload_all();
         }
@@ -231,6 +963,14 @@ weechat_js_command_cb (void *data, struct t_gui_buffer *buffer,
                     free (path_script);
             }
         }
+        else if (weechat_strcasecmp(argv[1], "reload") == 0)
+        {
+            weechat_js_reload_name(argv_eol[2]);
+        }
+        else if (weechat_strcasecmp(argv[1], "unload") == 0)
+        {
+            weechat_js_unload_name(argv_eol[2]);
+        }
     }
 
     return WEECHAT_RC_OK;
@@ -262,6 +1002,130 @@ weechat_js_hdata_cb (void *data, const char *hdata_name)
                                       hdata_name);
 }
 
+/*
+ * Adds a script in an infolist: variables of plugin_script_add_to_infolist
+ * (same as other script plugins), with heap statistics.
+ *
+ * The API does not give the item created by plugin_script_add_to_infolist,
+ * so it is built in a temporary infolist and its variables are copied.
+ */
+
+static void
+weechat_js_add_to_infolist (struct t_infolist *infolist,
+                            struct t_plugin_script *script)
+{
+    struct t_infolist *ptr_script_infolist;
+    struct t_infolist_item *ptr_item;
+    char **fields;
+    void *ptr_buffer;
+    int i, num_fields, size;
+
+    ptr_script_infolist = weechat_infolist_new();
+    if (!ptr_script_infolist)
+        return;
+
+    if (!plugin_script_add_to_infolist(weechat_js_plugin, ptr_script_infolist,
+                                       script)
+        || !weechat_infolist_next(ptr_script_infolist))
+    {
+        weechat_infolist_free(ptr_script_infolist);
+        return;
+    }
+
+    ptr_item = weechat_infolist_new_item(infolist);
+    if (!ptr_item)
+    {
+        weechat_infolist_free(ptr_script_infolist);
+        return;
+    }
+
+    /* fields are "type:name" (type is i/s/p/b/t) */
+    fields = weechat_string_split(weechat_infolist_fields(ptr_script_infolist),
+                                  ",", 0, 0, &num_fields);
+    for (i = 0; i < num_fields; i++)
+    {
+        if ((strlen(fields[i]) < 3) || (fields[i][1] != ':'))
+            continue;
+        switch (fields[i][0])
+        {
+            case 'i':
+                weechat_infolist_new_var_integer(
+                    ptr_item, fields[i] + 2,
+                    weechat_infolist_integer(ptr_script_infolist,
+                                             fields[i] + 2));
+                break;
+            case 's':
+                weechat_infolist_new_var_string(
+                    ptr_item, fields[i] + 2,
+                    weechat_infolist_string(ptr_script_infolist,
+                                            fields[i] + 2));
+                break;
+            case 'p':
+                weechat_infolist_new_var_pointer(
+                    ptr_item, fields[i] + 2,
+                    weechat_infolist_pointer(ptr_script_infolist,
+                                             fields[i] + 2));
+                break;
+            case 'b':
+                ptr_buffer = weechat_infolist_buffer(ptr_script_infolist,
+                                                     fields[i] + 2, &size);
+                weechat_infolist_new_var_buffer(ptr_item, fields[i] + 2,
+                                                ptr_buffer, size);
+                break;
+            case 't':
+                weechat_infolist_new_var_time(
+                    ptr_item, fields[i] + 2,
+                    weechat_infolist_time(ptr_script_infolist,
+                                          fields[i] + 2));
+                break;
+        }
+    }
+    if (fields)
+        weechat_string_free_split(fields);
+    weechat_infolist_free(ptr_script_infolist);
+
+    weechat_js_heap_add_to_infolist(ptr_item, script);
+}
+
+/*
+ * Builds infolist "js_script" (one script by pointer, or scripts matching
+ * arguments).
+ */
+
+static struct t_infolist *
+weechat_js_infolist_scripts (void *pointer, const char *arguments)
+{
+    struct t_infolist *ptr_infolist;
+    struct t_plugin_script *ptr_script;
+
+    if (pointer
+        && !plugin_script_valid(js_scripts, (struct t_plugin_script *) pointer))
+        return NULL;
+
+    ptr_infolist = weechat_infolist_new();
+    if (!ptr_infolist)
+        return NULL;
+
+    if (pointer)
+    {
+        weechat_js_add_to_infolist(ptr_infolist,
+                                   (struct t_plugin_script *) pointer);
+        return ptr_infolist;
+    }
+
+    for (ptr_script = js_scripts; ptr_script;
+         ptr_script = ptr_script->next_script)
+    {
+        if (!arguments || !arguments[0]
+            || weechat_string_match(ptr_script->name, arguments, 0))
+        {
+            weechat_js_add_to_infolist(ptr_infolist, ptr_script);
+        }
+    }
+
+    return ptr_infolist;
+}
+
 /*
  * Returns infolist with js scripts.
  */
@@ -275,9 +1139,15 @@ weechat_js_infolist_cb (void *data, const char *infolist_name,
 
     if (weechat_strcasecmp(infolist_name, "js_script") == 0)
     {
-        return plugin_script_infolist_list_scripts(weechat_js_plugin,
-                                                   js_scripts, pointer,
-                                                   arguments);
+        return weechat_js_infolist_scripts(pointer, arguments);
+    }
+    else if (weechat_strcasecmp(infolist_name, "js_callback_stats") == 0)
+    {
+        return weechat_js_profile_infolist(arguments);
+    }
+    else if (weechat_strcasecmp(infolist_name, "js_api_stats") == 0)
+    {
+        return weechat_js_apistats_infolist(arguments);
     }
 
     return NULL;
@@ -295,6 +1165,7 @@ weechat_js_signal_debug_dump_cb (void *data, const char *signal,
         || (weechat_strcasecmp((char *) signal_data, JS_PLUGIN_NAME) == 0))
     {
         plugin_script_print_log(weechat_js_plugin, js_scripts);
+        weechat_js_heap_print_log();
     }
 
     return WEECHAT_RC_OK;
@@ -316,17 +1187,133 @@ weechat_js_signal_buffer_closed_cb (void *data, const char *signal,
 }
 
 /*
- * Timer for executing actions.
+ * Returns names of scripts in an action list (without options like "-q",
+ * skipped as plugin_script_action_install does: only at beginning of list),
+ * as a split string (to free with weechat_string_free_split).
+ */
+
+static char **
+weechat_js_action_names (const char *list, int *num_names)
+{
+    const char *ptr_list;
+
+    *num_names = 0;
+    if (!list)
+        return NULL;
+
+    ptr_list = list;
+    while ((ptr_list[0] == ' ') || (ptr_list[0] == '-'))
+    {
+        if (ptr_list[0] == ' ')
+            ptr_list++;
+        else
+            ptr_list += (ptr_list[1]) ? 2 : 1;
+    }
+
+    return weechat_string_split(ptr_list, ",", 0, 0, num_names);
+}
+
+/*
+ * Displays result of a batch of actions (only if there are many scripts,
+ * one script is already reported by install/remove).
+ */
+
+static void
+weechat_js_action_report (const char *action, char **names, int num_names,
+                          int loaded_expected)
+{
+    std::string failed;
+    const char *base_name;
+    char *name, *pos;
+    int i, num_failed, loaded;
+
+    if (num_names < 2)
+        return;
+
+    num_failed = 0;
+    for (i = 0; i < num_names; i++)
+    {
+        /* script name is the file name without directory and extension */
+        base_name = strrchr(names[i], '/');
+        base_name = (base_name) ? base_name + 1 : names[i];
+        name = strdup(base_name);
+        if (!name)
+            continue;
+        pos = strrchr(name, '.');
+        if (pos)
+            pos[0] = '\0';
+        loaded = (weechat_js_script_search(name)) ? 1 : 0;
+        if (loaded != loaded_expected)
+        {
+            if (num_failed > 0)
+                failed += ", ";
+            failed += names[i];
+            num_failed++;
+        }
+        free(name);
+    }
+
+    if (num_failed > 0)
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s%s: %d scripts %s, %d failed: %s"),
+                       weechat_prefix("error"), JS_PLUGIN_NAME,
+                       num_names - num_failed, action, num_failed,
+                       failed.c_str());
+    }
+    else
+    {
+        weechat_printf(NULL,
+                       weechat_gettext("%s: %d scripts %s"),
+                       JS_PLUGIN_NAME, num_names, action);
+    }
+}
+
+/*
+ * Timer for executing actions: all scripts queued since first action are
+ * removed then installed in this single call.
  */
 
 int
 weechat_js_timer_action_cb (void *data, int remaining_calls)
 {
+    char **names;
+    int num_names;
+
+    /* timer is called once, then freed by WeeChat */
+    js_action_timer = NULL;
+
+    if (js_action_remove_list)
+    {
+        names = weechat_js_action_names(js_action_remove_list, &num_names);
+        plugin_script_action_remove(weechat_js_plugin, js_scripts,
+                                    &weechat_js_unload, &js_quiet,
+                                    &js_action_remove_list);
+        weechat_js_action_report("removed", names, num_names, 0);
+        if (names)
+            weechat_string_free_split(names);
+    }
+
+    if (js_action_install_list)
+    {
+        names = weechat_js_action_names(js_action_install_list, &num_names);
+        plugin_script_action_install(weechat_js_plugin, js_scripts,
+                                     &weechat_js_unload, &weechat_js_load,
+                                     &js_quiet, &js_action_install_list);
+        weechat_js_action_report("installed", names, num_names, 1);
+        if (names)
+            weechat_string_free_split(names);
+    }
+
     return WEECHAT_RC_OK;
 }
 
 /*
  * Callback called when a script action is asked (install/remove a script).
+ *
+ * Actions are queued, and run by a single timer: many actions sent at
+ * same time (for example upgrade of all scripts by script manager) are
+ * done in one pass.
  */
 
 int
@@ -334,6 +1321,29 @@ weechat_js_signal_script_action_cb (void *data, const char *signal,
                                     const char *type_data,
                                     void *signal_data)
 {
+    if (strcmp(type_data, WEECHAT_HOOK_SIGNAL_STRING) != 0)
+        return WEECHAT_RC_OK;
+
+    if (strcmp(signal, JS_PLUGIN_NAME "_script_install") == 0)
+    {
+        plugin_script_action_add(&js_action_install_list,
+                                 (const char *) signal_data);
+    }
+    else if (strcmp(signal, JS_PLUGIN_NAME "_script_remove") == 0)
+    {
+        plugin_script_action_add(&js_action_remove_list,
+                                 (const char *) signal_data);
+    }
+    else
+        return WEECHAT_RC_OK;
+
+    if (!js_action_timer)
+    {
+        js_action_timer = weechat_hook_timer(1, 0, 1,
+                                             &weechat_js_timer_action_cb,
+                                             NULL);
+    }
+
     return WEECHAT_RC_OK;
 }
 
@@ -345,6 +1355,7 @@ EXPORT int
 weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
 {
     struct t_plugin_script_init init;
+    int i, upgrading;
 
     weechat_js_plugin = plugin;
 
@@ -357,10 +1368,58 @@ weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
     init.callback_signal_script_action = &weechat_js_signal_script_action_cb;
     init.callback_load_file = &weechat_js_load_cb;
 
+    weechat_js_signal_init();
+    weechat_js_timer_init();
+    weechat_js_microtask_init();
+    weechat_js_process_init();
+    weechat_js_buffer_init();
+    weechat_js_stream_init();
+    weechat_js_worker_init();
+    weechat_js_fs_init();
+    weechat_js_store_init();
+    weechat_js_option_init();
+    weechat_js_profile_init();
+    weechat_js_cpuprofile_init();
+    weechat_js_heap_init();
+    weechat_js_apistats_init();
+    weechat_js_slowlog_init();
+    weechat_js_cbindex_init();
+    weechat_js_cache_init();
+    weechat_js_state_init();
+
+    js_scripts_by_name = weechat_hashtable_new(64,
+                                               WEECHAT_HASHTABLE_STRING,
+                                               WEECHAT_HASHTABLE_POINTER,
+                                               NULL, NULL);
+
+    /* states saved by scripts on /upgrade are given to them when loaded */
+    upgrading = 0;
+    for (i = 0; i < argc; i++)
+    {
+        if (weechat_strcasecmp(argv[i], "--upgrade") == 0)
+            upgrading = 1;
+    }
+    if (upgrading)
+        weechat_js_state_upgrade_load();
+
     js_quiet = 1;
     plugin_script_init(plugin, argc, argv, &init);
     js_quiet = 0;
 
+    /* after autoload: directories of scripts loaded are watched */
+    weechat_js_watch_init();
+
+    weechat_hook_infolist("js_callback_stats",
+                          N_("time spent in callbacks of js scripts"),
+                          NULL,
+                          N_("script name (optional)"),
+                          &weechat_js_infolist_cb, NULL);
+    weechat_hook_infolist("js_api_stats",
+                          N_("calls to weechat API by js scripts"),
+                          NULL,
+                          N_("script name (optional)"),
+                          &weechat_js_infolist_cb, NULL);
+
     plugin_script_display_short_list(weechat_js_plugin, js_scripts);
 
     return WEECHAT_RC_OK;
@@ -373,9 +1432,53 @@ weechat_plugin_init (struct t_weechat_plugin *plugin, int argc, char *argv[])
 EXPORT int
 weechat_plugin_end (struct t_weechat_plugin *plugin)
 {
+    weechat_js_watch_end();
+
     js_quiet = 1;
     plugin_script_end(plugin, &js_scripts, &weechat_js_unload_all);
     js_quiet = 0;
 
+    if (js_scripts_by_name)
+    {
+        weechat_hashtable_free(js_scripts_by_name);
+        js_scripts_by_name = NULL;
+    }
+
+    if (js_action_timer)
+    {
+        weechat_unhook(js_action_timer);
+        js_action_timer = NULL;
+    }
+    if (js_action_install_list)
+    {
+        free(js_action_install_list);
+        js_action_install_list = NULL;
+    }
+    if (js_action_remove_list)
+    {
+        free(js_action_remove_list);
+        js_action_remove_list = NULL;
+    }
+
+    weechat_js_signal_end();
+    weechat_js_timer_end();
+    weechat_js_microtask_end();
+    weechat_js_process_end();
+    weechat_js_fs_end();
+    weechat_js_store_end();
+    weechat_js_option_end();
+    weechat_js_worker_end();
+    weechat_js_stream_end();
+    weechat_js_buffer_end();
+    weechat_js_trace_end();
+    weechat_js_apistats_end();
+    weechat_js_slowlog_end();
+    weechat_js_cbindex_end();
+    weechat_js_cache_end();
+    weechat_js_state_end();
+    weechat_js_heap_end();
+    weechat_js_cpuprofile_end();
+    weechat_js_profile_end();
+
     return WEECHAT_RC_OK;
 }
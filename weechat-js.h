@@ -1,6 +1,8 @@
 #ifndef __WEECHAT_JS_H_
 #define __WEECHAT_JS_H_
 
+#include <stdio.h>
+
 #include "weechat-plugin.h"
 
 #ifdef __cplusplus
@@ -26,5 +28,28 @@ extern struct t_plugin_script *last_js_script;
 extern struct t_plugin_script *js_current_script;
 extern struct t_plugin_script *js_registered_script;
 extern const char *js_current_script_filename;
+extern int js_exec_depth;
+
+extern struct t_plugin_script *weechat_js_script_search (const char *name);
+extern struct t_plugin_script *weechat_js_script_add (const char *filename,
+                                                      const char *name,
+                                                      const char *author,
+                                                      const char *version,
+                                                      const char *license,
+                                                      const char *description,
+                                                      const char *shutdown_func,
+                                                      const char *charset);
+extern void weechat_js_script_remove (struct t_plugin_script *script);
+extern int weechat_js_load (const char *filename);
+extern void weechat_js_unload (struct t_plugin_script *script);
+extern void weechat_js_unload_name (const char *name);
+extern int weechat_js_reload (struct t_plugin_script *script);
+extern void weechat_js_reload_name (const char *name);
+extern void *weechat_js_exec (struct t_plugin_script *script,
+                              int ret_type, const char *function,
+                              const char *format, void **argv);
+extern char *weechat_js_dump_filename (const char *name,
+                                       const char *extension);
+extern void weechat_js_fprint_json_string (FILE *file, const char *string);
 
 #endif /* __WEECHAT_JS_H_ */